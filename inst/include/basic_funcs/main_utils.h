@@ -6,6 +6,7 @@
 
 #include <boost/math/special_functions/gamma.hpp>
 #include <boost/math/special_functions/beta.hpp>
+#include <unordered_map>
 
 using namespace Rcpp;
 using namespace arma;
@@ -74,7 +75,11 @@ using namespace arma;
 // 52. void pop_error  Standardized Error Messages
 // 
 // 53. void density_prep  Format All Density-related Variables Based on Density Inputs
-// 54. void equivalence_prep  Format All Equivalence Weight-related Variables Based on Input
+// 54. void dens_columns  Index Matrix Columns Holding Density Dependent Elements
+// 55. double substoch_limit  Limit Density Adjusted Element by Running Column Total
+// 56. void equivalence_prep  Format All Equivalence Weight-related Variables Based on Input
+// 
+// 57. arma::ivec stage_codes  Create Integer Codes for Strings Against a Reference Vector
 
 
 
@@ -2955,13 +2960,15 @@ namespace LefkoUtils {
   //' This function currently handles models developed with functions \code{lm()}
   //' and \code{glm()} from package \code{stats}, function \code{glm.nb()} from
   //' package \code{MASS}, function \code{zeroinfl()} from package \code{pscl},
-  //' and function \code{glmmTMB()} from package \code{glmmTMB}.
+  //' function \code{glmmTMB()} from package \code{glmmTMB}, and models of class
+  //' \code{lefkoGLM} produced by the native engine of \code{modelsearch()}.
+  //' Objects of class \code{lefkoGLM} already hold all needed components.
   //' 
   //' @keywords internal
   //' @noRd
   inline Rcpp::List S3_extractor(List object) {
     StringVector model_class = object.attr("class");
-    int model_type {0}; // 0 = unknown, 1 = lm/glm/negbin, 2 = zeroinfl, 3 = glmmTMB
+    int model_type {0}; // 0 = unknown, 1 = lm/glm/negbin, 2 = zeroinfl, 3 = glmmTMB, 4 = lefkoGLM
     
     List output;
     
@@ -2972,6 +2979,8 @@ namespace LefkoUtils {
         model_type = 2;
       } else if (stringcompare_hard(as<std::string>(model_class(i)), "glmmTMB")) {
         model_type = 3;
+      } else if (stringcompare_hard(as<std::string>(model_class(i)), "lefkoGLM")) {
+        model_type = 4;
       }
     }
     
@@ -2981,6 +2990,19 @@ namespace LefkoUtils {
       output = zeroinfl_extractor(object);
     } else if (model_type == 3) {
       output = glmmTMB_extractor(object);
+    } else if (model_type == 4) {
+      output = List::create(_["class"] = "lefkoGLM", _["family"] = object["family"],
+        _["dist"] = object["dist"], _["zero_inflated"] = object["zero_inflated"],
+        _["zero_truncated"] = object["zero_truncated"],
+        _["all_vars"] = object["all_vars"], _["fixed_vars"] = object["fixed_vars"],
+        _["fixed_slopes"] = object["fixed_slopes"],
+        _["fixed_zi_vars"] = object["fixed_zi_vars"],
+        _["fixed_zi_slopes"] = object["fixed_zi_slopes"],
+        _["random_vars"] = object["random_vars"],
+        _["random_slopes"] = object["random_slopes"],
+        _["random_zi_vars"] = object["random_zi_vars"],
+        _["random_zi_slopes"] = object["random_zi_slopes"],
+        _["sigma"] = object["sigma"], _["theta"] = object["theta"]);
     } else {
       throw Rcpp::exception("Model type unrecognized.", false);
     }
@@ -10460,6 +10482,78 @@ namespace LefkoUtils {
     }
   }
   
+  //' Index Matrix Columns Holding Density Dependent Elements
+  //' 
+  //' Function \code{dens_columns()} finds the distinct matrix columns holding
+  //' density dependent elements, so that the column totals used to enforce
+  //' substochasticity can be estimated once per column per occasion and then
+  //' updated as each element changes.
+  //' 
+  //' @name dens_columns
+  //' 
+  //' @param col_levels Vector to hold the distinct columns.
+  //' @param col_slot Vector to hold the position of each element's column
+  //' within \code{col_levels}.
+  //' @param dyn_index_col The column of each density dependent element, as
+  //' given by \code{density_prep()}.
+  //' 
+  //' @return No objects are returned, though some inputs are modified.
+  //' 
+  //' @keywords internal
+  //' @noRd
+  inline void dens_columns (arma::uvec& col_levels, arma::uvec& col_slot,
+    const arma::uvec& dyn_index_col) {
+    
+    int n_dyn_elems = static_cast<int>(dyn_index_col.n_elem);
+    
+    col_levels = unique(dyn_index_col);
+    col_slot.set_size(n_dyn_elems);
+    for (int j = 0; j < n_dyn_elems; j++) {
+      col_slot(j) = as_scalar(find(col_levels == dyn_index_col(j), 1));
+    }
+  }
+  
+  //' Limit Density Adjusted Element by Running Column Total
+  //' 
+  //' Function \code{substoch_limit()} enforces the column limit of
+  //' \code{substoch = 2} on a single density adjusted survival-transition
+  //' element, using a running total of the positive elements of its column
+  //' rather than the column itself.
+  //' 
+  //' @name substoch_limit
+  //' 
+  //' @param changing_element The density adjusted value of the element.
+  //' @param current_element The value of the element currently in the matrix.
+  //' @param col_positive The current total of positive elements in the column.
+  //' 
+  //' @return The limited value of the element. The calling function should
+  //' add the positive part of this value to \code{col_positive}, and remove
+  //' the positive part of \code{current_element}, once it is written to the
+  //' matrix.
+  //' 
+  //' @keywords internal
+  //' @noRd
+  inline double substoch_limit (double changing_element, double current_element,
+    double col_positive) {
+    
+    double barnyard_antics = col_positive - current_element + changing_element;
+    
+    if (barnyard_antics > 1.0 && changing_element > 0.0) {
+      double proposed_element = changing_element - barnyard_antics *
+        (changing_element / barnyard_antics);
+      
+      if (proposed_element >= 0.0) {
+        changing_element = proposed_element;
+      } else {
+        changing_element = 0.0;
+      }
+    } else if (changing_element < 0.0) {
+      changing_element = 0.0;
+    }
+    
+    return changing_element;
+  }
+  
   //' Format All Equivalence Weight-related Variables Based on Input
   //' 
   //' @name equivalence_prep
@@ -10574,5 +10668,51 @@ namespace LefkoUtils {
     }
   }
   
+  //' Create Integer Codes for Strings Against a Reference Vector
+  //' 
+  //' This function converts a StringVector into an integer vector of codes,
+  //' where each code gives the position of the matching string in a reference
+  //' vector, such as the stage names in a stageframe. Strings are hashed once,
+  //' so that per-row loops may compare integers rather than strings.
+  //' 
+  //' @name stage_codes
+  //' 
+  //' @param target The StringVector to code.
+  //' @param reference The StringVector holding the names to be coded. If a name
+  //' occurs more than once, then its first occurrence determines its code.
+  //' @param nomatch The code to give strings not found in \code{reference}.
+  //' Defaults to \code{0}.
+  //' 
+  //' @return An integer vector as long as \code{target}, holding the R-style
+  //' (1-based) position of each string in \code{reference}, or \code{nomatch}.
+  //' 
+  //' @section Notes:
+  //' Strings are compared literally, as in \code{stringcompare_hard()}.
+  //' 
+  //' @keywords internal
+  //' @noRd
+  inline arma::ivec stage_codes(const StringVector& target,
+    const StringVector& reference, int nomatch = 0) {
+    int target_length = static_cast<int>(target.length());
+    int reference_length = static_cast<int>(reference.length());
+    
+    std::unordered_map<std::string, int> code_map;
+    code_map.reserve(reference_length);
+    
+    for (int i = 0; i < reference_length; i++) {
+      code_map.emplace(as<std::string>(reference(i)), (i + 1));
+    }
+    
+    arma::ivec codes (target_length);
+    codes.fill(nomatch);
+    
+    for (int i = 0; i < target_length; i++) {
+      auto found_code = code_map.find(as<std::string>(target(i)));
+      if (found_code != code_map.end()) codes(i) = found_code->second;
+    }
+    
+    return codes;
+  }
+  
 }
 #endif
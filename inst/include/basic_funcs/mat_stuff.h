@@ -2,41 +2,329 @@
 #define LEFKOUTILS_mat_stuff_H
 
 #include <RcppArmadillo.h>
+#include <algorithm>
+#include <vector>
 
 using namespace Rcpp;
 using namespace arma;
 
 
 // Function index:
-// 1. arma::uvec spmat_index  Create Element Index Meeting Condition for Sparse Matrix
-// 2. arma::uvec general_index  Create General Element Index for Any lefkoMat Matrix
+// 1. class dgc_view  Non-owning View of dgCMatrix Slot Memory
 // 
-// 3. List decomp3  Full Eigen Analysis of a Single Dense Matrix
-// 4. List decomp3sp  Full Eigen Analysis of a Single Sparse Matrix
-// 5. List decomp3sp_inp  Full Eigen Analysis of a Single Sparse Matrix, with Sparse Input
+// 2. arma::uvec spmat_index  Create Element Index Meeting Condition for Sparse Matrix
+// 3. arma::uvec general_index  Create General Element Index for Any lefkoMat Matrix
 // 
-// 6. arma::mat ovreplace  Re-index Projection Matrix On Basis of Overwrite Table
+// 4. List decomp3  Full Eigen Analysis of a Single Dense Matrix
+// 5. List decomp3sp  Full Eigen Analysis of a Single Sparse Matrix
+// 6. List decomp3sp_inp  Full Eigen Analysis of a Single Sparse Matrix, with Sparse Input
 // 
-// 7. DataFrame sf_core  Creates Base Skeleton Stageframe
-// 8. DataFrame paramnames_skeleton  Base Skeleton Data Frame for Paramnames Objects
+// 7. arma::mat ovreplace  Re-index Projection Matrix On Basis of Overwrite Table
 // 
-// 9. List turbogeodiesel  Estimates Mean LefkoMat Object for Historical MPM
-// 10. List geodiesel  Estimates Mean LefkoMat Object for Ahistorical MPM
+// 8. DataFrame sf_core  Creates Base Skeleton Stageframe
+// 9. DataFrame paramnames_skeleton  Base Skeleton Data Frame for Paramnames Objects
 // 
-// 11. int supp_decision1  Create Skeleton Plan of Expanded Supplemental Table
-// 12. String supp_decision2  Decide on Stage for Each Entry in Supplemental Table
-// 13. DataFrame supp_reassess  Expand Supplemental Table Given User Input
-// 14. DataFrame age_expanded  Expand Supplemental Table by Age Inputs
+// 10. void mean_accumulate  Accumulate Element-wise Mean Matrices by Patch and Population
+// 11. List turbogeodiesel  Estimates Mean LefkoMat Object for Historical MPM
+// 12. List geodiesel  Estimates Mean LefkoMat Object for Ahistorical MPM
 // 
-// 15. void hst_maker  Creates hstages Data Frames
-// 16. DataFrame age_maker  Creates agestages Data Frames
+// 13. int supp_decision1  Create Skeleton Plan of Expanded Supplemental Table
+// 14. String supp_decision2  Decide on Stage for Each Entry in Supplemental Table
+// 15. DataFrame supp_reassess  Expand Supplemental Table Given User Input
+// 16. DataFrame age_expanded  Expand Supplemental Table by Age Inputs
 // 
-// 17. List theoldpizzle  Create Element Index for Matrix Estimation
-// 18. List sf_reassess_internal  Standardize Stageframe For MPM Analysis
-// 19. List sf_leslie  Create Stageframe for Population Matrix Projection Analysis
+// 17. void hst_maker  Creates hstages Data Frames
+// 18. DataFrame age_maker  Creates agestages Data Frames
+// 
+// 19. List theoldpizzle  Create Element Index for Matrix Estimation
+// 20. List sf_reassess_internal  Standardize Stageframe For MPM Analysis
+// 21. List sf_leslie  Create Stageframe for Population Matrix Projection Analysis
 
 
 namespace LefkoMats {
+  //' Non-owning View of dgCMatrix Slot Memory
+  //' 
+  //' Class \code{dgc_view} reads a sparse matrix of class \code{dgCMatrix}
+  //' directly from the memory of its \code{i}, \code{p}, and \code{x} slots,
+  //' without copying them into an \code{arma::sp_mat} object. Other input
+  //' formats, including dense matrices, are converted once into owned slots
+  //' so that the same kernels can be used.
+  //' 
+  //' @name dgc_view
+  //' 
+  //' @param mats A list of matrices, such as the \code{A} list of a
+  //' \code{lefkoMat} object.
+  //' @param element The index of the matrix to view within \code{mats}.
+  //' @param x An R object holding a matrix, usually of class \code{dgCMatrix}.
+  //' 
+  //' @section Notes:
+  //' The view holds a protected reference to the source object, and so remains
+  //' valid for as long as the view itself exists. Kernels never write to the
+  //' source slots.
+  //' 
+  //' @keywords internal
+  //' @noRd
+  class dgc_view {
+    public:
+      int n_rows;
+      int n_cols;
+      int n_nonzero;
+      const int* row_idx;
+      const int* col_ptr;
+      const double* values;
+      
+      dgc_view (const List& mats, int element) {
+        view_setup(VECTOR_ELT(mats, static_cast<R_xlen_t>(element)));
+      }
+      
+      explicit dgc_view (SEXP x) {
+        view_setup(x);
+      }
+      
+      // Matrix-vector product A * v
+      inline arma::vec times (const arma::vec& v) const {
+        arma::vec out (n_rows);
+        times_into(v, out);
+        
+        return out;
+      }
+      
+      // Matrix-vector product A * v written into existing storage
+      inline void times_into (const arma::vec& v, arma::vec& out) const {
+        out.zeros(n_rows);
+        double* out_mem = out.memptr();
+        
+        for (int j = 0; j < n_cols; j++) {
+          double v_j = v(j);
+          if (v_j == 0.0) continue;
+          
+          for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+            out_mem[row_idx[k]] += values[k] * v_j;
+          }
+        }
+      }
+      
+      // Matrix-vector product using other values over the same sparsity pattern
+      inline void times_into (const arma::vec& v, arma::vec& out,
+        const arma::vec& alt_values) const {
+        
+        out.zeros(n_rows);
+        double* out_mem = out.memptr();
+        const double* alt_mem = alt_values.memptr();
+        
+        for (int j = 0; j < n_cols; j++) {
+          double v_j = v(j);
+          if (v_j == 0.0) continue;
+          
+          for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+            out_mem[row_idx[k]] += alt_mem[k] * v_j;
+          }
+        }
+      }
+      
+      // Vector-matrix product v * A
+      inline arma::rowvec trans_times (const arma::rowvec& v) const {
+        arma::rowvec out (n_cols);
+        trans_times_into(v, out);
+        
+        return out;
+      }
+      
+      // Vector-matrix product v * A written into existing storage
+      inline void trans_times_into (const arma::rowvec& v, arma::rowvec& out) const {
+        out.set_size(n_cols);
+        double* out_mem = out.memptr();
+        const double* v_mem = v.memptr();
+        
+        for (int j = 0; j < n_cols; j++) {
+          double out_j {0.0};
+          for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+            out_j += values[k] * v_mem[row_idx[k]];
+          }
+          out_mem[j] = out_j;
+        }
+      }
+      
+      // Element values at column-major linear indices
+      inline arma::vec gather (const arma::uvec& indices) const {
+        int index_length = static_cast<int>(indices.n_elem);
+        arma::vec out (index_length, fill::zeros);
+        
+        for (int m = 0; m < index_length; m++) {
+          int col = static_cast<int>(indices(m) / n_rows);
+          int row = static_cast<int>(indices(m) % n_rows);
+          
+          const int* col_start = row_idx + col_ptr[col];
+          const int* col_end = row_idx + col_ptr[col+1];
+          const int* found = std::lower_bound(col_start, col_end, row);
+          
+          if (found != col_end && *found == row) out(m) = values[found - row_idx];
+        }
+        
+        return out;
+      }
+      
+      // Positions in the values array of column-major linear indices, or -1
+      inline arma::ivec value_positions (const arma::uvec& indices) const {
+        int index_length = static_cast<int>(indices.n_elem);
+        arma::ivec out (index_length);
+        out.fill(-1);
+        
+        for (int m = 0; m < index_length; m++) {
+          int col = static_cast<int>(indices(m) / n_rows);
+          int row = static_cast<int>(indices(m) % n_rows);
+          
+          const int* col_start = row_idx + col_ptr[col];
+          const int* col_end = row_idx + col_ptr[col+1];
+          const int* found = std::lower_bound(col_start, col_end, row);
+          
+          if (found != col_end && *found == row) out(m) = static_cast<int>(found - row_idx);
+        }
+        
+        return out;
+      }
+      
+      // Column-major linear indices of elements greater than tol
+      inline arma::uvec index_above (double tol) const {
+        std::vector<arma::uword> found;
+        found.reserve(n_nonzero);
+        
+        for (int j = 0; j < n_cols; j++) {
+          for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+            if (values[k] > tol) {
+              found.push_back(static_cast<arma::uword>(j) * n_rows + row_idx[k]);
+            }
+          }
+        }
+        
+        return arma::uvec(found);
+      }
+      
+      // Adds scaled triplets to batch vectors for a single sp_mat construction
+      inline void append_triplets (std::vector<arma::uword>& rows,
+        std::vector<arma::uword>& cols, std::vector<double>& vals,
+        double scale) const {
+        
+        for (int j = 0; j < n_cols; j++) {
+          for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+            rows.push_back(static_cast<arma::uword>(row_idx[k]));
+            cols.push_back(static_cast<arma::uword>(j));
+            vals.push_back(values[k] * scale);
+          }
+        }
+      }
+      
+      // Weighted sum a * A + b * B, merged column by column into CSC arrays
+      inline arma::sp_mat combine (const arma::sp_mat& B, double a,
+        double b) const {
+        
+        if (static_cast<int>(B.n_rows) != n_rows || static_cast<int>(B.n_cols) != n_cols) {
+          throw Rcpp::exception("All input matrices must have the same dimensions.",
+            false);
+        }
+        B.sync();
+        
+        std::vector<arma::uword> out_rows;
+        std::vector<double> out_vals;
+        out_rows.reserve(n_nonzero + B.n_nonzero);
+        out_vals.reserve(n_nonzero + B.n_nonzero);
+        arma::uvec out_ptrs (n_cols + 1, fill::zeros);
+        
+        for (int j = 0; j < n_cols; j++) {
+          int ka = col_ptr[j];
+          int kb = static_cast<int>(B.col_ptrs[j]);
+          int ka_end = col_ptr[j+1];
+          int kb_end = static_cast<int>(B.col_ptrs[j+1]);
+          
+          while (ka < ka_end || kb < kb_end) {
+            arma::uword row;
+            double value;
+            
+            if (kb >= kb_end || (ka < ka_end &&
+                static_cast<arma::uword>(row_idx[ka]) < B.row_indices[kb])) {
+              row = static_cast<arma::uword>(row_idx[ka]);
+              value = a * values[ka];
+              ka++;
+            } else if (ka >= ka_end || B.row_indices[kb] < static_cast<arma::uword>(row_idx[ka])) {
+              row = B.row_indices[kb];
+              value = b * B.values[kb];
+              kb++;
+            } else {
+              row = B.row_indices[kb];
+              value = a * values[ka] + b * B.values[kb];
+              ka++;
+              kb++;
+            }
+            
+            if (value != 0.0) {
+              out_rows.push_back(row);
+              out_vals.push_back(value);
+            }
+          }
+          out_ptrs(j+1) = static_cast<arma::uword>(out_rows.size());
+        }
+        
+        return arma::sp_mat(arma::uvec(out_rows), out_ptrs, arma::vec(out_vals),
+          n_rows, n_cols);
+      }
+      
+      // Owning copy in Armadillo format
+      inline arma::sp_mat sp () const {
+        arma::uvec out_rows (n_nonzero);
+        arma::uvec out_ptrs (n_cols + 1);
+        
+        for (int k = 0; k < n_nonzero; k++) out_rows(k) = row_idx[k];
+        for (int k = 0; k <= n_cols; k++) out_ptrs(k) = col_ptr[k];
+        
+        return arma::sp_mat(out_rows, out_ptrs, arma::vec(values, n_nonzero),
+          n_rows, n_cols);
+      }
+    
+    private:
+      IntegerVector i_slot;
+      IntegerVector p_slot;
+      NumericVector x_slot;
+      
+      inline void view_setup (SEXP x) {
+        if (Rf_isS4(x) && Rf_inherits(x, "dgCMatrix")) {
+          S4 x_s4 (x);
+          IntegerVector x_dim = x_s4.slot("Dim");
+          i_slot = x_s4.slot("i");
+          p_slot = x_s4.slot("p");
+          x_slot = x_s4.slot("x");
+          
+          n_rows = x_dim(0);
+          n_cols = x_dim(1);
+        } else {
+          arma::sp_mat x_sp;
+          if (Rf_isS4(x)) {
+            x_sp = as<arma::sp_mat>(x);
+          } else {
+            x_sp = arma::sp_mat(as<arma::mat>(x));
+          }
+          
+          n_rows = static_cast<int>(x_sp.n_rows);
+          n_cols = static_cast<int>(x_sp.n_cols);
+          
+          i_slot = IntegerVector(static_cast<int>(x_sp.n_nonzero));
+          p_slot = IntegerVector(n_cols + 1);
+          x_slot = NumericVector(x_sp.values, x_sp.values + x_sp.n_nonzero);
+          
+          for (int k = 0; k < static_cast<int>(x_sp.n_nonzero); k++) {
+            i_slot(k) = static_cast<int>(x_sp.row_indices[k]);
+          }
+          for (int k = 0; k <= n_cols; k++) {
+            p_slot(k) = static_cast<int>(x_sp.col_ptrs[k]);
+          }
+        }
+        
+        n_nonzero = static_cast<int>(x_slot.length());
+        row_idx = i_slot.begin();
+        col_ptr = p_slot.begin();
+        values = x_slot.begin();
+      }
+  };
+  
   //' Create Element Index Meeting Condition for Sparse Matrix
   //' 
   //' This function takes a single sparse matrix (dgCMatrix) and creates a
@@ -112,8 +400,8 @@ namespace LefkoMats {
     for (int i = 0; i < mat_length; i++) {
       arma::uvec iron_maiden;
       if (is<S4>(mats(i))) {
-        sp_mat rel_mat = as<arma::sp_mat>(mats(i));
-        iron_maiden = LefkoMats::spmat_index(rel_mat, tol);
+        LefkoMats::dgc_view rel_mat (mats, i);
+        iron_maiden = rel_mat.index_above(tol);
       } else {
         iron_maiden = find(as<arma::mat>(mats(i)) > tol);
       }
@@ -211,7 +499,7 @@ namespace LefkoMats {
   //' 
   //' @keywords internal
   //' @noRd
-  inline Rcpp::List decomp3sp_inp (arma::sp_mat spAmat) {
+  inline Rcpp::List decomp3sp_inp (const arma::sp_mat& spAmat) {
     arma::sp_mat t_spAmat = spAmat.t();
     arma::cx_vec Aeigval;
     arma::cx_vec Aeigvall;
@@ -561,6 +849,313 @@ namespace LefkoMats {
     return output;
   }
   
+  //' Accumulate Element-wise Mean Matrices by Patch and Population
+  //' 
+  //' Function \code{mean_accumulate()} sums each input matrix directly into the
+  //' mean matrix of its patch, and then sums patch means into population means,
+  //' without holding all matrices in memory at once. Patches are processed in
+  //' parallel, as are populations.
+  //' 
+  //' @name mean_accumulate
+  //' 
+  //' @param U The list to hold mean U matrices.
+  //' @param F The list to hold mean F matrices.
+  //' @param A The list to hold mean A matrices.
+  //' @param totalutrans Integer to hold the number of non-zero U elements.
+  //' @param totalftrans Integer to hold the number of non-zero F elements.
+  //' @param Umats The list of input U matrices.
+  //' @param Fmats The list of input F matrices.
+  //' @param pop_num The population of each matrix, starting from \code{0}.
+  //' @param poppatchc The patch of each matrix, starting from \code{0}.
+  //' @param patchesinpop The number of patches in the population of each
+  //' matrix.
+  //' @param yearsinpatch The number of occasions in the patch of each matrix.
+  //' @param numofpops The number of populations.
+  //' @param numofpatches The number of patches.
+  //' @param patchmats A logical value stating whether to output patch-level
+  //' means.
+  //' @param popmats A logical value stating whether to output population-level
+  //' means.
+  //' @param mat_input A logical value indicating whether the input matrix class
+  //' is a standard \code{NumericMatrix}.
+  //' @param sparse_output A logical value indicating whether to output sparse
+  //' matrices.
+  //' @param allindices The column-major linear indices of elements to average.
+  //' If empty, then all elements are averaged.
+  //' 
+  //' @return Lists \code{U}, \code{F}, and \code{A} are filled with patch means
+  //' followed by population means, as requested.
+  //' 
+  //' @section Notes:
+  //' Dense input matrices are read in place, and sparse input matrices are read
+  //' through \code{dgc_view} objects and merged column by column, so that only
+  //' one accumulator per output matrix is ever allocated. Patch means are always
+  //' estimated, since population means are estimated from them.
+  //' 
+  //' @keywords internal
+  //' @noRd
+  inline void mean_accumulate (List& U, List& F, List& A, int& totalutrans,
+    int& totalftrans, const List& Umats, const List& Fmats,
+    const arma::uvec& pop_num, const arma::uvec& poppatchc,
+    const arma::uvec& patchesinpop, const arma::uvec& yearsinpatch,
+    int numofpops, int numofpatches, bool patchmats, bool popmats,
+    bool mat_input, bool sparse_output, const arma::uvec& allindices) {
+    
+    int loydim = static_cast<int>(poppatchc.n_elem);
+    int mat_rows {0};
+    int mat_cols {0};
+    
+    // Matrix access set up before any parallel work
+    std::vector<NumericMatrix> u_dense;
+    std::vector<NumericMatrix> f_dense;
+    std::vector<dgc_view> u_sparse;
+    std::vector<dgc_view> f_sparse;
+    
+    if (mat_input) {
+      u_dense.reserve(loydim);
+      f_dense.reserve(loydim);
+    } else {
+      u_sparse.reserve(loydim);
+      f_sparse.reserve(loydim);
+    }
+    
+    for (int i = 0; i < loydim; i++) {
+      int u_rows {0};
+      int u_cols {0};
+      int f_rows {0};
+      int f_cols {0};
+      
+      if (mat_input) {
+        u_dense.push_back(as<NumericMatrix>(Umats(i)));
+        f_dense.push_back(as<NumericMatrix>(Fmats(i)));
+        
+        u_rows = u_dense[i].nrow();
+        u_cols = u_dense[i].ncol();
+        f_rows = f_dense[i].nrow();
+        f_cols = f_dense[i].ncol();
+      } else {
+        u_sparse.emplace_back(Umats, i);
+        f_sparse.emplace_back(Fmats, i);
+        
+        u_rows = u_sparse[i].n_rows;
+        u_cols = u_sparse[i].n_cols;
+        f_rows = f_sparse[i].n_rows;
+        f_cols = f_sparse[i].n_cols;
+      }
+      
+      if (i == 0) {
+        mat_rows = u_rows;
+        mat_cols = u_cols;
+      }
+      
+      if (u_rows != mat_rows || u_cols != mat_cols || f_rows != mat_rows ||
+          f_cols != mat_cols) {
+        throw Rcpp::exception("All input matrices must have the same dimensions.",
+          false);
+      }
+    }
+    
+    std::vector<const double*> u_dense_ptrs;
+    std::vector<const double*> f_dense_ptrs;
+    for (int i = 0; i < static_cast<int>(u_dense.size()); i++) {
+      u_dense_ptrs.push_back(u_dense[i].begin());
+      f_dense_ptrs.push_back(f_dense[i].begin());
+    }
+    
+    std::vector<std::vector<int>> patch_members (numofpatches);
+    arma::uvec patch_pop (numofpatches, fill::zeros);
+    arma::vec patch_share (numofpatches, fill::ones);
+    
+    for (int i = 0; i < loydim; i++) {
+      int patch = static_cast<int>(poppatchc(i));
+      
+      patch_members[patch].push_back(i);
+      patch_pop(patch) = pop_num(i);
+      patch_share(patch) = 1.0 / static_cast<double>(patchesinpop(i));
+    }
+    
+    bool index_used = (allindices.n_elem > 0);
+    arma::uvec kept_indices = sort(allindices);
+    int kept_length = static_cast<int>(kept_indices.n_elem);
+    arma::uword total_elems = static_cast<arma::uword>(mat_rows) * mat_cols;
+    
+    // Restricts a sparse accumulator to the averaged elements
+    auto sp_keep = [&](const arma::sp_mat& X) {
+      std::vector<arma::uword> kept_rows;
+      std::vector<arma::uword> kept_cols;
+      std::vector<double> kept_values;
+      
+      for (arma::sp_mat::const_iterator it = X.begin(); it != X.end(); ++it) {
+        arma::uword linear = it.col() * static_cast<arma::uword>(mat_rows) + it.row();
+        
+        if (std::binary_search(kept_indices.begin(), kept_indices.end(), linear)) {
+          kept_rows.push_back(it.row());
+          kept_cols.push_back(it.col());
+          kept_values.push_back(*it);
+        }
+      }
+      
+      arma::umat kept_locations (2, kept_values.size());
+      for (int k = 0; k < static_cast<int>(kept_values.size()); k++) {
+        kept_locations(0, k) = kept_rows[k];
+        kept_locations(1, k) = kept_cols[k];
+      }
+      
+      return arma::sp_mat(kept_locations, arma::vec(kept_values), mat_rows,
+        mat_cols);
+    };
+    
+    std::vector<arma::mat> u_patch_d;
+    std::vector<arma::mat> f_patch_d;
+    std::vector<arma::sp_mat> u_patch_s;
+    std::vector<arma::sp_mat> f_patch_s;
+    
+    if (mat_input) {
+      u_patch_d.resize(numofpatches);
+      f_patch_d.resize(numofpatches);
+    } else {
+      u_patch_s.resize(numofpatches);
+      f_patch_s.resize(numofpatches);
+    }
+    
+    // Patch means
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int p = 0; p < numofpatches; p++) {
+      if (mat_input) {
+        u_patch_d[p].zeros(mat_rows, mat_cols);
+        f_patch_d[p].zeros(mat_rows, mat_cols);
+        double* u_acc = u_patch_d[p].memptr();
+        double* f_acc = f_patch_d[p].memptr();
+        
+        for (int i : patch_members[p]) {
+          double years = static_cast<double>(yearsinpatch(i));
+          const double* u_src = u_dense_ptrs[i];
+          const double* f_src = f_dense_ptrs[i];
+          
+          if (index_used) {
+            for (int m = 0; m < kept_length; m++) {
+              arma::uword k = kept_indices(m);
+              u_acc[k] += u_src[k] / years;
+              f_acc[k] += f_src[k] / years;
+            }
+          } else {
+            for (arma::uword k = 0; k < total_elems; k++) {
+              u_acc[k] += u_src[k] / years;
+              f_acc[k] += f_src[k] / years;
+            }
+          }
+        }
+      } else {
+        arma::sp_mat u_acc (mat_rows, mat_cols);
+        arma::sp_mat f_acc (mat_rows, mat_cols);
+        
+        for (int i : patch_members[p]) {
+          double weight = 1.0 / static_cast<double>(yearsinpatch(i));
+          
+          u_acc = u_sparse[i].combine(u_acc, weight, 1.0);
+          f_acc = f_sparse[i].combine(f_acc, weight, 1.0);
+        }
+        
+        if (index_used) {
+          u_acc = sp_keep(u_acc);
+          f_acc = sp_keep(f_acc);
+        }
+        
+        u_patch_s[p] = u_acc;
+        f_patch_s[p] = f_acc;
+      }
+    }
+    
+    // Population means from patch means
+    int pop_outputs = popmats ? numofpops : 0;
+    std::vector<arma::mat> u_pop_d;
+    std::vector<arma::mat> f_pop_d;
+    std::vector<arma::sp_mat> u_pop_s;
+    std::vector<arma::sp_mat> f_pop_s;
+    
+    if (mat_input) {
+      u_pop_d.resize(pop_outputs);
+      f_pop_d.resize(pop_outputs);
+    } else {
+      u_pop_s.resize(pop_outputs);
+      f_pop_s.resize(pop_outputs);
+    }
+    
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int q = 0; q < pop_outputs; q++) {
+      if (mat_input) {
+        u_pop_d[q].zeros(mat_rows, mat_cols);
+        f_pop_d[q].zeros(mat_rows, mat_cols);
+      } else {
+        u_pop_s[q].zeros(mat_rows, mat_cols);
+        f_pop_s[q].zeros(mat_rows, mat_cols);
+      }
+      
+      for (int p = 0; p < numofpatches; p++) {
+        if (static_cast<int>(patch_pop(p)) != q) continue;
+        
+        if (mat_input) {
+          u_pop_d[q] += u_patch_d[p] * patch_share(p);
+          f_pop_d[q] += f_patch_d[p] * patch_share(p);
+        } else {
+          u_pop_s[q] += u_patch_s[p] * patch_share(p);
+          f_pop_s[q] += f_patch_s[p] * patch_share(p);
+        }
+      }
+    }
+    
+    // Output lists
+    int patch_outputs = patchmats ? numofpatches : 0;
+    int totalmatrices = patch_outputs + pop_outputs;
+    U = List(totalmatrices);
+    F = List(totalmatrices);
+    A = List(totalmatrices);
+    totalutrans = 0;
+    totalftrans = 0;
+    
+    for (int i = 0; i < totalmatrices; i++) {
+      bool from_patch = (i < patch_outputs);
+      int j = from_patch ? i : (i - patch_outputs);
+      
+      if (mat_input) {
+        const arma::mat& umat_base = from_patch ? u_patch_d[j] : u_pop_d[j];
+        const arma::mat& fmat_base = from_patch ? f_patch_d[j] : f_pop_d[j];
+        
+        arma::uvec utrans = find(umat_base);
+        arma::uvec ftrans = find(fmat_base);
+        totalutrans += static_cast<int>(utrans.n_elem);
+        totalftrans += static_cast<int>(ftrans.n_elem);
+        
+        if (sparse_output) {
+          arma::sp_mat umat_sp (umat_base);
+          arma::sp_mat fmat_sp (fmat_base);
+          
+          U(i) = umat_sp;
+          F(i) = fmat_sp;
+          A(i) = umat_sp + fmat_sp;
+        } else {
+          U(i) = umat_base;
+          F(i) = fmat_base;
+          A(i) = umat_base + fmat_base;
+        }
+      } else {
+        const arma::sp_mat& umat_base = from_patch ? u_patch_s[j] : u_pop_s[j];
+        const arma::sp_mat& fmat_base = from_patch ? f_patch_s[j] : f_pop_s[j];
+        
+        totalutrans += static_cast<int>(umat_base.n_nonzero);
+        totalftrans += static_cast<int>(fmat_base.n_nonzero);
+        
+        U(i) = umat_base;
+        F(i) = fmat_base;
+        A(i) = umat_base + fmat_base;
+      }
+    }
+  }
+  
   //' Estimates Mean LefkoMat Object for Historical MPM
   //' 
   //' Function \code{turbogeodiesel()} estimates mean historical population
@@ -605,7 +1200,10 @@ namespace LefkoMats {
     int numofpops = static_cast<int>(uniquepops.n_elem);
     int numofpatches = static_cast<int>(uniquepoppatches.n_elem);
     
-    if (numofpatches == 1) popmats = false;
+    if (numofpatches == 1) {
+      popmats = false;
+      patchmats = true;
+    }
     
     StringVector poporderlong(loydim);
     arma::uvec poporderlong_num(loydim);
@@ -726,86 +1324,9 @@ namespace LefkoMats {
     arma::uvec zerovec(1, fill::zeros);
     arma::uvec allindices = join_cols(zerovec, hsindex);
     
-    // Build U & F matrices of element-wise arithmetic means
-    // Each column holds predicted non-zero elements of each mean matrix
-    // Each matrix is a column vector within the overall matrix
-    int core_elem = counter;
-    
-    arma::mat umatvec(core_elem, totalmatrices, fill::zeros);
-    arma::mat fmatvec(core_elem, totalmatrices, fill::zeros);
-    
-    int patchchoice {0};
-    int popchoice {0};
-    
     pop_num = pop_num - 1;
     poppatchc = poppatchc - 1;
     
-    for (int i = 0; i < loydim; i ++) {
-      if (patchmats) {
-        patchchoice = poppatchc(i);
-        
-        if (mat_input) {
-          arma::mat Umats_invaded = as<arma::mat>(Umats(i));
-          arma::mat Fmats_invaded = as<arma::mat>(Fmats(i));
-          
-          umatvec.col(patchchoice) = umatvec.col(patchchoice) +
-            (Umats_invaded.elem(allindices) / yearsinpatch(i));
-          fmatvec.col(patchchoice) = fmatvec.col(patchchoice) +
-            (Fmats_invaded.elem(allindices) / yearsinpatch(i));
-        } else {
-          arma::sp_mat Umats_invaded = as<arma::sp_mat>(Umats(i));
-          arma::sp_mat Fmats_invaded = as<arma::sp_mat>(Fmats(i));
-          
-          arma::vec Umats_invaded_allindices (allindices.n_elem, fill::zeros);
-          arma::vec Fmats_invaded_allindices (allindices.n_elem, fill::zeros);
-          
-          for (int j = 0; j < static_cast<int>(allindices.n_elem); j++) {
-            Umats_invaded_allindices(j) = Umats_invaded(allindices(j));
-            Fmats_invaded_allindices(j) = Fmats_invaded(allindices(j));
-          }
-        
-          umatvec.col(patchchoice) = umatvec.col(patchchoice) +
-            (Umats_invaded_allindices / yearsinpatch(i));
-          fmatvec.col(patchchoice) = fmatvec.col(patchchoice) +
-            (Fmats_invaded_allindices / yearsinpatch(i));
-        }
-        
-        if (popmats) {
-          if (patchmats) {
-            popchoice = numofpatches + pop_num(i);
-          } else {
-            popchoice = pop_num(i);
-          }
-          
-          if (mat_input) {
-            arma::mat Umats_invaded = as<arma::mat>(Umats(i));
-            arma::mat Fmats_invaded = as<arma::mat>(Fmats(i));
-            
-            umatvec.col(popchoice) = umatvec.col(popchoice) +
-              (Umats_invaded.elem(allindices) / (yearsinpatch(i) * patchesinpop(i)));
-            fmatvec.col(popchoice) = fmatvec.col(popchoice) +
-              (Fmats_invaded.elem(allindices) / (yearsinpatch(i) * patchesinpop(i)));
-          } else {
-            arma::sp_mat Umats_invaded = as<arma::sp_mat>(Umats(i));
-            arma::sp_mat Fmats_invaded = as<arma::sp_mat>(Fmats(i));
-            
-            arma::vec Umats_invaded_allindices (allindices.n_elem, fill::zeros);
-            arma::vec Fmats_invaded_allindices (allindices.n_elem, fill::zeros);
-            
-            for (int j = 0; j < static_cast<int>(allindices.n_elem); j++) {
-              Umats_invaded_allindices(j) = Umats_invaded(allindices(j));
-              Fmats_invaded_allindices(j) = Fmats_invaded(allindices(j));
-            }
-          
-            umatvec.col(popchoice) = umatvec.col(popchoice) +
-              (Umats_invaded_allindices / (yearsinpatch(i) * patchesinpop(i)));
-            fmatvec.col(popchoice) = fmatvec.col(popchoice) +
-              (Fmats_invaded_allindices / (yearsinpatch(i) * patchesinpop(i)));
-          }
-        }
-      }
-    }
-    
     // New labels data frame
     int cheatsheetlength {1};
     
@@ -845,55 +1366,18 @@ namespace LefkoMats {
     DataFrame cheatsheet = DataFrame::create(Named("pop") = poporder_redone,
       _["patch"] = patchorder_redone);
     
-    // Create the main list objects holding matrices
-    List U (totalmatrices);
-    List F (totalmatrices);
-    List A (totalmatrices);
+    // Stream matrices into patch and population accumulators
+    List U;
+    List F;
+    List A;
     int totalutrans {0};
     int totalftrans {0};
     
-    if (mat_input && sparse_switch == 0) {
-      for (int i = 0; i < totalmatrices; i++) {
-        arma::mat umat_base(numhstages, numhstages, fill::zeros);
-        arma::mat fmat_base(numhstages, numhstages, fill::zeros);
-        
-        umat_base.elem(allindices) = umatvec.col(i);
-        fmat_base.elem(allindices) = fmatvec.col(i);
-        arma::mat amat_base = umat_base + fmat_base;
-        
-        U(i) = umat_base;
-        F(i) = fmat_base;
-        A(i) = amat_base;
-      }
-      
-      // Matrix QC output
-      arma::uvec utrans = find(umatvec);
-      arma::uvec ftrans = find(fmatvec);
-      totalutrans = static_cast<int>(utrans.n_elem);
-      totalftrans = static_cast<int>(ftrans.n_elem);
-      
-    } else {
-      for (int i = 0; i < totalmatrices; i++) {
-        arma::sp_mat umat_base(numhstages, numhstages);
-        arma::sp_mat fmat_base(numhstages, numhstages);
-        
-        for (int j = 0; j < static_cast<int>(allindices.n_elem); j++) {
-          umat_base(allindices(j)) = umatvec(j, i);
-          fmat_base(allindices(j)) = fmatvec(j, i);
-        }
-        arma::sp_mat amat_base = umat_base + fmat_base;
-        
-        U(i) = umat_base;
-        F(i) = fmat_base;
-        A(i) = amat_base;
-      }
-      
-      // Matrix QC output
-      arma::uvec utrans = find(umatvec);
-      arma::uvec ftrans = find(fmatvec);
-      totalutrans = static_cast<int>(utrans.n_elem);
-      totalftrans = static_cast<int>(ftrans.n_elem);
-    }
+    mean_accumulate(U, F, A, totalutrans, totalftrans, Umats, Fmats, pop_num,
+      poppatchc, patchesinpop, yearsinpatch, numofpops, numofpatches,
+      patchmats, popmats, mat_input, !(mat_input && sparse_switch == 0),
+      allindices);
+    totalmatrices = static_cast<int>(U.length());
     
     NumericVector matrixqc(3);
     matrixqc(0) = totalutrans; // summed number of non-zero u transitions
@@ -952,7 +1436,10 @@ namespace LefkoMats {
     int numofpops = static_cast<int>(uniquepops.n_elem);
     int numofpatches = static_cast<int>(uniquepoppatches.n_elem);
     
-    if (numofpatches == 1) popmats = false;
+    if (numofpatches == 1) {
+      popmats = false;
+      patchmats = true;
+    }
     
     StringVector poporderlong(loydim);
     arma::uvec poporderlong_num(loydim);
@@ -1024,149 +1511,8 @@ namespace LefkoMats {
       patchorder_str(i) = patches(toestimate(i));
     }
     
-    // Predicts which elements will be targeted for arithmetic mean estimation
-    arma::uvec astages = as<arma::uvec>(stages["stage_id"]);
-    int initialstages = static_cast<int>(astages.n_elem);
-    
-    // Test for the presence of ages, and determine matrix dimensions
-    int colsused {0};
-    
-    if (mat_input && sparse_switch == 0) {
-      arma::mat initUmat = as<arma::mat>(Umats(0));
-      colsused = initUmat.n_cols;
-    } else if (mat_input) {
-      arma::sp_mat initUmat(as<arma::mat>(Umats(0)));
-      colsused = initUmat.n_cols;
-    } else {
-      arma::sp_mat initUmat = as<arma::sp_mat>(Umats(0));
-      colsused = initUmat.n_cols;
-    }
-    
-    int agemultiplier = colsused / initialstages;
-    
-    int numstages = static_cast<int>(astages.n_elem) * agemultiplier;
-    
-    // Build U & F matrices of element-wise arithmetic means
-    // Each column holds predicted non-zero elements of each mean matrix
-    // Each matrix is a column vector within the overall matrix
-    int core_elem = numstages * numstages;
-    
-    arma::mat umatvec;
-    arma::mat fmatvec;
-    arma::mat amatvec;
-    arma::sp_mat umatvec_sp;
-    arma::sp_mat fmatvec_sp;
-    arma::sp_mat amatvec_sp;
-    
-    if (mat_input && sparse_switch == 0) {
-      arma::mat umatvec_(core_elem, totalmatrices);
-      arma::mat fmatvec_(core_elem, totalmatrices);
-      umatvec_.zeros();
-      fmatvec_.zeros();
-      
-      int patchchoice {0};
-      int popchoice {0};
-      
-      pop_num = pop_num - 1;
-      poppatchc = poppatchc - 1;
-      
-      for (int i = 0; i < loydim; i ++) {
-        if (patchmats) {
-          patchchoice = poppatchc(i);
-          
-          arma::mat Umats_invaded = as<arma::mat>(Umats(i));
-          arma::mat Fmats_invaded = as<arma::mat>(Fmats(i));
-          
-          umatvec_.col(patchchoice) = umatvec_.col(patchchoice) +
-            (arma::vectorise(Umats_invaded) / yearsinpatch(i));
-          fmatvec_.col(patchchoice) = fmatvec_.col(patchchoice) +
-            (arma::vectorise(Fmats_invaded) / yearsinpatch(i));
-        }
-        
-        if (popmats) {
-          if (patchmats) {
-            popchoice = numofpatches + pop_num(i);
-          } else {
-            popchoice = pop_num(i);
-          }
-          
-          arma::mat Umats_invaded = as<arma::mat>(Umats(i));
-          arma::mat Fmats_invaded = as<arma::mat>(Fmats(i));
-          
-          umatvec_.col(popchoice) = umatvec_.col(popchoice) +
-            (arma::vectorise(Umats_invaded) / (yearsinpatch(i) * patchesinpop(i)));
-          fmatvec_.col(popchoice) = fmatvec_.col(popchoice) +
-            (arma::vectorise(Fmats_invaded) / (yearsinpatch(i) * patchesinpop(i)));
-        }
-      }
-      umatvec = umatvec_;
-      fmatvec = fmatvec_;
-      amatvec = umatvec + fmatvec;
-      
-    } else {
-      arma::sp_mat umatvec_sp_(core_elem, totalmatrices);
-      arma::sp_mat fmatvec_sp_(core_elem, totalmatrices);
-      
-      int patchchoice {0};
-      int popchoice {0};
-      
-      pop_num = pop_num - 1;
-      poppatchc = poppatchc - 1;
-      
-      for (int i = 0; i < loydim; i ++) {
-        if (patchmats) {
-          patchchoice = poppatchc(i);
-          
-          arma::sp_mat Umats_invaded;
-          arma::sp_mat Fmats_invaded;
-          
-          if (mat_input) { 
-            arma::sp_mat Umats_invaded_(as<arma::mat>(Umats(i)));
-            arma::sp_mat Fmats_invaded_(as<arma::mat>(Fmats(i)));
-            Umats_invaded = Umats_invaded_;
-            Fmats_invaded = Fmats_invaded_;
-          } else { 
-            Umats_invaded = as<arma::sp_mat>(Umats(i));
-            Fmats_invaded = as<arma::sp_mat>(Fmats(i));
-          }
-          
-          umatvec_sp_.col(patchchoice) = umatvec_sp_.col(patchchoice) +
-            (arma::vectorise(Umats_invaded) / yearsinpatch(i));
-          fmatvec_sp_.col(patchchoice) = fmatvec_sp_.col(patchchoice) +
-            (arma::vectorise(Fmats_invaded) / yearsinpatch(i));
-        }
-        
-        if (popmats) {
-          if (patchmats) {
-            popchoice = numofpatches + pop_num(i);
-          } else {
-            popchoice = pop_num(i);
-          }
-          
-          arma::sp_mat Umats_invaded;
-          arma::sp_mat Fmats_invaded;
-          
-          if (mat_input) {
-            arma::sp_mat Umats_invaded_(as<arma::mat>(Umats(i)));
-            arma::sp_mat Fmats_invaded_(as<arma::mat>(Fmats(i)));
-            Umats_invaded = Umats_invaded_;
-            Fmats_invaded = Fmats_invaded_;
-          } else {
-            Umats_invaded = as<arma::sp_mat>(Umats(i));
-            Fmats_invaded = as<arma::sp_mat>(Fmats(i));
-          }
-          
-          umatvec_sp_.col(popchoice) = umatvec_sp_.col(popchoice) +
-            (arma::vectorise(Umats_invaded) / (yearsinpatch(i) * patchesinpop(i)));
-          fmatvec_sp_.col(popchoice) = fmatvec_sp_.col(popchoice) +
-            (arma::vectorise(Fmats_invaded) / (yearsinpatch(i) * patchesinpop(i)));
-        }
-      }
-      
-      umatvec_sp = umatvec_sp_;
-      fmatvec_sp = fmatvec_sp_;
-      amatvec_sp = umatvec_sp + fmatvec_sp;
-    }
+    pop_num = pop_num - 1;
+    poppatchc = poppatchc - 1;
     
     // New labels data frame
     int cheatsheetlength {1};
@@ -1206,55 +1552,18 @@ namespace LefkoMats {
     DataFrame cheatsheet = DataFrame::create(Named("pop") = poporder_redone, 
       _["patch"] = patchorder_redone);
     
-    // Create the main list objects to hold the matrices
-    List U (totalmatrices);
-    List F (totalmatrices);
-    List A (totalmatrices);
+    // Stream matrices into patch and population accumulators
+    List U;
+    List F;
+    List A;
     int totalutrans {0};
     int totalftrans {0};
     
-    if (mat_input && sparse_switch == 0) {
-      for (int i = 0; i < totalmatrices; i++) {
-        arma::mat umat_base = umatvec.col(i);
-        arma::mat fmat_base = fmatvec.col(i);
-        arma::mat amat_base = amatvec.col(i);
-        
-        umat_base.reshape(numstages, numstages);
-        fmat_base.reshape(numstages, numstages);
-        amat_base.reshape(numstages, numstages);
-        
-        U(i) = umat_base;
-        F(i) = fmat_base;
-        A(i) = amat_base;
-      }
-      
-      // Matrix QC output
-      arma::uvec utrans = find(umatvec);
-      arma::uvec ftrans = find(fmatvec);
-      totalutrans = static_cast<int>(utrans.n_elem);
-      totalftrans = static_cast<int>(ftrans.n_elem);
-      
-    } else {
-      for (int i = 0; i < totalmatrices; i++) {
-        arma::sp_mat umat_base = umatvec_sp.col(i);
-        arma::sp_mat fmat_base = fmatvec_sp.col(i);
-        arma::sp_mat amat_base = amatvec_sp.col(i);
-        
-        umat_base.reshape(numstages, numstages);
-        fmat_base.reshape(numstages, numstages);
-        amat_base.reshape(numstages, numstages);
-        
-        U(i) = umat_base;
-        F(i) = fmat_base;
-        A(i) = amat_base;
-      }
-      
-      // Matrix QC output
-      arma::uvec utrans = find(umatvec);
-      arma::uvec ftrans = find(fmatvec);
-      totalutrans = static_cast<int>(utrans.n_elem);
-      totalftrans = static_cast<int>(ftrans.n_elem);
-    }
+    mean_accumulate(U, F, A, totalutrans, totalftrans, Umats, Fmats, pop_num,
+      poppatchc, patchesinpop, yearsinpatch, numofpops, numofpatches,
+      patchmats, popmats, mat_input, !(mat_input && sparse_switch == 0),
+      arma::uvec());
+    totalmatrices = static_cast<int>(U.length());
     
     NumericVector matrixqc(3);
     matrixqc(0) = totalutrans; // summed number of U transitions
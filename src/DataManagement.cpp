@@ -3,6 +3,11 @@
 
 #include <RcppArmadillo.h>
 #include <LefkoUtils.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
 
 using namespace Rcpp;
 using namespace arma;
@@ -15,6 +20,10 @@ using namespace LefkoUtils;
 // 2. List jpf  Create Historical Vertical Structure for Ahistorical Vertical Data Frame
 // 3. NumericVector density3  Estimate Radial Density in Cartesian Space
 // 4. List bootstrap3  Bootstrap Standardized hfv_data Datasets
+// 5. void cache_write_node  Write One Object Node to a lefko3 Binary Cache
+// 6. RObject cache_read_node  Rebuild One Object Node from a Memory-Mapped lefko3 Binary Cache
+// 7. double write_lefko  Write lefko3 Objects to a Memory-Mappable Binary Cache
+// 8. RObject read_lefko  Read lefko3 Objects from a Memory-Mapped Binary Cache
 
 
 
@@ -3630,6 +3639,10 @@ Rcpp::List jpf(const DataFrame& data, const DataFrame& stageframe, int popidcol,
   
   // Variables to check whether censor has been checked and set at each step
   arma::uvec indivnum (ndflength, fill::zeros);
+  
+  // Integer individual codes, so that rows are matched without string tests
+  arma::ivec individx_codes = stage_codes(individx, allindivs);
+  arma::ivec individ_codes (ndflength, fill::zeros);
   arma::uvec censor2check (ndflength, fill::zeros);
   
   // Derived variables requiring extra looping or other control parameters
@@ -3689,13 +3702,8 @@ Rcpp::List jpf(const DataFrame& data, const DataFrame& stageframe, int popidcol,
     }
     
     // Establishes place marker corresponding to current individual
-    currentindiv = -1;
-    for (int k = 0; k < noindivs; k++) {
-      if (individx[i] == allindivs[k]) {
-        currentindiv = k;
-        indivnum[i] = k;
-      }
-    }
+    currentindiv = individx_codes(i) - 1;
+    if (currentindiv != -1) indivnum[i] = currentindiv;
     
     // Establishes row in new dataset
     ndfindex = (noyears * currentindiv) + currentyear;
@@ -3776,6 +3784,7 @@ Rcpp::List jpf(const DataFrame& data, const DataFrame& stageframe, int popidcol,
       individ_int[ndfindex] = individx_int[i];
     }
     individ[ndfindex] = allindivs[currentindiv];
+    individ_codes(ndfindex) = currentindiv + 1;
     
     year2[ndfindex] = yearall2x[currentyear];
     xpos2[ndfindex] = xpos2x[i];
@@ -4066,6 +4075,7 @@ Rcpp::List jpf(const DataFrame& data, const DataFrame& stageframe, int popidcol,
           individ_int[i] = individ_int[i-1];
         }
         individ[i] = individ[i-1];
+        individ_codes(i) = individ_codes(i-1);
         
         if (popid_type > 0) { 
           popid_int[i] = popid_int[i-1];
@@ -4093,10 +4103,7 @@ Rcpp::List jpf(const DataFrame& data, const DataFrame& stageframe, int popidcol,
       }
     }
     
-    currentindiv = -1;
-    for (int k = 0; k < noindivs; k++) {
-      if (individ[i] == allindivs[k]) currentindiv = k;
-    }
+    currentindiv = individ_codes(i) - 1;
     
     if (currentindiv != -1) { // Limits to only real individuals in the dataset
       if (year2[i] <= lastseenx[currentindiv] && year2[i] >= firstseenx[currentindiv] && 
@@ -6828,3 +6835,539 @@ Rcpp::List bootstrap3(RObject data, Nullable<RObject> by_pop = R_NilValue,
   return hfv_list;
 }
 
+// Binary cache format used by write_lefko() and read_lefko(). A cache file
+// holds a fixed header, a payload of 8-byte aligned data blocks, and a table
+// of fixed-width node descriptors written in preorder. Node types are 0 NULL,
+// 1 list, 2 logical, 3 integer, 4 numeric, 5 character, and 6 dgCMatrix. Each
+// node is followed in the table by the nodes of its attribute values, whose
+// names are held in the node's attribute block, and then by its list elements.
+struct lefko_cache_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::uint64_t n_nodes;
+  std::uint64_t node_offset;
+  std::uint64_t file_size;
+  char reserved[24];
+};
+
+struct lefko_cache_node {
+  std::int32_t type;
+  std::int32_t n_attrs;
+  std::int64_t length;
+  std::int64_t nrow;
+  std::int64_t ncol;
+  std::uint64_t data_offset;
+  std::uint64_t data_bytes;
+  std::uint64_t attr_offset;
+};
+
+inline std::uint64_t cache_aligned(std::uint64_t bytes) {
+  return (bytes + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+inline void cache_write_bytes(std::ofstream& out, std::uint64_t& pos,
+  const void* data, std::uint64_t bytes) {
+  if (bytes > 0) out.write(static_cast<const char*>(data), bytes);
+  pos += bytes;
+}
+
+inline void cache_pad(std::ofstream& out, std::uint64_t& pos) {
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  cache_write_bytes(out, pos, zeros, cache_aligned(pos) - pos);
+}
+
+// Strings are stored as a 32-bit byte count (-1 for NA) followed by UTF-8 text
+inline void cache_write_strings(std::ofstream& out, std::uint64_t& pos,
+  const StringVector& strings) {
+  for (int i = 0; i < static_cast<int>(strings.length()); i++) {
+    std::int32_t str_length {-1};
+    
+    if (StringVector::is_na(strings(i))) {
+      cache_write_bytes(out, pos, &str_length, sizeof(std::int32_t));
+    } else {
+      const char* str_utf8 = Rf_translateCharUTF8(strings(i));
+      str_length = static_cast<std::int32_t>(std::strlen(str_utf8));
+      cache_write_bytes(out, pos, &str_length, sizeof(std::int32_t));
+      cache_write_bytes(out, pos, str_utf8, str_length);
+    }
+  }
+}
+
+inline StringVector cache_read_strings(const char* ptr, const char* end,
+  R_xlen_t n, const char** next = NULL) {
+  StringVector strings (n);
+  
+  for (R_xlen_t i = 0; i < n; i++) {
+    std::int32_t str_length {-1};
+    
+    if (ptr + sizeof(std::int32_t) > end) {
+      throw Rcpp::exception("Cache file is corrupt.", false);
+    }
+    std::memcpy(&str_length, ptr, sizeof(std::int32_t));
+    ptr += sizeof(std::int32_t);
+    
+    if (str_length < 0) {
+      strings(i) = NA_STRING;
+    } else {
+      if (ptr + str_length > end) {
+        throw Rcpp::exception("Cache file is corrupt.", false);
+      }
+      strings(i) = Rf_mkCharLenCE(ptr, str_length, CE_UTF8);
+      ptr += str_length;
+    }
+  }
+  if (next != NULL) *next = ptr;
+  
+  return strings;
+}
+
+// Node type of an R object, or -1 if the object cannot be cached
+inline int cache_node_type(SEXP x) {
+  if (Rf_isS4(x)) return (Rf_inherits(x, "dgCMatrix")) ? 6 : -1;
+  
+  switch (TYPEOF(x)) {
+    case NILSXP: return 0;
+    case VECSXP: return 1;
+    case LGLSXP: return 2;
+    case INTSXP: return 3;
+    case REALSXP: return 4;
+    case STRSXP: return 5;
+    default: return -1;
+  }
+}
+
+//' Write One Object Node to a lefko3 Binary Cache
+//' 
+//' Function \code{cache_write_node()} appends the data of one R object to the
+//' payload of a binary cache file, records its descriptor in the node table,
+//' and then recurses in preorder into its attribute values and list elements.
+//' 
+//' @name cache_write_node
+//' 
+//' @param x The R object to write.
+//' @param out The output stream, positioned at the current end of the payload.
+//' @param pos The current byte offset of the output stream.
+//' @param nodes The node table, to which the descriptor of \code{x} is added.
+//' 
+//' @return This function modifies \code{out}, \code{pos}, and \code{nodes} by
+//' reference, and returns nothing.
+//' 
+//' @section Notes:
+//' All attributes are stored. In \code{dgCMatrix} objects, slots \code{i},
+//' \code{p}, \code{x}, and \code{Dim} are stored as raw CSC arrays, and all
+//' other slots, such as \code{Dimnames}, are stored as attributes.
+//' 
+//' @keywords internal
+//' @noRd
+inline void cache_write_node(RObject x, std::ofstream& out, std::uint64_t& pos,
+  std::vector<lefko_cache_node>& nodes) {
+  
+  lefko_cache_node node;
+  std::memset(&node, 0, sizeof(lefko_cache_node));
+  
+  node.type = cache_node_type(x);
+  if (node.type == -1) {
+    if (Rf_isS4(x)) {
+      throw Rcpp::exception("Only S4 objects of class dgCMatrix can be cached.", false);
+    }
+    throw Rcpp::exception("Object contains elements of a type that cannot be cached.",
+      false);
+  }
+  
+  // Vector data
+  cache_pad(out, pos);
+  node.data_offset = pos;
+  
+  if (node.type == 6) {
+    S4 x_s4mat = as<S4>(x);
+    IntegerVector x_dim = x_s4mat.slot("Dim");
+    IntegerVector x_i = x_s4mat.slot("i");
+    IntegerVector x_p = x_s4mat.slot("p");
+    NumericVector x_x = x_s4mat.slot("x");
+    
+    node.length = static_cast<std::int64_t>(x_x.length());
+    node.nrow = static_cast<std::int64_t>(x_dim(0));
+    node.ncol = static_cast<std::int64_t>(x_dim(1));
+    
+    cache_write_bytes(out, pos, x_p.begin(), x_p.length() * sizeof(int));
+    cache_pad(out, pos);
+    cache_write_bytes(out, pos, x_i.begin(), x_i.length() * sizeof(int));
+    cache_pad(out, pos);
+    cache_write_bytes(out, pos, x_x.begin(), x_x.length() * sizeof(double));
+    
+  } else if (node.type > 0) {
+    node.length = static_cast<std::int64_t>(Rf_xlength(x));
+    
+    if (node.type == 2) {
+      cache_write_bytes(out, pos, LOGICAL(x), node.length * sizeof(int));
+    } else if (node.type == 3) {
+      cache_write_bytes(out, pos, INTEGER(x), node.length * sizeof(int));
+    } else if (node.type == 4) {
+      cache_write_bytes(out, pos, REAL(x), node.length * sizeof(double));
+    } else if (node.type == 5) {
+      cache_write_strings(out, pos, as<StringVector>(x));
+    }
+  }
+  node.data_bytes = pos - node.data_offset;
+  
+  // Attribute names, read straight from the attribute pairlist so that compact
+  // row names stay compact
+  std::vector<SEXP> attr_values;
+  std::vector<std::string> attr_names;
+  
+  for (SEXP attr = ATTRIB(x); attr != R_NilValue; attr = CDR(attr)) {
+    SEXP attr_tag = TAG(attr);
+    std::string attr_name = CHAR(PRINTNAME(attr_tag));
+    
+    if (node.type == 6 && (attr_tag == R_ClassSymbol || attr_tag == R_DimSymbol ||
+        attr_name == "i" || attr_name == "p" || attr_name == "x")) continue;
+    
+    if (cache_node_type(CAR(attr)) == -1) {
+      std::string attr_error = "Attribute " + attr_name +
+        " holds a type that cannot be cached.";
+      throw Rcpp::exception(attr_error.c_str(), false);
+    }
+    
+    attr_names.push_back(attr_name);
+    attr_values.push_back(CAR(attr));
+  }
+  
+  cache_pad(out, pos);
+  node.attr_offset = pos;
+  node.n_attrs = static_cast<std::int32_t>(attr_names.size());
+  if (node.n_attrs > 0) {
+    StringVector attr_names_sv (attr_names.begin(), attr_names.end());
+    cache_write_strings(out, pos, attr_names_sv);
+  }
+  
+  nodes.push_back(node);
+  
+  for (int i = 0; i < static_cast<int>(attr_values.size()); i++) {
+    cache_write_node(RObject(attr_values[i]), out, pos, nodes);
+  }
+  
+  if (node.type == 1) {
+    List x_list = as<List>(x);
+    for (int i = 0; i < static_cast<int>(x_list.length()); i++) {
+      cache_write_node(x_list(i), out, pos, nodes);
+    }
+  }
+}
+
+//' Rebuild One Object Node from a Memory-Mapped lefko3 Binary Cache
+//' 
+//' Function \code{cache_read_node()} creates the R object described by the
+//' next node in the node table of a memory-mapped cache file, copying each
+//' vector once out of the mapped payload, and recursing in preorder into its
+//' attribute values and list elements.
+//' 
+//' @name cache_read_node
+//' 
+//' @param base A pointer to the start of the mapped file.
+//' @param file_size The size of the mapped file, in bytes.
+//' @param nodes A pointer to the start of the node table within the map.
+//' @param n_nodes The number of nodes in the node table.
+//' @param current The index of the next node to read, advanced by reference.
+//' 
+//' @return The rebuilt R object. It holds its own memory, and does not refer
+//' to the mapped file.
+//' 
+//' @keywords internal
+//' @noRd
+inline RObject cache_read_node(const char* base, std::uint64_t file_size,
+  const lefko_cache_node* nodes, std::uint64_t n_nodes, std::uint64_t& current) {
+  
+  if (current >= n_nodes) {
+    throw Rcpp::exception("Cache file node table is truncated.", false);
+  }
+  const lefko_cache_node& node = nodes[current];
+  current++;
+  
+  if (node.length < 0 || node.n_attrs < 0 ||
+    node.data_offset + node.data_bytes > file_size || node.attr_offset > file_size) {
+    throw Rcpp::exception("Cache file is corrupt.", false);
+  }
+  
+  const char* data_ptr = base + node.data_offset;
+  const char* data_end = data_ptr + node.data_bytes;
+  R_xlen_t node_length = static_cast<R_xlen_t>(node.length);
+  RObject output;
+  
+  // Attribute values come ahead of list elements in the node table
+  StringVector attr_names;
+  List attr_values (node.n_attrs);
+  if (node.n_attrs > 0) {
+    attr_names = cache_read_strings(base + node.attr_offset, base + file_size,
+      node.n_attrs);
+    
+    for (int i = 0; i < node.n_attrs; i++) {
+      attr_values(i) = cache_read_node(base, file_size, nodes, n_nodes, current);
+    }
+  }
+  
+  if (node.type == 0) {
+    return output;
+    
+  } else if (node.type == 6) {
+    std::uint64_t p_bytes = static_cast<std::uint64_t>(node.ncol + 1) * sizeof(int);
+    std::uint64_t i_offset = cache_aligned(p_bytes);
+    std::uint64_t x_offset = i_offset + cache_aligned(node.length * sizeof(int));
+    
+    if (x_offset + node.length * sizeof(double) > node.data_bytes) {
+      throw Rcpp::exception("Cache file is corrupt.", false);
+    }
+    
+    IntegerVector x_p (static_cast<R_xlen_t>(node.ncol + 1));
+    IntegerVector x_i (node_length);
+    NumericVector x_x (node_length);
+    std::memcpy(x_p.begin(), data_ptr, p_bytes);
+    std::memcpy(x_i.begin(), data_ptr + i_offset, node.length * sizeof(int));
+    std::memcpy(x_x.begin(), data_ptr + x_offset, node.length * sizeof(double));
+    
+    S4 x_s4mat ("dgCMatrix");
+    x_s4mat.slot("Dim") = IntegerVector::create(static_cast<int>(node.nrow),
+      static_cast<int>(node.ncol));
+    x_s4mat.slot("p") = x_p;
+    x_s4mat.slot("i") = x_i;
+    x_s4mat.slot("x") = x_x;
+    
+    for (int i = 0; i < node.n_attrs; i++) {
+      x_s4mat.slot(as<std::string>(attr_names(i))) = attr_values(i);
+    }
+    
+    return x_s4mat;
+    
+  } else if (node.type == 1) {
+    List x_list (node_length);
+    for (R_xlen_t i = 0; i < node_length; i++) {
+      x_list(i) = cache_read_node(base, file_size, nodes, n_nodes, current);
+    }
+    output = x_list;
+    
+  } else if (node.type == 2 || node.type == 3 || node.type == 4) {
+    std::uint64_t elem_bytes = (node.type == 4) ? sizeof(double) : sizeof(int);
+    if (node.length * elem_bytes > node.data_bytes) {
+      throw Rcpp::exception("Cache file is corrupt.", false);
+    }
+    
+    if (node.type == 2) {
+      LogicalVector x_vec (node_length);
+      std::memcpy(x_vec.begin(), data_ptr, node.length * elem_bytes);
+      output = x_vec;
+    } else if (node.type == 3) {
+      IntegerVector x_vec (node_length);
+      std::memcpy(x_vec.begin(), data_ptr, node.length * elem_bytes);
+      output = x_vec;
+    } else {
+      NumericVector x_vec (node_length);
+      std::memcpy(x_vec.begin(), data_ptr, node.length * elem_bytes);
+      output = x_vec;
+    }
+    
+  } else if (node.type == 5) {
+    output = cache_read_strings(data_ptr, data_end, node_length);
+    
+  } else {
+    throw Rcpp::exception("Cache file contains an unknown node type.", false);
+  }
+  
+  // Attributes are restored in their original order
+  for (int i = 0; i < node.n_attrs; i++) {
+    Rf_setAttrib(output, Rf_install(as<std::string>(attr_names(i)).c_str()),
+      attr_values(i));
+  }
+  
+  return output;
+}
+
+//' Write lefko3 Objects to a Memory-Mappable Binary Cache
+//' 
+//' Function \code{write_lefko()} saves an R object, such as an \code{hfvdata}
+//' data frame or a \code{lefkoMat} object, to a native binary cache file. The
+//' file holds a fixed header, raw vector and matrix data stored as contiguous,
+//' 8-byte aligned blocks, and a table of node descriptors giving the type,
+//' dimensions, and location of each element. Dense matrices are stored as raw
+//' column-major arrays, and sparse matrices of class \code{dgCMatrix} are
+//' stored as raw compressed sparse column (CSC) arrays.
+//' 
+//' @name write_lefko
+//' 
+//' @param object The R object to save. Must be composed of lists, data frames,
+//' and atomic logical, integer, numeric, or character vectors, factors,
+//' dense matrices, or sparse matrices of class \code{dgCMatrix}.
+//' @param file A string giving the path of the cache file to create.
+//' 
+//' @return The number of bytes written to the cache file.
+//' 
+//' @section Notes:
+//' All attributes are stored, including the dimensions of arrays, the row
+//' names of data frames, and the \code{Dimnames} of sparse matrices. Objects
+//' holding attributes that are not lists, atomic vectors, or \code{dgCMatrix}
+//' objects, such as functions or environments, cannot be cached, and produce
+//' an error.
+//' 
+//' @examples
+//' data(cypdata)
+//' 
+//' cypframe_raw <- sf_create(sizes = c(0, 0, 0, 0, 0, 0, 1, 2.5, 4.5, 8, 17.5),
+//'   stagenames = c("SD", "P1", "P2", "P3", "SL", "D", "XSm", "Sm", "Md", "Lg",
+//'     "XLg"),
+//'   repstatus = c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1),
+//'   obsstatus = c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1),
+//'   propstatus = c(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0),
+//'   immstatus = c(0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0),
+//'   matstatus = c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1),
+//'   indataset = c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1),
+//'   binhalfwidth = c(0, 0, 0, 0, 0, 0.5, 0.5, 1, 1, 2.5, 7))
+//' 
+//' cypraw_v1 <- verticalize3(data = cypdata, noyears = 6, firstyear = 2004,
+//'   patchidcol = "patch", individcol = "plantid", blocksize = 4,
+//'   sizeacol = "Inf2.04", sizebcol = "Inf.04", sizeccol = "Veg.04",
+//'   repstracol = "Inf.04", repstrbcol = "Inf2.04", fecacol = "Pod.04",
+//'   stageassign = cypframe_raw, stagesize = "sizeadded", NAas0 = TRUE,
+//'   NRasRep = TRUE)
+//' 
+//' cache_file <- tempfile(fileext = ".lfk")
+//' write_lefko(cypraw_v1, cache_file)
+//' cypraw_v2 <- read_lefko(cache_file)
+//' 
+//' @seealso \code{\link{read_lefko}()}
+//' 
+//' @export write_lefko
+// [[Rcpp::export(write_lefko)]]
+double write_lefko(RObject object, String file) {
+  std::string file_name = file.get_cstring();
+  std::ofstream out (file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  
+  if (!out.is_open()) {
+    throw Rcpp::exception("Could not open cache file for writing.", false);
+  }
+  
+  lefko_cache_header header;
+  std::memset(&header, 0, sizeof(lefko_cache_header));
+  std::memcpy(header.magic, "LEFKO3C1", 8);
+  header.version = 2;
+  header.endian = 0x01020304;
+  
+  std::uint64_t pos {0};
+  cache_write_bytes(out, pos, &header, sizeof(lefko_cache_header));
+  
+  std::vector<lefko_cache_node> nodes;
+  cache_write_node(object, out, pos, nodes);
+  
+  cache_pad(out, pos);
+  header.n_nodes = static_cast<std::uint64_t>(nodes.size());
+  header.node_offset = pos;
+  cache_write_bytes(out, pos, nodes.data(), nodes.size() * sizeof(lefko_cache_node));
+  header.file_size = pos;
+  
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(lefko_cache_header));
+  out.close();
+  
+  if (out.fail()) {
+    throw Rcpp::exception("Could not write cache file.", false);
+  }
+  
+  return static_cast<double>(pos);
+}
+
+//' Read lefko3 Objects from a Memory-Mapped Binary Cache
+//' 
+//' Function \code{read_lefko()} memory-maps a binary cache file created by
+//' \code{\link{write_lefko}()}, and rebuilds the stored object by copying each
+//' vector and matrix once out of the mapped file. Each block is copied with a
+//' single \code{memcpy()}, so no parsing or R deserialization is required.
+//' 
+//' @name read_lefko
+//' 
+//' @param file A string giving the path of the cache file to read.
+//' 
+//' @return The object originally saved with \code{\link{write_lefko}()}.
+//' 
+//' @section Notes:
+//' The returned object is an ordinary R object holding its own memory, and
+//' the file is unmapped before the function returns. Analyses therefore run on
+//' the copy, not on the mapped file.
+//' 
+//' Cache files are written in the byte order of the machine creating them, and
+//' cannot be read on a machine with a different byte order.
+//' 
+//' @examples
+//' data(cypdata)
+//' 
+//' cypframe_raw <- sf_create(sizes = c(0, 0, 0, 0, 0, 0, 1, 2.5, 4.5, 8, 17.5),
+//'   stagenames = c("SD", "P1", "P2", "P3", "SL", "D", "XSm", "Sm", "Md", "Lg",
+//'     "XLg"),
+//'   repstatus = c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1),
+//'   obsstatus = c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1),
+//'   propstatus = c(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0),
+//'   immstatus = c(0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0),
+//'   matstatus = c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1),
+//'   indataset = c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1),
+//'   binhalfwidth = c(0, 0, 0, 0, 0, 0.5, 0.5, 1, 1, 2.5, 7))
+//' 
+//' cypraw_v1 <- verticalize3(data = cypdata, noyears = 6, firstyear = 2004,
+//'   patchidcol = "patch", individcol = "plantid", blocksize = 4,
+//'   sizeacol = "Inf2.04", sizebcol = "Inf.04", sizeccol = "Veg.04",
+//'   repstracol = "Inf.04", repstrbcol = "Inf2.04", fecacol = "Pod.04",
+//'   stageassign = cypframe_raw, stagesize = "sizeadded", NAas0 = TRUE,
+//'   NRasRep = TRUE)
+//' 
+//' cache_file <- tempfile(fileext = ".lfk")
+//' write_lefko(cypraw_v1, cache_file)
+//' cypraw_v2 <- read_lefko(cache_file)
+//' 
+//' @seealso \code{\link{write_lefko}()}
+//' 
+//' @export read_lefko
+// [[Rcpp::export(read_lefko)]]
+RObject read_lefko(String file) {
+  std::string file_name = file.get_cstring();
+  
+  boost::interprocess::file_mapping cache_map;
+  boost::interprocess::mapped_region cache_region;
+  
+  try {
+    boost::interprocess::file_mapping opened_map (file_name.c_str(),
+      boost::interprocess::read_only);
+    boost::interprocess::mapped_region opened_region (opened_map,
+      boost::interprocess::read_only);
+    cache_map.swap(opened_map);
+    cache_region.swap(opened_region);
+  } catch (boost::interprocess::interprocess_exception& err) {
+    throw Rcpp::exception("Could not open cache file for reading.", false);
+  }
+  
+  const char* base = static_cast<const char*>(cache_region.get_address());
+  std::uint64_t file_size = static_cast<std::uint64_t>(cache_region.get_size());
+  
+  if (file_size < sizeof(lefko_cache_header)) {
+    throw Rcpp::exception("File is not a lefko3 cache file.", false);
+  }
+  
+  lefko_cache_header header;
+  std::memcpy(&header, base, sizeof(lefko_cache_header));
+  
+  if (std::memcmp(header.magic, "LEFKO3C1", 8) != 0) {
+    throw Rcpp::exception("File is not a lefko3 cache file.", false);
+  }
+  if (header.endian != 0x01020304) {
+    throw Rcpp::exception("Cache file was written with a different byte order.",
+      false);
+  }
+  if (header.version != 2) {
+    throw Rcpp::exception("Cache file version is not supported.", false);
+  }
+  if (header.file_size != file_size || header.n_nodes == 0 ||
+    header.node_offset + header.n_nodes * sizeof(lefko_cache_node) > file_size) {
+    throw Rcpp::exception("Cache file is truncated or corrupt.", false);
+  }
+  
+  const lefko_cache_node* nodes = reinterpret_cast<const lefko_cache_node*>(base +
+    header.node_offset);
+  
+  std::uint64_t current {0};
+  return cache_read_node(base, file_size, nodes, header.n_nodes, current);
+}
@@ -1,120 +1,288 @@
 #include <RcppArmadillo.h>
 // [[Rcpp::depends(RcppArmadillo)]]
+#include <LefkoUtils.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace Rcpp;
 using namespace arma;
+using namespace LefkoMats;
 
 
 // Index of Functions
-// 1. List .hoffmannofstuttgart Core Engine for cond_hmpm()
-// 2. List .hoffmannofstuttgart_sp Core Engine for cond_hmpm() with Sparse Matrices
+// 1. DataFrame cond_index Create Element Index for Conditional Matrices
+// 2. List hoffmannofstuttgart Core Engine for cond_hmpm() and cond_diff()
 // 3. List cond_hmpm Extract Conditional Ahistorical Matrices from Historical MPM
 // 4. List cond_diff Extract Conditional Ahistorical Difference Matrices
 
-//' Core Engine for cond_hmpm()
+//' Create Element Index for Conditional Matrices
 //' 
-//' Creates a list of conditional ahistorical matrices in the style noted in
-//' deVries and Caswell (2018).
+//' Function \code{cond_index()} matches each element of a historical matrix
+//' to its stage in time \emph{t}-1 and its location within the conditional
+//' ahistorical matrix for that stage. This index is created once per
+//' \code{lefkoMat} object, and then used for all of its matrices.
 //' 
-//' @name .hoffmannofstuttgart
+//' @name cond_index
 //' 
-//' @param mainmat Historical matrix.
-//' @param indices Data frame including the stages at times \emph{t}-1,
-//' \emph{t}, and \emph{t}+1, asvwell as indices corresponding to elements in
-//' the main historical matrix andvthe conditional matrices to be produced.
-//' @param ahstages The number of stages in the stageframe.
-//' @param stageframe The original stageframe for the input matrices.
-//'
-//' @return A list of ahistorical matrices.
+//' @param hstage1 The stage in time \emph{t}-1 of each historical stage pair.
+//' @param hstage2 The stage in time \emph{t} of each historical stage pair.
+//' @param ahmpm_rows The number of stages in the stageframe.
+//' @param format_int An integer indicating Ehrlen format (\code{0}) or deVries
+//' format (\code{1}).
+//' 
+//' @return A data frame including the stages at times \emph{t}-1, \emph{t},
+//' and \emph{t}+1, as well as indices corresponding to elements in the main
+//' historical matrix and the conditional matrices to be produced. Rows are
+//' ordered by index in the main historical matrix.
 //' 
 //' @keywords internal
 //' @noRd
-// [[Rcpp::export(.hoffmannofstuttgart)]]
-Rcpp::List hoffmannofstuttgart(arma::mat& mainmat, DataFrame indices,
-  int ahstages, StringVector stagenames) {
-  arma::uvec stage1 = indices["stage1"];
-  arma::uvec stage2 = indices["stage2"];
-  arma::uvec stage3 = indices["stage3"];
-  arma::ivec main_index = indices["main_index"];
-  arma::ivec new_index = indices["new_index"];
+inline DataFrame cond_index (const arma::uvec& hstage1,
+  const arma::uvec& hstage2, int ahmpm_rows, int format_int) {
   
-  arma::mat newmatrix(ahstages, ahstages);
-  newmatrix.zeros();
+  int hmpm_rows = static_cast<int>(hstage1.n_elem);
+  int hmpm_elems = 2 * ahmpm_rows * ahmpm_rows * ahmpm_rows;
   
-  Rcpp::List condlist (ahstages);
+  arma::uvec stage1(hmpm_elems);
+  arma::uvec stage2(hmpm_elems);
+  arma::uvec stage3(hmpm_elems);
+  arma::ivec main_index(hmpm_elems);
+  arma::ivec new_index(hmpm_elems);
+  stage1.zeros();
+  stage2.zeros();
+  stage3.zeros();
+  main_index.fill(-1);
+  new_index.fill(-1);
+  
+  int stage1_proxy {0};
+  int stage2o_proxy {0};
+  int stage2n_proxy {0};
+  int stage3_proxy {0};
   
-  arma::uvec condidx = find(stage1 == 1);
-  int condlength = static_cast<int>(condidx.n_elem);
+  int counter = 0;
   
-  for (int i = 0; i < ahstages; i++) {
-    newmatrix.zeros();
-    
-    condidx = find(stage1 == (i+1));
-    condlength = static_cast<int>(condidx.n_elem);
-    
-    for (int j = 0; j < condlength; j++) {
-      if (mainmat(main_index(condidx(j))) > 0) newmatrix(new_index(condidx(j))) = 
-        newmatrix(new_index(condidx(j))) + mainmat(main_index(condidx(j)));
+  // Create index of matrix elements in original matrices & conditional matrices
+  // Must be run on hstages inputs to handle reduced matrices properly
+  if (format_int == 0) {
+    // Ehrlen-format hMPMs
+    for (int prior = 0; prior < hmpm_rows; prior++) {
+      for (int post = 0; post < hmpm_rows; post++) {
+        stage1_proxy = hstage1[prior];
+        stage2o_proxy = hstage2[prior];
+        stage2n_proxy = hstage1[post];
+        stage3_proxy = hstage2[post];
+        
+        if (stage2o_proxy == stage2n_proxy) {
+          stage1[counter] = stage1_proxy;
+          stage2[counter] = stage2n_proxy;
+          stage3[counter] = stage3_proxy;
+              
+          main_index[counter] = post + (prior * hmpm_rows);
+          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
+          
+          counter++;
+        }
+      }
+    }
+  } else {
+    // deVries-format hMPMs
+    for (int prior = 0; prior < hmpm_rows; prior++) {
+      for (int post = 0; post < hmpm_rows; post++) {
+        stage1_proxy = hstage1[prior];
+        stage2o_proxy = hstage2[prior];
+        stage2n_proxy = hstage1[post];
+        stage3_proxy = hstage2[post];
+        
+        if (stage2o_proxy == stage2n_proxy) {
+          stage1[counter] = stage1_proxy;
+          stage2[counter] = stage2o_proxy;
+          stage3[counter] = stage3_proxy;
+              
+          main_index[counter] = post + (prior * hmpm_rows);
+          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
+          
+          counter++;
+        } else if (stage2n_proxy == ahmpm_rows && stage1_proxy < ahmpm_rows) {
+          stage1[counter] = stage1_proxy;
+          stage2[counter] = stage2o_proxy;
+          stage3[counter] = stage3_proxy;
+              
+          main_index[counter] = post + (prior * hmpm_rows);
+          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
+              
+          counter++;
+        }
+      }
     }
-    
-    condlist(i) = newmatrix;
   }
-  condlist.names() = stagenames;
   
-  return (condlist);
+  arma::uvec elements_to_use = find(stage1 > 0);
+  stage1 = stage1.elem(elements_to_use);
+  stage2 = stage2.elem(elements_to_use);
+  stage3 = stage3.elem(elements_to_use);
+  main_index = main_index.elem(elements_to_use);
+  new_index = new_index.elem(elements_to_use);
+  
+  DataFrame loveontherocks = DataFrame::create(Named("stage1") = stage1,
+    _["stage2"] = stage2, _["stage3"] = stage3, _["main_index"] = main_index,
+    _["new_index"] = new_index);
+  
+  return loveontherocks;
 }
 
-//' Core Engine for cond_hmpm() with Sparse Matrices
+//' Core Engine for cond_hmpm() and cond_diff()
 //' 
-//' Creates a list of conditional ahistorical matrices in the style noted in
-//' deVries and Caswell (2018).
+//' Creates lists of conditional ahistorical matrices in the style noted in
+//' deVries and Caswell (2018), for all matrices in a list at once.
 //' 
-//' @name .hoffmannofstuttgart_sp
+//' @name hoffmannofstuttgart
 //' 
-//' @param mainmat Historical matrix in sparse format.
+//' @param mats A list of historical matrices, in dense or sparse format.
 //' @param indices Data frame including the stages at times \emph{t}-1,
-//' \emph{t}, and \emph{t}+1, asvwell as indices corresponding to elements in
-//' the main historical matrix andvthe conditional matrices to be produced.
+//' \emph{t}, and \emph{t}+1, as well as indices corresponding to elements in
+//' the main historical matrix and the conditional matrices to be produced, as
+//' produced by \code{cond_index()}.
 //' @param ahstages The number of stages in the stageframe.
-//' @param stageframe The original stageframe for the input matrices.
+//' @param hstages The number of historical stage pairs.
+//' @param stagenames The names of stages in the stageframe.
 //'
-//' @return A list of ahistorical matrices.
+//' @return A list with one element per historical matrix, each of which is a
+//' list of ahistorical matrices, one per stage in time \emph{t}-1.
+//' 
+//' @section Notes:
+//' The index is converted once into a scatter map pointing into a cube holding
+//' all conditional matrices of a historical matrix. Dense matrices are then
+//' gathered element by element from the index, while sparse matrices are read
+//' in place and merged column by column against the index, which is ordered
+//' by column. Cubes are built in parallel in chunks of one matrix per thread,
+//' and each chunk is emitted as lists of matrices before the next chunk is
+//' built in the same cubes, so that memory use does not grow with the number
+//' of historical matrices.
 //' 
 //' @keywords internal
 //' @noRd
-// [[Rcpp::export(.hoffmannofstuttgart_sp)]]
-Rcpp::List hoffmannofstuttgart_sp(arma::sp_mat& mainmat, DataFrame indices,
-  int ahstages, StringVector stagenames) {
-  arma::uvec stage1 = indices["stage1"];
-  arma::uvec stage2 = indices["stage2"];
-  arma::uvec stage3 = indices["stage3"];
-  arma::ivec main_index = indices["main_index"];
-  arma::ivec new_index = indices["new_index"];
+inline Rcpp::List hoffmannofstuttgart(const List& mats,
+  const DataFrame& indices, int ahstages, int hstages,
+  const StringVector& stagenames) {
+  
+  arma::uvec stage1 = as<arma::uvec>(indices["stage1"]);
+  arma::ivec main_index = as<arma::ivec>(indices["main_index"]);
+  arma::ivec new_index = as<arma::ivec>(indices["new_index"]);
+  
+  int numofmats = static_cast<int>(mats.length());
+  int index_length = static_cast<int>(stage1.n_elem);
+  arma::uword cond_elems = static_cast<arma::uword>(ahstages) * ahstages;
+  
+  // Scatter map into a cube with one slice per stage in time t-1
+  arma::uvec cube_index (index_length);
+  arma::ivec entry_row (index_length);
+  arma::ivec entry_col_start (hstages + 1, fill::zeros);
+  
+  for (int e = 0; e < index_length; e++) {
+    cube_index(e) = (stage1(e) - 1) * cond_elems +
+      static_cast<arma::uword>(new_index(e));
+    entry_row(e) = main_index(e) % hstages;
+    entry_col_start(main_index(e) / hstages + 1) += 1;
+  }
+  for (int j = 0; j < hstages; j++) {
+    entry_col_start(j + 1) += entry_col_start(j);
+  }
   
-  arma::mat newmatrix(ahstages, ahstages);
-  newmatrix.zeros();
+  // Matrix access set up before any parallel work
+  std::vector<NumericMatrix> dense_mats;
+  std::vector<dgc_view> sparse_mats;
+  std::vector<const double*> dense_ptrs (numofmats, nullptr);
+  std::vector<int> sparse_slot (numofmats, -1);
   
-  Rcpp::List condlist (ahstages);
+  for (int i = 0; i < numofmats; i++) {
+    int mat_rows {0};
+    int mat_cols {0};
+    
+    if (is<NumericMatrix>(mats(i))) {
+      dense_mats.push_back(as<NumericMatrix>(mats(i)));
+      dense_ptrs[i] = dense_mats.back().begin();
+      
+      mat_rows = dense_mats.back().nrow();
+      mat_cols = dense_mats.back().ncol();
+    } else {
+      sparse_slot[i] = static_cast<int>(sparse_mats.size());
+      sparse_mats.emplace_back(mats, i);
+      
+      mat_rows = sparse_mats.back().n_rows;
+      mat_cols = sparse_mats.back().n_cols;
+    }
+    
+    if (mat_rows != hstages || mat_cols != hstages) {
+      throw Rcpp::exception("Matrix dimensions do not match hstages.", false);
+    }
+  }
   
-  arma::uvec condidx = find(stage1 == 1);
-  int condlength = static_cast<int>(condidx.n_elem);
+  // Cubes built in parallel one chunk at a time, with one cube per thread
+  int chunk_size {1};
+  #ifdef _OPENMP
+  chunk_size = omp_get_max_threads();
+  #endif
+  if (chunk_size < 1) chunk_size = 1;
+  if (chunk_size > numofmats) chunk_size = numofmats;
   
-  for (int i = 0; i < ahstages; i++) {
-    newmatrix.zeros();
-    
-    condidx = find(stage1 == (i+1));
-    condlength = static_cast<int>(condidx.n_elem);
+  List allout (numofmats);
+  std::vector<arma::cube> cond_cubes (chunk_size);
+  
+  for (int chunk_start = 0; chunk_start < numofmats; chunk_start += chunk_size) {
+    int chunk_end = chunk_start + chunk_size;
+    if (chunk_end > numofmats) chunk_end = numofmats;
     
-    for (int j = 0; j < condlength; j++) {
-      if (mainmat(main_index(condidx(j))) > 0) newmatrix(new_index(condidx(j))) = 
-        newmatrix(new_index(condidx(j))) + mainmat(main_index(condidx(j)));
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int i = chunk_start; i < chunk_end; i++) {
+      arma::cube& cond_cube = cond_cubes[i - chunk_start];
+      cond_cube.zeros(ahstages, ahstages, ahstages);
+      double* out_mem = cond_cube.memptr();
+      
+      if (dense_ptrs[i] != nullptr) {
+        const double* main_mem = dense_ptrs[i];
+        
+        for (int e = 0; e < index_length; e++) {
+          double value = main_mem[main_index(e)];
+          if (value > 0) out_mem[cube_index(e)] += value;
+        }
+      } else {
+        const dgc_view& mainmat = sparse_mats[sparse_slot[i]];
+        
+        for (int j = 0; j < hstages; j++) {
+          int e = static_cast<int>(entry_col_start(j));
+          int e_end = static_cast<int>(entry_col_start(j + 1));
+          
+          for (int k = mainmat.col_ptr[j]; k < mainmat.col_ptr[j+1] && e < e_end; k++) {
+            int row = mainmat.row_idx[k];
+            while (e < e_end && entry_row(e) < row) e++;
+            
+            if (e < e_end && entry_row(e) == row) {
+              if (mainmat.values[k] > 0) out_mem[cube_index(e)] += mainmat.values[k];
+              e++;
+            }
+          }
+        }
+      }
     }
     
-    condlist(i) = newmatrix;
+    // Each chunk is emitted before its cubes are reused
+    for (int i = chunk_start; i < chunk_end; i++) {
+      const arma::cube& cond_cube = cond_cubes[i - chunk_start];
+      
+      Rcpp::List condlist (ahstages);
+      for (int s = 0; s < ahstages; s++) {
+        condlist(s) = arma::mat(cond_cube.slice(s));
+      }
+      condlist.names() = stagenames;
+      allout(i) = condlist;
+    }
   }
-  condlist.names() = stagenames;
   
-  return (condlist);
+  return allout;
 }
 
 //' Extract Conditional Ahistorical Matrices from Historical MPM
@@ -256,133 +424,23 @@ Rcpp::List cond_hmpm(List hmpm, Nullable<CharacterVector> matchoice = R_NilValue
   
   int ahmpm_rows = static_cast<int>(ahstages.n_elem);
   int hmpm_rows = static_cast<int>(hstage1.n_elem);
-  int hmpm_elems = 2 * ahmpm_rows * ahmpm_rows * ahmpm_rows;
   
   int format_int {0};
   if (stagenames(ahmpm_rows - 1) == "AlmostBorn") format_int = 1;
   
-  arma::uvec stage1(hmpm_elems);
-  arma::uvec stage2(hmpm_elems);
-  arma::uvec stage3(hmpm_elems);
-  arma::ivec main_index(hmpm_elems);
-  arma::ivec new_index(hmpm_elems);
-  stage1.zeros();
-  stage2.zeros();
-  stage3.zeros();
-  main_index.fill(-1);
-  new_index.fill(-1);
-  
-  int stage1_proxy {0};
-  int stage2o_proxy {0};
-  int stage2n_proxy {0};
-  int stage3_proxy {0};
-  
-  int counter = 0;
-  
-  // Create index of matrix elements in original matrices & conditional matrices
-  // Must be run on hstages inputs to handle reduced matrices properly
-  if (format_int == 0) {
-    // Ehrlen-format hMPMs
-    for (int prior = 0; prior < hmpm_rows; prior++) {
-      for (int post = 0; post < hmpm_rows; post++) {
-        stage1_proxy = hstage1[prior];
-        stage2o_proxy = hstage2[prior];
-        stage2n_proxy = hstage1[post];
-        stage3_proxy = hstage2[post];
-        
-        if (stage2o_proxy == stage2n_proxy) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2n_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-          
-          counter++;
-        }
-      }
-    }
-  } else {
-    // deVries-format hMPMs
-    for (int prior = 0; prior < hmpm_rows; prior++) {
-      for (int post = 0; post < hmpm_rows; post++) {
-        stage1_proxy = hstage1[prior];
-        stage2o_proxy = hstage2[prior];
-        stage2n_proxy = hstage1[post];
-        stage3_proxy = hstage2[post];
-        
-        if (stage2o_proxy == stage2n_proxy) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2o_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-          
-          counter++;
-        } else if (stage2n_proxy == ahmpm_rows && stage1_proxy < ahmpm_rows) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2o_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-              
-          counter++;
-        }
-      }
-    }
-  }
-  
-  arma::uvec elements_to_use = find(stage1 > 0);
-  stage1 = stage1.elem(elements_to_use);
-  stage2 = stage2.elem(elements_to_use);
-  stage3 = stage3.elem(elements_to_use);
-  main_index = main_index.elem(elements_to_use);
-  new_index = new_index.elem(elements_to_use);
-  
-  DataFrame loveontherocks = DataFrame::create(Named("stage1") = stage1,
-    _["stage2"] = stage2, _["stage3"] = stage3, _["main_index"] = main_index,
-    _["new_index"] = new_index);
+  DataFrame loveontherocks = cond_index(hstage1, hstage2, ahmpm_rows,
+    format_int);
   
   // Creates conditional matrices in list form
-  List allout (numofmats);
-  List mats1;
-  
+  List chosen_mats = amats;
   if (iusedmats == 3) {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(fmats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(fmats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(fmats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
+    chosen_mats = fmats;
   } else if (iusedmats == 2) {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(umats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(umats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(umats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
-  } else {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(amats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(amats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(amats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
+    chosen_mats = umats;
   }
+  
+  List allout = hoffmannofstuttgart(chosen_mats, loveontherocks, ahmpm_rows,
+    hmpm_rows, stagenames);
   allout.names() = matnames;
   
   int panama_parts = 4;
@@ -616,133 +674,23 @@ Rcpp::List cond_diff(List lDiff, int ref = 1,
   
   int ahmpm_rows = static_cast<int>(ahstages.n_elem);
   int hmpm_rows = static_cast<int>(hstage1.n_elem);
-  int hmpm_elems = 2 * ahmpm_rows * ahmpm_rows * ahmpm_rows;
   
   int format_int {0};
   if (stagenames(ahmpm_rows - 1) == "AlmostBorn") format_int = 1;
   
-  arma::uvec stage1(hmpm_elems);
-  arma::uvec stage2(hmpm_elems);
-  arma::uvec stage3(hmpm_elems);
-  arma::ivec main_index(hmpm_elems);
-  arma::ivec new_index(hmpm_elems);
-  stage1.zeros();
-  stage2.zeros();
-  stage3.zeros();
-  main_index.fill(-1);
-  new_index.fill(-1);
-  
-  int stage1_proxy {0};
-  int stage2o_proxy {0};
-  int stage2n_proxy {0};
-  int stage3_proxy {0};
-  
-  int counter = 0;
-  
-  // Create index of matrix elements in original matrices & conditional matrices
-  // Run on hstages inputs to handle reduced matrices properly
-  if (format_int == 0) {
-    // Ehrlen-format hMPMs
-    for (int prior = 0; prior < hmpm_rows; prior++) {
-      for (int post = 0; post < hmpm_rows; post++) {
-        stage1_proxy = hstage1[prior];
-        stage2o_proxy = hstage2[prior];
-        stage2n_proxy = hstage1[post];
-        stage3_proxy = hstage2[post];
-        
-        if (stage2o_proxy == stage2n_proxy) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2n_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-          
-          counter++;
-        }
-      }
-    }
-  } else {
-    // deVries-format hMPMs
-    for (int prior = 0; prior < hmpm_rows; prior++) {
-      for (int post = 0; post < hmpm_rows; post++) {
-        stage1_proxy = hstage1[prior];
-        stage2o_proxy = hstage2[prior];
-        stage2n_proxy = hstage1[post];
-        stage3_proxy = hstage2[post];
-        
-        if (stage2o_proxy == stage2n_proxy) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2o_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-          
-          counter++;
-        } else if (stage2n_proxy == ahmpm_rows && stage1_proxy < ahmpm_rows) {
-          stage1[counter] = stage1_proxy;
-          stage2[counter] = stage2o_proxy;
-          stage3[counter] = stage3_proxy;
-              
-          main_index[counter] = post + (prior * hmpm_rows);
-          new_index[counter] = (stage3[counter] - 1) + ((stage2[counter] - 1) * ahmpm_rows);
-              
-          counter++;
-        }
-      }
-    }
-  }
-  
-  arma::uvec elements_to_use = find(stage1 > 0);
-  stage1 = stage1.elem(elements_to_use);
-  stage2 = stage2.elem(elements_to_use);
-  stage3 = stage3.elem(elements_to_use);
-  main_index = main_index.elem(elements_to_use);
-  new_index = new_index.elem(elements_to_use);
-  
-  DataFrame loveontherocks = DataFrame::create(Named("stage1") = stage1,
-    _["stage2"] = stage2, _["stage3"] = stage3, _["main_index"] = main_index,
-    _["new_index"] = new_index);
-  
-  // Create conditional matrices in list form
-  List allout (numofmats);
-  List mats1;
+  DataFrame loveontherocks = cond_index(hstage1, hstage2, ahmpm_rows,
+    format_int);
   
+  // Creates conditional matrices in list form
+  List chosen_mats = amats;
   if (iusedmats == 3) {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(fmats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(fmats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(fmats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
+    chosen_mats = fmats;
   } else if (iusedmats == 2) {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(umats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(umats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(umats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
-  } else {
-    for (int i = 0; i < numofmats; i++) {
-      if (is<NumericMatrix>(amats(i))) {
-        arma::mat chosen_mat = as<arma::mat>(amats(i));
-        mats1 = hoffmannofstuttgart(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      } else { 
-        arma::sp_mat chosen_mat = as<arma::sp_mat>(amats(i));
-        mats1 = hoffmannofstuttgart_sp(chosen_mat, loveontherocks, ahmpm_rows, stagenames);
-      }
-      allout(i) = mats1;
-    }
+    chosen_mats = umats;
   }
+  
+  List allout = hoffmannofstuttgart(chosen_mats, loveontherocks, ahmpm_rows,
+    hmpm_rows, stagenames);
   allout.names() = matnames;
   
   int panama_parts = 4;
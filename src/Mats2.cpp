@@ -13,12 +13,16 @@ using namespace LefkoMats;
 // 
 // 1. List sf_reassess  Standardize Stageframe For MPM Analysis
 // 2. DataFrame sf_skeleton  Create Skeleton Stageframe
-// 3. List thefifthhousemate  Create Historically Structured Version of ahMPM
-// 4. List hist_null  Create Historical MPMs Assuming No Influence of Individual History
-// 5. List lmean  Estimate Mean Projection Matrices
-// 6. void add_stage_single  Add a New Stage to a Single lefkoMat
-// 7. List add_stage  Add a New Stage to an Existing lefkoMat or lefkoMatList Object
-// 8. List cycle_check  Check Continuity of Life Cycle through Matrices in lefkoMat Objects
+// 3. arma::sp_mat null_expand  Create Expansion Factor of a Null Historical Matrix
+// 4. List thefifthhousemate  Create Historically Structured Version of ahMPM
+// 5. List hist_null  Create Historical MPMs Assuming No Influence of Individual History
+// 6. List lmean  Estimate Mean Projection Matrices
+// 7. void add_stage_single  Add a New Stage to a Single lefkoMat
+// 8. Vector<RTYPE> stage_insert  Insert New Entries Into a Stage Table Column
+// 9. void add_stage_batch  Add Several New Stages to a Single lefkoMat
+// 10. List add_stage  Add a New Stage to an Existing lefkoMat or lefkoMatList Object
+// 11. void cycle_graph  Analyze the Life Cycle Graph of a Single Matrix
+// 12. List cycle_check  Check Continuity of Life Cycle through Matrices in lefkoMat Objects
 
 
 //' Standardize Stageframe For MPM Analysis
@@ -108,6 +112,9 @@ Rcpp::DataFrame sf_skeleton(int stages, bool standard = true) {
 //' being operationalized.
 //' @param format Integer indicating whether historical matrices should be in
 //' (1) Ehrlen or (2) deVries format.
+//' @param full_index A logical value indicating whether to create the
+//' \code{allstages} data frame. If \code{FALSE}, then only the new stageframe
+//' and the \code{hstages} index are created. Defaults to \code{TRUE}.
 //' 
 //' @return The output is composed of three elements:
 //' \item{ahstages}{A new stageframe, which only differs from the input
@@ -115,11 +122,12 @@ Rcpp::DataFrame sf_skeleton(int stages, bool standard = true) {
 //' \item{hstages}{A new historical stage-pair index for the new historical
 //' matrices.}
 //' \item{allstages}{A large data frame describing every element to be estimated
-//' in the new historical matrices.}
+//' in the new historical matrices. Only produced if \code{full_index = TRUE}.}
 //' 
 //' @keywords internal
 //' @noRd
-Rcpp::List simplepizzle(DataFrame StageFrame, int format) {
+Rcpp::List simplepizzle(DataFrame StageFrame, int format,
+  bool full_index = true) {
   
   arma::vec newstageid = as<arma::vec>(StageFrame["stage_id"]);
   StringVector origstageid = as<StringVector>(StageFrame["stage"]);
@@ -388,6 +396,12 @@ Rcpp::List simplepizzle(DataFrame StageFrame, int format) {
     stid2.length());
   hstages.attr("class") = "data.frame";
   
+  if (!full_index) {
+    Rcpp::List output = Rcpp::List::create(Named("ahstages") = StageFrame,
+      _["hstages"] = hstages);
+    return output;
+  }
+  
   // Set up vectors to put together into matrix map data frame
   arma::vec stage3(totallength, fill::zeros);
   arma::vec stage2n(totallength, fill::zeros);
@@ -797,89 +811,253 @@ Rcpp::List simplepizzle(DataFrame StageFrame, int format) {
   return output;
 }
 
+//' Create Expansion Factor of a Null Historical Matrix
+//' 
+//' Function \code{null_expand()} takes a single ahistorical matrix and creates
+//' the sparse factor holding its elements in the rows of the corresponding
+//' null historical matrix. Column \code{j} of the output is the column shared
+//' by all historical stage pairs in which stage \code{j} occurs in time
+//' \emph{t}.
+//' 
+//' @name null_expand
+//' 
+//' @param M A view of the original ahistorical \code{U} or \code{F} matrix.
+//' @param entry_ok A vector marking stages that are entry stages.
+//' @param rep_ok A vector marking stages that are reproductive.
+//' @param format Integer indicating whether historical matrices should be in
+//' (1) Ehrlen or (2) deVries format.
+//' @param fec A logical value indicating whether \code{M} is an \code{F}
+//' matrix.
+//' 
+//' @return A sparse matrix with as many rows as the historical matrix, and as
+//' many columns as the ahistorical matrix.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::sp_mat null_expand (const dgc_view& M, const arma::uvec& entry_ok,
+  const arma::uvec& rep_ok, int format, bool fec) {
+  
+  int nostages = M.n_cols;
+  int h_rows = nostages * nostages;
+  if (format == 2) h_rows = nostages * (nostages + 1);
+  
+  std::vector<arma::uword> out_rows;
+  std::vector<double> out_vals;
+  arma::uvec out_ptrs (nostages + 1, fill::zeros);
+  out_rows.reserve(static_cast<size_t>(2 * M.n_nonzero));
+  out_vals.reserve(static_cast<size_t>(2 * M.n_nonzero));
+  
+  for (int j = 0; j < nostages; j++) {
+    // Stage pair (k, j), with rows sorted within the column
+    if (format == 1 || !fec) {
+      for (int k = M.col_ptr[j]; k < M.col_ptr[j+1]; k++) {
+        out_rows.push_back(static_cast<arma::uword>(M.row_idx[k] + (j * nostages)));
+        out_vals.push_back(M.values[k]);
+      }
+    }
+    
+    // Stage pair (k, AlmostBorn) in deVries format
+    if (format == 2 && rep_ok(j) > 0) {
+      for (int k = M.col_ptr[j]; k < M.col_ptr[j+1]; k++) {
+        if (entry_ok(M.row_idx[k]) > 0) {
+          out_rows.push_back(static_cast<arma::uword>(M.row_idx[k] +
+            (nostages * nostages)));
+          out_vals.push_back(M.values[k]);
+        }
+      }
+    }
+    out_ptrs(j + 1) = static_cast<arma::uword>(out_rows.size());
+  }
+  
+  arma::sp_mat output(arma::uvec(out_rows), out_ptrs, arma::vec(out_vals),
+    h_rows, nostages);
+  return output;
+}
+
 //' Create Historically Structured Version of ahMPM
 //' 
 //' Function \code{thefifthhousemate()} takes an ahistorical MPM as input, and
-//' uses the \code{allstages} index to create a historically structured version
-//' of it.
+//' creates a historically structured version of it directly in compressed
+//' sparse column format. Each historical matrix factors as \code{D * S}, where
+//' \code{D} holds the elements of the ahistorical matrix in the historical rows
+//' (see \code{null_expand()}), and \code{S} is a zero-one matrix mapping each
+//' historical column to the stage in time \emph{t}. Each column of the
+//' historical matrix is therefore a copy of one column of \code{D}, and the
+//' number of non-zero elements is at most the number of stages times the
+//' number of non-zero elements in the ahistorical matrix.
 //' 
 //' @name thefifthhousemate
 //' 
 //' @param mpm The original ahMPM, supplied as a \code{lefkoMat} object.
-//' @param allstages The index dataframe named \code{allstages}, in the third
-//' element of output developed by \code{simplepizzle()}.
-//' @param hstages The index dataframe named \code{hstages}, in the second
-//' element of output developed by \code{simplepizzle()}.
-//' @param stageframe The ahistorical stageframe supplied by
-//' \code{simplepizzle()}.
+//' @param stageframe The original ahistorical stageframe.
 //' @param format Integer indicating whether historical matrices should be in
 //' (1) Ehrlen or (2) deVries format.
+//' @param sparse_output A logical value indicating whether to output matrices
+//' in sparse format.
+//' @param as_operator A logical value indicating whether to output the factors
+//' \code{D} and \code{S} rather than the historical matrices themselves.
 //' 
 //' @return This will return a list of lists. The first list is composed of all
 //' new \code{A} matrices. The second list is composed of all new \code{U}
-//' matrices. The third list is composed of all new \code{F} matrices.
+//' matrices. The third list is composed of all new \code{F} matrices. If
+//' \code{as_operator = TRUE}, then these are the \code{D} factors, and a fourth
+//' element called \code{collapse} holds the \code{S} factor shared by all
+//' matrices. The last element, \code{matrixqc}, gives the total numbers of
+//' non-zero elements in the historical \code{U} and \code{F} matrices.
 //' 
 //' @keywords internal
 //' @noRd
-Rcpp::List thefifthhousemate(List mpm, DataFrame allstages, DataFrame hstages,
-  DataFrame stageframe, int format) {
+Rcpp::List thefifthhousemate(List mpm, DataFrame stageframe, int format,
+  bool sparse_output, bool as_operator) {
   Rcpp::List old_Umats = as<List>(mpm["U"]);
   Rcpp::List old_Fmats = as<List>(mpm["F"]);
   
-  Rcpp::IntegerVector stageid = stageframe["stage_id"];
-  int nostages = stageid.length();
+  arma::vec entrystage = as<arma::vec>(stageframe["entrystage"]);
+  arma::vec repstatus = as<arma::vec>(stageframe["repstatus"]);
+  int nostages = static_cast<int>(entrystage.n_elem);
   int nocols = nostages * nostages;
+  if (format == 2) nocols = nostages * (nostages + 1);
   
-  if (format == 2) nocols = (nostages -1) * nostages;
+  arma::uvec entry_ok (nostages, fill::zeros);
+  arma::uvec rep_ok (nostages, fill::zeros);
+  for (int i = 0; i < nostages; i++) {
+    if (entrystage(i) >= 1.0) entry_ok(i) = 1;
+    if (repstatus(i) >= 1.0) rep_ok(i) = 1;
+  }
   
-  Rcpp::IntegerVector old_index = allstages["index21"];
-  Rcpp::IntegerVector new_indexu = allstages["index321u"];
-  Rcpp::IntegerVector new_indexf = allstages["index321f"];
-  arma::ivec stage2o_all = as<arma::ivec>(allstages["stage2o"]);
-  arma::ivec stage1_all = as<arma::ivec>(allstages["stage1"]);
-  arma::ivec hst_s_id_1 = as<arma::ivec>(hstages["stage_id_1"]);
-  arma::ivec hst_s_id_2 = as<arma::ivec>(hstages["stage_id_2"]);
+  // Column c of the historical matrix copies column col_source(c) of D
+  arma::ivec col_source (nocols);
+  arma::uvec col_copies (nostages, fill::zeros);
+  for (int c = 0; c < nocols; c++) {
+    int stage_t = c % nostages;
+    int stage_tm1 = c / nostages;
+    
+    if (stage_tm1 == nostages && entry_ok(stage_t) == 0) {
+      col_source(c) = -1;
+    } else {
+      col_source(c) = stage_t;
+      col_copies(stage_t) += 1;
+    }
+  }
   
   int num_mats = old_Umats.length();
-  int index_elems = new_indexu.length();
+  if (num_mats > 0 && is<S4>(old_Umats(0))) sparse_output = true;
   
   Rcpp::List new_Umats(num_mats);
   Rcpp::List new_Fmats(num_mats);
   Rcpp::List new_Amats(num_mats);
   
-  arma::mat new_U(nocols, nocols, fill::zeros);
-  arma::mat new_F(nocols, nocols, fill::zeros);
-  arma::mat new_A(nocols, nocols, fill::zeros);
-  arma::mat old_U(nostages, nostages, fill::zeros);
-  arma::mat old_F(nostages, nostages, fill::zeros);
+  int tot_U_elems {0};
+  int tot_F_elems {0};
   
   for (int i = 0; i < num_mats; i++) {
-    new_U.zeros();
-    new_F.zeros();
-    new_A.zeros();
-    old_U.zeros();
-    old_F.zeros();
-    
-    old_U = as<arma::mat>(old_Umats(i));
-    old_F = as<arma::mat>(old_Fmats(i));
-    
-    for (int j = 0; j < index_elems; j++) {
-      if (new_indexu(j) > -1.0) {
-        new_U(new_indexu(j)) = old_U(old_index(j));
+    dgc_view old_U (old_Umats, i);
+    dgc_view old_F (old_Fmats, i);
+    
+    if (old_U.n_rows != nostages || old_U.n_cols != nostages ||
+      old_F.n_rows != nostages || old_F.n_cols != nostages) {
+      throw Rcpp::exception("Matrix dimensions do not match the stageframe.",
+        false);
+    }
+    
+    arma::sp_mat D_U = null_expand(old_U, entry_ok, rep_ok, format, false);
+    arma::sp_mat D_F = null_expand(old_F, entry_ok, rep_ok, format, true);
+    arma::sp_mat D_A = D_U + D_F;
+    
+    // Stored zeros are not counted, as with find() on dense matrices
+    for (int j = 0; j < nostages; j++) {
+      int u_found {0};
+      int f_found {0};
+      for (arma::uword k = D_U.col_ptrs[j]; k < D_U.col_ptrs[j+1]; k++) {
+        if (D_U.values[k] != 0.0) u_found++;
+      }
+      for (arma::uword k = D_F.col_ptrs[j]; k < D_F.col_ptrs[j+1]; k++) {
+        if (D_F.values[k] != 0.0) f_found++;
+      }
+      tot_U_elems += static_cast<int>(col_copies(j)) * u_found;
+      tot_F_elems += static_cast<int>(col_copies(j)) * f_found;
+    }
+    
+    if (as_operator) {
+      if (sparse_output) {
+        new_Umats(i) = D_U;
+        new_Fmats(i) = D_F;
+        new_Amats(i) = D_A;
+      } else {
+        new_Umats(i) = arma::mat(D_U);
+        new_Fmats(i) = arma::mat(D_F);
+        new_Amats(i) = arma::mat(D_A);
+      }
+      continue;
+    }
+    
+    arma::sp_mat new_mats[3];
+    const arma::sp_mat* factors[3] = {&D_U, &D_F, &D_A};
+    
+    for (int m = 0; m < 3; m++) {
+      const arma::sp_mat& D = *factors[m];
+      
+      arma::uvec out_ptrs (nocols + 1, fill::zeros);
+      for (int c = 0; c < nocols; c++) {
+        arma::uword col_nnz {0};
+        if (col_source(c) > -1) {
+          col_nnz = D.col_ptrs[col_source(c) + 1] - D.col_ptrs[col_source(c)];
+        }
+        out_ptrs(c + 1) = out_ptrs(c) + col_nnz;
       }
-      if (new_indexf(j) > -1.0) {
-        new_F(new_indexf(j)) = old_F(old_index(j));
+      
+      arma::uvec out_rows (out_ptrs(nocols));
+      arma::vec out_vals (out_ptrs(nocols));
+      for (int c = 0; c < nocols; c++) {
+        if (col_source(c) < 0) continue;
+        
+        arma::uword from = D.col_ptrs[col_source(c)];
+        arma::uword col_nnz = out_ptrs(c + 1) - out_ptrs(c);
+        for (arma::uword k = 0; k < col_nnz; k++) {
+          out_rows(out_ptrs(c) + k) = D.row_indices[from + k];
+          out_vals(out_ptrs(c) + k) = D.values[from + k];
+        }
       }
+      
+      new_mats[m] = arma::sp_mat(out_rows, out_ptrs, out_vals, nocols, nocols);
     }
     
-    new_A = new_U + new_F;
-    new_Umats(i) = new_U;
-    new_Fmats(i) = new_F;
-    new_Amats(i) = new_A;
+    if (sparse_output) {
+      new_Umats(i) = new_mats[0];
+      new_Fmats(i) = new_mats[1];
+      new_Amats(i) = new_mats[2];
+    } else {
+      new_Umats(i) = arma::mat(new_mats[0]);
+      new_Fmats(i) = arma::mat(new_mats[1]);
+      new_Amats(i) = arma::mat(new_mats[2]);
+    }
   }
   
+  IntegerVector new_mqc = {tot_U_elems, tot_F_elems, num_mats};
+  
   Rcpp::List output = List::create(Named("A") = new_Amats, _["U"] = new_Umats,
-    _["F"] = new_Fmats);
+    _["F"] = new_Fmats, _["matrixqc"] = new_mqc);
+  
+  if (as_operator) {
+    arma::uvec s_rows (static_cast<arma::uword>(sum(col_copies)));
+    arma::uvec s_ptrs (nocols + 1, fill::zeros);
+    for (int c = 0; c < nocols; c++) {
+      s_ptrs(c + 1) = s_ptrs(c);
+      if (col_source(c) > -1) {
+        s_rows(s_ptrs(c)) = static_cast<arma::uword>(col_source(c));
+        s_ptrs(c + 1) += 1;
+      }
+    }
+    arma::sp_mat S (s_rows, s_ptrs, arma::vec(s_rows.n_elem, fill::ones),
+      nostages, nocols);
+    
+    if (sparse_output) {
+      output.push_back(S, "collapse");
+    } else {
+      output.push_back(arma::mat(S), "collapse");
+    }
+  }
+  
   return output;
 }
 
@@ -897,6 +1075,12 @@ Rcpp::List thefifthhousemate(List mpm, DataFrame allstages, DataFrame hstages,
 //' produced in Ehrlen format (\code{1}) or deVries format (\code{2}).
 //' @param err_check A logical value indicating whether to output the main index
 //' data frames used to sort elements in the matrices.
+//' @param sparse_output A logical value indicating whether to output matrices
+//' in sparse format. Defaults to \code{FALSE}, in which case matrices are
+//' output in the same format as the input matrices.
+//' @param as_operator A logical value indicating whether to output the
+//' historical matrices in factored form, rather than as matrices. Defaults to
+//' \code{FALSE}.
 //' 
 //' @return An object of class \code{lefkoMat}, with the same list structure as
 //' the input object, but with \code{A}, \code{U}, and \code{F} elements
@@ -906,11 +1090,31 @@ Rcpp::List thefifthhousemate(List mpm, DataFrame allstages, DataFrame hstages,
 //' \code{err_check = TRUE}, then a list of three data frames showing the values
 //' used to determine matrix element index values is also exported.
 //' 
+//' If \code{as_operator = TRUE}, then the output is a plain list with the same
+//' elements, but in which each element of \code{A}, \code{U}, and \code{F} is
+//' a matrix with as many rows as the historical matrix and as many columns as
+//' the ahistorical matrix. An extra element called \code{collapse} holds a
+//' zero-one matrix with as many rows as the ahistorical matrix and as many
+//' columns as the historical matrix. Each historical matrix is then equal to
+//' the product of its factor and \code{collapse}, as in
+//' \code{A[[i]] \%*\% collapse}.
+//' 
 //' @section Notes:
 //' This function does not currently identify biologically impossible
 //' transitions. Ahistorical transition values are placed in all theoretically
 //' possible historical transitions.
 //' 
+//' Historical matrices are built directly in sparse format, and are only
+//' converted to standard matrices at the end if the input matrices are in
+//' standard format and \code{sparse_output = FALSE}. With many stages, setting
+//' \code{sparse_output = TRUE} or \code{as_operator = TRUE} allows null
+//' historical MPMs to be created even where standard matrices would not fit in
+//' memory. Option \code{as_operator = TRUE} stores only as many non-zero
+//' elements as in the original matrices, and projection then requires two
+//' sparse matrix multiplications per time step. Setting \code{err_check = TRUE}
+//' creates an index with one row per possible element in the historical
+//' matrices, and so should be avoided with many stages.
+//' 
 //' @examples
 //' sizevector <- c(1, 1, 2, 3)
 //' stagevector <- c("Sdl", "Veg", "SmFlo", "LFlo")
@@ -948,10 +1152,12 @@ Rcpp::List thefifthhousemate(List mpm, DataFrame allstages, DataFrame hstages,
 //'   
 //' nullmodel1 <- hist_null(anth_lefkoMat, 1) # Ehrlen format
 //' nullmodel2 <- hist_null(anth_lefkoMat, 2) # deVries format
+//' nullmodel3 <- hist_null(anth_lefkoMat, 1, sparse_output = TRUE)
 //' 
 //' @export hist_null
 // [[Rcpp::export(hist_null)]]
-Rcpp::List hist_null (RObject mpm, int format = 1, bool err_check = false) {
+Rcpp::List hist_null (RObject mpm, int format = 1, bool err_check = false,
+  bool sparse_output = false, bool as_operator = false) {
   
   List mpm_;
   DataFrame mpm_ahstages;
@@ -1022,39 +1228,26 @@ Rcpp::List hist_null (RObject mpm, int format = 1, bool err_check = false) {
     mpm_model_qc = mpm_model_qc_;
   }
   
-  List allstages = simplepizzle(mpm_ahstages, format);
+  if (format != 1 && format != 2) {
+    throw Rcpp::exception("Option format must equal 1 or 2.", false);
+  }
+  
+  // The full element index is only needed for error checking
+  List allstages = simplepizzle(mpm_ahstages, format, err_check);
   
-  DataFrame allindices = as<DataFrame>(allstages["allstages"]);
   DataFrame all_hstages = as<DataFrame>(allstages["hstages"]);
   DataFrame all_ahstages = as<DataFrame>(allstages["ahstages"]);
   
-  List redone_mpms = thefifthhousemate(mpm_, allindices, all_hstages,
-    all_ahstages, format);
+  List redone_mpms = thefifthhousemate(mpm_, mpm_ahstages, format,
+    sparse_output, as_operator);
   
   List A_mpms = as<List>(redone_mpms["A"]);
   List U_mpms = as<List>(redone_mpms["U"]);
   List F_mpms = as<List>(redone_mpms["F"]);
-  
-  int tot_U_elems {0};
-  int tot_F_elems {0};
-  int tot_mats = A_mpms.length();
-  
-  for (int i = 0; i < tot_mats; i++) {
-    arma::mat current_Umat = as<arma::mat>(U_mpms(i));
-    arma::mat current_Fmat = as<arma::mat>(F_mpms(i));
-    
-    arma::uvec found_U_uvec = find(current_Umat);
-    arma::uvec found_F_uvec = find(current_Fmat);
-    int found_U = static_cast<int>(found_U_uvec.n_elem);
-    int found_F = static_cast<int>(found_F_uvec.n_elem);
-    
-    tot_U_elems += found_U;
-    tot_F_elems += found_F;
-  }
-  
-  IntegerVector new_mqc = {tot_U_elems, tot_F_elems, tot_mats};
+  IntegerVector new_mqc = as<IntegerVector>(redone_mpms["matrixqc"]);
   
   if (err_check) tot_dims++;
+  if (as_operator) tot_dims++;
   
   List final_output(tot_dims);
   CharacterVector listnames (tot_dims);
@@ -1087,14 +1280,23 @@ Rcpp::List hist_null (RObject mpm, int format = 1, bool err_check = false) {
     listnames(next_dude) = "dataqc";
   }
   
+  if (as_operator) {
+    int collapse_position = tot_dims - 1;
+    if (err_check) collapse_position--;
+    
+    final_output(collapse_position) = redone_mpms["collapse"];
+    listnames(collapse_position) = "collapse";
+  }
   if (err_check) {
     final_output(tot_dims - 1) = allstages;
     listnames(tot_dims - 1) = "err_check";
   }
   
   final_output.attr("names") = listnames;
-  StringVector needed_classes {"lefkoMat"};
-  final_output.attr("class") = needed_classes;
+  if (!as_operator) {
+    StringVector needed_classes {"lefkoMat"};
+    final_output.attr("class") = needed_classes;
+  }
   
   return final_output;
 }
@@ -1365,6 +1567,12 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
           int mat_rows {0};
           int mat_cols {0};
           
+          // Sparse input is read in place and summed in one batch construction
+          std::vector<arma::uword> sp_rows;
+          std::vector<arma::uword> sp_cols;
+          std::vector<double> sp_values;
+          double mats_scale = 1.0 / static_cast<double>(mats_length);
+          
           for (int i = 0; i < mats_length; i++) {
             RObject test_bit = as<RObject>(mats_[i]);
             
@@ -1383,10 +1591,12 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
                 mat_rows = core_mat.n_rows;
                 mat_cols = core_mat.n_cols;
               } else {
-                core_mat_sp = as<arma::sp_mat>(mats_[0]);
+                LefkoMats::dgc_view core_view (mats_, 0);
+                
+                mat_rows = core_view.n_rows;
+                mat_cols = core_view.n_cols;
                 
-                mat_rows = core_mat_sp.n_rows;
-                mat_cols = core_mat_sp.n_cols;
+                core_view.append_triplets(sp_rows, sp_cols, sp_values, mats_scale);
               }
               
               if (mat_rows != mat_cols) {
@@ -1395,8 +1605,6 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
               
               if (mat_input) {
                 core_mat = core_mat / mats_length;
-              } else {
-                core_mat_sp = core_mat_sp / mats_length;
               }
             } else {
               if (mat_input) {
@@ -1412,32 +1620,44 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
                 
                 core_mat = core_mat + (next_mat / mats_length);
               } else {
-                arma::sp_mat next_mat_sp = as<arma::sp_mat>(mats_[i]);
+                LefkoMats::dgc_view next_view (mats_, i);
                 
-                int next_rows = next_mat_sp.n_rows;
-                int next_cols = next_mat_sp.n_cols;
+                int next_rows = next_view.n_rows;
+                int next_cols = next_view.n_cols;
                 
                 if (next_rows != mat_rows || next_cols != mat_cols) {
                   throw Rcpp::exception("All input matrices must have the same dimensions.",
                     false);
                 }
                 
-                core_mat_sp = core_mat_sp + (next_mat_sp / mats_length);
+                next_view.append_triplets(sp_rows, sp_cols, sp_values, mats_scale);
               }
             }
-            
-            if (mat_input && force_sparse) {
-              arma::sp_mat core_mat_sp_(core_mat);
-              core_mat_sp = core_mat_sp_;
+          }
+          
+          if (!mat_input) {
+            arma::umat sp_locations (2, sp_values.size());
+            for (int j = 0; j < static_cast<int>(sp_values.size()); j++) {
+              sp_locations(0, j) = sp_rows[j];
+              sp_locations(1, j) = sp_cols[j];
             }
             
-            if (mat_input && !force_sparse) {
-              List A = List::create(_["A"] = core_mat);
-              gd_output_currentonly = A;
-            } else {
-              List A = List::create(_["A"] = core_mat_sp);
-              gd_output_currentonly = A;
-            }
+            arma::sp_mat core_mat_sp_(true, sp_locations, arma::vec(sp_values),
+              mat_rows, mat_cols, true, true);
+            core_mat_sp = core_mat_sp_;
+          }
+          
+          if (mat_input && force_sparse) {
+            arma::sp_mat core_mat_sp_(core_mat);
+            core_mat_sp = core_mat_sp_;
+          }
+          
+          if (mat_input && !force_sparse) {
+            List A = List::create(_["A"] = core_mat);
+            gd_output_currentonly = A;
+          } else {
+            List A = List::create(_["A"] = core_mat_sp);
+            gd_output_currentonly = A;
           }
           final_output_for_gd(i) = gd_output_currentonly;
         }
@@ -1536,6 +1756,12 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
         int mat_rows {0};
         int mat_cols {0};
         
+        // Sparse input is read in place and summed in one batch construction
+        std::vector<arma::uword> sp_rows;
+        std::vector<arma::uword> sp_cols;
+        std::vector<double> sp_values;
+        double mats_scale = 1.0 / static_cast<double>(mats_length);
+        
         for (int i = 0; i < mats_length; i++) {
           RObject test_bit = as<RObject>(mats_[i]);
           
@@ -1554,10 +1780,12 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
               mat_rows = core_mat.n_rows;
               mat_cols = core_mat.n_cols;
             } else {
-              core_mat_sp = as<arma::sp_mat>(mats_[0]);
+              LefkoMats::dgc_view core_view (mats_, 0);
+              
+              mat_rows = core_view.n_rows;
+              mat_cols = core_view.n_cols;
               
-              mat_rows = core_mat_sp.n_rows;
-              mat_cols = core_mat_sp.n_cols;
+              core_view.append_triplets(sp_rows, sp_cols, sp_values, mats_scale);
             }
             
             if (mat_rows != mat_cols) {
@@ -1566,8 +1794,6 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
             
             if (mat_input) {
               core_mat = core_mat / mats_length;
-            } else {
-              core_mat_sp = core_mat_sp / mats_length;
             }
           } else {
             if (mat_input) {
@@ -1583,32 +1809,44 @@ Rcpp::List lmean(RObject mats, Nullable<String> matsout = R_NilValue,
               
               core_mat = core_mat + (next_mat / mats_length);
             } else {
-              arma::sp_mat next_mat_sp = as<arma::sp_mat>(mats_[i]);
+              LefkoMats::dgc_view next_view (mats_, i);
               
-              int next_rows = next_mat_sp.n_rows;
-              int next_cols = next_mat_sp.n_cols;
+              int next_rows = next_view.n_rows;
+              int next_cols = next_view.n_cols;
               
               if (next_rows != mat_rows || next_cols != mat_cols) {
                 throw Rcpp::exception("All input matrices must have the same dimensions.",
                   false);
               }
               
-              core_mat_sp = core_mat_sp + (next_mat_sp / mats_length);
+              next_view.append_triplets(sp_rows, sp_cols, sp_values, mats_scale);
             }
           }
-          
-          if (mat_input && force_sparse) {
-            arma::sp_mat core_mat_sp_(core_mat);
-            core_mat_sp = core_mat_sp_;
+        }
+        
+        if (!mat_input) {
+          arma::umat sp_locations (2, sp_values.size());
+          for (int j = 0; j < static_cast<int>(sp_values.size()); j++) {
+            sp_locations(0, j) = sp_rows[j];
+            sp_locations(1, j) = sp_cols[j];
           }
           
-          if (mat_input && !force_sparse) {
-            List A = List::create(_["A"] = core_mat);
-            gd_output = A;
-          } else {
-            List A = List::create(_["A"] = core_mat_sp);
-            gd_output = A;
-          }
+          arma::sp_mat core_mat_sp_(true, sp_locations, arma::vec(sp_values),
+            mat_rows, mat_cols, true, true);
+          core_mat_sp = core_mat_sp_;
+        }
+        
+        if (mat_input && force_sparse) {
+          arma::sp_mat core_mat_sp_(core_mat);
+          core_mat_sp = core_mat_sp_;
+        }
+        
+        if (mat_input && !force_sparse) {
+          List A = List::create(_["A"] = core_mat);
+          gd_output = A;
+        } else {
+          List A = List::create(_["A"] = core_mat_sp);
+          gd_output = A;
         }
       }
     }
@@ -2438,135 +2676,987 @@ void add_stage_single (List& final_output, const List mpm, int add_before = 0,
   final_output = true_output;
 }
 
-//' Add a New Stage to an Existing lefkoMat or lefkoMatList Object
-//' 
-//' Function \code{add_stage()} adds a new stage to an existing \code{lefkoMat}
-//' or \code{lefkoMatList} object. In addition to altering the \code{ahstages}
-//' object within the MPM, it alters the \code{hstages} and \code{agestages}
-//' objects and adds the appropriate number of new rows and columns depending on
-//' the kind of MPM input. Note that, if entering a \code{lefkoMatList} object,
-//' then a stage will be added to all \code{lefkoMat} objects contained therein.
-//' 
-//' @name add_stage
-//' 
-//' @param mpm The \code{lefkoMat} or \code{lefkoMatList} object to add a stage
-//' to.
-//' @param add_before The index of the stage to insert a new stage before. This
-//' index should be derived from the \code{ahstages} of the input \code{mpm}.
-//' Cannot be set if \code{add_after} is to be used.
-//' @param add_after The index of the stage to insert a new stage after. This
-//' index should be derived from the \code{ahstages} of the input \code{mpm}.
-//' Cannot be set if \code{add_before} is to be used.
-//' @param stage_name The name of the new stage to add. Defaults to
-//' \code{new_stage}. 
-//' 
-//' @return A new copy of the original MPM edited to include new rows and
-//' columns in the associated matrices, and with \code{ahstages},
-//' \code{agestages}, and \code{hstages} objects edited to include the new
-//' stage.
+//' Insert New Entries Into a Stage Table Column
 //' 
-//' @seealso \code{\link{edit_lM}()}
+//' Function \code{stage_insert()} creates a new column for a stageframe or
+//' similar stage table, placing the values of new stages at the positions
+//' given by a final stage order.
 //' 
-//' @examples
-//' data(cypdata)
+//' @name stage_insert
 //' 
-//' cyp_lesl_data <- verticalize3(data = cypdata, noyears = 6, firstyear = 2004, 
-//'   patchidcol = "patch", individcol = "plantid", blocksize = 4, 
-//'   sizeacol = "Inf2.04", sizebcol = "Inf.04", sizeccol = "Veg.04", 
-//'   repstracol = "Inf.04", repstrbcol = "Inf2.04", fecacol = "Pod.04", 
-//'   stagesize = "sizeadded", NAas0 = TRUE, age_offset = 2)
+//' @param old_vec The original column.
+//' @param new_order A vector giving the final order of stages, in which
+//' non-negative values are indices of original stages and negative value
+//' \code{-(m + 1)} marks the \code{m}th new stage.
+//' @param new_values A vector of the values of the new stages, in order of
+//' entry.
 //' 
-//' cyp_survival <- glm(alive3 ~ obsage + as.factor(year2), data = cyp_lesl_data,
-//'   family = "binomial")
-//' cyp_fecundity <- glm(feca2 ~ 1 + obsage + as.factor(year2),
-//'   data = cyp_lesl_data, family = "poisson")
+//' @return A new column of the same type as \code{old_vec}.
 //' 
-//' mod_params <- create_pm(name_terms = TRUE)
-//' mod_params$modelparams[22] <- "obsage"
+//' @keywords internal
+//' @noRd
+template <int RTYPE>
+inline Vector<RTYPE> stage_insert (Vector<RTYPE> old_vec,
+  const arma::ivec& new_order, Vector<RTYPE> new_values) {
+  
+  int new_length = static_cast<int>(new_order.n_elem);
+  Vector<RTYPE> new_vec (new_length);
+  
+  for (int i = 0; i < new_length; i++) {
+    if (new_order(i) < 0) {
+      new_vec(i) = new_values(static_cast<int>(-new_order(i) - 1));
+    } else {
+      new_vec(i) = old_vec(static_cast<int>(new_order(i)));
+    }
+  }
+  
+  return new_vec;
+}
+
+//' Add Several New Stages to a Single lefkoMat
 //' 
-//' germination <- 0.08
-//' protocorm_to_seedling <- 0.10
-//' seeding_to_adult <- 0.20
-//' seeds_per_fruit <- 8000
+//' Function \code{add_stage_batch()} adds several new stages to an existing
+//' \code{lefkoMat} object at once. The final order of stages and the new
+//' position of every original row and column are determined once, after which
+//' each matrix is written into its new dimensions in a single pass. Matrices
+//' are handled in parallel, and sparse matrices are handled without conversion
+//' to dense format.
 //' 
-//' cyp_lesl_supp <- supplemental(historical = FALSE, stagebased = FALSE,
-//'   agebased = TRUE, age2 = c(1, 2), type = c(1, 1),
-//'   givenrate = c(protocorm_to_seedling, seeding_to_adult))
+//' @name add_stage_batch
 //' 
-//' cyp_lesl_fb_mpm <- fleslie(data = cyp_lesl_data, surv_model = cyp_survival,
-//'   fec_model = cyp_fecundity, paramnames = mod_params, last_age = 7,
-//'   fecage_min = 3, fecmod = (germination * seeds_per_fruit),
-//'   supplement = cyp_lesl_supp)
+//' @param final_output A reference to the final list to modify.
+//' @param mpm The \code{lefkoMat} object to add stages to.
+//' @param insert_at A vector giving, for each new stage, the index of the
+//' original stage to insert it before, counting from \code{0}. A value equal
+//' to the number of original stages places the new stage at the end. New stages
+//' entered at the same position are kept in order of entry.
+//' @param stage_names The names of the new stages, in the same order as
+//' \code{insert_at}.
 //' 
-//' altered1 <- add_stage(cyp_lesl_fb_mpm, add_before = 1, stage_name = "DS")
+//' @return Creates a new copy of the original MPM edited to include new rows
+//' and columns in the associated matrices, and with \code{ahstages},
+//' \code{agestages}, and \code{hstages} objects edited to include the new
+//' stages, and makes it accessible by reference.
 //' 
-//' @export add_stage
-// [[Rcpp::export(add_stage)]]
-Rcpp::List add_stage (const RObject mpm, int add_before = 0,
-  int add_after = 0, Nullable<CharacterVector> stage_name  = R_NilValue) {
+//' @keywords internal
+//' @noRd
+void add_stage_batch (List& final_output, const List mpm,
+  const arma::ivec& insert_at, const CharacterVector& stage_names) {
   
-  List mpm_list;
-  List final_output;
+  String mpm_error = "Please enter a lefkoMat or lefkoMatList object as input.";
+  if (!mpm.containsElementNamed("ahstages")) {
+    throw Rcpp::exception(mpm_error.get_cstring(), false);
+  }
+  if (!mpm.containsElementNamed("hstages")) {
+    throw Rcpp::exception(mpm_error.get_cstring(), false);
+  }
+  if (!mpm.containsElementNamed("agestages")) {
+    throw Rcpp::exception(mpm_error.get_cstring(), false);
+  }
+  if (!mpm.containsElementNamed("labels")) {
+    throw Rcpp::exception(mpm_error.get_cstring(), false);
+  }
   
-  if (is<List>(mpm)) mpm_list = as<List>(mpm);
-  StringVector mpm_class = mpm_list.attr("class");
+  Rcpp::DataFrame ahstages = as<DataFrame>(mpm["ahstages"]);
+  Rcpp::DataFrame hstages = as<DataFrame>(mpm["hstages"]);
+  Rcpp::DataFrame agestages = as<DataFrame>(mpm["agestages"]);
   
-  String mpm_error = "Please enter a lefkoMat or lefkoMatList object as input.";
-  bool mpm_yes {false};
-  bool mpmlist_yes {false};
+  int wtf = LefkoUtils::whichbrew(ahstages, hstages, agestages);
+  // wtf possible results: \code{0}: historical MPM, \code{1}:
+  // ahistorical MPM, \code{2}: age-by-stage MPM, and \code{3}: age-based MPM
   
-  for (int i = 0; i < static_cast<int>(mpm_class.length()); i++) {
-    if (mpm_class(i) == "lefkoMat") mpm_yes = true;
-    if (mpm_class(i) == "lefkoMatList") mpmlist_yes = true;
-  }
-  if (!mpm_yes && !mpmlist_yes) throw Rcpp::exception(mpm_error.get_cstring(), false);
+  StringVector stagevec = as<StringVector>(ahstages["stage"]);
+  IntegerVector stageidvec = as<IntegerVector>(ahstages["stage_id"]);
+  int num_stages = stagevec.length();
+  int num_added = static_cast<int>(insert_at.n_elem);
+  int new_num_stages = num_stages + num_added;
   
-  if (add_before > 0 && add_after > 0) {
-    throw Rcpp::exception("Please set either add_before or add_after, but not both.",
-      false);
+  for (int m = 0; m < num_added; m++) {
+    if (insert_at(m) < 0 || insert_at(m) > num_stages) {
+      throw Rcpp::exception("Fewer stages exist than suggested by numbers input in options add_before or add_after.",
+        false);
+    }
+    
+    for (int i = 0; i < num_stages; i++) {
+      if (LefkoUtils::stringcompare_hard(as<std::string>(stage_names(m)),
+          as<std::string>(stagevec(i)))) {
+        throw Rcpp::exception("Entered stage_name cannot be the same as an existing stage.",
+          false);
+      }
+    }
+    for (int m2 = 0; m2 < m; m2++) {
+      if (LefkoUtils::stringcompare_hard(as<std::string>(stage_names(m)),
+          as<std::string>(stage_names(m2)))) {
+        throw Rcpp::exception("Entered stage names must be unique.", false);
+      }
+    }
   }
   
-  if (mpm_yes) {
-    add_stage_single(final_output, mpm_list, add_before, add_after, stage_name);
-  } else if (mpmlist_yes) {
-    int length_of_mpmlist = static_cast<int>(mpm_list.length());
-    List semifinal_output (length_of_mpmlist);
-    
-    for (int i = 0; i < length_of_mpmlist; i++) {
-      List current_output;
-      List current_mpm = as<List>(mpm_list(i));
-      
-      add_stage_single(current_output, current_mpm, add_before, add_after, stage_name);
-      
-      semifinal_output(i) = current_output;
+  // Final stage order, with new stage m coded as -(m + 1)
+  arma::uvec insert_order = arma::stable_sort_index(insert_at);
+  arma::ivec new_order (new_num_stages);
+  arma::uvec old_new_index (num_stages);
+  arma::uvec added_new_index (num_added);
+  
+  int place {0};
+  int next_insert {0};
+  for (int s = 0; s <= num_stages; s++) {
+    while (next_insert < num_added && insert_at(insert_order(next_insert)) == s) {
+      int m = static_cast<int>(insert_order(next_insert));
+      new_order(place) = -(m + 1);
+      added_new_index(m) = place;
+      place++;
+      next_insert++;
     }
-    CharacterVector final_class = "lefkoMatList";
-    semifinal_output.attr("class") = final_class;
     
-    final_output = semifinal_output;
-  } else throw Rcpp::exception(mpm_error.get_cstring(), false);
+    if (s < num_stages) {
+      new_order(place) = s;
+      old_new_index(s) = place;
+      place++;
+    }
+  }
   
-  return final_output;
-}
-
-//' Check Continuity of Life Cycle through Matrices in lefkoMat Objects
-//' 
-//' Function \code{cycle_check()} tests whether stages, stage-pairs, or
-//' age-stages connect in matrices within \code{lefkoMat} objects.
-//' 
+  // Stage id lookup for hstages and agestages
+  int max_stage_id = max(stageidvec);
+  arma::ivec id_to_old (max_stage_id + 1);
+  id_to_old.fill(-1);
+  for (int i = 0; i < num_stages; i++) {
+    if (stageidvec(i) > -1) id_to_old(stageidvec(i)) = i;
+  }
+  
+  // New stageframe
+  IntegerVector added_ids (num_added);
+  IntegerVector added_imm (num_added);
+  IntegerVector added_mat (num_added);
+  IntegerVector added_rep (num_added);
+  IntegerVector added_repentry (num_added);
+  StringVector added_comments (num_added);
+  
+  for (int m = 0; m < num_added; m++) {
+    added_ids(m) = num_stages + m + 1;
+    added_comments(m) = "new stage";
+    
+    if (insert_at(m) == 0) {
+      added_imm(m) = 1;
+      added_mat(m) = 0;
+      added_rep(m) = 0;
+      added_repentry(m) = 1;
+    } else {
+      added_imm(m) = 0;
+      added_mat(m) = 1;
+      added_rep(m) = 1;
+      added_repentry(m) = 0;
+    }
+  }
+  
+  IntegerVector added_zeros_int (num_added, 0);
+  IntegerVector added_ones_int (num_added, 1);
+  NumericVector added_zeros (num_added, 0.0);
+  NumericVector added_halves (num_added, 0.5);
+  NumericVector added_ones (num_added, 1.0);
+  NumericVector added_threehalves (num_added, 1.5);
+  
+  IntegerVector new_stageidvec = stage_insert(stageidvec, new_order, added_ids);
+  StringVector new_stagevec = stage_insert(stagevec, new_order,
+    as<StringVector>(stage_names));
+  
+  Rcpp::List new_stageframe(33);
+  
+  new_stageframe(0) = new_stageidvec;
+  new_stageframe(1) = new_stagevec;
+  new_stageframe(2) = stage_insert(as<NumericVector>(ahstages["original_size"]),
+    new_order, added_zeros);
+  new_stageframe(3) = stage_insert(as<NumericVector>(ahstages["original_size_b"]),
+    new_order, added_zeros);
+  new_stageframe(4) = stage_insert(as<NumericVector>(ahstages["original_size_c"]),
+    new_order, added_zeros);
+  new_stageframe(5) = stage_insert(as<NumericVector>(ahstages["min_age"]),
+    new_order, added_zeros);
+  new_stageframe(6) = stage_insert(as<NumericVector>(ahstages["max_age"]),
+    new_order, added_zeros);
+  new_stageframe(7) = stage_insert(as<IntegerVector>(ahstages["repstatus"]),
+    new_order, added_rep);
+  new_stageframe(8) = stage_insert(as<IntegerVector>(ahstages["obsstatus"]),
+    new_order, added_ones_int);
+  new_stageframe(9) = stage_insert(as<IntegerVector>(ahstages["propstatus"]),
+    new_order, added_zeros_int);
+  new_stageframe(10) = stage_insert(as<IntegerVector>(ahstages["immstatus"]),
+    new_order, added_imm);
+  new_stageframe(11) = stage_insert(as<IntegerVector>(ahstages["matstatus"]),
+    new_order, added_mat);
+  new_stageframe(12) = stage_insert(as<IntegerVector>(ahstages["entrystage"]),
+    new_order, added_repentry);
+  new_stageframe(13) = stage_insert(as<IntegerVector>(ahstages["indataset"]),
+    new_order, added_zeros_int);
+  new_stageframe(14) = stage_insert(as<NumericVector>(ahstages["binhalfwidth_raw"]),
+    new_order, added_ones);
+  new_stageframe(15) = stage_insert(as<NumericVector>(ahstages["sizebin_min"]),
+    new_order, added_halves);
+  new_stageframe(16) = stage_insert(as<NumericVector>(ahstages["sizebin_max"]),
+    new_order, added_threehalves);
+  new_stageframe(17) = stage_insert(as<NumericVector>(ahstages["sizebin_center"]),
+    new_order, added_ones);
+  new_stageframe(18) = stage_insert(as<NumericVector>(ahstages["sizebin_width"]),
+    new_order, added_halves);
+  new_stageframe(19) = stage_insert(as<NumericVector>(ahstages["binhalfwidthb_raw"]),
+    new_order, added_ones);
+  new_stageframe(20) = stage_insert(as<NumericVector>(ahstages["sizebinb_min"]),
+    new_order, added_halves);
+  new_stageframe(21) = stage_insert(as<NumericVector>(ahstages["sizebinb_max"]),
+    new_order, added_threehalves);
+  new_stageframe(22) = stage_insert(as<NumericVector>(ahstages["sizebinb_center"]),
+    new_order, added_ones);
+  new_stageframe(23) = stage_insert(as<NumericVector>(ahstages["sizebinb_width"]),
+    new_order, added_halves);
+  new_stageframe(24) = stage_insert(as<NumericVector>(ahstages["binhalfwidthc_raw"]),
+    new_order, added_ones);
+  new_stageframe(25) = stage_insert(as<NumericVector>(ahstages["sizebinc_min"]),
+    new_order, added_halves);
+  new_stageframe(26) = stage_insert(as<NumericVector>(ahstages["sizebinc_max"]),
+    new_order, added_threehalves);
+  new_stageframe(27) = stage_insert(as<NumericVector>(ahstages["sizebinc_center"]),
+    new_order, added_ones);
+  new_stageframe(28) = stage_insert(as<NumericVector>(ahstages["sizebinc_width"]),
+    new_order, added_halves);
+  new_stageframe(29) = stage_insert(as<IntegerVector>(ahstages["group"]),
+    new_order, added_zeros_int);
+  new_stageframe(30) = stage_insert(as<StringVector>(ahstages["comments"]),
+    new_order, added_comments);
+  new_stageframe(31) = stage_insert(as<IntegerVector>(ahstages["alive"]),
+    new_order, added_ones_int);
+  new_stageframe(32) = stage_insert(as<IntegerVector>(ahstages["almostborn"]),
+    new_order, added_zeros_int);
+  
+  CharacterVector namevec = {"stage_id", "stage", "original_size",
+    "original_size_b", "original_size_c", "min_age", "max_age", "repstatus",
+    "obsstatus", "propstatus", "immstatus", "matstatus", "entrystage",
+    "indataset", "binhalfwidth_raw", "sizebin_min", "sizebin_max",
+    "sizebin_center", "sizebin_width", "binhalfwidthb_raw", "sizebinb_min",
+    "sizebinb_max", "sizebinb_center", "sizebinb_width", "binhalfwidthc_raw",
+    "sizebinc_min", "sizebinc_max", "sizebinc_center", "sizebinc_width",
+    "group", "comments", "alive", "almostborn"};
+  CharacterVector new_classes = {"data.frame", "stageframe"};
+  new_stageframe.attr("names") = namevec;
+  new_stageframe.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER,
+      new_num_stages);
+  new_stageframe.attr("class") = new_classes;
+  
+  DataFrame new_hstages = hstages;
+  DataFrame new_agestages = agestages;
+  
+  // New position of each original row and column
+  arma::uvec new_pos;
+  int old_dim {0};
+  int new_dim {0};
+  
+  if (wtf == 1 || wtf == 3) {
+    new_pos = old_new_index;
+    old_dim = num_stages;
+    new_dim = new_num_stages;
+    
+  } else if (wtf == 0) {
+    arma::ivec sid2 = as<arma::ivec>(hstages["stage_id_2"]);
+    arma::ivec sid1 = as<arma::ivec>(hstages["stage_id_1"]);
+    old_dim = static_cast<int>(sid2.n_elem);
+    new_dim = old_dim + (new_num_stages * new_num_stages) -
+      (num_stages * num_stages);
+    
+    // Stage pairs are ordered by stage in time t-1, then stage in time t
+    arma::uvec pair_keys (new_dim);
+    for (int r = 0; r < old_dim; r++) {
+      if (sid2(r) < 0 || sid2(r) > max_stage_id || sid1(r) < 0 ||
+          sid1(r) > max_stage_id || id_to_old(sid2(r)) < 0 ||
+          id_to_old(sid1(r)) < 0) {
+        throw Rcpp::exception("Object hstages does not match ahstages.", false);
+      }
+      
+      pair_keys(r) = old_new_index(id_to_old(sid2(r))) +
+        old_new_index(id_to_old(sid1(r))) * static_cast<arma::uword>(new_num_stages);
+    }
+    
+    int next_key = old_dim;
+    for (int b = 0; b < new_num_stages; b++) {
+      for (int a = 0; a < new_num_stages; a++) {
+        if (new_order(a) < 0 || new_order(b) < 0) {
+          pair_keys(next_key) = static_cast<arma::uword>(a + b * new_num_stages);
+          next_key++;
+        }
+      }
+    }
+    
+    arma::uvec key_order = arma::sort_index(pair_keys);
+    new_pos.set_size(old_dim);
+    
+    IntegerVector new_sid2 (new_dim);
+    IntegerVector new_sid1 (new_dim);
+    StringVector new_h_stage2 (new_dim);
+    StringVector new_h_stage1 (new_dim);
+    
+    for (int p = 0; p < new_dim; p++) {
+      arma::uword key = pair_keys(key_order(p));
+      int a = static_cast<int>(key % new_num_stages);
+      int b = static_cast<int>(key / new_num_stages);
+      
+      if (static_cast<int>(key_order(p)) < old_dim) new_pos(key_order(p)) = p;
+      
+      new_sid2(p) = new_stageidvec(a);
+      new_sid1(p) = new_stageidvec(b);
+      new_h_stage2(p) = new_stagevec(a);
+      new_h_stage1(p) = new_stagevec(b);
+    }
+    
+    List new_hstages_pre (4);
+    new_hstages_pre(0) = new_sid2;
+    new_hstages_pre(1) = new_sid1;
+    new_hstages_pre(2) = new_h_stage2;
+    new_hstages_pre(3) = new_h_stage1;
+    
+    CharacterVector hstage_namevec = {"stage_id_2", "stage_id_1", "stage_2",
+      "stage_1"};
+    CharacterVector hstage_classes = {"data.frame"};
+    new_hstages_pre.attr("names") = hstage_namevec;
+    new_hstages_pre.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER,
+      new_dim);
+    new_hstages_pre.attr("class") = hstage_classes;
+    new_hstages = new_hstages_pre;
+    
+  } else if (wtf == 2) {
+    arma::ivec sid = as<arma::ivec>(agestages["stage_id"]);
+    StringVector age_stage = as<StringVector>(agestages["stage"]);
+    IntegerVector age_age = as<IntegerVector>(agestages["age"]);
+    old_dim = static_cast<int>(sid.n_elem);
+    new_pos.set_size(old_dim);
+    
+    std::vector<int> new_sid_std;
+    std::vector<int> new_age_std;
+    std::vector<int> new_stage_std; // Index in new stage order
+    
+    // Adds new age-stages entered at position s, with the age of row r
+    auto add_rows = [&](int s, int r) {
+      for (int m_i = 0; m_i < num_added; m_i++) {
+        int m = static_cast<int>(insert_order(m_i));
+        if (insert_at(m) != s) continue;
+        
+        new_sid_std.push_back(num_stages + m + 1);
+        new_age_std.push_back(age_age(r));
+        new_stage_std.push_back(static_cast<int>(added_new_index(m)));
+      }
+    };
+    
+    for (int r = 0; r < old_dim; r++) {
+      if (sid(r) < 0 || sid(r) > max_stage_id || id_to_old(sid(r)) < 0) {
+        throw Rcpp::exception("Object agestages does not match ahstages.", false);
+      }
+      int s = static_cast<int>(id_to_old(sid(r)));
+      
+      add_rows(s, r);
+      
+      new_pos(r) = static_cast<arma::uword>(new_sid_std.size());
+      new_sid_std.push_back(sid(r));
+      new_age_std.push_back(age_age(r));
+      new_stage_std.push_back(static_cast<int>(old_new_index(s)));
+      
+      if (s == num_stages - 1) add_rows(num_stages, r);
+    }
+    new_dim = static_cast<int>(new_sid_std.size());
+    
+    IntegerVector new_sid (new_dim);
+    StringVector new_age_stage (new_dim);
+    IntegerVector new_age_age (new_dim);
+    
+    for (int p = 0; p < new_dim; p++) {
+      new_sid(p) = new_sid_std[p];
+      new_age_stage(p) = new_stagevec(new_stage_std[p]);
+      new_age_age(p) = new_age_std[p];
+    }
+    
+    List new_agestages_pre (3);
+    new_agestages_pre(0) = new_sid;
+    new_agestages_pre(1) = new_age_stage;
+    new_agestages_pre(2) = new_age_age;
+    
+    CharacterVector agestage_namevec = {"stage_id", "stage", "age"};
+    CharacterVector agestage_classes = {"data.frame"};
+    new_agestages_pre.attr("names") = agestage_namevec;
+    new_agestages_pre.attr("row.names") = Rcpp::IntegerVector::create(NA_INTEGER,
+      new_dim);
+    new_agestages_pre.attr("class") = agestage_classes;
+    new_agestages = new_agestages_pre;
+  }
+  
+  // Core matrix editing
+  bool A_used {false};
+  bool U_used {false};
+  bool F_used {false};
+  
+  if (mpm.containsElementNamed("A")) A_used = is<List>(mpm["A"]);
+  if (mpm.containsElementNamed("U")) U_used = is<List>(mpm["U"]);
+  if (mpm.containsElementNamed("F")) F_used = is<List>(mpm["F"]);
+  
+  if (!A_used && !U_used && !F_used) {
+    throw Rcpp::exception("The input object does not appear to hold matrices.", false);
+  }
+  
+  // With U and F matrices, A matrices are rebuilt as their sums
+  bool UF_used = U_used && F_used;
+  
+  List A_in;
+  List U_in;
+  List F_in;
+  int mat_num {0};
+  
+  if (UF_used) {
+    U_in = as<List>(mpm["U"]);
+    F_in = as<List>(mpm["F"]);
+    mat_num = static_cast<int>(U_in.length());
+  } else {
+    A_in = as<List>(mpm["A"]);
+    mat_num = static_cast<int>(A_in.length());
+  }
+  
+  int lists_used = UF_used ? 2 : 1;
+  bool mat_sparse {false};
+  if (mat_num > 0) {
+    if (UF_used) {
+      mat_sparse = is<S4>(U_in(0));
+    } else {
+      mat_sparse = is<S4>(A_in(0));
+    }
+  }
+  
+  // Matrix access set up before any parallel work
+  std::vector<NumericMatrix> mats_dense;
+  std::vector<dgc_view> mats_sparse;
+  
+  for (int l = 0; l < lists_used; l++) {
+    const List& current_list = UF_used ? ((l == 0) ? U_in : F_in) : A_in;
+    
+    for (int i = 0; i < mat_num; i++) {
+      int current_rows {0};
+      int current_cols {0};
+      
+      if (!mat_sparse) {
+        mats_dense.push_back(as<NumericMatrix>(current_list(i)));
+        current_rows = mats_dense.back().nrow();
+        current_cols = mats_dense.back().ncol();
+      } else {
+        mats_sparse.emplace_back(current_list, i);
+        current_rows = mats_sparse.back().n_rows;
+        current_cols = mats_sparse.back().n_cols;
+      }
+      
+      if (current_rows != old_dim || current_cols != old_dim) {
+        throw Rcpp::exception("Matrix dimensions do not match the stage index.",
+          false);
+      }
+    }
+  }
+  
+  std::vector<const double*> dense_ptrs;
+  for (int j = 0; j < static_cast<int>(mats_dense.size()); j++) {
+    dense_ptrs.push_back(mats_dense[j].begin());
+  }
+  
+  int num_jobs = lists_used * mat_num;
+  std::vector<arma::mat> dense_out;
+  std::vector<arma::sp_mat> sparse_out;
+  if (!mat_sparse) {
+    dense_out.resize(num_jobs);
+  } else {
+    sparse_out.resize(num_jobs);
+  }
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int j = 0; j < num_jobs; j++) {
+    if (!mat_sparse) {
+      dense_out[j].zeros(new_dim, new_dim);
+      const double* src = dense_ptrs[j];
+      double* dest = dense_out[j].memptr();
+      
+      for (int c = 0; c < old_dim; c++) {
+        double* dest_col = dest + (new_pos(c) * static_cast<arma::uword>(new_dim));
+        const double* src_col = src + (static_cast<arma::uword>(c) * old_dim);
+        
+        for (int r = 0; r < old_dim; r++) {
+          dest_col[new_pos(r)] = src_col[r];
+        }
+      }
+    } else {
+      const dgc_view& current_mat = mats_sparse[j];
+      arma::umat locations (2, current_mat.n_nonzero);
+      arma::vec values (current_mat.n_nonzero);
+      
+      for (int c = 0; c < old_dim; c++) {
+        for (int k = current_mat.col_ptr[c]; k < current_mat.col_ptr[c+1]; k++) {
+          locations(0, k) = new_pos(current_mat.row_idx[k]);
+          locations(1, k) = new_pos(c);
+          values(k) = current_mat.values[k];
+        }
+      }
+      
+      sparse_out[j] = arma::sp_mat(locations, values, new_dim, new_dim);
+    }
+  }
+  
+  List A_mats (mat_num);
+  List U_mats;
+  List F_mats;
+  
+  // Missing U and F matrices are kept as entered, usually as NA
+  RObject U_out = LogicalVector::create(NA_LOGICAL);
+  RObject F_out = LogicalVector::create(NA_LOGICAL);
+  if (!U_used && mpm.containsElementNamed("U")) U_out = as<RObject>(mpm["U"]);
+  if (!F_used && mpm.containsElementNamed("F")) F_out = as<RObject>(mpm["F"]);
+  
+  if (UF_used) {
+    U_mats = List(mat_num);
+    F_mats = List(mat_num);
+    
+    for (int i = 0; i < mat_num; i++) {
+      if (!mat_sparse) {
+        U_mats(i) = dense_out[i];
+        F_mats(i) = dense_out[mat_num + i];
+        A_mats(i) = arma::mat(dense_out[i] + dense_out[mat_num + i]);
+      } else {
+        U_mats(i) = sparse_out[i];
+        F_mats(i) = sparse_out[mat_num + i];
+        A_mats(i) = arma::sp_mat(sparse_out[i] + sparse_out[mat_num + i]);
+      }
+    }
+    U_out = U_mats;
+    F_out = F_mats;
+  } else {
+    for (int i = 0; i < mat_num; i++) {
+      if (!mat_sparse) {
+        A_mats(i) = dense_out[i];
+      } else {
+        A_mats(i) = sparse_out[i];
+      }
+    }
+  }
+  
+  // MPM final processing
+  DataFrame new_labels = as<DataFrame>(mpm["labels"]);
+  RObject new_matrixqc = as<RObject>(mpm["matrixqc"]);
+  
+  List new_mpm = List::create(_["A"] = A_mats, _["U"] = U_out, _["F"] = F_out,
+    _["ahstages"] = new_stageframe, _["agestages"] = new_agestages,
+    _["hstages"] = new_hstages, _["labels"] = new_labels,
+    _["matrixqc"] = new_matrixqc);
+  
+  if (mpm.containsElementNamed("modelqc")) {
+    DataFrame new_modelqc = as<DataFrame>(mpm["modelqc"]);
+    new_mpm.push_back(new_modelqc, "modelqc");
+  }
+  if (mpm.containsElementNamed("dataqc")) {
+    RObject new_dataqc = as<RObject>(mpm["dataqc"]);
+    new_mpm.push_back(new_dataqc, "dataqc");
+  }
+  
+  CharacterVector new_mpm_classes = {"lefkoMat"};
+  new_mpm.attr("class") = new_mpm_classes;
+  
+  final_output = new_mpm;
+}
+
+//' Add a New Stage to an Existing lefkoMat or lefkoMatList Object
+//' 
+//' Function \code{add_stage()} adds a new stage to an existing \code{lefkoMat}
+//' or \code{lefkoMatList} object. In addition to altering the \code{ahstages}
+//' object within the MPM, it alters the \code{hstages} and \code{agestages}
+//' objects and adds the appropriate number of new rows and columns depending on
+//' the kind of MPM input. Note that, if entering a \code{lefkoMatList} object,
+//' then a stage will be added to all \code{lefkoMat} objects contained therein.
+//' 
+//' @name add_stage
+//' 
+//' @param mpm The \code{lefkoMat} or \code{lefkoMatList} object to add a stage
+//' to.
+//' @param add_before The index of the stage to insert a new stage before. This
+//' index should be derived from the \code{ahstages} of the input \code{mpm}.
+//' Can also be a vector of such indices, in which case one new stage is added
+//' before each. Cannot be set if \code{add_after} is to be used.
+//' @param add_after The index of the stage to insert a new stage after. This
+//' index should be derived from the \code{ahstages} of the input \code{mpm}.
+//' Can also be a vector of such indices, in which case one new stage is added
+//' after each. Cannot be set if \code{add_before} is to be used.
+//' @param stage_name The name of the new stage to add. Defaults to
+//' \code{new_stage}. If several stages are to be added, then should be a
+//' vector of names of the same length as \code{add_before} or
+//' \code{add_after}, and defaults to \code{new_stage1}, \code{new_stage2},
+//' and so on.
+//' 
+//' @return A new copy of the original MPM edited to include new rows and
+//' columns in the associated matrices, and with \code{ahstages},
+//' \code{agestages}, and \code{hstages} objects edited to include the new
+//' stage.
+//' 
+//' @section Notes:
+//' If several stages are added at once, then all indices refer to the stages of
+//' the input \code{mpm}, and new stages entered at the same position are added
+//' in order of entry. New stages are then added in a single pass, and so this
+//' is much faster than calling \code{add_stage()} once per new stage.
+//' 
+//' @seealso \code{\link{edit_lM}()}
+//' 
+//' @examples
+//' data(cypdata)
+//' 
+//' cyp_lesl_data <- verticalize3(data = cypdata, noyears = 6, firstyear = 2004, 
+//'   patchidcol = "patch", individcol = "plantid", blocksize = 4, 
+//'   sizeacol = "Inf2.04", sizebcol = "Inf.04", sizeccol = "Veg.04", 
+//'   repstracol = "Inf.04", repstrbcol = "Inf2.04", fecacol = "Pod.04", 
+//'   stagesize = "sizeadded", NAas0 = TRUE, age_offset = 2)
+//' 
+//' cyp_survival <- glm(alive3 ~ obsage + as.factor(year2), data = cyp_lesl_data,
+//'   family = "binomial")
+//' cyp_fecundity <- glm(feca2 ~ 1 + obsage + as.factor(year2),
+//'   data = cyp_lesl_data, family = "poisson")
+//' 
+//' mod_params <- create_pm(name_terms = TRUE)
+//' mod_params$modelparams[22] <- "obsage"
+//' 
+//' germination <- 0.08
+//' protocorm_to_seedling <- 0.10
+//' seeding_to_adult <- 0.20
+//' seeds_per_fruit <- 8000
+//' 
+//' cyp_lesl_supp <- supplemental(historical = FALSE, stagebased = FALSE,
+//'   agebased = TRUE, age2 = c(1, 2), type = c(1, 1),
+//'   givenrate = c(protocorm_to_seedling, seeding_to_adult))
+//' 
+//' cyp_lesl_fb_mpm <- fleslie(data = cyp_lesl_data, surv_model = cyp_survival,
+//'   fec_model = cyp_fecundity, paramnames = mod_params, last_age = 7,
+//'   fecage_min = 3, fecmod = (germination * seeds_per_fruit),
+//'   supplement = cyp_lesl_supp)
+//' 
+//' altered1 <- add_stage(cyp_lesl_fb_mpm, add_before = 1, stage_name = "DS")
+//' altered2 <- add_stage(cyp_lesl_fb_mpm, add_before = c(1, 1),
+//'   stage_name = c("DS1", "DS2"))
+//' 
+//' @export add_stage
+// [[Rcpp::export(add_stage)]]
+Rcpp::List add_stage (const RObject mpm,
+  Nullable<IntegerVector> add_before = R_NilValue,
+  Nullable<IntegerVector> add_after = R_NilValue,
+  Nullable<CharacterVector> stage_name  = R_NilValue) {
+  
+  List mpm_list;
+  List final_output;
+  
+  if (is<List>(mpm)) mpm_list = as<List>(mpm);
+  StringVector mpm_class = mpm_list.attr("class");
+  
+  String mpm_error = "Please enter a lefkoMat or lefkoMatList object as input.";
+  bool mpm_yes {false};
+  bool mpmlist_yes {false};
+  
+  for (int i = 0; i < static_cast<int>(mpm_class.length()); i++) {
+    if (mpm_class(i) == "lefkoMat") mpm_yes = true;
+    if (mpm_class(i) == "lefkoMatList") mpmlist_yes = true;
+  }
+  if (!mpm_yes && !mpmlist_yes) throw Rcpp::exception(mpm_error.get_cstring(), false);
+  
+  IntegerVector add_before_vec = {0};
+  IntegerVector add_after_vec = {0};
+  if (add_before.isNotNull()) add_before_vec = as<IntegerVector>(add_before);
+  if (add_after.isNotNull()) add_after_vec = as<IntegerVector>(add_after);
+  if (add_before_vec.length() == 0) add_before_vec = IntegerVector::create(0);
+  if (add_after_vec.length() == 0) add_after_vec = IntegerVector::create(0);
+  
+  bool before_set = (add_before_vec.length() > 1 ||
+    (add_before_vec.length() == 1 && add_before_vec(0) > 0));
+  bool after_set = (add_after_vec.length() > 1 ||
+    (add_after_vec.length() == 1 && add_after_vec(0) > 0));
+  
+  if (before_set && after_set) {
+    throw Rcpp::exception("Please set either add_before or add_after, but not both.",
+      false);
+  }
+  
+  // Several new stages are added in one pass by add_stage_batch()
+  int num_added {1};
+  if (before_set) num_added = add_before_vec.length();
+  if (after_set) num_added = add_after_vec.length();
+  
+  arma::ivec insert_at (num_added, fill::zeros);
+  CharacterVector stage_names (num_added);
+  
+  if (num_added > 1) {
+    for (int m = 0; m < num_added; m++) {
+      if (before_set) {
+        if (IntegerVector::is_na(add_before_vec(m)) || add_before_vec(m) < 1) {
+          throw Rcpp::exception("Entries in option add_before must be positive integers.",
+            false);
+        }
+        insert_at(m) = add_before_vec(m) - 1;
+      } else {
+        if (IntegerVector::is_na(add_after_vec(m)) || add_after_vec(m) < 1) {
+          throw Rcpp::exception("Entries in option add_after must be positive integers.",
+            false);
+        }
+        insert_at(m) = add_after_vec(m);
+      }
+    }
+    
+    if (stage_name.isNotNull()) {
+      CharacterVector stage_name_input = as<CharacterVector>(stage_name);
+      
+      if (stage_name_input.length() != num_added) {
+        throw Rcpp::exception("Please enter one new stage name per new stage.",
+          false);
+      }
+      stage_names = stage_name_input;
+    } else {
+      for (int m = 0; m < num_added; m++) {
+        stage_names(m) = "new_stage" + std::to_string(m + 1);
+      }
+    }
+  }
+  
+  int add_before_single = add_before_vec(0);
+  int add_after_single = add_after_vec(0);
+  
+  if (mpm_yes) {
+    if (num_added > 1) {
+      add_stage_batch(final_output, mpm_list, insert_at, stage_names);
+    } else {
+      add_stage_single(final_output, mpm_list, add_before_single,
+        add_after_single, stage_name);
+    }
+  } else if (mpmlist_yes) {
+    int length_of_mpmlist = static_cast<int>(mpm_list.length());
+    List semifinal_output (length_of_mpmlist);
+    
+    for (int i = 0; i < length_of_mpmlist; i++) {
+      List current_output;
+      List current_mpm = as<List>(mpm_list(i));
+      
+      if (num_added > 1) {
+        add_stage_batch(current_output, current_mpm, insert_at, stage_names);
+      } else {
+        add_stage_single(current_output, current_mpm, add_before_single,
+          add_after_single, stage_name);
+      }
+      
+      semifinal_output(i) = current_output;
+    }
+    CharacterVector final_class = "lefkoMatList";
+    semifinal_output.attr("class") = final_class;
+    
+    final_output = semifinal_output;
+  } else throw Rcpp::exception(mpm_error.get_cstring(), false);
+  
+  return final_output;
+}
+
+//' Analyze the Life Cycle Graph of a Single Matrix
+//' 
+//' Function \code{cycle_graph()} reads a single matrix in compressed sparse
+//' column format, and finds stages without transitions leading to or from
+//' them, the strongly connected components of the life cycle graph, and the
+//' period of the matrix if it is irreducible.
+//' 
+//' @name cycle_graph
+//' 
+//' @param current_mat A \code{dgc_view} of the matrix to analyze.
+//' @param no_in Vector to hold a \code{1} for each stage without transitions
+//' leading to it from other stages, and a \code{0} otherwise.
+//' @param no_out Vector to hold a \code{1} for each stage without transitions
+//' leading from it to other stages, and a \code{0} otherwise.
+//' @param components Vector to hold the strongly connected component of each
+//' stage, numbered from \code{1} in order of the first stage in each.
+//' @param irreducible Logical value to hold whether the matrix is irreducible.
+//' @param period Integer to hold the period of the matrix, given as the
+//' greatest common divisor of the lengths of all cycles in the life cycle
+//' graph. Only estimated for irreducible matrices, and set to \code{NA}
+//' otherwise.
+//' 
+//' @return All output is written into the arguments above.
+//' 
+//' @section Notes:
+//' Strongly connected components are found through an iterative version of
+//' Tarjan's algorithm, and the period through the level differences of a
+//' breadth-first search from the first stage, so that the whole analysis takes
+//' time proportional to the number of stages plus the number of non-zero
+//' elements. Explicitly stored zeros are not treated as transitions.
+//' 
+//' @keywords internal
+//' @noRd
+inline void cycle_graph (const dgc_view& current_mat, arma::uvec& no_in,
+  arma::uvec& no_out, arma::uvec& components, bool& irreducible,
+  int& period) {
+  
+  int num_stages = current_mat.n_cols;
+  const int* col_ptr = current_mat.col_ptr;
+  const int* row_idx = current_mat.row_idx;
+  const double* values = current_mat.values;
+  
+  // Transitions from column j to row i, excluding stasis
+  no_in.ones(num_stages);
+  no_out.ones(num_stages);
+  
+  for (int j = 0; j < num_stages; j++) {
+    for (int k = col_ptr[j]; k < col_ptr[j+1]; k++) {
+      if (values[k] == 0. || row_idx[k] == j) continue;
+      
+      no_out(j) = 0;
+      if (values[k] > 0.) no_in(row_idx[k]) = 0;
+    }
+  }
+  
+  // Iterative Tarjan strongly connected components
+  std::vector<int> order_index (num_stages, -1);
+  std::vector<int> lowlink (num_stages, 0);
+  std::vector<char> on_stack (num_stages, 0);
+  std::vector<int> scc_stack;
+  std::vector<std::pair<int, int>> call_stack;
+  arma::uvec tarjan_components (num_stages, fill::zeros);
+  
+  int next_index {0};
+  int num_components {0};
+  
+  for (int root = 0; root < num_stages; root++) {
+    if (order_index[root] != -1) continue;
+    
+    order_index[root] = next_index;
+    lowlink[root] = next_index;
+    next_index++;
+    scc_stack.push_back(root);
+    on_stack[root] = 1;
+    call_stack.push_back(std::make_pair(root, col_ptr[root]));
+    
+    while (!call_stack.empty()) {
+      int node = call_stack.back().first;
+      int k = call_stack.back().second;
+      
+      if (k < col_ptr[node+1]) {
+        call_stack.back().second = k + 1;
+        if (values[k] == 0.) continue;
+        
+        int target = row_idx[k];
+        if (order_index[target] == -1) {
+          order_index[target] = next_index;
+          lowlink[target] = next_index;
+          next_index++;
+          scc_stack.push_back(target);
+          on_stack[target] = 1;
+          call_stack.push_back(std::make_pair(target, col_ptr[target]));
+          
+        } else if (on_stack[target]) {
+          lowlink[node] = std::min(lowlink[node], order_index[target]);
+        }
+        
+      } else {
+        call_stack.pop_back();
+        if (!call_stack.empty()) {
+          int parent = call_stack.back().first;
+          lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+        }
+        
+        if (lowlink[node] == order_index[node]) {
+          int member {-1};
+          while (member != node) {
+            member = scc_stack.back();
+            scc_stack.pop_back();
+            on_stack[member] = 0;
+            tarjan_components(member) = num_components;
+          }
+          num_components++;
+        }
+      }
+    }
+  }
+  
+  // Components renumbered in order of first stage
+  arma::ivec renumbered (num_components);
+  renumbered.fill(-1);
+  components.zeros(num_stages);
+  int assigned {0};
+  
+  for (int i = 0; i < num_stages; i++) {
+    if (renumbered(tarjan_components(i)) == -1) {
+      renumbered(tarjan_components(i)) = assigned;
+      assigned++;
+    }
+    components(i) = renumbered(tarjan_components(i)) + 1;
+  }
+  
+  irreducible = (num_components == 1);
+  period = NA_INTEGER;
+  if (!irreducible) return;
+  
+  // Period as gcd of level differences over all transitions
+  std::vector<int> level (num_stages, -1);
+  std::vector<int> bfs_queue;
+  bfs_queue.reserve(num_stages);
+  bfs_queue.push_back(0);
+  level[0] = 0;
+  
+  int cycle_gcd {0};
+  for (int q = 0; q < static_cast<int>(bfs_queue.size()); q++) {
+    int node = bfs_queue[q];
+    
+    for (int k = col_ptr[node]; k < col_ptr[node+1]; k++) {
+      if (values[k] == 0.) continue;
+      
+      int target = row_idx[k];
+      if (level[target] == -1) {
+        level[target] = level[node] + 1;
+        bfs_queue.push_back(target);
+      } else {
+        int difference = std::abs(level[node] + 1 - level[target]);
+        
+        while (difference != 0) {
+          int remainder = cycle_gcd % difference;
+          cycle_gcd = difference;
+          difference = remainder;
+        }
+      }
+    }
+  }
+  
+  // A single stage without stasis has no cycles
+  if (cycle_gcd == 0) {
+    irreducible = false;
+  } else {
+    period = cycle_gcd;
+  }
+}
+
+//' Check Continuity of Life Cycle through Matrices in lefkoMat Objects
+//' 
+//' Function \code{cycle_check()} tests whether stages, stage-pairs, or
+//' age-stages connect in matrices within \code{lefkoMat} objects.
+//' 
 //' @name cycle_check
 //' 
 //' @param mpm An object of class lefkoMat, a matrix, or a list of matrices.
 //' @param quiet A logical variable indicating whether to suppress diagnostic
 //' messages. Defaults to \code{FALSE}.
 //' 
-//' @return Returns a list with two elements, both of which are also lists.
-//' The first list, \code{no_in}, contains as many elements as matrices, with
-//' each element containing an integer vector showing the identification numbers
-//' of stages, stage-pairs, or age-stages, in each matrix that do not show any
-//' transitions leading to them. The second list, \code{no_out}, is structured
-//' similarly to the first, but shows stages, stage-pairs, or age-stages from
-//' which there are no transitions leading out.
+//' @return Returns a list with the following elements:
+//' \item{no_in}{A list with as many elements as matrices, with each element
+//' containing an integer vector showing the identification numbers of stages,
+//' stage-pairs, or age-stages, in each matrix that do not show any transitions
+//' leading to them.}
+//' \item{no_out}{A list structured similarly to \code{no_in}, but showing
+//' stages, stage-pairs, or age-stages from which there are no transitions
+//' leading out.}
+//' \item{components}{A list with as many elements as matrices, with each
+//' element containing an integer vector giving the strongly connected component
+//' of the life cycle graph to which each stage, stage-pair, or age-stage
+//' belongs. Components are numbered in order of their first stage.}
+//' \item{irreducible}{A logical vector indicating whether each matrix is
+//' irreducible, meaning that every stage can be reached from every other
+//' stage.}
+//' \item{primitive}{A logical vector indicating whether each matrix is
+//' primitive, meaning that it is irreducible with a period of 1.}
+//' \item{period}{An integer vector giving the period of each irreducible
+//' matrix, as the greatest common divisor of the lengths of all cycles in its
+//' life cycle graph. Equals \code{NA} for reducible matrices.}
 //' 
 //' @section Notes:
 //' This function tests whether stages, stage-pairs, and age-stages are
@@ -2584,6 +3674,14 @@ Rcpp::List add_stage (const RObject mpm, int add_before = 0,
 //' case of a historical MPM, or against the row number of the associated
 //' \code{agestages} data frame in the case of an age-by-stage MPM.
 //' 
+//' Irreducibility and primitivity are assessed from the strongly connected
+//' components of the life cycle graph, which are found in time proportional to
+//' the number of non-zero elements, without converting sparse matrices to dense
+//' format. Primitive matrices have a single dominant eigenvalue with a positive
+//' eigenvector, and so are suited to power iteration methods of estimating
+//' \eqn{\lambda}. Reducible and imprimitive matrices may require full eigen
+//' decomposition.
+//' 
 //' @examples
 //' data(cypdata)
 //' 
@@ -2632,7 +3730,6 @@ Rcpp::List add_stage (const RObject mpm, int add_before = 0,
 // [[Rcpp::export(cycle_check)]]
 List cycle_check(RObject mpm, Nullable<RObject> quiet = R_NilValue) {
   
-  List lopv (2);
   bool quiet_bool = false;
   
   if (quiet.isNotNull()) {
@@ -2641,13 +3738,17 @@ List cycle_check(RObject mpm, Nullable<RObject> quiet = R_NilValue) {
     }
   }
   
+  CharacterVector stage_terms_caps = {"Stages", "Stage-pairs", "Age-stages"};
+  CharacterVector stage_terms_small = {"stage", "stage-pair", "age-stage"};
+  
+  List amats;
+  bool lefkoMat_input {false};
+  int mat_type {0}; // 0: ahist/age; 1: hist; 2:agestage
+  int num_stages {0};
+  
   if (is<List>(mpm)) {
     List mpm_list = as<List>(mpm);
-    int mat_type {0}; // 0: ahist/age; 1: hist; 2:agestage
-    // Need to include a test to determine if lefkoMat object or list of matrices
-    
-    CharacterVector stage_terms_caps = {"Stages", "Stage-pairs", "Age-stages"};
-    CharacterVector stage_terms_small = {"stage", "stage-pair", "age-stage"};
+    lefkoMat_input = true;
     
     CharacterVector list_names = mpm_list.attr("names");
     int all_found {0};
@@ -2660,18 +3761,13 @@ List cycle_check(RObject mpm, Nullable<RObject> quiet = R_NilValue) {
     }
     if (all_found < 5) pop_error("mpm", "a lefkoMat object, matrix, or list of matrices", "", 1);
     
-    List amats = as<List>(mpm_list["A"]);
+    amats = as<List>(mpm_list["A"]);
     DataFrame stageframe = as<DataFrame>(mpm_list["ahstages"]);
     DataFrame hstages = as<DataFrame>(mpm_list["hstages"]);
-    DataFrame labels = as<DataFrame>(mpm_list["labels"]);
     DataFrame agestages = as<DataFrame>(mpm_list["agestages"]);
     
-    StringVector poporder = as<StringVector>(labels["pop"]);
-    int loysize = poporder.length();
-    
     StringVector stages = as<StringVector>(stageframe["stage"]);
-    IntegerVector stage_id = as<IntegerVector>(stageframe["stage_id"]);
-    int num_stages = stages.length();
+    num_stages = stages.length();
     
     if (hstages.length() > 1) {
       mat_type = 1;
@@ -2685,93 +3781,78 @@ List cycle_check(RObject mpm, Nullable<RObject> quiet = R_NilValue) {
       num_stages = sid_agestages.length();
     }
     
-    List list_of_no_in (loysize);
-    List list_of_no_out (loysize);
+  } else if (is<NumericMatrix>(mpm) || is<S4>(mpm)) {
+    amats = List::create(mpm);
     
-    arma::uvec mats_probs_a_arma (loysize, fill::zeros);
-    arma::uvec mats_probs_b_arma (loysize, fill::zeros);
+  } else {
+    pop_error("mpm", "a lefkoMat object, matrix, or list of matrices", "", 1);
+  }
+  
+  int loysize = static_cast<int>(amats.length());
+  
+  List list_of_no_in (loysize);
+  List list_of_no_out (loysize);
+  List list_of_components (loysize);
+  LogicalVector irreducible_vec (loysize);
+  LogicalVector primitive_vec (loysize);
+  IntegerVector period_vec (loysize);
+  
+  arma::uvec mats_probs_a_arma (loysize, fill::zeros);
+  arma::uvec mats_probs_b_arma (loysize, fill::zeros);
+  arma::uvec mats_reducible_arma (loysize, fill::zeros);
+  
+  for (int mat = 0; mat < loysize; mat++) {
+    Rcpp::checkUserInterrupt();
     
-    for (int mat = 0; mat < loysize; mat++) {
-      arma::uvec stage_check (num_stages, fill::zeros); // Stages without inward transitions (as 0)
-      arma::uvec problem_vector (num_stages, fill::zeros); // Stages without outward transitions (as 1)
-      
-      if (is<NumericMatrix>(amats(mat))) {
-        arma::mat current_mat = as<arma::mat>(amats(mat));
-        int num_cols = current_mat.n_cols;
-        
-        for (int current_col = 0; current_col < num_cols; current_col++) {
-          if (current_col % 5 == 0) Rcpp::checkUserInterrupt();
-          
-          arma::vec check_col = current_mat.col(current_col);
-          arma::uvec nonzeros_vec = find(check_col);
-          
-          int nonzeros_num = nonzeros_vec.n_elem;
-          if (check_col(current_col) != 0.) nonzeros_num -= 1;
-          
-          if (nonzeros_num == 0) {
-            problem_vector(current_col) = 1; // No out}
-            mats_probs_a_arma(mat) = 1;
-          }
-          
-          arma::mat cmat_nocurrent = current_mat;
-          cmat_nocurrent.shed_col(current_col);
-          arma::vec cmat_nc_sums = sum(cmat_nocurrent, 1);
-          
-          if (cmat_nc_sums(current_col) > 0.) stage_check(current_col) += 1;
-          
-        }
-        
-      } else if (is<S4>(amats(mat))) {
-        arma::sp_mat current_mat = as<arma::sp_mat>(amats(mat));
-        int num_cols = current_mat.n_cols;
-        
-        if (num_cols != num_stages) {
-          throw Rcpp::exception("This function currently handles only ahistorical and age-based MPMs", false);
-        }
-        
-        for (int current_col = 0; current_col < num_cols; current_col++) {
-          if (current_col % 5 == 0) Rcpp::checkUserInterrupt();
-          
-          arma::vec check_col = arma::vec(current_mat.col(current_col));
-          arma::uvec nonzeros_vec = find(check_col);
-          
-          int nonzeros_num = nonzeros_vec.n_elem;
-          if (check_col(current_col) != 0.) nonzeros_num -= 1;
-          
-          if (nonzeros_num == 0) problem_vector(current_col) = 1; // No out
-          
-          arma::sp_mat cmat_nocurrent = current_mat;
-          cmat_nocurrent.shed_col(current_col);
-          arma::vec cmat_nc_sums = arma::vec(sum(cmat_nocurrent, 1));
-          
-          if (cmat_nc_sums(current_col) > 0.) {
-            stage_check(current_col) += 1;
-            mats_probs_b_arma(mat) = 1;
-          }
-          
-        }
-        
-      }
-      
-      arma::uvec probs_a_arma = find(problem_vector); // No out
-      arma::uvec probs_b_arma = find(stage_check == 0); // No in
-      
-      probs_a_arma += 1;
-      probs_b_arma += 1;
-      
-      IntegerVector unique_probs_a = as<IntegerVector>(wrap(probs_a_arma));
-      IntegerVector unique_probs_b = as<IntegerVector>(wrap(probs_b_arma));
+    dgc_view current_mat (amats, mat);
+    
+    if (current_mat.n_rows != current_mat.n_cols) {
+      throw Rcpp::exception("Matrices must be square.", false);
+    }
+    if (lefkoMat_input && current_mat.n_cols != num_stages) {
+      String eat_my_shorts = "Matrix dimensions do not match the number of ";
+      eat_my_shorts += stage_terms_small(mat_type);
+      eat_my_shorts += "s in the lefkoMat object.";
       
-      list_of_no_out(mat) = unique_probs_a;
-      list_of_no_in(mat) = unique_probs_b;
+      throw Rcpp::exception(eat_my_shorts.get_cstring(), false);
     }
     
-    if (!quiet_bool) {
+    arma::uvec stage_check; // Stages without inward transitions (as 1)
+    arma::uvec problem_vector; // Stages without outward transitions (as 1)
+    arma::uvec components;
+    bool irreducible {false};
+    int period {NA_INTEGER};
+    
+    cycle_graph(current_mat, stage_check, problem_vector, components,
+      irreducible, period);
+    
+    arma::uvec probs_a_arma = find(problem_vector); // No out
+    arma::uvec probs_b_arma = find(stage_check); // No in
+    
+    if (probs_a_arma.n_elem > 0) mats_probs_a_arma(mat) = 1;
+    if (probs_b_arma.n_elem > 0) mats_probs_b_arma(mat) = 1;
+    if (!irreducible) mats_reducible_arma(mat) = 1;
+    
+    probs_a_arma += 1;
+    probs_b_arma += 1;
+    
+    list_of_no_out(mat) = as<IntegerVector>(wrap(probs_a_arma));
+    list_of_no_in(mat) = as<IntegerVector>(wrap(probs_b_arma));
+    list_of_components(mat) = as<IntegerVector>(wrap(components));
+    irreducible_vec(mat) = irreducible;
+    primitive_vec(mat) = (irreducible && period == 1);
+    period_vec(mat) = period;
+  }
+  
+  if (!quiet_bool) {
+    if (lefkoMat_input) {
       arma::uvec find_em_a = find(mats_probs_a_arma);
       arma::uvec find_em_b = find(mats_probs_b_arma);
+      arma::uvec find_em_c = find(mats_reducible_arma);
       
       find_em_a += 1;
       find_em_b += 1;
+      find_em_c += 1;
       
       if (find_em_a.n_elem > 0) {
         Rcout << stage_terms_caps(mat_type)
@@ -2788,136 +3869,36 @@ List cycle_check(RObject mpm, Nullable<RObject> quiet = R_NilValue) {
         Rcout << "All matrices have no " << stage_terms_small(mat_type)
           << " discontinuities." << endl;
       }
-    }
-    
-    lopv(0) = list_of_no_in;
-    lopv(1) = list_of_no_out;
-    
-  } else if (is<NumericMatrix>(mpm)) {
-    NumericMatrix mpm_matrix = as<NumericMatrix>(mpm);
-    int num_stages = mpm_matrix.ncol();
-    List list_of_no_in (1);
-    List list_of_no_out (1);
-    
-    arma::uvec stage_check (num_stages, fill::zeros); // Stages without inward transitions (as 0)
-    arma::uvec problem_vector (num_stages, fill::zeros); // Stages without outward transitions (as 1)
-    
-    arma::mat current_mat = as<arma::mat>(mpm_matrix);
-    int num_cols = current_mat.n_cols;
-    
-    for (int current_col = 0; current_col < num_cols; current_col++) {
-      if (current_col % 5 == 0) Rcpp::checkUserInterrupt();
-      
-      arma::vec check_col = current_mat.col(current_col);
-      arma::uvec nonzeros_vec = find(check_col);
-      
-      int nonzeros_num = nonzeros_vec.n_elem;
-      if (check_col(current_col) != 0.) nonzeros_num -= 1;
       
-      if (nonzeros_num == 0) problem_vector(current_col) = 1; // No out
-      
-      arma::mat cmat_nocurrent = current_mat;
-      cmat_nocurrent.shed_col(current_col);
-      arma::vec cmat_nc_sums = sum(cmat_nocurrent, 1);
-      
-      if (cmat_nc_sums(current_col) > 0.) stage_check(current_col) += 1;
+      if (find_em_c.n_elem > 0) {
+        Rcout << "Reducible matrices found: "
+          << as<IntegerVector>(wrap(find_em_c)) << endl;
+      }
       
-    }
-    
-    arma::uvec probs_a_arma = find(problem_vector); // No out
-    arma::uvec probs_b_arma = find(stage_check == 0); // No in
-    
-    probs_a_arma += 1;
-    probs_b_arma += 1;
-    
-    IntegerVector unique_probs_a = as<IntegerVector>(wrap(probs_a_arma));
-    IntegerVector unique_probs_b = as<IntegerVector>(wrap(probs_b_arma));
-    
-    list_of_no_out(0) = unique_probs_a;
-    list_of_no_in(0) = unique_probs_b;
-    
-    if (!quiet_bool) {
-      if (probs_a_arma.n_elem > 0) {
+    } else {
+      if (mats_probs_a_arma(0) > 0) {
         Rcout << "Stages without connections leading to the rest of the "  
           << "life cycle found in matrix" << endl;
       }
-      if (probs_b_arma.n_elem > 0) {
+      if (mats_probs_b_arma(0) > 0) {
         Rcout << "Stages without connections leading to them found in matrix"
           << endl;
       }
       
-      if (probs_a_arma.n_elem == 0 && probs_b_arma.n_elem == 0) {
+      if (mats_probs_a_arma(0) == 0 && mats_probs_b_arma(0) == 0) {
         Rcout << "Matrix has no stage discontinuities." << endl;
       }
-    }
-    
-    lopv(0) = list_of_no_in;
-    lopv(1) = list_of_no_out;
-    
-  } else if (is<S4>(mpm)) {
-    arma::sp_mat current_mat = as<arma::sp_mat>(mpm);
-    int num_stages = current_mat.n_cols;
-    int num_cols = num_stages;
-    List list_of_no_in (1);
-    List list_of_no_out (1);
-    
-    arma::uvec stage_check (num_stages, fill::zeros); // Stages without inward transitions (as 0)
-    arma::uvec problem_vector (num_stages, fill::zeros); // Stages without outward transitions (as 1)
-    
-    for (int current_col = 0; current_col < num_cols; current_col++) {
-      if (current_col % 5 == 0) Rcpp::checkUserInterrupt();
-      
-      arma::vec check_col = arma::vec(current_mat.col(current_col));
-      arma::uvec nonzeros_vec = find(check_col);
-      
-      int nonzeros_num = nonzeros_vec.n_elem;
-      if (check_col(current_col) != 0.) nonzeros_num -= 1;
-      
-      if (nonzeros_num == 0) problem_vector(current_col) = 1; // No out
-      
-      arma::sp_mat cmat_nocurrent = current_mat;
-      cmat_nocurrent.shed_col(current_col);
-      arma::vec cmat_nc_sums = arma::vec(sum(cmat_nocurrent, 1));
-      
-      if (cmat_nc_sums(current_col) > 0.) stage_check(current_col) += 1;
-      
-    }
-    
-    arma::uvec probs_a_arma = find(problem_vector); // No out
-    arma::uvec probs_b_arma = find(stage_check == 0); // No in
-    
-    probs_a_arma += 1;
-    probs_b_arma += 1;
-    
-    IntegerVector unique_probs_a = as<IntegerVector>(wrap(probs_a_arma));
-    IntegerVector unique_probs_b = as<IntegerVector>(wrap(probs_b_arma));
-    
-    list_of_no_out(0) = unique_probs_a;
-    list_of_no_in(0) = unique_probs_b;
-    
-    if (!quiet_bool) {
-      if (probs_a_arma.n_elem > 0) {
-        Rcout << "Stages without connections leading to the rest of the "  
-          << "life cycle found in matrix" << endl;
-      }
-      if (probs_b_arma.n_elem > 0) {
-        Rcout << "Stages without connections leading to them found in matrix" << endl;
-      }
       
-      if (probs_a_arma.n_elem == 0 && probs_b_arma.n_elem == 0) {
-        Rcout << "Matrix has no stage discontinuities." << endl;
+      if (mats_reducible_arma(0) > 0) {
+        Rcout << "Matrix is reducible." << endl;
       }
     }
-    
-    lopv(0) = list_of_no_in;
-    lopv(1) = list_of_no_out;
-    
-  } else {
-    pop_error("mpm", "a lefkoMat object, matrix, or list of matrices", "", 1);
   }
   
-  CharacterVector lopv_names {"no_in", "no_out"};
-  lopv.attr("names") = lopv_names;
+  List lopv = List::create(_["no_in"] = list_of_no_in,
+    _["no_out"] = list_of_no_out, _["components"] = list_of_components,
+    _["irreducible"] = irreducible_vec, _["primitive"] = primitive_vec,
+    _["period"] = period_vec);
   
   return lopv;
 }
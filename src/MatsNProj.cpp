@@ -5,6 +5,7 @@
 #include <boost/math/special_functions/gamma.hpp>
 #include <boost/math/special_functions/beta.hpp>
 #include <LefkoUtils.h>
+#include <random>
 
 using namespace Rcpp;
 using namespace arma;
@@ -33,21 +34,58 @@ using namespace LefkoMats;
 // 16. .sens3matrix_spinp() - Returns sensitivity of lambda to each element in a sparse matrix, with output in dense matrix format
 // 17. .sens3hlefko() - Returns sensitivity of lambda to each historical stage-pair, and associated life stage
 // 18. .sens3hlefko_sp() - Returns sensitivity of lambda to each historical stage-pair, and associated life stage, with input in sparse format
-// 19. .elas3matrix() - Returns elasticity of lambda to each element in dense or sparse matrix
-// 20. .ekas3sp_matrix() - Returns elasticity of lambda to each element in sparse matrix, in sparse output
-// 21. .elas3hlefko() - Returns elasticity of lambda to each historical stage-pair, and each associated life stage
-// 22. .elas3sp_hlefko() - Returns elasticity of lambda to each historical stage-pair, and each associated life stage, with sparse input
-// 23. .proj3() - Cure functiuon running matrix projections used in other functions in lefko3
-// 24. .proj3sp() - Core function running sparse matrix projections used in other functions in lefko3
-// 25. .proj3dens() - Core function running density-dependent projections used in other functions in lefko3
-// 26. projection3_single() - Conduct single population projection simulations
-// 27. projection3() - Runs projection simulations with lefkoMat objects
-// 28. slambda3() - Estimates stochastic population growth rate in lefkoMat objects and other MPMs
-// 29. .stoch_senselas() - Estimates sensitivity and elasticity of matrix elements to a
-// 30. .ltre3matrix() - Returns one-way fixed deterministic LTRE matrix
-// 31. .sltre3matrix() - Returns one-way stochastic LTRE matrices
-// 32. .snaltre3matrix() - Returns one-way small noise approximation LTRE matrices
-// 33. markov_run() - Creates vector of randomly sampled times
+// 19. elas3_core() - Estimates lambda and elasticities of a dense matrix using only Armadillo objects
+// 20. .elas3matrix() - Returns elasticity of lambda to each element in dense or sparse matrix
+// 21. .ekas3sp_matrix() - Returns elasticity of lambda to each element in sparse matrix, in sparse output
+// 22. .elas3hlefko() - Returns elasticity of lambda to each historical stage-pair, and each associated life stage
+// 23. .elas3sp_hlefko() - Returns elasticity of lambda to each historical stage-pair, and each associated life stage, with sparse input
+// 24. order_period() - Finds the shortest repeating cycle in a sequence of matrix indices
+// 25. proj3_fused() - Runs forward and backward projections in a single pass over preconverted matrices
+// 26. .proj3() - Cure functiuon running matrix projections used in other functions in lefko3
+// 27. .proj3sp() - Core function running sparse matrix projections used in other functions in lefko3
+// 28. conv_extend() - Extends a deterministic projection stopped at convergence to all requested occasions
+// 29. dens_groups() - Groups density dependent elements by time delay and density function
+// 30. dens_values() - Applies each density function to all of its elements at once for a single occasion
+// 31. dens_write() - Writes density-adjusted element values into a dense matrix
+// 32. dens_apply() - Adjusts density dependent elements of a dense matrix, compounding repeated elements in order of entry
+// 33. dens_limits() - Applies additive and fixed density limits to a projected population vector
+// 34. .proj3dens() - Core function running density-dependent projections used in other functions in lefko3
+// 35. periodic_power() - Applies a power of a period product matrix to a vector by repeated squaring
+// 36. periodic_final() - Projects a vector through a periodic matrix sequence to a final occasion
+// 37. proj3periodic() - Projects periodic deterministic matrix sequences without stepping through each occasion
+// 38. demog_unif() - Draws a uniform deviate from a replicate-specific random stream
+// 39. demog_logfact() - Log factorial safe for use in parallel
+// 40. demog_binom() - Draws binomial deviates by inversion or BTRS transformed rejection
+// 41. demog_pois() - Draws Poisson deviates by multiplication or PTRS transformed rejection
+// 42. demog_step() - Projects one occasion of whole individuals drawn from U and F matrices
+// 43. demog_mean() - Creates element-wise mean matrices for population-level individual-based projection
+// 44. proj3demog() - Projects whole individuals with demographic stochasticity in parallel replicates
+// 45. proj3pva() - Projects replicates until quasi-extinction, stopping each replicate early
+// 46. pva_record() - Records quasi-extinction times and cumulative extinction risk
+// 47. start_frame_vec() - Creates a starting vector from a start_input() data frame
+// 48. projection3_single() - Conduct single population projection simulations
+// 49. projection3() - Runs projection simulations with lefkoMat objects
+// 50. equil_jacobian() - Estimates the Jacobian of a density dependent projection map by finite differences
+// 51. equil_solve() - Finds the fixed point of a density dependent projection map
+// 52. equilibrium3() - Finds equilibria of density dependent matrix projection models
+// 53. slambda_chains() - Estimates stochastic population growth rate with parallel independent chains
+// 54. sna_growth() - Estimates stochastic population growth rate via the small noise approximation
+// 55. slambda3() - Estimates stochastic population growth rate in lefkoMat objects and other MPMs
+// 56. senselas_checkpointed() - Adds stochastic sensitivity terms of one projection using checkpointed w vectors
+// 57. sna_senselas() - Estimates stochastic sensitivities or elasticities via the small noise approximation
+// 58. .stoch_senselas() - Estimates sensitivity and elasticity of matrix elements to a
+// 59. ltre_eigen_pair() - Extracts the dominant right and left eigenvectors from eigen analysis output
+// 60. ltre_warm_eigen() - Estimates dominant eigenvectors by power iteration from a warm start
+// 61. ltre_sp_cont() - Creates sparse LTRE contributions from eigenvectors
+// 62. .ltre3matrix() - Returns one-way fixed deterministic LTRE matrix
+// 63. ltre_stack() - Stacks chosen matrix elements across a set of matrices
+// 64. ltre_moments() - Estimates standard deviations and correlations of stacked matrix elements
+// 65. ltre_cv() - Estimates coefficients of variation of indexed matrix elements
+// 66. ltre_sp_elems() - Creates a sparse square matrix from indexed element values
+// 67. ltre_sp_pairs() - Creates a sparse element-by-element matrix from indexed pair values
+// 68. .sltre3matrix() - Returns one-way stochastic LTRE matrices
+// 69. .snaltre3matrix() - Returns one-way small noise approximation LTRE matrices
+// 70. markov_run() - Creates vector of randomly sampled times
 
 
 
@@ -198,12 +236,25 @@ List specialpatrolgroup(const DataFrame& sge9l, const arma::ivec& sge3index21,
   List s2f_err (loy_length);
   List di321p_err (loy_length);
   
-  StringVector data_pop_;
-  StringVector data_patch_;
+  // Integer codes for populations, patches, and years used in data subsetting
+  arma::ivec data_pop_codes;
+  arma::ivec data_patch_codes;
+  arma::ivec loy_pop_codes;
+  arma::ivec loy_patch_codes;
   
-  if (loy_pop_used) data_pop_ = as<StringVector>(MainData[pop_var_int]);
-  if (loy_patch_used) data_patch_ = as<StringVector>(MainData[patch_var_int]);
+  if (loy_pop_used) {
+    StringVector data_pop_ = as<StringVector>(MainData[pop_var_int]);
+    data_pop_codes = LefkoUtils::stage_codes(data_pop_, loypop);
+    loy_pop_codes = LefkoUtils::stage_codes(loypop, loypop);
+  }
+  if (loy_patch_used) {
+    StringVector data_patch_ = as<StringVector>(MainData[patch_var_int]);
+    data_patch_codes = LefkoUtils::stage_codes(data_patch_, loypatch);
+    loy_patch_codes = LefkoUtils::stage_codes(loypatch, loypatch);
+  }
   StringVector data_year_ = as<StringVector>(MainData[year_var_int]);
+  arma::ivec data_year_codes = LefkoUtils::stage_codes(data_year_, loyyear2);
+  arma::ivec loy_year_codes = LefkoUtils::stage_codes(loyyear2, loyyear2);
   
   arma::uvec ovgiventind = find(sge9ovgivent != -1.);
   arma::uvec ovgivenfind = find(sge9ovgivenf != -1.);
@@ -221,17 +272,16 @@ List specialpatrolgroup(const DataFrame& sge9l, const arma::ivec& sge3index21,
   int ovesfn = static_cast<int>(ovestfind.n_elem);
   
   for (int i = 0; i < loy_length; i++) {
-    arma::uvec data_current_index = as<arma::uvec>(LefkoUtils::index_l3(data_year_, loyyear2(i)));
+    arma::uvec data_current_rows = (data_year_codes == loy_year_codes(i));
     
     if (loy_pop_used) {
-      arma::uvec data_current_pop = as<arma::uvec>(LefkoUtils::index_l3(data_pop_, loypop(i)));
-      data_current_index = intersect(data_current_index, data_current_pop);
+      data_current_rows = data_current_rows % (data_pop_codes == loy_pop_codes(i));
     }
     
     if (loy_patch_used) {
-      arma::uvec data_current_patch = as<arma::uvec>(LefkoUtils::index_l3(data_patch_, loypatch(i)));
-      data_current_index = intersect(data_current_index, data_current_patch);
+      data_current_rows = data_current_rows % (data_patch_codes == loy_patch_codes(i));
     }
+    arma::uvec data_current_index = find(data_current_rows);
     
     int data_subset_rows = static_cast<int>(data_current_index.n_elem);
     if (data_subset_rows < 10 && !small_subset) {
@@ -655,12 +705,25 @@ List normalpatrolgroup(const DataFrame& sge3, const arma::ivec& sge2stage2,
   List conc_err (loy_length);
   List s2f_err (loy_length);
 
-  StringVector data_pop_;
-  StringVector data_patch_;
-  
-  if (loy_pop_used) data_pop_ = as<StringVector>(MainData[pop_var_int]);
-  if (loy_patch_used) data_patch_ = as<StringVector>(MainData[patch_var_int]);
+  // Integer codes for populations, patches, and years used in data subsetting
+  arma::ivec data_pop_codes;
+  arma::ivec data_patch_codes;
+  arma::ivec loy_pop_codes;
+  arma::ivec loy_patch_codes;
+  
+  if (loy_pop_used) {
+    StringVector data_pop_ = as<StringVector>(MainData[pop_var_int]);
+    data_pop_codes = LefkoUtils::stage_codes(data_pop_, loypop);
+    loy_pop_codes = LefkoUtils::stage_codes(loypop, loypop);
+  }
+  if (loy_patch_used) {
+    StringVector data_patch_ = as<StringVector>(MainData[patch_var_int]);
+    data_patch_codes = LefkoUtils::stage_codes(data_patch_, loypatch);
+    loy_patch_codes = LefkoUtils::stage_codes(loypatch, loypatch);
+  }
   StringVector data_year_ = as<StringVector>(MainData[year_var_int]);
+  arma::ivec data_year_codes = LefkoUtils::stage_codes(data_year_, loyyear2);
+  arma::ivec loy_year_codes = LefkoUtils::stage_codes(loyyear2, loyyear2);
   
   arma::uvec ovgiventind = find(sge3ovgivent != -1.);
   arma::uvec ovgivenfind = find(sge3ovgivenf != -1.);
@@ -678,17 +741,16 @@ List normalpatrolgroup(const DataFrame& sge3, const arma::ivec& sge2stage2,
   int ovesfn = static_cast<int>(ovestfind.n_elem);
   
   for (int i = 0; i < loy_length; i++) {
-    arma::uvec data_current_index = as<arma::uvec>(LefkoUtils::index_l3(data_year_, loyyear2(i)));
+    arma::uvec data_current_rows = (data_year_codes == loy_year_codes(i));
     
     if (loy_pop_used) {
-      arma::uvec data_current_pop = as<arma::uvec>(LefkoUtils::index_l3(data_pop_, loypop(i)));
-      data_current_index = intersect(data_current_index, data_current_pop);
+      data_current_rows = data_current_rows % (data_pop_codes == loy_pop_codes(i));
     }
     
     if (loy_patch_used) {
-      arma::uvec data_current_patch = as<arma::uvec>(LefkoUtils::index_l3(data_patch_, loypatch(i)));
-      data_current_index = intersect(data_current_index, data_current_patch);
+      data_current_rows = data_current_rows % (data_patch_codes == loy_patch_codes(i));
     }
+    arma::uvec data_current_index = find(data_current_rows);
     
     int data_subset_rows = static_cast<int>(data_current_index.n_elem);
     if (data_subset_rows < 10 && !small_subset) {
@@ -1076,31 +1138,43 @@ Rcpp::List minorpatrolgroup(const DataFrame& MainData,
   List F_output (loy_length);
   List conc_err (loy_length);
   
-  StringVector data_pop_;
-  StringVector data_patch_;
+  // Integer codes for populations, patches, and years used in data subsetting
+  arma::ivec data_pop_codes;
+  arma::ivec data_patch_codes;
+  arma::ivec loy_pop_codes;
+  arma::ivec loy_patch_codes;
   
-  if (loy_pop_used) data_pop_ = as<StringVector>(MainData[pop_var_int]);
-  if (loy_patch_used) data_patch_ = as<StringVector>(MainData[patch_var_int]);
+  if (loy_pop_used) {
+    StringVector data_pop_ = as<StringVector>(MainData[pop_var_int]);
+    data_pop_codes = LefkoUtils::stage_codes(data_pop_, loypop);
+    loy_pop_codes = LefkoUtils::stage_codes(loypop, loypop);
+  }
+  if (loy_patch_used) {
+    StringVector data_patch_ = as<StringVector>(MainData[patch_var_int]);
+    data_patch_codes = LefkoUtils::stage_codes(data_patch_, loypatch);
+    loy_patch_codes = LefkoUtils::stage_codes(loypatch, loypatch);
+  }
   StringVector data_year_ = as<StringVector>(MainData[year_var_int]);
+  arma::ivec data_year_codes = LefkoUtils::stage_codes(data_year_, loyyear2);
+  arma::ivec loy_year_codes = LefkoUtils::stage_codes(loyyear2, loyyear2);
   
   //Rcout << "minorpatrolgroup 6" << endl;
   
   for (int i = 0; i < loy_length; i++) {
-    arma::uvec data_current_index = as<arma::uvec>(LefkoUtils::index_l3(data_year_, loyyear2(i)));
+    arma::uvec data_current_rows = (data_year_codes == loy_year_codes(i));
     
     //Rcout << "minorpatrolgroup 7" << endl;
     
     if (loy_pop_used) {
-      arma::uvec data_current_pop = as<arma::uvec>(LefkoUtils::index_l3(data_pop_, loypop(i)));
-      data_current_index = intersect(data_current_index, data_current_pop);
+      data_current_rows = data_current_rows % (data_pop_codes == loy_pop_codes(i));
     }
     
     //Rcout << "minorpatrolgroup 8" << endl;
     
     if (loy_patch_used) {
-      arma::uvec data_current_patch = as<arma::uvec>(LefkoUtils::index_l3(data_patch_, loypatch(i)));
-      data_current_index = intersect(data_current_index, data_current_patch);
+      data_current_rows = data_current_rows % (data_patch_codes == loy_patch_codes(i));
     }
+    arma::uvec data_current_index = find(data_current_rows);
     
     //Rcout << "minorpatrolgroup 9" << endl;
     
@@ -1470,12 +1544,25 @@ List subvertedpatrolgroup(const DataFrame& sge3, const arma::ivec& sge2index21,
   List conc_err (loy_length);
   List s2f_err (loy_length);
   
-  StringVector data_pop_;
-  StringVector data_patch_;
+  // Integer codes for populations, patches, and years used in data subsetting
+  arma::ivec data_pop_codes;
+  arma::ivec data_patch_codes;
+  arma::ivec loy_pop_codes;
+  arma::ivec loy_patch_codes;
   
-  if (loy_pop_used) data_pop_ = as<StringVector>(MainData[pop_var_int]);
-  if (loy_patch_used) data_patch_ = as<StringVector>(MainData[patch_var_int]);
+  if (loy_pop_used) {
+    StringVector data_pop_ = as<StringVector>(MainData[pop_var_int]);
+    data_pop_codes = LefkoUtils::stage_codes(data_pop_, loypop);
+    loy_pop_codes = LefkoUtils::stage_codes(loypop, loypop);
+  }
+  if (loy_patch_used) {
+    StringVector data_patch_ = as<StringVector>(MainData[patch_var_int]);
+    data_patch_codes = LefkoUtils::stage_codes(data_patch_, loypatch);
+    loy_patch_codes = LefkoUtils::stage_codes(loypatch, loypatch);
+  }
   StringVector data_year_ = as<StringVector>(MainData[year_var_int]);
+  arma::ivec data_year_codes = LefkoUtils::stage_codes(data_year_, loyyear2);
+  arma::ivec loy_year_codes = LefkoUtils::stage_codes(loyyear2, loyyear2);
   
   arma::uvec ovgiventind = find(sge3ovgivent != -1.);
   arma::uvec ovgivenfind = find(sge3ovgivenf != -1.);
@@ -1493,17 +1580,16 @@ List subvertedpatrolgroup(const DataFrame& sge3, const arma::ivec& sge2index21,
   int ovesfn = static_cast<int>(ovestfind.n_elem);
   
   for (int i = 0; i < loy_length; i++) {
-    arma::uvec data_current_index = as<arma::uvec>(LefkoUtils::index_l3(data_year_, loyyear2(i)));
+    arma::uvec data_current_rows = (data_year_codes == loy_year_codes(i));
     
     if (loy_pop_used) {
-      arma::uvec data_current_pop = as<arma::uvec>(LefkoUtils::index_l3(data_pop_, loypop(i)));
-      data_current_index = intersect(data_current_index, data_current_pop);
+      data_current_rows = data_current_rows % (data_pop_codes == loy_pop_codes(i));
     }
     
     if (loy_patch_used) {
-      arma::uvec data_current_patch = as<arma::uvec>(LefkoUtils::index_l3(data_patch_, loypatch(i)));
-      data_current_index = intersect(data_current_index, data_current_patch);
+      data_current_rows = data_current_rows % (data_patch_codes == loy_patch_codes(i));
     }
+    arma::uvec data_current_index = find(data_current_rows);
     
     int data_subset_rows = static_cast<int>(data_current_index.n_elem);
     if (data_subset_rows < 10 && !small_subset) {
@@ -7284,6 +7370,8 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
   arma::vec dyn_gamma;
   arma::uvec dyn_delay;
   arma::uvec dyn_type;
+  arma::uvec col_levels;
+  arma::uvec col_slot;
   int n_dyn_elems {0};
   int dens_list_length {0};
   
@@ -7304,6 +7392,7 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
       dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
       dyn_type = as<arma::uvec>(dens_input["type"]);
       n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+      LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
       
       for (int i = 0; i < static_cast<int>(dyn_style.n_elem); i++) {
         if (dyn_style(i) < 1 || dyn_style(i) > 6) pop_error("density inputs", "", "", 21);
@@ -7346,6 +7435,7 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
         dyn_delay = as<arma::uvec>(dens_thru_0["time_delay"]);
         dyn_type = as<arma::uvec>(dens_thru_0["type"]);
         n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+        LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
         
         for (int i = 0; i < static_cast<int>(dyn_style.n_elem); i++) {
           if (dyn_style(i) < 1 || dyn_style(i) > 6) pop_error("density inputs", "", "", 21);
@@ -7501,6 +7591,7 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
           dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
           dyn_type = as<arma::uvec>(dens_input["type"]);
           n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+          LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
         }
         
         if (eq_list_length > 1) {
@@ -7513,6 +7604,18 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
         
         bool additive_limit_enforced {false};
         
+        // Positive column totals found once per column, then kept current
+        arma::vec col_positive;
+        if (substoch == 2) {
+          col_positive.zeros(col_levels.n_elem);
+          for (int c = 0; c < static_cast<int>(col_levels.n_elem); c++) {
+            const double* col_mem = Umat.colptr(col_levels(c));
+            for (int r = 0; r < static_cast<int>(Umat.n_rows); r++) {
+              if (col_mem[r] > 0.0) col_positive(c) += col_mem[r];
+            }
+          }
+        }
+        
         for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
           time_delay = dyn_delay(j);
           if (time_delay > 0) time_delay = time_delay - 1;
@@ -7570,30 +7673,18 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
                 changing_element_U = 0.0;
               }
             } else if (substoch == 2 && dyn_type(j) == 1) {
-              arma::vec given_col = Umat.col(dyn_index_col(j));
-              arma::uvec gc_negs = find(given_col < 0.0);
-              arma::uvec gc_pos = find(given_col > 0.0);
-              
-              double barnyard_antics = sum(given_col(gc_pos)) - Umat(dyn_index321(j)) +
-                changing_element_U;
-              
-              if (barnyard_antics > 1.0 && changing_element_U > 0.0) {
-                double proposed_element_U = changing_element_U - barnyard_antics *
-                  (changing_element_U / barnyard_antics);
-                
-                if (proposed_element_U >= 0.0) {
-                  changing_element_U = proposed_element_U;
-                } else {
-                  changing_element_U = 0.0;
-                }
-              } else if (changing_element_U < 0.0) {
-                changing_element_U = 0.0;
-              }
+              changing_element_U = LefkoUtils::substoch_limit(changing_element_U,
+                Umat(dyn_index321(j)), col_positive(col_slot(j)));
             } else if (substoch > 0 && dyn_type(j) == 2) {
               if (changing_element_F < 0.0) {
                 changing_element_F = 0.0;
               }
             }
+            if (substoch == 2) {
+              double current_element = Umat(dyn_index321(j));
+              if (current_element > 0.0) col_positive(col_slot(j)) -= current_element;
+              if (changing_element_U > 0.0) col_positive(col_slot(j)) += changing_element_U;
+            }
             Umat(dyn_index321(j)) = changing_element_U;
             Fmat(dyn_index321(j)) = changing_element_F;
             
@@ -7807,6 +7898,7 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
           dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
           dyn_type = as<arma::uvec>(dens_input["type"]);
           n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+          LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
         }
         
         if (eq_list_length > 1) {
@@ -7819,6 +7911,18 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
         
         bool additive_limit_enforced {false};
         
+        // Positive column totals found once per column, then kept current
+        arma::vec col_positive;
+        if (substoch == 2) {
+          col_positive.zeros(col_levels.n_elem);
+          for (int c = 0; c < static_cast<int>(col_levels.n_elem); c++) {
+            for (arma::sp_mat::const_col_iterator it = Umat_sp.begin_col(col_levels(c));
+                it != Umat_sp.end_col(col_levels(c)); ++it) {
+              if ((*it) > 0.0) col_positive(c) += (*it);
+            }
+          }
+        }
+        
         for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
           time_delay = dyn_delay(j);
           if (time_delay > 0) time_delay = time_delay - 1;
@@ -7876,30 +7980,18 @@ void f_projection3_single(List& fin_out, int format, bool prebreeding = true,
               }
               
             } else if (substoch == 2 && dyn_type(j) == 1) {
-              arma::vec given_col = arma::vec(Umat_sp.col(dyn_index_col(j)));
-              arma::uvec gc_negs = find(given_col < 0.0);
-              arma::uvec gc_pos = find(given_col > 0.0);
-              
-              double barnyard_antics = sum(given_col(gc_pos)) - Umat_sp(dyn_index321(j)) +
-                changing_element_U;
-              
-              if (barnyard_antics > 1.0 && changing_element_U > 0.0) {
-                double proposed_element_U = changing_element_U - barnyard_antics *
-                  (changing_element_U / barnyard_antics);
-                
-                if (proposed_element_U >= 0.0) {
-                  changing_element_U = proposed_element_U;
-                } else {
-                  changing_element_U = 0.0;
-                }
-              } else if (changing_element_U < 0.0) {
-                changing_element_U = 0.0;
-              }
+              changing_element_U = LefkoUtils::substoch_limit(changing_element_U,
+                Umat_sp(dyn_index321(j)), col_positive(col_slot(j)));
             } else if (substoch > 0 && dyn_type(j) == 2) {
               if (changing_element_F < 0.0) {
                 changing_element_F = 0.0;
               }
             }
+            if (substoch == 2) {
+              double current_element = Umat_sp(dyn_index321(j));
+              if (current_element > 0.0) col_positive(col_slot(j)) -= current_element;
+              if (changing_element_U > 0.0) col_positive(col_slot(j)) += changing_element_U;
+            }
             Umat_sp(dyn_index321(j)) = changing_element_U;
             Fmat_sp(dyn_index321(j)) = changing_element_F;
             
@@ -15793,7 +15885,6 @@ arma::sp_mat sens3sp_matrix(const arma::sp_mat& Aspmat, const arma::sp_mat& refm
   realleftvec = realleftvec / rlvmin;
   
   arma::vec vwprod (rvel, fill::zeros);
-  arma::sp_mat smat (rvel, rvel);
   
   // Create scalar product vw
   for (int i = 0; i < rvel; i++) {
@@ -15801,15 +15892,21 @@ arma::sp_mat sens3sp_matrix(const arma::sp_mat& Aspmat, const arma::sp_mat& refm
   }
   double vwscalar = sum(vwprod);
   
-  // Populate sensitivity matrix
-  for (int i = 0; i < rvel; i++) {
-    for (int j = 0; j < rvel; j++) {
-      if (refmat(i, j) != 0.0) {
-        smat(i, j) = realleftvec(i) * realrightvec(j) / vwscalar;
-      }
-    }
+  // Populate sensitivity matrix on the non-zero pattern of the reference
+  int refmat_nonzero = static_cast<int>(refmat.n_nonzero);
+  arma::umat smat_locations (2, refmat_nonzero);
+  arma::vec smat_values (refmat_nonzero);
+  
+  int counter {0};
+  for (arma::sp_mat::const_iterator it = refmat.begin(); it != refmat.end(); ++it) {
+    smat_locations(0, counter) = it.row();
+    smat_locations(1, counter) = it.col();
+    smat_values(counter) = realleftvec(it.row()) * realrightvec(it.col()) / vwscalar;
+    counter++;
   }
   
+  arma::sp_mat smat (smat_locations, smat_values, rvel, rvel, false, true);
+  
   return smat;
 }
 
@@ -16085,6 +16182,69 @@ List sens3hlefko_sp(const arma::sp_mat& Amat, const DataFrame& ahstages,
   return output;
 }
 
+//' Core Deterministic Elasticity Analysis of a Dense Matrix
+//' 
+//' Function \code{elas3_core()} estimates the dominant eigenvalue and the
+//' elasticity matrix of a dense matrix via the \code{eig_gen}() function in
+//' the C++ Armadillo library. It uses only Armadillo objects, and so may be
+//' called within parallel regions.
+//' 
+//' @name elas3_core
+//' 
+//' @param Amat A population projection matrix of class \code{matrix}.
+//' @param lambda A double to hold the dominant eigenvalue.
+//' @param emat A matrix to hold the elasticities.
+//' 
+//' @return A logical value indicating whether the eigen analysis succeeded.
+//' Output values are modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool elas3_core(const arma::mat& Amat, double& lambda,
+  arma::mat& emat) {
+  
+  arma::cx_vec Aeigval;
+  arma::cx_mat Aeigvecl;
+  arma::cx_mat Aeigvecr;
+  
+  if (!eig_gen(Aeigval, Aeigvecl, Aeigvecr, Amat)) return false;
+  
+  arma::vec realeigenvals = real(Aeigval);
+  int lambda1 = realeigenvals.index_max();
+  lambda = max(realeigenvals);
+  
+  // w vector
+  arma::vec realrightvec = real(Aeigvecr.col(lambda1));
+  realrightvec.clean(0.00000000000001); // Lower threshold than used in w and v
+  
+  double rvsum = sum(realrightvec);
+  int rvel = static_cast<int>(realrightvec.n_elem);
+  realrightvec = realrightvec / rvsum;
+  
+  // v vector
+  arma::vec realleftvec = real(Aeigvecl.col(lambda1));
+  realleftvec.clean(0.00000000000001); // Lower threshold than used in w and v
+  
+  // Identify first non-zero element of rep value vector
+  arma::uvec rlvabsalt = find(realleftvec);
+  if (rlvabsalt.n_elem == 0) return false;
+  double rlvmin = realleftvec(static_cast<unsigned long long>(rlvabsalt(0)));
+  realleftvec = realleftvec / rlvmin;
+  
+  // Create scalar product vw
+  double vwscalar = arma::dot(realrightvec, realleftvec);
+  
+  // Populate elasticity matrix
+  emat.zeros(rvel, rvel);
+  for (int i = 0; i < rvel; i++) {
+    for (int j = 0; j < rvel; j++) {
+      emat(i, j) = (realleftvec(i) * realrightvec(j) * Amat(i, j)) / (vwscalar * lambda);
+    }
+  }
+  
+  return true;
+}
+
 //' Estimate Deterministic Elasticities of Any Population Matrix
 //' 
 //' \code{elas3matrix()} returns the elasticity of lambda with respect
@@ -16104,17 +16264,21 @@ List sens3hlefko_sp(const arma::sp_mat& Amat, const DataFrame& ahstages,
 //' @noRd
 // [[Rcpp::export(.elas3matrix)]]
 arma::mat elas3matrix(const arma::mat& Amat, bool sparse) {
-  List eigenstuff;
+  arma::mat emat;
+  double lambda {0.0};
   
-  if (sparse) {
-    eigenstuff = LefkoMats::decomp3sp(Amat);
-  } else {
-    eigenstuff = LefkoMats::decomp3(Amat);
+  if (!sparse) {
+    if (!elas3_core(Amat, lambda, emat)) {
+      throw Rcpp::exception("Eigen analysis failed.", false);
+    }
+    return emat;
   }
   
+  List eigenstuff = LefkoMats::decomp3sp(Amat);
+  
   arma::vec realeigenvals = real(as<arma::cx_vec>(eigenstuff["eigenvalues"]));
   int lambda1 = realeigenvals.index_max();
-  double lambda = max(realeigenvals);
+  lambda = max(realeigenvals);
 
   // w vector
   arma::vec realrightvec = real(as<arma::cx_mat>(eigenstuff["right_eigenvectors"]).col(lambda1));
@@ -16134,7 +16298,7 @@ arma::mat elas3matrix(const arma::mat& Amat, bool sparse) {
   realleftvec = realleftvec / rlvmin;
 
   arma::vec vwprod (rvel);
-  arma::mat emat (rvel, rvel, fill::zeros);
+  emat.zeros(rvel, rvel);
   
   // Create scalar product vw
   for (int i = 0; i < rvel; i++) {
@@ -16362,6 +16526,182 @@ List elas3sp_hlefko(const arma::sp_mat& Amat, const DataFrame& ahstages, const
   return output;
 }
 
+//' Shortest Cycle in a Matrix Order
+//' 
+//' Function \code{order_period()} finds the length of the shortest cycle that
+//' repeats through a sequence of matrix indices, so that the index at each
+//' occasion equals the index one cycle earlier. A single repeated matrix has a
+//' cycle length of \code{1}, and a sequence without any repeating cycle has a
+//' cycle length equal to its own length.
+//' 
+//' @name order_period
+//' 
+//' @param mat_order A vector giving the order of matrices to use at each
+//' occasion.
+//' 
+//' @return The cycle length.
+//' 
+//' @keywords internal
+//' @noRd
+inline int order_period(const arma::uvec& mat_order) {
+  int order_length = static_cast<int>(mat_order.n_elem);
+  if (order_length < 2) return 1;
+  
+  // Longest proper prefix that is also a suffix, as in Knuth-Morris-Pratt
+  std::vector<int> border (order_length, 0);
+  for (int i = 1; i < order_length; i++) {
+    int k = border[i - 1];
+    while (k > 0 && mat_order(i) != mat_order(k)) k = border[k - 1];
+    if (mat_order(i) == mat_order(k)) k++;
+    border[i] = k;
+  }
+  
+  return (order_length - border[order_length - 1]);
+}
+
+//' Fused Forward and Backward Projection Kernel
+//' 
+//' Function \code{proj3_fused()} runs the projection behind \code{proj3()} and
+//' \code{proj3sp()} on matrices that have already been read from R. The
+//' forward population vector, the \emph{w} and \emph{R} series, and the
+//' backward \emph{v} series are computed in a single pass, using two scratch
+//' vectors in each direction and writing directly into the output matrix.
+//' 
+//' @name proj3_fused
+//' 
+//' @param start_vec The starting population vector for the projection.
+//' @param dense_mats A vector of dense matrices, used if \code{dense = TRUE}.
+//' @param sparse_mats A vector of sparse matrix views, used if
+//' \code{dense = FALSE}.
+//' @param slot A vector giving the position in \code{dense_mats} or
+//' \code{sparse_mats} of each matrix in the original matrix list.
+//' @param mat_order A vector giving the order of matrices to use at each
+//' occasion, as indices in the original matrix list.
+//' @param dense A logical value indicating whether to use \code{dense_mats}.
+//' @param standardize A logical value stating whether to standardize population
+//' size vector to sum to 1 at each estimated occasion.
+//' @param growthonly A logical value stating whether to output only the
+//' forward projection.
+//' @param integeronly A logical value indicating whether to round all projected
+//' numbers of individuals to the nearest integer.
+//' @param conv_tol The convergence tolerance of the stage distribution, as in
+//' \code{proj3()}. Convergence is assessed between occasions one cycle of
+//' \code{mat_order} apart.
+//' @param calc_v A logical value indicating whether to run the backward
+//' projection. If \code{FALSE}, then the \emph{v} rows of the output are left
+//' as zeros.
+//' 
+//' @return A matrix structured as in \code{proj3()}.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::mat proj3_fused(const arma::vec& start_vec,
+  const std::vector<arma::mat>& dense_mats,
+  const std::vector<dgc_view>& sparse_mats, const std::vector<int>& slot,
+  const arma::uvec& mat_order, bool dense, bool standardize, bool growthonly,
+  bool integeronly, double conv_tol, bool calc_v) {
+  
+  int nostages = static_cast<int>(start_vec.n_elem);
+  int theclairvoyant = static_cast<int>(mat_order.n_elem);
+  bool backward = (!growthonly && calc_v);
+  
+  // Population, w, v, and R blocks are stacked in a single output matrix
+  int out_rows = (growthonly ? nostages : (3 * nostages + 1));
+  arma::mat output (out_rows, (theclairvoyant + 1), fill::zeros);
+  
+  arma::vec current_n = start_vec;
+  arma::vec next_n (nostages);
+  arma::rowvec current_v = start_vec.as_row();
+  arma::rowvec next_v (nostages);
+  double start_sum = accu(start_vec);
+  
+  // Convergence is only assessed on the forward projection, at the end of
+  // each full cycle of matrices
+  bool conv_check = (growthonly && conv_tol > 0.0);
+  int conv_step {0};
+  int conv_period = (conv_check ? order_period(mat_order) : 1);
+  if (2 * conv_period > theclairvoyant) conv_check = false;
+  arma::vec last_dist;
+  if (conv_check) last_dist = start_vec / start_sum;
+  
+  double* first_col = output.colptr(0);
+  for (int j = 0; j < nostages; j++) first_col[j] = start_vec(j);
+  if (!growthonly) {
+    for (int j = 0; j < nostages; j++) {
+      first_col[nostages + j] = start_vec(j) / start_sum;
+    }
+    first_col[3 * nostages] = start_sum;
+  }
+  if (backward) {
+    double* last_col = output.colptr(theclairvoyant);
+    for (int j = 0; j < nostages; j++) {
+      last_col[2 * nostages + j] = start_vec(j) / start_sum;
+    }
+  }
+  
+  for (int i = 0; i < theclairvoyant; i++) {
+    if (i % 50 == 0) Rcpp::checkUserInterrupt();
+    
+    int forward_slot = slot[mat_order(i)];
+    if (dense) {
+      next_n = dense_mats[forward_slot] * current_n;
+    } else {
+      sparse_mats[forward_slot].times_into(current_n, next_n);
+    }
+    if (integeronly) next_n = floor(next_n);
+    
+    double next_R = accu(next_n);
+    double* proj_col = output.colptr(i+1);
+    for (int j = 0; j < nostages; j++) proj_col[j] = next_n(j);
+    if (!growthonly) proj_col[3 * nostages] = next_R;
+    
+    if (next_R <= 0.0) break;
+    
+    if (conv_check && ((i + 1) % conv_period == 0)) {
+      double max_change {0.0};
+      for (int j = 0; j < nostages; j++) {
+        double current_dist = next_n(j) / next_R;
+        max_change = std::max(max_change, std::abs(current_dist - last_dist(j)));
+        last_dist(j) = current_dist;
+      }
+      
+      if (max_change < conv_tol) {
+        conv_step = i + 1;
+        break;
+      }
+    }
+    
+    if (!growthonly) {
+      for (int j = 0; j < nostages; j++) {
+        proj_col[nostages + j] = next_n(j) / next_R;
+      }
+    }
+    
+    if (standardize) next_n /= next_R;
+    current_n.swap(next_n);
+    
+    if (backward) {
+      int backward_slot = slot[mat_order(theclairvoyant - (i+1))];
+      if (dense) {
+        next_v = current_v * dense_mats[backward_slot];
+      } else {
+        sparse_mats[backward_slot].trans_times_into(current_v, next_v);
+      }
+      
+      double next_vsum = accu(next_v);
+      next_v /= next_vsum;
+      
+      double* v_col = output.colptr(theclairvoyant - (i+1));
+      for (int j = 0; j < nostages; j++) v_col[2 * nostages + j] = next_v(j);
+      current_v.swap(next_v);
+    }
+  }
+  
+  if (conv_step > 0) return output.cols(0, conv_step);
+  
+  return output;
+}
+
 //' Core Time-based Population Matrix Projection Function
 //' 
 //' Function \code{proj3()} runs the matrix projections used in other functions
@@ -16386,6 +16726,16 @@ List elas3sp_hlefko(const arma::sp_mat& Amat, const DataFrame& ahstages, const
 //' to use sparse matrix encoding automatically.
 //' @param sparse A logical value indicating whether to use sparse matrix
 //' encoding if \code{sparse_auto = FALSE}.
+//' @param conv_tol If positive and \code{growthonly = TRUE}, the projection
+//' stops once no element of the stage distribution changes by more than this
+//' amount between consecutive cycles of \code{mat_order}, which are single
+//' occasions if only one matrix is used. Defaults to \code{0}, in which case
+//' all occasions are projected.
+//' @param calc_v A logical value indicating whether to estimate the \emph{v}
+//' projection if \code{growthonly = FALSE}. If \code{FALSE}, then the rows
+//' corresponding to \emph{v} are returned as zeros, saving the backward
+//' projection when reproductive values are not needed. Defaults to
+//' \code{TRUE}.
 //' 
 //' @return A matrix in which, if \code{growthonly = TRUE}, each row is the
 //' population vector at each projected occasion, and if \code{growthonly =
@@ -16395,36 +16745,25 @@ List elas3sp_hlefko(const arma::sp_mat& Amat, const DataFrame& ahstages, const
 //' values) for use in estimation of stochastic sensitivities and elasticities
 //' (in addition, a further row is appended to the bottom, corresponding to the
 //' \emph{R} vector, which is the sum of the unstandardized \emph{w} vector
-//' resulting from each occasion's projection).
+//' resulting from each occasion's projection). If the projection converges
+//' under \code{conv_tol}, then the matrix is truncated after the occasion of
+//' convergence, which equals the number of columns minus one.
 //' 
 //' @keywords internal
 //' @noRd
 // [[Rcpp::export(.proj3)]]
 arma::mat proj3(const arma::vec& start_vec, const List& core_list,
   const arma::uvec& mat_order, bool standardize, bool growthonly,
-  bool integeronly, bool sparse_auto, bool sparse) {
+  bool integeronly, bool sparse_auto, bool sparse, double conv_tol = 0.0,
+  bool calc_v = true) {
   
   int sparse_switch {0};
-  int nostages = static_cast<int>(start_vec.n_elem);
-  int theclairvoyant = static_cast<int>(mat_order.n_elem);
-  arma::vec theseventhson;
-  arma::rowvec theseventhgrandson;
-  arma::mat theprophecy;
-  arma::mat thesecondprophecy;
-  
-  arma::mat popproj(nostages, (theclairvoyant + 1), fill::zeros); // Population vector
-  arma::mat wpopproj(nostages, (theclairvoyant + 1), fill::zeros); // Population w vector
-  arma::mat vpopproj(nostages, (theclairvoyant + 1), fill::zeros); // Population v vector
-  arma::mat Rvecmat(1, (theclairvoyant+1), fill::zeros);
-  
-  theseventhson = start_vec;
-  theseventhgrandson = start_vec.as_row();
-  arma::mat finaloutput;
   
   // Check if matrix is large and sparse
   if (sparse_auto) {
-    int test_elems = static_cast<int>(as<arma::mat>(core_list(0)).n_elem);
-    arma::uvec nonzero_elems = find(as<arma::mat>(core_list(0)));
+    arma::mat test_mat = as<arma::mat>(core_list(0));
+    int test_elems = static_cast<int>(test_mat.n_elem);
+    arma::uvec nonzero_elems = find(test_mat);
     int all_nonzeros = static_cast<int>(nonzero_elems.n_elem);
     double sparse_check = static_cast<double>(all_nonzeros) /
       static_cast<double>(test_elems);
@@ -16433,101 +16772,27 @@ arma::mat proj3(const arma::vec& start_vec, const List& core_list,
     } else sparse_switch = 0;
   } else sparse_switch = sparse;
   
-  // Now the projection
-  popproj.col(0) = start_vec;
-  if (!growthonly) {
-    wpopproj.col(0) = start_vec / sum(start_vec);
-    vpopproj.col(theclairvoyant) = start_vec / sum(start_vec);
-    Rvecmat(0) = sum(start_vec);
-  }
+  // Matrices used in the projection are read once
+  int matlist_length = static_cast<int>(core_list.size());
+  arma::uvec used_mats = unique(mat_order);
+  std::vector<int> slot (matlist_length, -1);
+  std::vector<arma::mat> dense_mats;
+  std::vector<dgc_view> sparse_mats;
   
-  if (sparse_switch == 0) {
-    // Dense matrix projection
-    for (int i = 0; i < theclairvoyant; i++) {
-      if (i % 50 == 0) Rcpp::checkUserInterrupt();
-      
-      theprophecy = as<arma::mat>(core_list[(mat_order(i))]);
-      
-      theseventhson = theprophecy * theseventhson;
-      if (integeronly) {
-        theseventhson = floor(theseventhson);
-      }
-      popproj.col(i+1) = theseventhson;
-      Rvecmat(i+1) = sum(theseventhson);
-      
-      if (Rvecmat(i+1) <= 0.0) break;
-      
-      if (standardize) {
-        theseventhson = theseventhson / sum(theseventhson);
-      }
-      
-      if (!growthonly) {
-        wpopproj.col(i+1) = popproj.col(i+1) / Rvecmat(i+1);
-        thesecondprophecy = as<arma::mat>(core_list[(mat_order(theclairvoyant - (i+1)))]);
-        theseventhgrandson = theseventhgrandson * thesecondprophecy;
-        
-        double seventhgrandsum = sum(theseventhgrandson);
-        arma::vec midwife = theseventhgrandson.as_col() / seventhgrandsum;
-        theseventhgrandson = theseventhgrandson / seventhgrandsum;
-        vpopproj.col(theclairvoyant - (i+1)) = midwife;
-      }
-    }
-    
-  } else {
-    // Sparse matrix projection
-    arma::sp_mat sparse_seventhson = arma::sp_mat(theseventhson);
+  for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+    int current_mat = static_cast<int>(used_mats(m));
+    slot[current_mat] = m;
     
-    int matlist_length = static_cast<int>(core_list.size());
-    arma::mat first_mat;
-    arma::sp_mat new_sparse;
-    Rcpp::List sparse_list (matlist_length);
-    
-    for (int i = 0; i < matlist_length; i++) {
-      first_mat = as<arma::mat>(core_list(i));
-      new_sparse = arma::sp_mat(first_mat);
-      sparse_list(i) = new_sparse;
-    }
-    arma::sp_mat sparse_prophecy;
-    arma::sp_mat sparse_secondprophecy;
-    
-    for (int i = 0; i < theclairvoyant; i++) {
-      if (i % 50 == 0) Rcpp::checkUserInterrupt();
-      
-      sparse_prophecy = as<arma::sp_mat>(sparse_list[(mat_order(i))]);
-      sparse_seventhson = sparse_prophecy * sparse_seventhson;
-      if (integeronly) {
-        sparse_seventhson = floor(sparse_seventhson);
-      }
-      popproj.col(i+1) = arma::vec(arma::mat(sparse_seventhson));
-      Rvecmat(i+1) = sum(popproj.col(i+1));
-      
-      if (Rvecmat(i+1) <= 0.0) break;
-      
-      if (standardize) {
-        sparse_seventhson = sparse_seventhson / sum(popproj.col(i+1));
-      }
-      
-      if (!growthonly) {
-        wpopproj.col(i+1) = popproj.col(i+1) / Rvecmat(i+1);
-        sparse_secondprophecy = as<arma::sp_mat>(sparse_list[(mat_order(theclairvoyant - (i+1)))]);
-        theseventhgrandson = theseventhgrandson * sparse_secondprophecy;
-        
-        double seventhgrandsum = sum(theseventhgrandson);
-        arma::vec midwife = theseventhgrandson.as_col() / seventhgrandsum;
-        theseventhgrandson = theseventhgrandson / seventhgrandsum;
-        vpopproj.col(theclairvoyant - (i+1)) = midwife;
-      }
+    if (sparse_switch == 0) {
+      dense_mats.push_back(as<arma::mat>(core_list[current_mat]));
+    } else {
+      sparse_mats.emplace_back(core_list, current_mat);
     }
   }
   
-  if (growthonly) {
-    return popproj;
-  } else {
-    arma::mat revised_vproj = join_cols(vpopproj, Rvecmat);
-    arma::mat expanded_proj = join_cols(wpopproj, revised_vproj);
-    
-    return join_cols(popproj, expanded_proj);
-  }
+  return proj3_fused(start_vec, dense_mats, sparse_mats, slot, mat_order,
+    (sparse_switch == 0), standardize, growthonly, integeronly, conv_tol,
+    calc_v);
 }
 
 //' Slimmed-down Time-based Population Sparse Matrix Projection Function
@@ -16552,6 +16817,12 @@ arma::mat proj3(const arma::vec& start_vec, const List& core_list,
 //' stage distribution estimation, and reproductive value estimation.
 //' @param integeronly A logical value indicating whether to round all projected
 //' numbers of individuals to the nearest integer.
+//' @param conv_tol If positive and \code{growthonly = TRUE}, the projection
+//' stops once no element of the stage distribution changes by more than this
+//' amount between consecutive cycles of \code{mat_order}. Defaults to
+//' \code{0}.
+//' @param calc_v A logical value indicating whether to estimate the \emph{v}
+//' projection if \code{growthonly = FALSE}. Defaults to \code{TRUE}.
 //' 
 //' @return A matrix in which, if \code{growthonly = TRUE}, each row is the
 //' population vector at each projected occasion, and if \code{growthonly =
@@ -16561,80 +16832,483 @@ arma::mat proj3(const arma::vec& start_vec, const List& core_list,
 //' values) for use in estimation of stochastic sensitivities and elasticities
 //' (in addition, a further row is appended to the bottom, corresponding to the
 //' \emph{R} vector, which is the sum of the unstandardized \emph{w} vector
-//' resulting from each occasion's projection).
+//' resulting from each occasion's projection). As in \code{proj3()}, the
+//' matrix is truncated after the occasion of convergence under
+//' \code{conv_tol}.
 //' 
 //' @keywords internal
 //' @noRd
 // [[Rcpp::export(.proj3sp)]]
 arma::mat proj3sp(const arma::vec& start_vec, const List& core_list,
   const arma::uvec& mat_order, bool standardize, bool growthonly,
-  bool integeronly) {
-  
-  int nostages = static_cast<int>(start_vec.n_elem);
-  int theclairvoyant = static_cast<int>(mat_order.n_elem);
-  arma::vec theseventhson;
-  arma::rowvec theseventhgrandson;
-  arma::mat theprophecy;
-  arma::mat thesecondprophecy;
-  
-  arma::mat popproj(nostages, (theclairvoyant + 1), fill::zeros); // Population vector
-  arma::mat wpopproj(nostages, (theclairvoyant + 1), fill::zeros); // Population w vector
-  arma::mat vpopproj(nostages, (theclairvoyant + 1), fill::zeros); // Population v vector
-  arma::mat Rvecmat(1, (theclairvoyant+1), fill::zeros);
+  bool integeronly, double conv_tol = 0.0, bool calc_v = true) {
+  
+  // Sparse matrices are viewed in place, reading dgCMatrix slots directly
+  int matlist_length = static_cast<int>(core_list.size());
+  arma::uvec used_mats = unique(mat_order);
+  std::vector<int> slot (matlist_length, -1);
+  std::vector<arma::mat> dense_mats;
+  std::vector<dgc_view> sparse_mats;
+  
+  for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+    int current_mat = static_cast<int>(used_mats(m));
+    slot[current_mat] = m;
+    sparse_mats.emplace_back(core_list, current_mat);
+  }
   
-  theseventhson = start_vec;
-  theseventhgrandson = start_vec.as_row();
-  arma::sp_mat sparse_seventhson = arma::sp_mat(theseventhson);
-  arma::mat finaloutput;
+  return proj3_fused(start_vec, dense_mats, sparse_mats, slot, mat_order,
+    false, standardize, growthonly, integeronly, conv_tol, calc_v);
+}
+
+//' Extend Converged Deterministic Projection
+//' 
+//' Function \code{conv_extend()} fills in the occasions left unprojected when
+//' \code{proj3()} or \code{proj3sp()} stops at convergence, by repeating the
+//' last projected cycle of population vectors scaled by the population growth
+//' rate across that cycle. With a single repeated matrix, the cycle is one
+//' occasion long.
+//' 
+//' @name conv_extend
+//' 
+//' @param projection A projection matrix produced with \code{growthonly = TRUE}
+//' and a positive \code{conv_tol}. Resized in place to \code{times + 1}
+//' columns.
+//' @param times The number of occasions requested in the projection.
+//' @param standardize A logical value indicating whether the population vector
+//' was standardized at each occasion of the projection.
+//' @param mat_order The order of matrices used in the projection.
+//' 
+//' @return The occasion at which the projection converged, or \code{NA} if
+//' the projection ran through all occasions.
+//' 
+//' @keywords internal
+//' @noRd
+inline int conv_extend(arma::mat& projection, int times, bool standardize,
+  const arma::uvec& mat_order) {
+  
+  int conv_step = static_cast<int>(projection.n_cols) - 1;
+  if (conv_step >= times) return NA_INTEGER;
+  
+  // Convergence only occurs at the end of a full cycle
+  int conv_period = order_period(mat_order);
+  double growth {1.0};
+  if (!standardize) {
+    growth = sum(projection.col(conv_step)) /
+      sum(projection.col(conv_step - conv_period));
+  }
   
-  // Now the projection
-  popproj.col(0) = start_vec;
-  if (!growthonly) {
-    wpopproj.col(0) = start_vec / sum(start_vec);
-    vpopproj.col(theclairvoyant) = start_vec / sum(start_vec);
-    Rvecmat(0) = sum(start_vec);
+  projection.resize(projection.n_rows, (times + 1));
+  for (int j = (conv_step + 1); j <= times; j++) {
+    projection.col(j) = projection.col(j - conv_period) * growth;
   }
   
-  // Sparse matrix projection
-  arma::sp_mat sparse_prophecy;
-  arma::sp_mat sparse_secondprophecy;
+  return conv_step;
+}
+
+//' Group Density Dependent Elements by Delay and Function Type
+//' 
+//' Function \code{dens_groups()} sorts the elements named in a
+//' \code{lefkoDens} object into groups sharing the same density function, and
+//' finds the distinct time delays used, so that the population size at each
+//' delay need only be estimated once per occasion.
+//' 
+//' @name dens_groups
+//' 
+//' @param dyn_lag Vector to hold the number of occasions back from the current
+//' occasion at which population size is assessed for each element.
+//' @param lag_levels Vector to hold the distinct values of \code{dyn_lag}.
+//' @param lag_slot Vector to hold the position of each element's lag within
+//' \code{lag_levels}.
+//' @param style_groups A vector of six index vectors, to hold the elements
+//' using the Ricker, Beverton-Holt, Usher, logistic, additive limit, and
+//' fixed limit functions, respectively.
+//' @param dyn_pass Vector to hold the adjustment pass of each element, equal
+//' to the number of earlier entries of the same matrix element. Left empty if
+//' no matrix element is entered more than once.
+//' @param dyn_style The density function code of each element.
+//' @param dyn_delay The time delay of each element, as given in the
+//' \code{lefkoDens} object.
+//' @param dyn_index321 The linear index of each element within the matrix.
+//' 
+//' @return All arguments except \code{dyn_style}, \code{dyn_delay}, and
+//' \code{dyn_index321} are modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void dens_groups(arma::uvec& dyn_lag, arma::uvec& lag_levels,
+  arma::uvec& lag_slot, std::vector<arma::uvec>& style_groups,
+  arma::uvec& dyn_pass, const arma::uvec& dyn_style,
+  const arma::uvec& dyn_delay, const arma::uvec& dyn_index321) {
+  
+  int n_dyn_elems = static_cast<int>(dyn_style.n_elem);
+  
+  // Repeated matrix elements are adjusted again in later passes
+  dyn_pass.reset();
+  arma::uvec entry_order = stable_sort_index(dyn_index321);
+  for (int k = 1; k < n_dyn_elems; k++) {
+    if (dyn_index321(entry_order(k)) != dyn_index321(entry_order(k - 1))) continue;
     
-  for (int i = 0; i < theclairvoyant; i++) {
-    if (i % 50 == 0) Rcpp::checkUserInterrupt();
+    if (dyn_pass.n_elem == 0) dyn_pass.zeros(n_dyn_elems);
+    dyn_pass(entry_order(k)) = dyn_pass(entry_order(k - 1)) + 1;
+  }
+  
+  dyn_lag = dyn_delay;
+  for (int j = 0; j < n_dyn_elems; j++) {
+    if (dyn_lag(j) > 0) dyn_lag(j) = dyn_lag(j) - 1;
+  }
+  
+  lag_levels = unique(dyn_lag);
+  lag_slot.set_size(n_dyn_elems);
+  for (int j = 0; j < n_dyn_elems; j++) {
+    lag_slot(j) = as_scalar(find(lag_levels == dyn_lag(j), 1));
+  }
+  
+  style_groups.assign(6, arma::uvec());
+  for (int s = 0; s < 6; s++) {
+    style_groups[s] = find(dyn_style == static_cast<arma::uword>(s + 1));
+  }
+}
+
+//' Density-Adjusted Values of Matrix Elements
+//' 
+//' Function \code{dens_values()} applies density dependence to the matrix
+//' elements named in a \code{lefkoDens} object for a single occasion. The
+//' weighted population size is estimated once for each distinct time delay,
+//' and each density function is then applied to all elements using it at
+//' once.
+//' 
+//' @name dens_values
+//' 
+//' @param elem_values On input, the current values of all density dependent
+//' elements in the matrix for this occasion. On output, the density-adjusted
+//' values of elements in \code{active}.
+//' @param active Vector to hold the indices of elements for which enough
+//' occasions have passed to apply the time delay, in their original order.
+//' @param pop_size The weighted population size used for the last element in
+//' \code{active}. Left unchanged if no element is active.
+//' @param popproj The matrix of projected population vectors.
+//' @param step The current occasion.
+//' @param equivalence_vec The vector of stage weights.
+//' @param eq_vec_length The length of \code{equivalence_vec}. Weights are only
+//' applied if this is greater than 1.
+//' @param dyn_lag The lag of each element, from \code{dens_groups()}.
+//' @param lag_levels The distinct lags, from \code{dens_groups()}.
+//' @param lag_slot The position of each element's lag in \code{lag_levels}.
+//' @param style_groups The elements using each density function, from
+//' \code{dens_groups()}.
+//' @param dyn_pass The adjustment pass of each element, from
+//' \code{dens_groups()}.
+//' @param pass The pass to apply. If \code{dyn_pass} is not empty, then only
+//' elements in this pass are adjusted and listed in \code{active}.
+//' @param dyn_alpha The alpha parameter of each element.
+//' @param dyn_beta The beta parameter of each element.
+//' @param dyn_type The type of each element, with \code{1} for survival-
+//' transition and \code{2} for fecundity.
+//' @param substoch The substochasticity option. Limits set by option \code{1},
+//' and the non-negativity of fecundity set by options \code{1} and \code{2},
+//' are enforced here, while the column limit of option \code{2} is left to the
+//' calling function.
+//' 
+//' @return A logical value indicating whether any active element uses the
+//' additive or fixed limit functions, which are enforced on the projected
+//' vector rather than on the matrix.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool dens_values(arma::vec& elem_values, arma::uvec& active,
+  double& pop_size, const arma::mat& popproj, int step,
+  const arma::vec& equivalence_vec, int eq_vec_length, const arma::uvec& dyn_lag,
+  const arma::uvec& lag_levels, const arma::uvec& lag_slot,
+  const std::vector<arma::uvec>& style_groups, const arma::uvec& dyn_pass,
+  int pass, const arma::vec& dyn_alpha, const arma::vec& dyn_beta,
+  const arma::uvec& dyn_type, int substoch) {
+  
+  int n_dyn_elems = static_cast<int>(elem_values.n_elem);
+  if (n_dyn_elems == 0) return false;
+  
+  arma::uword current_step = static_cast<arma::uword>(step);
+  bool all_active = (lag_levels.n_elem == 0 || lag_levels.max() <= current_step);
+  bool all_passes = (dyn_pass.n_elem == 0);
+  arma::uword current_pass = static_cast<arma::uword>(pass);
+  
+  if (all_active) {
+    active = regspace<arma::uvec>(0, (n_dyn_elems - 1));
+  } else {
+    active = find(dyn_lag <= current_step);
+  }
+  if (!all_passes) active = active.elem(find(dyn_pass.elem(active) == current_pass));
+  if (active.n_elem == 0) return false;
+  
+  // Weighted population size estimated once per distinct delay
+  int lag_count = static_cast<int>(lag_levels.n_elem);
+  arma::vec lag_sizes (lag_count, fill::zeros);
+  for (int d = 0; d < lag_count; d++) {
+    if (lag_levels(d) > current_step) continue;
     
-    sparse_prophecy = as<arma::sp_mat>(core_list[(mat_order(i))]);
-    sparse_seventhson = sparse_prophecy * sparse_seventhson;
-    if (integeronly) {
-      sparse_seventhson = floor(sparse_seventhson);
+    if (eq_vec_length > 1) {
+      lag_sizes(d) = dot(popproj.col(current_step - lag_levels(d)), equivalence_vec);
+    } else {
+      lag_sizes(d) = accu(popproj.col(current_step - lag_levels(d)));
     }
-    popproj.col(i+1) = arma::vec(arma::mat(sparse_seventhson));
-    Rvecmat(i+1) = sum(popproj.col(i+1));
-    
-    if (Rvecmat(i+1) <= 0.0) break;
+  }
+  pop_size = lag_sizes(lag_slot(active(active.n_elem - 1)));
+  
+  bool additive_limit_enforced {false};
+  
+  for (int s = 0; s < 6; s++) {
+    arma::uvec group = style_groups[s];
+    if (!all_active) group = group.elem(find(dyn_lag.elem(group) <= current_step));
+    if (!all_passes) group = group.elem(find(dyn_pass.elem(group) == current_pass));
+    if (group.n_elem == 0) continue;
     
-    if (standardize) {
-      sparse_seventhson = sparse_seventhson / sum(popproj.col(i+1));
+    if (s > 3) {
+      // Additive and fixed limit functions leave matrix elements unchanged
+      additive_limit_enforced = true;
+      continue;
     }
     
-    if (!growthonly) {
-      wpopproj.col(i+1) = popproj.col(i+1) / Rvecmat(i+1);
-      sparse_secondprophecy = as<arma::sp_mat>(core_list[(mat_order(theclairvoyant - (i+1)))]);
-      theseventhgrandson = theseventhgrandson * sparse_secondprophecy;
+    arma::vec group_values = elem_values.elem(group);
+    arma::vec group_n = lag_sizes.elem(lag_slot.elem(group));
+    arma::vec group_alpha = dyn_alpha.elem(group);
+    arma::vec group_beta = dyn_beta.elem(group);
+    
+    if (s == 0) { // Ricker: Fi*ALPHA*exp(-BETA*n)
+      group_values = group_values % group_alpha % exp(-group_beta % group_n);
+      
+    } else if (s == 1) { // Beverton-Holt: Fi*ALPHA/(1+BETA*n)
+      group_values = group_values % group_alpha / (1.0 + group_beta % group_n);
       
-      double seventhgrandsum = sum(theseventhgrandson);
-      arma::vec midwife = theseventhgrandson.as_col() / seventhgrandsum;
-      theseventhgrandson = theseventhgrandson / seventhgrandsum;
-      vpopproj.col(theclairvoyant - (i+1)) = midwife;
+    } else if (s == 2) { // Usher: Fi*(1 / (1 + exp(alpha*N+b)))
+      group_values = group_values / (1.0 + exp(group_alpha % group_n + group_beta));
+      
+    } else { // Logistic: Fi*(1 - n/ALPHA)
+      arma::uvec capped = find(group_beta > 0.0 && group_n > group_alpha);
+      group_n.elem(capped) = group_alpha.elem(capped);
+      group_values = group_values % (1.0 - group_n / group_alpha);
     }
+    
+    elem_values.elem(group) = group_values;
   }
   
-  if (growthonly) {
-    return popproj;
-  } else {
-    arma::mat revised_vproj = join_cols(vpopproj, Rvecmat);
-    arma::mat expanded_proj = join_cols(wpopproj, revised_vproj);
+  if (substoch > 0) {
+    arma::vec active_values = elem_values.elem(active);
+    arma::uvec active_types = dyn_type.elem(active);
     
-    return join_cols(popproj, expanded_proj);
+    if (substoch == 1) {
+      arma::uvec surv_elems = find(active_types == 1);
+      active_values.elem(surv_elems) = clamp(active_values.elem(surv_elems), 0.0, 1.0);
+    }
+    arma::uvec fec_elems = find(active_types == 2);
+    active_values.elem(fec_elems) = clamp(active_values.elem(fec_elems), 0.0,
+      arma::datum::inf);
+    
+    elem_values.elem(active) = active_values;
+  }
+  
+  return additive_limit_enforced;
+}
+
+//' Write Density-Adjusted Values Into a Dense Matrix
+//' 
+//' Function \code{dens_write()} writes the density-adjusted values of active
+//' elements into a dense matrix. If \code{substoch = 2}, then the column limit
+//' is enforced element by element in input order, using running totals of the
+//' positive elements of each affected column.
+//' 
+//' @name dens_write
+//' 
+//' @param theprophecy The matrix to modify.
+//' @param elem_values The density-adjusted values of all density dependent
+//' elements, as given by \code{dens_values()}.
+//' @param active The indices of active elements, from \code{dens_values()}.
+//' @param dyn_index321 The linear index of each element within the matrix.
+//' @param dyn_type The type of each element, with \code{1} for survival-
+//' transition and \code{2} for fecundity.
+//' @param col_levels The distinct columns holding density dependent elements.
+//' @param col_slot The position of each element's column in
+//' \code{col_levels}.
+//' @param substoch The substochasticity option.
+//' 
+//' @return Matrix \code{theprophecy} is modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void dens_write(arma::mat& theprophecy, const arma::vec& elem_values,
+  const arma::uvec& active, const arma::uvec& dyn_index321,
+  const arma::uvec& dyn_type, const arma::uvec& col_levels,
+  const arma::uvec& col_slot, int substoch) {
+  
+  if (substoch != 2) {
+    theprophecy.elem(dyn_index321.elem(active)) = elem_values.elem(active);
+    return;
+  }
+  
+  // Positive column totals found once per column, then kept current
+  int col_count = static_cast<int>(col_levels.n_elem);
+  int mat_rows = static_cast<int>(theprophecy.n_rows);
+  arma::vec col_positive (col_count, fill::zeros);
+  for (int c = 0; c < col_count; c++) {
+    const double* col_mem = theprophecy.colptr(col_levels(c));
+    for (int r = 0; r < mat_rows; r++) {
+      if (col_mem[r] > 0.0) col_positive(c) += col_mem[r];
+    }
+  }
+  
+  for (int k = 0; k < static_cast<int>(active.n_elem); k++) {
+    int j = static_cast<int>(active(k));
+    double current_element = theprophecy(dyn_index321(j));
+    double changing_element = elem_values(j);
+    
+    if (dyn_type(j) == 1) {
+      changing_element = LefkoUtils::substoch_limit(changing_element,
+        current_element, col_positive(col_slot(j)));
+    }
+    theprophecy(dyn_index321(j)) = changing_element;
+    
+    if (current_element > 0.0) col_positive(col_slot(j)) -= current_element;
+    if (changing_element > 0.0) col_positive(col_slot(j)) += changing_element;
+  }
+}
+
+//' Apply Density Dependence to a Dense Matrix
+//' 
+//' Function \code{dens_apply()} adjusts the density dependent elements of a
+//' dense matrix for a single occasion. Matrix elements entered once in the
+//' \code{lefkoDens} object are adjusted together in a single pass. Each
+//' further entry of a repeated element is handled in a further pass, which
+//' reads the values written by the pass before it, so that adjustments to the
+//' same element compound in order of entry.
+//' 
+//' @name dens_apply
+//' 
+//' @param theprophecy The matrix to modify.
+//' @param active Vector to hold the indices of all adjusted elements, in
+//' ascending order.
+//' @param pop_size The weighted population size used for the last element in
+//' \code{active}. Left unchanged if no element is active.
+//' @param popproj The matrix of projected population vectors.
+//' @param step The current occasion.
+//' @param equivalence_vec The vector of stage weights.
+//' @param eq_vec_length The length of \code{equivalence_vec}.
+//' @param dyn_index321 The linear index of each element within the matrix.
+//' @param dyn_lag The lag of each element, from \code{dens_groups()}.
+//' @param lag_levels The distinct lags, from \code{dens_groups()}.
+//' @param lag_slot The position of each element's lag in \code{lag_levels}.
+//' @param style_groups The elements using each density function, from
+//' \code{dens_groups()}.
+//' @param dyn_pass The adjustment pass of each element, from
+//' \code{dens_groups()}.
+//' @param dyn_alpha The alpha parameter of each element.
+//' @param dyn_beta The beta parameter of each element.
+//' @param dyn_type The type of each element.
+//' @param col_levels The distinct columns holding density dependent elements.
+//' @param col_slot The position of each element's column in
+//' \code{col_levels}.
+//' @param substoch The substochasticity option.
+//' 
+//' @return A logical value indicating whether any active element uses the
+//' additive or fixed limit functions. Matrix \code{theprophecy} is modified
+//' in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool dens_apply(arma::mat& theprophecy, arma::uvec& active,
+  double& pop_size, const arma::mat& popproj, int step,
+  const arma::vec& equivalence_vec, int eq_vec_length,
+  const arma::uvec& dyn_index321, const arma::uvec& dyn_lag,
+  const arma::uvec& lag_levels, const arma::uvec& lag_slot,
+  const std::vector<arma::uvec>& style_groups, const arma::uvec& dyn_pass,
+  const arma::vec& dyn_alpha, const arma::vec& dyn_beta,
+  const arma::uvec& dyn_type, const arma::uvec& col_levels,
+  const arma::uvec& col_slot, int substoch) {
+  
+  int pass_count = (dyn_pass.n_elem == 0) ? 1 : static_cast<int>(dyn_pass.max()) + 1;
+  bool additive_limit_enforced {false};
+  
+  active.reset();
+  arma::uvec pass_active;
+  
+  for (int p = 0; p < pass_count; p++) {
+    arma::vec elem_values = theprophecy.elem(dyn_index321);
+    double pass_size {pop_size};
+    
+    if (dens_values(elem_values, pass_active, pass_size, popproj, step,
+        equivalence_vec, eq_vec_length, dyn_lag, lag_levels, lag_slot,
+        style_groups, dyn_pass, p, dyn_alpha, dyn_beta, dyn_type, substoch)) {
+      additive_limit_enforced = true;
+    }
+    if (pass_active.n_elem == 0) continue;
+    
+    dens_write(theprophecy, elem_values, pass_active, dyn_index321, dyn_type,
+      col_levels, col_slot, substoch);
+    
+    // Population size follows the last element in order of entry
+    if (active.n_elem == 0 || pass_active.max() > active.max()) {
+      pop_size = pass_size;
+    }
+    active = join_cols(active, pass_active);
+  }
+  if (pass_count > 1) active = sort(active);
+  
+  return additive_limit_enforced;
+}
+
+//' Enforce Additive and Fixed Limits on a Projected Vector
+//' 
+//' Function \code{dens_limits()} applies the additive limit and fixed limit
+//' density functions, which act on the numbers of individuals in a stage
+//' after projection rather than on matrix elements.
+//' 
+//' @name dens_limits
+//' 
+//' @param theseventhson The projected population vector, modified in place.
+//' @param pop_size The weighted population size used in density adjustment.
+//' @param dyn_style The density function code of each element.
+//' @param dyn_alpha The alpha parameter of each element.
+//' @param dyn_beta The beta parameter of each element.
+//' @param dyn_gamma The gamma parameter of each element.
+//' @param dyn_index_s3 The stage in time \emph{t}+1 of each element.
+//' 
+//' @return Vector \code{theseventhson} is modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void dens_limits(arma::vec& theseventhson, double pop_size,
+  const arma::uvec& dyn_style, const arma::vec& dyn_alpha,
+  const arma::vec& dyn_beta, const arma::vec& dyn_gamma,
+  const arma::uvec& dyn_index_s3) {
+  
+  int n_dyn_elems = static_cast<int>(dyn_style.n_elem);
+  
+  for (int j = 0; j < n_dyn_elems; j++) {
+    double current_alpha = dyn_alpha(j);
+    double current_beta = dyn_beta(j);
+    double current_gamma = dyn_gamma(j);
+    double Nsum = accu(theseventhson);
+    double K_limit = current_alpha;
+    unsigned int current_stage = dyn_index_s3(j);
+    double current_stage_inds = theseventhson(current_stage);
+    double NK_diff = Nsum - current_stage_inds;
+    double max_limit = K_limit - NK_diff;
+    
+    if (dyn_style(j) == 5) { // Additive limit function
+      double proposed_s3_total = current_beta * (current_alpha - pop_size);
+      if (proposed_s3_total < current_gamma) {
+        proposed_s3_total = current_gamma;
+      } else if (proposed_s3_total > max_limit && max_limit > current_gamma) {
+        proposed_s3_total = max_limit;
+      }
+      theseventhson(current_stage) = proposed_s3_total;
+      
+    } else if (dyn_style(j) == 6) { // Fixed limit function
+      double proposed_s3_total = current_stage_inds;
+      if (proposed_s3_total < current_gamma) {
+        proposed_s3_total = current_gamma;
+      } else if (proposed_s3_total > max_limit && current_alpha > current_beta) {
+        proposed_s3_total = max_limit;
+      }
+      theseventhson(current_stage) = proposed_s3_total;
+    }
   }
 }
 
@@ -16690,6 +17364,12 @@ arma::mat proj3sp(const arma::vec& start_vec, const List& core_list,
 //' There is no option to standardize population vectors here, because density
 //' dependence requires the full population size to be tracked.
 //' 
+//' In sparse projections, the position of each density dependent element in
+//' the values array of each matrix is found once, and density adjustment
+//' overwrites those values in place, so that the sparsity pattern never
+//' changes. Elements that are structural zeros remain zero under all density
+//' functions, and so are skipped.
+//' 
 //' @keywords internal
 //' @noRd
 arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
@@ -16704,7 +17384,6 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
   //Rcout << "proj3dens A" << endl;
   
   int sparse_switch {0};
-  int time_delay {1};
   double pop_size {0.};
   bool warn_trigger_neg = false;
   bool warn_trigger_1 = false;
@@ -16717,8 +17396,6 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
   
   arma::mat theprophecy;
   arma::mat thesecondprophecy;
-  arma::sp_mat theprophecy_sp;
-  arma::sp_mat thesecondprophecy_sp;
   
   // Density dependence
   List dens_input_list;
@@ -16734,6 +17411,13 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
   arma::vec dyn_gamma;
   arma::uvec dyn_delay;
   arma::uvec dyn_type;
+  arma::uvec dyn_lag;
+  arma::uvec lag_levels;
+  arma::uvec lag_slot;
+  std::vector<arma::uvec> style_groups;
+  arma::uvec dyn_pass;
+  arma::uvec col_levels;
+  arma::uvec col_slot;
   int n_dyn_elems {0};
   
   DataFrame equivalence_frame;
@@ -16753,6 +17437,9 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
     dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
     dyn_type = as<arma::uvec>(dens_input["type"]);
     n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+    dens_groups(dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass,
+      dyn_style, dyn_delay, dyn_index321);
+    LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
     
   } else if (dens_list_length == 1){
     dens_input_list = as<List>(dens_RO);
@@ -16766,6 +17453,9 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
     dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
     dyn_type = as<arma::uvec>(dens_input["type"]);
     n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+    dens_groups(dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass,
+      dyn_style, dyn_delay, dyn_index321);
+    LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
   } else {
     dens_input_list = as<List>(dens_RO);
   }
@@ -16841,6 +17531,9 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
         dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
         dyn_type = as<arma::uvec>(dens_input["type"]);
         n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+        dens_groups(dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass,
+          dyn_style, dyn_delay, dyn_index321);
+        LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
       }
       
       if (eq_list_length > 1) {
@@ -16853,89 +17546,26 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
       
       bool additive_limit_enforced {false};
       
-      for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
-        time_delay = dyn_delay(j);
-        if (time_delay > 0) time_delay = time_delay - 1;
+      if (n_dyn_elems > 0) { // Density dependence
+        arma::uvec active;
+        additive_limit_enforced = dens_apply(theprophecy, active, pop_size,
+          popproj, i, equivalence_vec_arma, eq_vec_length, dyn_index321,
+          dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass, dyn_alpha,
+          dyn_beta, dyn_type, col_levels, col_slot, substoch);
         
-        if (i >= time_delay) {
-          arma::vec base_popprojcol = popproj.col(i - time_delay);
-          if (eq_vec_length > 1) base_popprojcol = base_popprojcol % equivalence_vec_arma;
-          
-          pop_size = sum(base_popprojcol);
-          
-          if (dyn_style(j) == 1) { // Ricker
-            changing_element = theprophecy(dyn_index321(j)) * 
-              dyn_alpha(j) * exp((-1*dyn_beta(j)) * pop_size); // Fi*ALPHA*exp(-BETA*n)
-            
-          } else if (dyn_style(j) == 2) { // Beverton-Holt
-            changing_element = theprophecy(dyn_index321(j)) * 
-              dyn_alpha(j) / (1 + dyn_beta(j) * pop_size); // Fi*ALPHA/(1+BETA*n)
-            
-          } else if (dyn_style(j) == 3) { // Usher function
-            changing_element = theprophecy(dyn_index321(j)) * 
-              (1 / (1 + exp(dyn_alpha(j) * pop_size + dyn_beta(j)))); // Fi*(1 / (1 + exp(alpha*N+b)))
-            
-          } else if (dyn_style(j) == 4) { // Logistic function
-            double used_popsize = pop_size;
-            if (dyn_beta(j) > 0.0 && pop_size > dyn_alpha(j)) {
-              used_popsize = dyn_alpha(j);
-            }
-            changing_element = theprophecy(dyn_index321(j)) * 
-              (1 - used_popsize / dyn_alpha(j)); // Fi*(1 - ALPHA/n)
-          } else if (dyn_style(j) == 5) { // Additive limit function
-            additive_limit_enforced = true;
-            
-            changing_element = theprophecy(dyn_index321(j)); // K + (beta * N) // but note that if the result is N > K, then stage3 will be reduced
-          } else if (dyn_style(j) == 6) {
-            additive_limit_enforced = true;
-            
-            changing_element = theprophecy(dyn_index321(j));
-          }
+        if (allow_warnings) {
+          arma::vec final_values = theprophecy.elem(dyn_index321.elem(active));
+          arma::uvec final_types = dyn_type.elem(active);
           
-          if (substoch == 1 && dyn_type(j) == 1) {
-            if (changing_element > 1.0) {
-              changing_element = 1.0;
-            } else if (changing_element < 0.0) {
-              changing_element = 0.0;
-            }
-          } else if (substoch == 2 && dyn_type(j) == 1) {
-            arma::vec given_col = theprophecy.col(dyn_index_col(j));
-            arma::uvec gc_negs = find(given_col < 0.0);
-            arma::uvec gc_pos = find(given_col > 0.0);
-            
-            double barnyard_antics = sum(given_col(gc_pos)) -
-              theprophecy(dyn_index321(j)) + changing_element;
-            
-            if (barnyard_antics > 1.0 && changing_element > 0.0) {
-              double proposed_element = changing_element - barnyard_antics *
-                (changing_element / barnyard_antics);
-              
-              if (proposed_element >= 0.0) {
-                changing_element = proposed_element;
-              } else {
-                changing_element = 0.0;
-              }
-            } else if (changing_element < 0.0) {
-              changing_element = 0.0;
-            }
-          } else if (substoch > 0 && dyn_type(j) == 2) {
-            if (changing_element < 0.0) {
-              changing_element = 0.0;
-            }
+          if (!warn_trigger_1 && any((final_values > 1.0) && (final_types == 1))) {
+            warn_trigger_1 = true;
+            Rf_warningcall(R_NilValue,
+              "Some probabilities with value > 1.0 produced during density adjustment.");
           }
-          theprophecy(dyn_index321(j)) = changing_element;
-          
-          if (allow_warnings) {
-            if (dyn_type(j) == 1 && theprophecy(dyn_index321(j)) > 1.0 && !warn_trigger_1) {
-              warn_trigger_1 = true;
-              Rf_warningcall(R_NilValue,
-                "Some probabilities with value > 1.0 produced during density adjustment.");
-              
-            } else if (theprophecy(dyn_index321(j)) < 0.0 && !warn_trigger_neg) {
-              warn_trigger_neg = true;
-              Rf_warningcall(R_NilValue,
-                "Some matrix elements with value < 0.0 produced during density adjustment.");
-            }
+          if (!warn_trigger_neg && any(final_values < 0.0)) {
+            warn_trigger_neg = true;
+            Rf_warningcall(R_NilValue,
+              "Some matrix elements with value < 0.0 produced during density adjustment.");
           }
         }
       }
@@ -16945,40 +17575,8 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
       }
       
       if (additive_limit_enforced) {
-        for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
-          double current_alpha = dyn_alpha(j);
-          double current_beta = dyn_beta(j);
-          double current_gamma = dyn_gamma(j);
-          double Nsum = sum(theseventhson);
-          double K_limit = current_alpha;
-          unsigned int current_stage = dyn_index_s3(j);
-          double current_stage_inds = theseventhson(current_stage);
-          double NK_diff = Nsum - current_stage_inds;
-          double max_limit = K_limit - NK_diff;
-          
-          if (dyn_style(j) == 5) { // Additive limit function
-            //Rcout << "Found additive limit function" << endl;
-            //double current_s3_total = theseventhson(dyn_index_s3(j));
-            //double current_total_nots3 = accu(theseventhson) - current_s3_total;
-            
-            double proposed_s3_total = current_beta * (current_alpha - pop_size);
-            if (proposed_s3_total < current_gamma) {
-              proposed_s3_total = current_gamma;
-            } else if (proposed_s3_total > max_limit && max_limit > current_gamma) {
-              proposed_s3_total = max_limit;
-            }
-            theseventhson(current_stage) = proposed_s3_total;
-            
-          } else if (dyn_style(j) == 6) {
-            double proposed_s3_total = current_stage_inds;
-            if (proposed_s3_total < current_gamma) {
-              proposed_s3_total = current_gamma;
-            } else if (proposed_s3_total > max_limit && current_alpha > current_beta) {
-              proposed_s3_total = max_limit;
-            }
-            theseventhson(current_stage) = proposed_s3_total;
-          }
-        }
+        dens_limits(theseventhson, pop_size, dyn_style, dyn_alpha, dyn_beta,
+          dyn_gamma, dyn_index_s3);
       }
       
       popproj.col(i+1) = theseventhson;
@@ -16999,32 +17597,34 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
     }
     
   } else {
-    // Sparse matrix projection
-    arma::sp_mat sparse_seventhson = arma::sp_mat(theseventhson);
+    // Sparse matrix projection, with matrices read once and density dependent
+    // elements overwritten in place within each matrix's values array
     int matlist_length = static_cast<int>(core_list.size());
-    Rcpp::List sparse_list(matlist_length);
+    arma::uvec used_mats = unique(mat_order);
+    std::vector<int> slot (matlist_length, -1);
+    std::vector<dgc_view> sparse_mats;
+    std::vector<arma::vec> work_values;
+    std::vector<arma::ivec> dens_positions;
+    std::vector<bool> positions_found;
     
-    if (!sparse_input) {
-      arma::mat first_mat = core_list(0);
-      arma::sp_mat new_sparse = arma::sp_mat(first_mat);
-      sparse_list(0) = new_sparse;
-      
-      if(matlist_length > 1) {
-        for (int i = 1; i < matlist_length; i++) {
-          first_mat = as<arma::mat>(core_list(i));
-          new_sparse = arma::sp_mat(first_mat);
-          sparse_list(i) = new_sparse;
-        }
-      }
-    } else sparse_list = core_list;
+    for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+      int current_mat = static_cast<int>(used_mats(m));
+      slot[current_mat] = m;
+      sparse_mats.emplace_back(core_list, current_mat);
+      work_values.push_back(arma::vec(sparse_mats[m].values,
+        sparse_mats[m].n_nonzero));
+    }
+    dens_positions.resize(used_mats.n_elem);
+    positions_found.assign(used_mats.n_elem, false);
     
-    arma::sp_mat sparse_prophecy;
-    arma::sp_mat sparse_secondprophecy;
+    arma::vec next_son (nostages);
     
     for (int i = 0; i < theclairvoyant; i++) {
       if (i % 50 == 0) Rcpp::checkUserInterrupt();
       
-      sparse_prophecy = as<arma::sp_mat>(sparse_list[(mat_order(i))]);
+      int current_slot = slot[mat_order(i)];
+      const dgc_view& sparse_prophecy = sparse_mats[current_slot];
+      arma::vec& prophecy_values = work_values[current_slot];
       
       if (dens_list_length > 1){
         dens_input = as<DataFrame>(dens_input_list((mat_order(i))));
@@ -17037,6 +17637,9 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
         dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
         dyn_type = as<arma::uvec>(dens_input["type"]);
         n_dyn_elems = static_cast<int>(dyn_index321.n_elem);
+        dens_groups(dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass,
+          dyn_style, dyn_delay, dyn_index321);
+        LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
       }
       
       if (eq_list_length > 1) {
@@ -17047,146 +17650,117 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
           used_matsize);
       }
       
-      bool additive_limit_enforced {false};
+      // Each density element is found in each matrix only once
+      if (!positions_found[current_slot]) {
+        dens_positions[current_slot] = sparse_prophecy.value_positions(dyn_index321);
+        positions_found[current_slot] = true;
+      }
+      const arma::ivec& elem_positions = dens_positions[current_slot];
       
-      for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
-        time_delay = dyn_delay(j);
-        if (time_delay > 0) time_delay = time_delay - 1;
+      bool additive_limit_enforced {false};
+      arma::uvec active;
+      
+      if (n_dyn_elems > 0) { // Density dependence
+        // Positive column totals found once per column, then kept current
+        arma::vec col_positive;
+        if (substoch == 2) {
+          int col_count = static_cast<int>(col_levels.n_elem);
+          col_positive.zeros(col_count);
+          for (int c = 0; c < col_count; c++) {
+            int current_col = static_cast<int>(col_levels(c));
+            for (int l = sparse_prophecy.col_ptr[current_col];
+                l < sparse_prophecy.col_ptr[current_col+1]; l++) {
+              if (prophecy_values(l) > 0.0) col_positive(c) += prophecy_values(l);
+            }
+          }
+        }
         
-        if (i >= time_delay) {
-          arma::vec base_popprojcol = popproj.col(i - time_delay);
-          if (eq_vec_length > 1) base_popprojcol = base_popprojcol % equivalence_vec_arma;
-          
-          pop_size = sum(base_popprojcol);
+        // Repeated elements are adjusted in later passes, from current values
+        int pass_count = (dyn_pass.n_elem == 0) ? 1 : static_cast<int>(dyn_pass.max()) + 1;
+        arma::uvec pass_active;
+        
+        for (int p = 0; p < pass_count; p++) {
+          arma::vec elem_values (n_dyn_elems, fill::zeros);
+          for (int j = 0; j < n_dyn_elems; j++) {
+            if (elem_positions(j) >= 0) elem_values(j) = prophecy_values(elem_positions(j));
+          }
           
-          if (dyn_style(j) == 1) { // Ricker
-            changing_element = sparse_prophecy(dyn_index321(j)) * 
-              dyn_alpha(j) * exp((-1*dyn_beta(j)) * pop_size); // Fi*ALPHA*exp(-BETA*n)
-            
-          } else if (dyn_style(j) == 2) { // Beverton-Holt
-            changing_element = sparse_prophecy(dyn_index321(j)) * 
-              dyn_alpha(j) / (1 + dyn_beta(j) * pop_size); // Fi*ALPHA/(1+BETA*n)
-            
-          } else if (dyn_style(j) == 3) { // Usher function
-            changing_element = sparse_prophecy(dyn_index321(j)) * 
-              (1 / (1 + exp(dyn_alpha(j) * pop_size + dyn_beta(j)))); // Fi*(1 / (1 + exp(alpha*N+b)))
-            
-          } else if (dyn_style(j) == 4) { // Logistic function
-            double used_popsize = pop_size;
-            if (dyn_beta(j) > 0.0 && pop_size > dyn_alpha(j)) {
-              used_popsize = dyn_alpha(j);
-            }
-            changing_element = sparse_prophecy(dyn_index321(j)) * 
-              (1 - used_popsize / dyn_alpha(j)); // Fi*(1 - ALPHA/n)
-          } else if (dyn_style(j) == 5) { // Additive limit function
-            additive_limit_enforced = true;
-            
-            changing_element = theprophecy(dyn_index321(j)); // K + (beta * N) // but note that if the result is N > K, then stage3 will be reduced
-          } else if (dyn_style(j) == 6) {
+          double pass_size {pop_size};
+          if (dens_values(elem_values, pass_active, pass_size, popproj, i,
+              equivalence_vec_arma, eq_vec_length, dyn_lag, lag_levels, lag_slot,
+              style_groups, dyn_pass, p, dyn_alpha, dyn_beta, dyn_type, substoch)) {
             additive_limit_enforced = true;
-            
-            changing_element = theprophecy(dyn_index321(j));
           }
+          if (pass_active.n_elem == 0) continue;
           
-          if (substoch == 1 && dyn_type(j) == 1) {
-            if (changing_element > 1.0) {
-              changing_element = 1.0;
-            } else if (changing_element < 0.0) {
-              changing_element = 0.0;
-            }
-          } else if (substoch == 2 && dyn_type(j) == 1) {
-            arma::vec given_col = arma::vec(sparse_prophecy.col(dyn_index_col(j)));
-            arma::uvec gc_negs = find(given_col < 0.0);
-            arma::uvec gc_pos = find(given_col > 0.0);
-            
-            double barnyard_antics = sum(given_col(gc_pos)) -
-              sparse_prophecy(dyn_index321(j)) + changing_element;
+          if (active.n_elem == 0 || pass_active.max() > active.max()) {
+            pop_size = pass_size;
+          }
+          
+          // Structural zeros remain zero under all density functions
+          for (int k = 0; k < static_cast<int>(pass_active.n_elem); k++) {
+            int j = static_cast<int>(pass_active(k));
+            if (elem_positions(j) < 0) continue;
+            double current_element = prophecy_values(elem_positions(j));
+            changing_element = elem_values(j);
             
-            if (barnyard_antics > 1.0 && changing_element > 0.0) {
-              double proposed_element = changing_element - barnyard_antics *
-                (changing_element / barnyard_antics);
-              
-              if (proposed_element >= 0.0) {
-                changing_element = proposed_element;
-              } else {
-                changing_element = 0.0;
+            if (substoch == 2) {
+              if (dyn_type(j) == 1) {
+                changing_element = LefkoUtils::substoch_limit(changing_element,
+                  current_element, col_positive(col_slot(j)));
               }
-            } else if (changing_element < 0.0) {
-              changing_element = 0.0;
+              if (current_element > 0.0) col_positive(col_slot(j)) -= current_element;
+              if (changing_element > 0.0) col_positive(col_slot(j)) += changing_element;
             }
-          } else if (substoch > 0 && dyn_type(j) == 2) {
-            if (changing_element < 0.0) {
-              changing_element = 0.0;
+            prophecy_values(elem_positions(j)) = changing_element;
+            
+            if (allow_warnings) {
+              if (dyn_type(j) == 1 && changing_element > 1.0 && !warn_trigger_1) {
+                warn_trigger_1 = true;
+                Rf_warningcall(R_NilValue,
+                  "Some probabilities with value > 1.0 produced during density adjustment.");
+                  
+              } else if (changing_element < 0.0 && !warn_trigger_neg) {
+                warn_trigger_neg = true;
+                Rf_warningcall(R_NilValue,
+                  "Some matrix elements with value < 0.0 produced during density adjustment.");
+              }
             }
           }
-          sparse_prophecy(dyn_index321(j)) = changing_element;
           
-          if (allow_warnings) {
-            if (dyn_type(j) == 1 && sparse_prophecy(dyn_index321(j)) > 1.0 && !warn_trigger_1) {
-              warn_trigger_1 = true;
-              Rf_warningcall(R_NilValue,
-                "Some probabilities with value > 1.0 produced during density adjustment.");
-                
-            } else if (sparse_prophecy(dyn_index321(j)) < 0.0 && !warn_trigger_neg) {
-              warn_trigger_neg = true;
-              Rf_warningcall(R_NilValue,
-                "Some matrix elements with value < 0.0 produced during density adjustment.");
-            }
-          }
+          active = join_cols(active, pass_active);
         }
       }
       
-      sparse_seventhson = sparse_prophecy * sparse_seventhson;
+      sparse_prophecy.times_into(theseventhson, next_son, prophecy_values);
+      theseventhson.swap(next_son);
       if (integeronly) {
-        sparse_seventhson = floor(sparse_seventhson);
+        theseventhson = floor(theseventhson);
       }
       
-      if (additive_limit_enforced) {
-        for (int j = 0; j < n_dyn_elems; j++) { // Density dependence
-          double current_alpha = dyn_alpha(j);
-          double current_beta = dyn_beta(j);
-          double current_gamma = dyn_gamma(j);
-          double Nsum = accu(sparse_seventhson);
-          double K_limit = current_alpha;
-          unsigned int current_stage = dyn_index_s3(j);
-          double current_stage_inds = sparse_seventhson(current_stage);
-          double NK_diff = Nsum - current_stage_inds;
-          double max_limit = K_limit - NK_diff;
-          
-          if (dyn_style(j) == 5) { // Additive limit function
-            //Rcout << "Found additive limit function" << endl;
-            //double current_s3_total = theseventhson(dyn_index_s3(j));
-            //double current_total_nots3 = accu(theseventhson) - current_s3_total;
-            
-            double proposed_s3_total = current_beta * (current_alpha - pop_size);
-            if (proposed_s3_total < current_gamma) {
-              proposed_s3_total = current_gamma;
-            } else if (proposed_s3_total > max_limit && max_limit > current_gamma) {
-              proposed_s3_total = max_limit;
-            }
-            sparse_seventhson(current_stage) = proposed_s3_total;
-            
-          } else if (dyn_style(j) == 6) {
-            double proposed_s3_total = current_stage_inds;
-            if (proposed_s3_total < current_gamma) {
-              proposed_s3_total = current_gamma;
-            } else if (proposed_s3_total > max_limit && current_alpha > current_beta) {
-              proposed_s3_total = max_limit;
-            }
-            sparse_seventhson(current_stage) = proposed_s3_total;
-          }
+      // Adjusted elements are restored to their original values
+      for (int k = 0; k < static_cast<int>(active.n_elem); k++) {
+        int current_position = elem_positions(active(k));
+        if (current_position >= 0) {
+          prophecy_values(current_position) = sparse_prophecy.values[current_position];
         }
       }
       
-      popproj.col(i+1) = arma::vec(arma::mat(sparse_seventhson));
-      Rvecmat(i+1) = sum(popproj.col(i+1));
+      if (additive_limit_enforced) {
+        dens_limits(theseventhson, pop_size, dyn_style, dyn_alpha, dyn_beta,
+          dyn_gamma, dyn_index_s3);
+      }
+      
+      popproj.col(i+1) = theseventhson;
+      Rvecmat(i+1) = sum(theseventhson);
       
       if (Rvecmat(i+1) <= 0.0) break;
       
       if (!growthonly) {
         wpopproj.col(i+1) = popproj.col(i+1) / Rvecmat(i+1);
-        sparse_secondprophecy = as<arma::sp_mat>(sparse_list[(mat_order(theclairvoyant - (i+1)))]);
-        theseventhgrandson = theseventhgrandson * sparse_secondprophecy;
+        const dgc_view& sparse_secondprophecy =
+          sparse_mats[slot[mat_order(theclairvoyant - (i+1))]];
+        theseventhgrandson = sparse_secondprophecy.trans_times(theseventhgrandson);
         
         double seventhgrandsum = sum(theseventhgrandson);
         arma::vec midwife = theseventhgrandson.as_col() / seventhgrandsum;
@@ -17208,67 +17782,906 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
   }
 }
 
-//' Conduct Single Population Projection Simulations
+//' Raise Period Product to a Power and Apply to a Vector
 //' 
-//' Function \code{projection3_single()} runs single projection simulations. It
-//' is the workhorse function behind \code{projection3()}.
+//' Function \code{periodic_power()} applies the \code{cycles}-th power of a
+//' period product matrix to a vector by repeated squaring. Matrix and vector
+//' are rescaled by their largest absolute values at each step, with the log of
+//' the removed scale tracked separately, so that long horizons neither
+//' overflow nor underflow.
 //' 
-//' @name projection3_single
+//' @name periodic_power
 //' 
-//' @param fin_out The resulting List, built by reference.
-//' @param mpm A matrix projection model of class \code{lefkoMat}, or a list of
-//' full matrix projection matrices.
-//' @param nreps The number of replicate projections.
-//' @param times Number of occasions to iterate per replicate. Defaults to
-//' 10,000.
-//' @param historical An optional logical value only used if object \code{mpm}
-//' is a list of matrices, rather than a \code{lefkoMat} object. Defaults to
-//' \code{FALSE} for the former case, and overridden by information supplied in
-//' the \code{lefkoMat} object for the latter case.
-//' @param stochastic A logical value denoting whether to conduct a stochastic
-//' projection or a deterministic / cyclical projection.
-//' @param standardize A logical value denoting whether to re-standardize the
-//' population size to 1.0 at each occasion. Defaults to \code{FALSE}.
-//' @param growthonly A logical value indicating whether to produce only the
-//' projected population size at each occasion, or a vector showing the stage
-//' distribution followed by the reproductive value vector followed by the full
-//' population size at each occasion. Defaults to \code{TRUE}.
-//' @param integeronly A logical value indicating whether to round the number of
-//' individuals projected in each stage at each occasion to the nearest
-//' integer. Defaults to \code{FALSE}.
-//' @param substoch An integer value indicating whether to force survival-
-//' transition matrices to be substochastic in density dependent simulations.
-//' Defaults to \code{0}, which does not force substochasticity. Alternatively,
-//' \code{1} forces all survival-transition elements to range from 0.0 to 1.0,
-//' and forces fecundity to be non-negative; and \code{2} forces all column rows
-//' in the survival-transition matrices to total no more than 1.0, in addition
-//' to the actions outlined for option \code{1}.
-//' @param exp_tol A numeric value used to indicate a maximum value to set
-//' exponents to in the core kernel to prevent numerical overflow. Defaults to
-//' \code{700}.
-//' @param sub_warnings A logical value indicating whether to warn the user if
-//' density dependence yields matrix values outside of the realm of possibility.
-//' Generally, this means that survival-transition elements altered to values
-//' outside of the interval [0, 1], and negative fecundity values, will both
-//' yield warnings. Defaults to \code{TRUE}, but becomes \code{FALSE} if
-//' \code{quiet = TRUE}.
-//' @param quiet A logical value indicating whether to suppress warnings.
-//' Defaults to \code{FALSE}.
-//' @param year Either a single integer value corresponding to the year to
-//' project, or a vector of \code{times} elements with the year to use at each
-//' time step. If a vector shorter than \code{times} is supplied, then this
-//' vector will be cycled. If not provided, then all annual matrices will be
-//' cycled within patches or populations.
-//' @param start_vec An optional numeric vector denoting the starting stage
-//' distribution for the projection. Defaults to a single individual of each
-//' stage.
-//' @param start_frame An optional data frame characterizing stages, age-stages,
-//' or stage-pairs that should be set to non-zero values in the starting vector,
-//' and what those values should be. Can only be used with \code{lefkoMat}
-//' objects.
-//' @param tweights An optional numeric vector or matrix denoting the
-//' probabilities of choosing each matrix in a stochastic projection. If a
-//' matrix is input, then a first-order Markovian environment is assumed, in
+//' @param period_mat The dense or sparse period product matrix.
+//' @param start_vec The vector to project.
+//' @param cycles The number of times to apply \code{period_mat}.
+//' @param log_scale The log of the factor by which the returned vector must be
+//' multiplied to give the actual projected vector, modified in place.
+//' 
+//' @return The projected vector, rescaled so that its largest absolute value is
+//' 1.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename T>
+inline arma::vec periodic_power(const T& period_mat, const arma::vec& start_vec,
+  unsigned int cycles, double& log_scale) {
+  
+  arma::vec x = start_vec;
+  T current = period_mat;
+  double current_log {0.0};
+  log_scale = 0.0;
+  
+  while (cycles > 0) {
+    if (cycles & 1U) {
+      x = current * x;
+      log_scale += current_log;
+      
+      double x_max = abs(x).max();
+      if (x_max > 0.0) {
+        x = x / x_max;
+        log_scale += log(x_max);
+      }
+    }
+    cycles >>= 1;
+    
+    if (cycles > 0) {
+      current = current * current;
+      current_log *= 2.0;
+      
+      double current_max = abs(current).max();
+      if (current_max > 0.0) {
+        current = current / current_max;
+        current_log += log(current_max);
+      }
+    }
+  }
+  
+  return x;
+}
+
+//' Project Vector Through Periodic Matrix Sequence
+//' 
+//' Function \code{periodic_final()} forms the period product of a sequence of
+//' matrices and projects a vector to a given occasion through repeated
+//' squaring, followed by the remaining occasions of the last partial period.
+//' 
+//' @name periodic_final
+//' 
+//' @param period_mats A vector of dense or sparse matrices making up one
+//' period, in order of use.
+//' @param start_vec The starting population vector.
+//' @param times The number of occasions to project.
+//' @param standardize A logical value indicating whether the population vector
+//' is standardized to sum to 1 before each occasion.
+//' @param period_mat A matrix to hold the period product.
+//' @param log_size The log of the sum of the vector projected to occasion
+//' \code{times}, modified in place. Set to \code{-Inf} if the projected
+//' vector sums to zero.
+//' 
+//' @return The vector projected to occasion \code{times}, standardized to sum
+//' to 1. The vector is never multiplied back by its accumulated scale, which
+//' may overflow or underflow over long horizons, and the actual projected
+//' vector is this vector multiplied by \code{exp(log_size)}.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename T>
+inline arma::vec periodic_final(const std::vector<T>& period_mats,
+  const arma::vec& start_vec, int times, bool standardize, T& period_mat,
+  double& log_size) {
+  
+  int period = static_cast<int>(period_mats.size());
+  unsigned int cycles = static_cast<unsigned int>((times - 1) / period);
+  int remainder = (times - 1) % period;
+  
+  period_mat = period_mats[0];
+  for (int j = 1; j < period; j++) {
+    period_mat = period_mats[j] * period_mat;
+  }
+  
+  // Occasions before the last, with the final occasion applied separately
+  double log_scale {0.0};
+  arma::vec current_vec = periodic_power(period_mat, start_vec, cycles,
+    log_scale);
+  for (int j = 0; j < remainder; j++) {
+    current_vec = period_mats[j] * current_vec;
+  }
+  
+  double current_sum = sum(current_vec);
+  if (standardize) {
+    if (current_sum > 0.0) current_vec = current_vec / current_sum;
+    log_scale = 0.0;
+  }
+  
+  arma::vec final_vec = period_mats[remainder] * current_vec;
+  double final_sum = sum(final_vec);
+  if (final_sum > 0.0) {
+    final_vec = final_vec / final_sum;
+    log_size = log_scale + log(final_sum);
+  } else {
+    final_vec.zeros();
+    log_size = R_NegInf;
+  }
+  
+  return final_vec;
+}
+
+//' Project Periodic Matrix Sequence to Final Occasion
+//' 
+//' Function \code{proj3periodic()} projects a starting vector through a
+//' repeating sequence of matrices without stepping through each occasion. The
+//' product of the matrices in one period is formed once, and its powers are
+//' developed by repeated squaring, so that the work required grows with the
+//' logarithm of the number of occasions rather than linearly.
+//' 
+//' @name proj3periodic
+//' 
+//' @param start_vec The starting population vector.
+//' @param mats A list of dense or sparse projection matrices.
+//' @param period_order A vector giving the indices of the matrices in
+//' \code{mats} used in one period, in order of use.
+//' @param times The number of occasions to project.
+//' @param standardize A logical value indicating whether the population vector
+//' is standardized to sum to 1 before each occasion, as in \code{proj3()}.
+//' @param sparse A logical value indicating whether to form the period product
+//' with sparse matrices.
+//' @param period_lambda The dominant eigenvalue of the period product, raised to
+//' the inverse of the period length, giving the periodic population growth rate
+//' per occasion. Modified in place.
+//' @param log_size The log of the population size at occasion \code{times},
+//' modified in place.
+//' 
+//' @return A matrix with two columns, giving the starting vector and the vector
+//' projected to occasion \code{times}, standardized to sum to 1. The latter
+//' multiplied by \code{exp(log_size)} matches the final column produced by
+//' \code{proj3()} with \code{growthonly = TRUE}.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::mat proj3periodic(const arma::vec& start_vec, const List& mats,
+  const arma::uvec& period_order, int times, bool standardize, bool sparse,
+  double& period_lambda, double& log_size) {
+  
+  int period = static_cast<int>(period_order.n_elem);
+  
+  arma::mat output (start_vec.n_elem, 2, fill::zeros);
+  output.col(0) = start_vec;
+  
+  double lambda {0.0};
+  
+  if (sparse) {
+    std::vector<arma::sp_mat> period_mats (period);
+    for (int j = 0; j < period; j++) {
+      int current_mat = static_cast<int>(period_order(j));
+      
+      if (is<S4>(mats(current_mat))) {
+        period_mats[j] = as<arma::sp_mat>(mats(current_mat));
+      } else {
+        period_mats[j] = arma::sp_mat(as<arma::mat>(mats(current_mat)));
+      }
+    }
+    
+    arma::sp_mat period_mat;
+    output.col(1) = periodic_final(period_mats, start_vec, times, standardize,
+      period_mat, log_size);
+    
+    List eigenstuff = LefkoMats::decomp3sp_inp(period_mat);
+    lambda = max(real(as<arma::cx_vec>(eigenstuff["eigenvalues"])));
+    
+  } else {
+    std::vector<arma::mat> period_mats (period);
+    for (int j = 0; j < period; j++) {
+      period_mats[j] = as<arma::mat>(mats(static_cast<int>(period_order(j))));
+    }
+    
+    arma::mat period_mat;
+    output.col(1) = periodic_final(period_mats, start_vec, times, standardize,
+      period_mat, log_size);
+    
+    List eigenstuff = LefkoMats::decomp3(period_mat);
+    lambda = max(real(as<arma::cx_vec>(eigenstuff["eigenvalues"])));
+  }
+  
+  if (lambda > 0.0) {
+    period_lambda = pow(lambda, 1.0 / static_cast<double>(period));
+  } else {
+    period_lambda = 0.0;
+  }
+  
+  return output;
+}
+
+//' Uniform Random Deviate for Demographic Stochasticity
+//' 
+//' Function \code{demog_unif()} returns a uniform random deviate strictly
+//' within the open interval (0, 1) from a thread-specific random stream.
+//' 
+//' @name demog_unif
+//' 
+//' @param gen The random stream of the current replicate.
+//' 
+//' @return A single uniform random deviate.
+//' 
+//' @keywords internal
+//' @noRd
+inline double demog_unif(std::mt19937_64& gen) {
+  return (static_cast<double>(gen() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+//' Log Factorial for Demographic Stochasticity
+//' 
+//' Function \code{demog_logfact()} returns the log factorial of a non-negative
+//' integer, given as a double, without using the global state written by
+//' \code{lgamma()}, so that it can be called in parallel.
+//' 
+//' @name demog_logfact
+//' 
+//' @param k A non-negative integer value.
+//' 
+//' @return The log of the factorial of \code{k}, from a table for small values
+//' and from the Stirling series otherwise.
+//' 
+//' @keywords internal
+//' @noRd
+inline double demog_logfact(double k) {
+  static const double small_logfact[10] = {0.0, 0.0, 0.69314718055994531,
+    1.79175946922805500, 3.17805383034794562, 4.78749174278204599,
+    6.57925121201010100, 8.52516136106541430, 10.60460290274525023,
+    12.80182748008146961};
+  
+  if (k < 10.0) return small_logfact[static_cast<int>(k)];
+  
+  double k_inv = 1.0 / k;
+  double k_inv2 = k_inv * k_inv;
+  
+  return (k + 0.5) * log(k) - k + 0.91893853320467274 +
+    k_inv * (1.0 / 12.0 - k_inv2 * (1.0 / 360.0 - k_inv2 / 1260.0));
+}
+
+//' Binomial Random Deviate for Demographic Stochasticity
+//' 
+//' Function \code{demog_binom()} draws the number of successes out of
+//' \code{n} trials. Small expected numbers are drawn by inversion, and
+//' large ones by Hormann's BTRS transformed rejection sampler, so that runtime
+//' does not grow with the number of trials.
+//' 
+//' @name demog_binom
+//' 
+//' @param gen The random stream of the current replicate.
+//' @param n The number of trials, given as a non-negative integer double.
+//' @param p The probability of success in each trial.
+//' 
+//' @return A binomial random deviate, as a double.
+//' 
+//' @keywords internal
+//' @noRd
+inline double demog_binom(std::mt19937_64& gen, double n, double p) {
+  if (n <= 0.0 || p <= 0.0) return 0.0;
+  if (p >= 1.0) return n;
+  if (p > 0.5) return n - demog_binom(gen, n, 1.0 - p);
+  
+  double q = 1.0 - p;
+  
+  if (n * p < 10.0) {
+    // Inversion through the recursion of binomial probabilities
+    double s = p / q;
+    double a = (n + 1.0) * s;
+    double r = exp(n * log(q));
+    double u = demog_unif(gen);
+    double x {0.0};
+    
+    while (u > r && x < n) {
+      u -= r;
+      x += 1.0;
+      r *= (a / x - s);
+    }
+    
+    return x;
+  }
+  
+  // BTRS
+  double spq = sqrt(n * p * q);
+  double b = 1.15 + 2.53 * spq;
+  double a = -0.0873 + 0.0248 * b + 0.01 * p;
+  double c = n * p + 0.5;
+  double v_r = 0.92 - 4.2 / b;
+  double alpha = (2.83 + 5.1 / b) * spq;
+  double lpq = log(p / q);
+  double m = floor((n + 1.0) * p);
+  double h = demog_logfact(m) + demog_logfact(n - m);
+  
+  while (true) {
+    double u = demog_unif(gen) - 0.5;
+    double v = demog_unif(gen);
+    double us = 0.5 - std::abs(u);
+    double k = floor((2.0 * a / us + b) * u + c);
+    
+    if (k < 0.0 || k > n) continue;
+    if (us >= 0.07 && v <= v_r) return k;
+    
+    v = log(v * alpha / (a / (us * us) + b));
+    if (v <= (h - demog_logfact(k) - demog_logfact(n - k) + (k - m) * lpq)) {
+      return k;
+    }
+  }
+}
+
+//' Poisson Random Deviate for Demographic Stochasticity
+//' 
+//' Function \code{demog_pois()} draws a Poisson random deviate. Small means are
+//' drawn by multiplication of uniform deviates, and large ones by Hormann's
+//' PTRS transformed rejection sampler.
+//' 
+//' @name demog_pois
+//' 
+//' @param gen The random stream of the current replicate.
+//' @param mu The mean of the Poisson distribution.
+//' 
+//' @return A Poisson random deviate, as a double.
+//' 
+//' @keywords internal
+//' @noRd
+inline double demog_pois(std::mt19937_64& gen, double mu) {
+  if (mu <= 0.0) return 0.0;
+  
+  if (mu < 10.0) {
+    double limit = exp(-mu);
+    double prod = demog_unif(gen);
+    double k {0.0};
+    
+    while (prod > limit) {
+      prod *= demog_unif(gen);
+      k += 1.0;
+    }
+    
+    return k;
+  }
+  
+  // PTRS
+  double slam = sqrt(mu);
+  double loglam = log(mu);
+  double b = 0.931 + 2.53 * slam;
+  double a = -0.059 + 0.02483 * b;
+  double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+  double v_r = 0.9277 - 3.6224 / (b - 2.0);
+  
+  while (true) {
+    double u = demog_unif(gen) - 0.5;
+    double v = demog_unif(gen);
+    double us = 0.5 - std::abs(u);
+    double k = floor((2.0 * a / us + b) * u + mu + 0.43);
+    
+    if (us >= 0.07 && v <= v_r) return k;
+    if (k < 0.0 || (us < 0.013 && v > us)) continue;
+    
+    if ((log(v) + log(invalpha) - log(a / (us * us) + b)) <=
+        (-mu + k * loglam - demog_logfact(k))) {
+      return k;
+    }
+  }
+}
+
+//' Single Occasion of Demographic Stochasticity
+//' 
+//' Function \code{demog_step()} projects whole numbers of individuals forward
+//' by one occasion. Survival and transition are drawn as a multinomial trial
+//' across the elements of the corresponding column of the \code{U} matrix,
+//' with the remainder dying, and the offspring produced into each stage are
+//' drawn as Poisson deviates with mean given by the number of parents times
+//' the corresponding \code{F} matrix element.
+//' 
+//' @name demog_step
+//' 
+//' @param gen The random stream of the current replicate.
+//' @param u_mat The survival-transition matrix of the current occasion.
+//' @param f_mat The fecundity matrix of the current occasion.
+//' @param current_n The numbers of individuals in each stage.
+//' @param next_n The vector to hold the numbers of individuals in each stage
+//' in the next occasion.
+//' 
+//' @return The total number of individuals in the next occasion. Vector
+//' \code{next_n} is overwritten.
+//' 
+//' @section Notes:
+//' The multinomial trial is conducted as a sequence of binomial trials, each
+//' conditional on the individuals not yet assigned. Elements of \code{U}
+//' columns summing to more than 1 are truncated once the full stage has been
+//' assigned.
+//' 
+//' @keywords internal
+//' @noRd
+inline double demog_step(std::mt19937_64& gen, const dgc_view& u_mat,
+  const dgc_view& f_mat, const arma::vec& current_n, arma::vec& next_n) {
+  
+  int nostages = static_cast<int>(current_n.n_elem);
+  next_n.zeros(nostages);
+  
+  for (int j = 0; j < nostages; j++) {
+    double stage_n = current_n(j);
+    if (stage_n <= 0.0) continue;
+    
+    // Survival and transition as sequential conditional binomials
+    double remaining = stage_n;
+    double p_left {1.0};
+    for (int k = u_mat.col_ptr[j]; k < u_mat.col_ptr[j+1]; k++) {
+      if (remaining <= 0.0) break;
+      
+      double p = u_mat.values[k];
+      if (p <= 0.0) continue;
+      
+      double moved = demog_binom(gen, remaining, (p < p_left ? p / p_left : 1.0));
+      next_n(u_mat.row_idx[k]) += moved;
+      remaining -= moved;
+      p_left -= p;
+    }
+    
+    // Offspring of all parents in the stage
+    for (int k = f_mat.col_ptr[j]; k < f_mat.col_ptr[j+1]; k++) {
+      double f = f_mat.values[k];
+      if (f <= 0.0) continue;
+      
+      next_n(f_mat.row_idx[k]) += demog_pois(gen, stage_n * f);
+    }
+  }
+  
+  return accu(next_n);
+}
+
+//' Mean Matrix for Demographic Stochasticity
+//' 
+//' Function \code{demog_mean()} creates the element-wise mean of chosen
+//' matrices in a list, used to develop population-level \code{U} and \code{F}
+//' matrices for individual-based projections.
+//' 
+//' @name demog_mean
+//' 
+//' @param mats A list of matrices, either all dense or all of class
+//' \code{dgCMatrix}.
+//' @param chosen A vector of indices of the matrices in \code{mats} to
+//' average.
+//' @param sparse A logical value indicating whether \code{mats} holds sparse
+//' matrices.
+//' 
+//' @return The mean matrix, in the same format as the input.
+//' 
+//' @keywords internal
+//' @noRd
+inline RObject demog_mean(const List& mats, const arma::uvec& chosen,
+  bool sparse) {
+  
+  int chosen_length = static_cast<int>(chosen.n_elem);
+  double chosen_inv = 1.0 / static_cast<double>(chosen_length);
+  
+  if (sparse) {
+    dgc_view first_mat (mats, static_cast<int>(chosen(0)));
+    arma::sp_mat mean_mat = first_mat.sp();
+    
+    for (int k = 1; k < chosen_length; k++) {
+      dgc_view current_mat (mats, static_cast<int>(chosen(k)));
+      mean_mat = current_mat.combine(mean_mat, 1.0, 1.0);
+    }
+    mean_mat *= chosen_inv;
+    
+    return wrap(mean_mat);
+  }
+  
+  arma::mat mean_mat = as<arma::mat>(mats(static_cast<int>(chosen(0))));
+  for (int k = 1; k < chosen_length; k++) {
+    mean_mat += as<arma::mat>(mats(static_cast<int>(chosen(k))));
+  }
+  mean_mat *= chosen_inv;
+  
+  return wrap(mean_mat);
+}
+
+//' Individual-based Projection with Demographic Stochasticity
+//' 
+//' Function \code{proj3demog()} projects whole numbers of individuals, drawing
+//' the fates of the individuals in each stage at each occasion through
+//' \code{demog_step()} rather than multiplying expected numbers. Replicates
+//' are run in parallel, each with its own random stream seeded from R.
+//' 
+//' @name proj3demog
+//' 
+//' @param start_vec The starting population vector for the projection, which
+//' is rounded to whole numbers of individuals.
+//' @param umats A list of survival-transition matrices.
+//' @param fmats A list of fecundity matrices, in the same order as
+//' \code{umats}.
+//' @param mat_orders A matrix with one row per occasion and one column per
+//' replicate, giving the index of the matrices used in each occasion of each
+//' replicate.
+//' 
+//' @return A matrix with the projected numbers of individuals in each stage,
+//' with replicates stacked by row and occasions by column, as given by
+//' \code{proj3()} with \code{growthonly = TRUE}.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::mat proj3demog(const arma::vec& start_vec, const List& umats,
+  const List& fmats, const arma::umat& mat_orders) {
+  
+  int nostages = static_cast<int>(start_vec.n_elem);
+  int theclairvoyant = static_cast<int>(mat_orders.n_rows);
+  int nreps = static_cast<int>(mat_orders.n_cols);
+  
+  // Matrices used in the projection are read once, in column-compressed form
+  int matlist_length = static_cast<int>(umats.length());
+  arma::uvec used_mats = unique(vectorise(mat_orders));
+  std::vector<int> slot (matlist_length, -1);
+  std::vector<dgc_view> u_mats;
+  std::vector<dgc_view> f_mats;
+  
+  for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+    int current_mat = static_cast<int>(used_mats(m));
+    slot[current_mat] = m;
+    u_mats.emplace_back(umats, current_mat);
+    f_mats.emplace_back(fmats, current_mat);
+  }
+  
+  // Independent streams, seeded from R so that set.seed() applies
+  std::vector<std::mt19937_64> streams (nreps);
+  for (int rep = 0; rep < nreps; rep++) {
+    uint64_t seed_high = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+    uint64_t seed_low = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+    streams[rep].seed((seed_high << 32) ^ seed_low);
+  }
+  
+  arma::vec start_counts = round(start_vec);
+  start_counts.clamp(0.0, arma::datum::inf);
+  arma::mat output ((nostages * nreps), (theclairvoyant + 1), fill::zeros);
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int rep = 0; rep < nreps; rep++) {
+    std::mt19937_64& gen = streams[rep];
+    int row_start = rep * nostages;
+    
+    arma::vec current_n = start_counts;
+    arma::vec next_n (nostages);
+    for (int j = 0; j < nostages; j++) output(row_start + j, 0) = current_n(j);
+    
+    for (int t = 0; t < theclairvoyant; t++) {
+      int current_slot = slot[mat_orders(t, rep)];
+      double next_total = demog_step(gen, u_mats[current_slot],
+        f_mats[current_slot], current_n, next_n);
+      
+      for (int j = 0; j < nostages; j++) output(row_start + j, t + 1) = next_n(j);
+      current_n.swap(next_n);
+      
+      if (next_total <= 0.0) break;
+    }
+  }
+  
+  return output;
+}
+
+//' Quasi-extinction Occasions of Projection Replicates
+//' 
+//' Function \code{proj3pva()} projects replicates until the first occasion at
+//' which the total or stage-weighted population size falls below a
+//' quasi-extinction threshold, without storing trajectories. Replicates that
+//' cross the threshold stop immediately, and replicates are run in parallel.
+//' 
+//' @name proj3pva
+//' 
+//' @param start_vec The starting population vector for the projection.
+//' @param amats A list of full projection matrices, used unless
+//' \code{demostoch = TRUE}.
+//' @param umats A list of survival-transition matrices, used if
+//' \code{demostoch = TRUE}.
+//' @param fmats A list of fecundity matrices, used if
+//' \code{demostoch = TRUE}.
+//' @param mat_orders A matrix with one row per occasion and one column per
+//' replicate, giving the index of the matrices used in each occasion of each
+//' replicate.
+//' @param ext_weights A vector of weights for each stage in the
+//' quasi-extinction criterion, or a single weight applied to all stages.
+//' @param quasi_ext The quasi-extinction threshold.
+//' @param dense A logical value indicating whether to use dense matrix
+//' encoding when \code{demostoch = FALSE}.
+//' @param demostoch A logical value indicating whether to project whole
+//' individuals with demographic stochasticity, as in \code{proj3demog()}.
+//' @param integeronly A logical value indicating whether to round all projected
+//' numbers of individuals to the nearest integer.
+//' 
+//' @return An integer vector giving the first occasion at which each replicate
+//' falls below \code{quasi_ext}, or \code{-1} if it never does.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::ivec proj3pva(const arma::vec& start_vec, const List& amats,
+  const List& umats, const List& fmats, const arma::umat& mat_orders,
+  const arma::vec& ext_weights, double quasi_ext, bool dense, bool demostoch,
+  bool integeronly) {
+  
+  int nostages = static_cast<int>(start_vec.n_elem);
+  int theclairvoyant = static_cast<int>(mat_orders.n_rows);
+  int nreps = static_cast<int>(mat_orders.n_cols);
+  bool stage_weighted = (static_cast<int>(ext_weights.n_elem) == nostages);
+  
+  // Matrices used in the projection are read once
+  int matlist_length = static_cast<int>(amats.length());
+  arma::uvec used_mats = unique(vectorise(mat_orders));
+  std::vector<int> slot (matlist_length, -1);
+  std::vector<arma::mat> dense_mats;
+  std::vector<dgc_view> sparse_mats;
+  std::vector<dgc_view> u_mats;
+  std::vector<dgc_view> f_mats;
+  
+  for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+    int current_mat = static_cast<int>(used_mats(m));
+    slot[current_mat] = m;
+    
+    if (demostoch) {
+      u_mats.emplace_back(umats, current_mat);
+      f_mats.emplace_back(fmats, current_mat);
+    } else if (dense) {
+      dense_mats.push_back(as<arma::mat>(amats[current_mat]));
+    } else {
+      sparse_mats.emplace_back(amats, current_mat);
+    }
+  }
+  
+  std::vector<std::mt19937_64> streams;
+  arma::vec start_counts = start_vec;
+  if (demostoch) {
+    streams.resize(nreps);
+    for (int rep = 0; rep < nreps; rep++) {
+      uint64_t seed_high = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+      uint64_t seed_low = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+      streams[rep].seed((seed_high << 32) ^ seed_low);
+    }
+    
+    start_counts = round(start_vec);
+    start_counts.clamp(0.0, arma::datum::inf);
+  }
+  
+  auto weighted_n = [&ext_weights, stage_weighted](const arma::vec& n) -> double {
+    if (stage_weighted) return dot(ext_weights, n);
+    return ext_weights(0) * accu(n);
+  };
+  
+  arma::ivec ext_occasions (nreps);
+  ext_occasions.fill(-1);
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int rep = 0; rep < nreps; rep++) {
+    arma::vec current_n = start_counts;
+    arma::vec next_n (nostages);
+    
+    if (weighted_n(current_n) < quasi_ext) {
+      ext_occasions(rep) = 0;
+      continue;
+    }
+    
+    for (int t = 0; t < theclairvoyant; t++) {
+      int current_slot = slot[mat_orders(t, rep)];
+      
+      if (demostoch) {
+        demog_step(streams[rep], u_mats[current_slot], f_mats[current_slot],
+          current_n, next_n);
+      } else {
+        if (dense) {
+          next_n = dense_mats[current_slot] * current_n;
+        } else {
+          sparse_mats[current_slot].times_into(current_n, next_n);
+        }
+        if (integeronly) next_n = floor(next_n);
+      }
+      current_n.swap(next_n);
+      
+      if (weighted_n(current_n) < quasi_ext) {
+        ext_occasions(rep) = t + 1;
+        break;
+      }
+    }
+  }
+  
+  return ext_occasions;
+}
+
+//' Record Quasi-extinction Results
+//' 
+//' Function \code{pva_record()} adds the quasi-extinction occasions of all
+//' replicates of one pop-patch or population to the cumulative
+//' quasi-extinction risk curve and the table of quasi-extinction times.
+//' 
+//' @name pva_record
+//' 
+//' @param ext_risk The matrix of cumulative quasi-extinction risk, with
+//' pop-patches or populations by row and occasions by column.
+//' @param ext_time The matrix of quasi-extinction occasions, with pop-patches
+//' or populations by row and replicates by column.
+//' @param ext_occasions The output of \code{proj3pva()}.
+//' @param row The row of \code{ext_risk} and \code{ext_time} to fill.
+//' 
+//' @return Matrices \code{ext_risk} and \code{ext_time} are filled in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void pva_record(arma::mat& ext_risk, IntegerMatrix& ext_time,
+  const arma::ivec& ext_occasions, int row) {
+  
+  int nreps = static_cast<int>(ext_occasions.n_elem);
+  int occasions = static_cast<int>(ext_risk.n_cols);
+  arma::rowvec first_crossings (occasions, fill::zeros);
+  
+  for (int rep = 0; rep < nreps; rep++) {
+    if (ext_occasions(rep) < 0) {
+      ext_time(row, rep) = NA_INTEGER;
+    } else {
+      ext_time(row, rep) = ext_occasions(rep);
+      first_crossings(ext_occasions(rep)) += 1.0;
+    }
+  }
+  
+  ext_risk.row(row) = cumsum(first_crossings) / static_cast<double>(nreps);
+}
+
+//' Create Starting Vector from Start Frame
+//' 
+//' Function \code{start_frame_vec()} creates a full starting population vector
+//' from a data frame produced by \code{start_input()}, matching the stages,
+//' stage pairs, or age-stages given in the data frame to the rows of the MPM.
+//' 
+//' @name start_frame_vec
+//' 
+//' @param start_thru The \code{lefkoSV} data frame.
+//' @param matrows The number of rows in the matrices of the MPM.
+//' @param agestage_format A logical value indicating whether the MPM is an
+//' age-by-stage MPM.
+//' @param historical A logical value indicating whether the MPM is historical.
+//' @param stageframe The \code{ahstages} data frame of the MPM.
+//' @param hstages The \code{hstages} data frame of the MPM.
+//' @param agestages The \code{agestages} data frame of the MPM.
+//' 
+//' @return The starting population vector.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::vec start_frame_vec(const DataFrame& start_thru, int matrows,
+  bool agestage_format, bool historical, const DataFrame& stageframe,
+  const DataFrame& hstages, const DataFrame& agestages) {
+  
+  arma::vec startvec (matrows, fill::zeros);
+  
+  arma::uvec start_elems = as<arma::uvec>(start_thru["row_num"]);
+  start_elems = start_elems - 1;
+  arma::vec start_values = as<arma::vec>(start_thru["value"]);
+  
+  // Here we will check to make sure the row designations are consistent
+  // with the stageframe, and if not, fix them
+  StringVector startframe_stage2 = as<StringVector>(start_thru["stage2"]);
+  StringVector startframe_stage1 = as<StringVector>(start_thru["stage1"]);
+  IntegerVector startframe_age2 = as<IntegerVector>(start_thru["age2"]);
+  int startframe_rows = startframe_stage2.length();
+  
+  if (agestage_format) {
+    StringVector agestages_stage = as<StringVector>(agestages["stage"]);
+    IntegerVector agestages_age = as<IntegerVector>(agestages["age"]);
+    int agestages_rows = agestages_stage.length();
+    
+    for (int i = 0; i < startframe_rows; i++) { 
+      for (int j = 0; j < agestages_rows; j++) {
+        for (int k = 0; k < agestages_rows; k++) {
+          if (LefkoUtils::stringcompare_simple(String(agestages_stage(j)),
+                String(startframe_stage2(i)))) {
+            if (agestages_age(k) == startframe_age2(i)) {
+              start_elems(i) = k;
+            }
+          }
+        }
+      }
+    }
+  } else if (historical) {
+    StringVector hstages_stage2 = as<StringVector>(hstages["stage_2"]);
+    StringVector hstages_stage1 = as<StringVector>(hstages["stage_1"]);
+    int hstages_rows = hstages_stage2.length();
+    
+    for (int i = 0; i < startframe_rows; i++) { 
+      for (int j = 0; j < hstages_rows; j++) {
+        for (int k = 0; k < hstages_rows; k++) {
+          if (LefkoUtils::stringcompare_simple(String(hstages_stage2(j)),
+                String(startframe_stage2(i)))) {
+            if (LefkoUtils::stringcompare_simple(String(hstages_stage1(k)),
+                String(startframe_stage1(i)))) {
+              start_elems(i) = k;
+            }
+          }
+        }
+      }
+    }
+  } else {
+    StringVector stageframe_stage2 = as<StringVector>(stageframe["stage"]);
+    int stageframe_rows = stageframe_stage2.length();
+    
+    for (int i = 0; i < startframe_rows; i++) { 
+      for (int j = 0; j < stageframe_rows; j++) {
+        if (LefkoUtils::stringcompare_simple(String(stageframe_stage2(j)),
+              String(startframe_stage2(i)))) {
+          start_elems(i) = j;
+        }
+      }
+    }
+  }
+  
+  if (static_cast<int>(start_elems.max()) > (matrows - 1)) {
+    throw Rcpp::exception("Start vector input frame includes element indices too high for this MPM.",
+      false);
+  }
+  for (int i = 0; i < static_cast<int>(start_elems.n_elem); i++) {
+    startvec(start_elems(i)) = start_values(i);
+  }
+  
+  return startvec;
+}
+
+//' Conduct Single Population Projection Simulations
+//' 
+//' Function \code{projection3_single()} runs single projection simulations. It
+//' is the workhorse function behind \code{projection3()}.
+//' 
+//' @name projection3_single
+//' 
+//' @param fin_out The resulting List, built by reference.
+//' @param mpm A matrix projection model of class \code{lefkoMat}, or a list of
+//' full matrix projection matrices.
+//' @param nreps The number of replicate projections.
+//' @param times Number of occasions to iterate per replicate. Defaults to
+//' 10,000.
+//' @param historical An optional logical value only used if object \code{mpm}
+//' is a list of matrices, rather than a \code{lefkoMat} object. Defaults to
+//' \code{FALSE} for the former case, and overridden by information supplied in
+//' the \code{lefkoMat} object for the latter case.
+//' @param stochastic A logical value denoting whether to conduct a stochastic
+//' projection or a deterministic / cyclical projection.
+//' @param standardize A logical value denoting whether to re-standardize the
+//' population size to 1.0 at each occasion. Defaults to \code{FALSE}.
+//' @param growthonly A logical value indicating whether to produce only the
+//' projected population size at each occasion, or a vector showing the stage
+//' distribution followed by the reproductive value vector followed by the full
+//' population size at each occasion. Defaults to \code{TRUE}.
+//' @param integeronly A logical value indicating whether to round the number of
+//' individuals projected in each stage at each occasion to the nearest
+//' integer. Defaults to \code{FALSE}.
+//' @param substoch An integer value indicating whether to force survival-
+//' transition matrices to be substochastic in density dependent simulations.
+//' Defaults to \code{0}, which does not force substochasticity. Alternatively,
+//' \code{1} forces all survival-transition elements to range from 0.0 to 1.0,
+//' and forces fecundity to be non-negative; and \code{2} forces all column rows
+//' in the survival-transition matrices to total no more than 1.0, in addition
+//' to the actions outlined for option \code{1}.
+//' @param exp_tol A numeric value used to indicate a maximum value to set
+//' exponents to in the core kernel to prevent numerical overflow. Defaults to
+//' \code{700}.
+//' @param sub_warnings A logical value indicating whether to warn the user if
+//' density dependence yields matrix values outside of the realm of possibility.
+//' Generally, this means that survival-transition elements altered to values
+//' outside of the interval [0, 1], and negative fecundity values, will both
+//' yield warnings. Defaults to \code{TRUE}, but becomes \code{FALSE} if
+//' \code{quiet = TRUE}.
+//' @param quiet A logical value indicating whether to suppress warnings.
+//' Defaults to \code{FALSE}.
+//' @param year Either a single integer value corresponding to the year to
+//' project, or a vector of \code{times} elements with the year to use at each
+//' time step. If a vector shorter than \code{times} is supplied, then this
+//' vector will be cycled. If not provided, then all annual matrices will be
+//' cycled within patches or populations.
+//' @param start_vec An optional numeric vector denoting the starting stage
+//' distribution for the projection. Defaults to a single individual of each
+//' stage.
+//' @param start_frame An optional data frame characterizing stages, age-stages,
+//' or stage-pairs that should be set to non-zero values in the starting vector,
+//' and what those values should be. Can only be used with \code{lefkoMat}
+//' objects.
+//' @param tweights An optional numeric vector or matrix denoting the
+//' probabilities of choosing each matrix in a stochastic projection. If a
+//' matrix is input, then a first-order Markovian environment is assumed, in
 //' which the probability of choosing a specific annual matrix depends on which
 //' annual matrix is currently chosen. If a vector is input, then the choice of
 //' annual matrix is assumed to be independent of the current matrix. Defaults
@@ -17293,6 +18706,23 @@ arma::mat proj3dens(const arma::vec& start_vec, const RObject& stage_weights,
 //' standard, square matrices with at least 50 rows and no more than 50\% of
 //' elements with values greater than zero, or when input \code{lefkoMat}
 //' objects include matrices of class \code{dgCMatrix}.
+//' @param periodic A logical value indicating whether to project deterministic
+//' cycles of matrices directly to the final occasion, using powers of the
+//' product of the matrices in one cycle. Only used if \code{growthonly = TRUE}.
+//' Defaults to \code{FALSE}.
+//' @param conv_tol If positive, deterministic projections stop once no element
+//' of the stage distribution changes by more than this amount between
+//' consecutive occasions, and the remaining occasions are extrapolated from the
+//' final growth rate. Only used if \code{growthonly = TRUE}. Defaults to
+//' \code{0}.
+//' @param demostoch A logical value indicating whether to project whole
+//' individuals with demographic stochasticity, drawing survival-transition
+//' fates from the \code{U} matrices and offspring from the \code{F} matrices.
+//' Defaults to \code{FALSE}.
+//' @param quasi_ext If positive, the quasi-extinction threshold. Replicates are
+//' then only followed until the weighted population size falls below this
+//' threshold, and extinction risk is returned instead of projections. Defaults
+//' to \code{0}.
 //' 
 //' @return A list of class \code{lefkoProj}, which always includes the first
 //' three elements of the following, and also includes the remaining elements
@@ -17329,7 +18759,8 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
   Nullable<IntegerVector> year = R_NilValue, Nullable<NumericVector> start_vec = R_NilValue,
   Nullable<DataFrame> start_frame = R_NilValue, Nullable<RObject> tweights = R_NilValue,
   Nullable<RObject> density = R_NilValue, Nullable<RObject> stage_weights = R_NilValue,
-  Nullable<RObject> sparse = R_NilValue) {
+  Nullable<RObject> sparse = R_NilValue, bool periodic = false,
+  double conv_tol = 0.0, bool demostoch = false, double quasi_ext = 0.0) {
   
   Rcpp::List dens_index;
   Rcpp::DataFrame dens_input;
@@ -17355,6 +18786,75 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
   if (theclairvoyant < 1) pop_error("times", "a positive integer", "", 1);
   if (nreps < 1) pop_error("nreps", "a positive integer", "", 1);
   if (substoch < 0 || substoch > 2) pop_error("substoch", "integer 0, 1, or 2", "", 1);
+  if (conv_tol < 0.0) pop_error("conv_tol", "a non-negative number", "", 1);
+  if (quasi_ext < 0.0) pop_error("quasi_ext", "a non-negative number", "", 1);
+  
+  if (periodic) {
+    if (stochastic) {
+      throw Rcpp::exception("Argument periodic cannot be used when stochastic = TRUE.",
+        false);
+    }
+    if (density.isNotNull()) {
+      throw Rcpp::exception("Argument periodic cannot be used in density dependent projections.",
+        false);
+    }
+    if (integeronly) {
+      throw Rcpp::exception("Argument periodic cannot be used when integeronly = TRUE.",
+        false);
+    }
+  }
+  
+  if (conv_tol > 0.0) {
+    if (stochastic) {
+      throw Rcpp::exception("Argument conv_tol cannot be used when stochastic = TRUE.",
+        false);
+    }
+    if (density.isNotNull()) {
+      throw Rcpp::exception("Argument conv_tol cannot be used in density dependent projections.",
+        false);
+    }
+    if (integeronly) {
+      throw Rcpp::exception("Argument conv_tol cannot be used when integeronly = TRUE.",
+        false);
+    }
+  }
+  
+  if (demostoch) {
+    if (density.isNotNull()) {
+      throw Rcpp::exception("Argument demostoch cannot be used in density dependent projections.",
+        false);
+    }
+    if (periodic || conv_tol > 0.0) {
+      throw Rcpp::exception("Argument demostoch cannot be used with arguments periodic or conv_tol.",
+        false);
+    }
+    if (standardize || !growthonly) {
+      throw Rcpp::exception("Argument demostoch requires standardize = FALSE and growthonly = TRUE.",
+        false);
+    }
+  }
+  
+  // Quasi-extinction analysis replaces stored trajectories
+  bool pva_used = (quasi_ext > 0.0);
+  if (pva_used) {
+    if (density.isNotNull()) {
+      throw Rcpp::exception("Argument quasi_ext cannot be used in density dependent projections.",
+        false);
+    }
+    if (periodic || conv_tol > 0.0 || standardize) {
+      throw Rcpp::exception("Argument quasi_ext cannot be used with arguments periodic, conv_tol, or standardize.",
+        false);
+    }
+  }
+  bool collect_orders = (demostoch || pva_used);
+  
+  // Periodic projection only used if no occasion-specific vectors are needed
+  bool periodic_used = (periodic && growthonly);
+  int output_times = (periodic_used ? 1 : times);
+  
+  // Early termination at convergence, with deterministic replicates identical
+  bool conv_used = (conv_tol > 0.0 && growthonly && !periodic_used);
+  double used_tol = (conv_used ? conv_tol : 0.0);
   
   if (quiet) sub_warnings = false;
   
@@ -17515,10 +19015,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
         member_sum = 0;
       }
       
-      StringVector years_pre (times);
+      int years_needed = (periodic_used ? static_cast<int>(years_.length()) : times);
+      StringVector years_pre (years_needed);
       
       int rampant_exigence {0};
-      for (int i = 0; i < times; i++) {
+      for (int i = 0; i < years_needed; i++) {
         years_pre(i) = years_(rampant_exigence);
         rampant_exigence++;
         
@@ -17669,81 +19170,22 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     }
     
     List projection_list(trials);
+    NumericVector periodic_lambdas(trials);
+    NumericVector periodic_log_sizes(trials);
+    IntegerVector conv_steps(trials, NA_INTEGER);
+    
+    arma::mat ext_risk;
+    IntegerMatrix ext_times;
+    if (pva_used) {
+      ext_risk.zeros(trials, (theclairvoyant + 1));
+      ext_times = IntegerMatrix(trials, nreps);
+    }
     
     //Rcout << "projection3_single G" << endl;
     
     if(start_frame.isNotNull()) {
-      Rcpp::DataFrame start_thru(start_frame);
-      startvec.set_size(meanmatrows);
-      startvec.zeros();
-      
-      arma::uvec start_elems = as<arma::uvec>(start_thru["row_num"]);
-      start_elems = start_elems - 1;
-      arma::vec start_values = as<arma::vec>(start_thru["value"]);
-      
-      // Here we will check to make sure the row designations are consistent
-      // with the stageframe, and if not, fix them
-      StringVector startframe_stage2 = as<StringVector>(start_thru["stage2"]);
-      StringVector startframe_stage1 = as<StringVector>(start_thru["stage1"]);
-      IntegerVector startframe_age2 = as<IntegerVector>(start_thru["age2"]);
-      int startframe_rows = startframe_stage2.length();
-      
-      if (agestage_format) {
-        StringVector agestages_stage = as<StringVector>(agestages["stage"]);
-        IntegerVector agestages_age = as<IntegerVector>(agestages["age"]);
-        int agestages_rows = agestages_stage.length();
-        
-        for (int i = 0; i < startframe_rows; i++) { 
-          for (int j = 0; j < agestages_rows; j++) {
-            for (int k = 0; k < agestages_rows; k++) {
-              if (LefkoUtils::stringcompare_simple(String(agestages_stage(j)),
-                    String(startframe_stage2(i)))) {
-                if (agestages_age(k) == startframe_age2(i)) {
-                  start_elems(i) = k;
-                }
-              }
-            }
-          }
-        }
-      } else if (historical) {
-        StringVector hstages_stage2 = as<StringVector>(hstages["stage_2"]);
-        StringVector hstages_stage1 = as<StringVector>(hstages["stage_1"]);
-        int hstages_rows = hstages_stage2.length();
-        
-        for (int i = 0; i < startframe_rows; i++) { 
-          for (int j = 0; j < hstages_rows; j++) {
-            for (int k = 0; k < hstages_rows; k++) {
-              if (LefkoUtils::stringcompare_simple(String(hstages_stage2(j)),
-                    String(startframe_stage2(i)))) {
-                if (LefkoUtils::stringcompare_simple(String(hstages_stage1(k)),
-                    String(startframe_stage1(i)))) {
-                  start_elems(i) = k;
-                }
-              }
-            }
-          }
-        }
-      } else {
-        StringVector stageframe_stage2 = as<StringVector>(stageframe["stage"]);
-        int stageframe_rows = stageframe_stage2.length();
-        
-        for (int i = 0; i < startframe_rows; i++) { 
-          for (int j = 0; j < stageframe_rows; j++) {
-            if (LefkoUtils::stringcompare_simple(String(stageframe_stage2(j)),
-                  String(startframe_stage2(i)))) {
-              start_elems(i) = j;
-            }
-          }
-        }
-      }
-      
-      if (static_cast<int>(start_elems.max()) > (meanmatrows - 1)) {
-        throw Rcpp::exception("Start vector input frame includes element indices too high for this MPM.",
-          false);
-      }
-      for (int i = 0; i < static_cast<int>(start_elems.n_elem); i++) {
-        startvec(start_elems(i)) = start_values(i);
-      }
+      startvec = start_frame_vec(Rcpp::DataFrame(start_frame), meanmatrows,
+        agestage_format, historical, stageframe, hstages, agestages);
       
     } else if (start_vec.isNotNull()) {
       startvec = as<arma::vec>(start_vec);
@@ -17817,9 +19259,10 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
       arma::uvec thenumbersofthebeast = find(ppcindex == allppcs(i));
       int chosen_yl = static_cast<int>(thenumbersofthebeast.n_elem);
       
-      arma::uvec pre_prophecy (theclairvoyant, fill::zeros);
+      int years_forward_length = static_cast<int>(years_forward.length());
+      arma::uvec pre_prophecy (years_forward_length, fill::zeros);
       if (year_override) {
-        for (int j = 0; j < theclairvoyant; j++) {
+        for (int j = 0; j < years_forward_length; j++) {
           IntegerVector tnb_year_indices_IV = (match(as<StringVector>(years_forward(j)),
             yearorder) - 1) + (i * yl);
           arma::uvec tnb_year_indices = as<arma::uvec>(tnb_year_indices_IV);
@@ -17830,6 +19273,28 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
         }
       }
       
+      if (periodic_used) {
+        // Deterministic cycle projected through powers of the period product
+        arma::uvec period_order = thenumbersofthebeast;
+        if (year_override) period_order = pre_prophecy;
+        
+        double period_lambda {0.0};
+        double log_size {0.0};
+        arma::mat periodic_proj = proj3periodic(startvec, amats, period_order,
+          theclairvoyant, standardize, (sparse_input || sparse_switch == 1),
+          period_lambda, log_size);
+        
+        projection = repmat(periodic_proj, nreps, 1);
+        projection_list(i) = projection;
+        periodic_lambdas(i) = period_lambda;
+        periodic_log_sizes(i) = log_size;
+        continue;
+      }
+      
+      // Occasion orders of all replicates, projected together if needed
+      arma::umat rep_orders;
+      if (collect_orders) rep_orders.set_size(theclairvoyant, nreps);
+      
       // Replicate loop, creating final data frame of results for each pop-patch
       for (int rep = 0; rep < nreps; rep++) {
         if (stochastic && !assume_markov) {
@@ -17862,6 +19327,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
           }
         }
         
+        if (collect_orders) {
+          rep_orders.col(rep) = theprophecy;
+          continue;
+        }
+        
         if (dens_switch) {
           RObject stage_weights_input = RObject(stage_weights);
           RObject dens_RO = RObject(density);
@@ -17885,10 +19355,17 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
           if (rep == 0) {
             if (!sparse_input) {
               projection = proj3(startvec, amats, theprophecy, standardize,
-                growthonly, integeronly, sparse_auto, sparse_switch);
+                growthonly, integeronly, sparse_auto, sparse_switch, used_tol);
             } else {
               projection = proj3sp(startvec, amats, theprophecy, standardize,
-                growthonly, integeronly);
+                growthonly, integeronly, used_tol);
+            }
+            
+            if (conv_used) {
+              conv_steps(i) = conv_extend(projection, theclairvoyant, standardize,
+                theprophecy);
+              projection = repmat(projection, nreps, 1);
+              break;
             }
           } else {
             if (!sparse_input) {
@@ -17904,6 +19381,16 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
         }
       }
       
+      if (pva_used) {
+        arma::ivec ext_occasions = proj3pva(startvec, amats, umats, fmats,
+          rep_orders, equivalence_vec_arma, quasi_ext,
+          (!sparse_input && sparse_switch == 0), demostoch, integeronly);
+        pva_record(ext_risk, ext_times, ext_occasions, i);
+        continue;
+      } else if (demostoch) {
+        projection = proj3demog(startvec, umats, fmats, rep_orders);
+      }
+      
       projection_list(i) = projection;
     }
     
@@ -17913,6 +19400,8 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     arma::uvec popmatch(loysize, fill::zeros);
     arma::uvec yearmatch(loysize, fill::zeros);
     List meanmatyearlist(uniqueyears.length());
+    List meanuyearlist(uniqueyears.length());
+    List meanfyearlist(uniqueyears.length());
     
     if (allppcsnem > 1) { // Checks pop-mean matrices separately from patch means
       pop_est = trials - allppcsnem;
@@ -17971,6 +19460,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
             happymedium.reshape(meanmatrows, meanmatrows);
             meanmatyearlist(j) = happymedium;
           }
+          
+          if (demostoch) {
+            meanuyearlist(j) = demog_mean(umats, crankybanky, sparse_input);
+            meanfyearlist(j) = demog_mean(fmats, crankybanky, sparse_input);
+          }
         }
         
         int numyearsused = meanmatyearlist.length();
@@ -17978,6 +19472,23 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
           numyearsused);
         int chosen_yl = static_cast<int>(choicevec.n_elem);
         
+        if (periodic_used) {
+          double period_lambda {0.0};
+          double log_size {0.0};
+          arma::mat periodic_proj = proj3periodic(startvec, meanmatyearlist,
+            choicevec, theclairvoyant, standardize,
+            (sparse_input || sparse_switch == 1), period_lambda, log_size);
+          
+          projection = repmat(periodic_proj, nreps, 1);
+          projection_list(allppcsnem + i) = projection;
+          periodic_lambdas(allppcsnem + i) = period_lambda;
+          periodic_log_sizes(allppcsnem + i) = log_size;
+          continue;
+        }
+        
+        arma::umat rep_orders;
+        if (collect_orders) rep_orders.set_size(theclairvoyant, nreps);
+        
         // Replicate loop, creating final data frame of results for pop means
         for (int rep = 0; rep < nreps; rep++) {
           if (stochastic && !assume_markov) {
@@ -18004,6 +19515,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
             }
           }
           
+          if (collect_orders) {
+            rep_orders.col(rep) = theprophecy;
+            continue;
+          }
+          
           if (dens_switch) {
             RObject stage_weights_input = RObject(stage_weights);
             RObject dens_RO = RObject(density);
@@ -18026,10 +19542,18 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
             if (rep == 0) {
               if (!sparse_input) {
                 projection = proj3(startvec, meanmatyearlist, theprophecy,
-                  standardize, growthonly, integeronly, sparse_auto, sparse_switch);
+                  standardize, growthonly, integeronly, sparse_auto, sparse_switch,
+                  used_tol);
               } else {
                 projection = proj3sp(startvec, meanmatyearlist, theprophecy,
-                  standardize, growthonly, integeronly);
+                  standardize, growthonly, integeronly, used_tol);
+              }
+              
+              if (conv_used) {
+                conv_steps(allppcsnem + i) = conv_extend(projection,
+                  theclairvoyant, standardize, theprophecy);
+                projection = repmat(projection, nreps, 1);
+                break;
               }
             } else {
               if (!sparse_input) {
@@ -18044,17 +19568,40 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
             }
           }
         }
+        
+        if (pva_used) {
+          arma::ivec ext_occasions = proj3pva(startvec, meanmatyearlist,
+            meanuyearlist, meanfyearlist, rep_orders, equivalence_vec_arma,
+            quasi_ext, (!sparse_input && sparse_switch == 0), demostoch,
+            integeronly);
+          pva_record(ext_risk, ext_times, ext_occasions, allppcsnem + i);
+          continue;
+        } else if (demostoch) {
+          projection = proj3demog(startvec, meanuyearlist, meanfyearlist,
+            rep_orders);
+        }
         projection_list(allppcsnem + i) = projection;
       }
     }
     
     //Rcout << "projection3_single K" << endl;
     
+    if (pva_used) {
+      DataFrame pva_labels = DataFrame::create(_["pop"] = mmpops,
+        _["patch"] = mmpatches);
+      Rcpp::IntegerVector control = {nreps, times};
+      
+      fin_out = List::create(_["ext_risk"] = ext_risk, _["ext_time"] = ext_times,
+        _["labels"] = pva_labels, _["control"] = control,
+        _["quasi_ext"] = quasi_ext);
+      return;
+    }
+    
     // Output proj list w/ #elem = nreps nested within list w/ #elem = #poppatches
     List projection_set(nreps);
     List ss_set(nreps);
     List rv_set(nreps);
-    arma::mat total_sizes_set(nreps, (times+1), fill::zeros);
+    arma::mat total_sizes_set(nreps, (output_times+1), fill::zeros);
     
     int length_ppy = projection_list.length();
     List final_projection(length_ppy);
@@ -18063,12 +19610,13 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     List final_ns(length_ppy);
     
     int out_elements {9};
-    if (dens_switch) out_elements++;
+    if (dens_switch || periodic_used || conv_used) out_elements++;
+    if (periodic_used && !dens_switch) out_elements++;
     
     List output (out_elements);
     
     if (!growthonly) {
-      arma::mat list_proj(total_projrows, (times+1), fill::zeros);
+      arma::mat list_proj(total_projrows, (output_times+1), fill::zeros);
       arma::mat extracted_proj(used_matsize, used_matsize, fill::zeros);
       int diversion = used_matsize * 3 + 1;
       
@@ -18097,7 +19645,7 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
       }
       
     } else {
-      arma::mat list_proj(total_projrows, (times+1), fill::zeros);
+      arma::mat list_proj(total_projrows, (output_times+1), fill::zeros);
       arma::mat extracted_proj(used_matsize, used_matsize, fill::zeros);
       int diversion = used_matsize;
       
@@ -18122,7 +19670,7 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     
     DataFrame newlabels = DataFrame::create(_["pop"] = mmpops,
       _["patch"] = mmpatches);
-    Rcpp::IntegerVector control = {nreps, times};
+    Rcpp::IntegerVector control = {nreps, output_times};
     
     output(0) = final_projection;
     output(1) = final_ss;
@@ -18140,7 +19688,21 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
       output(9) = dens_input;
       
       CharacterVector namevec = {"projection", "stage_dist", "rep_value", "pop_size",
-        "labels", "ahstages", "hstages", "agestages", "control", "density"};
+        "labels", "ahstages", "hstages", "agestages", "control", "density"};
+      output.attr("names") = namevec;
+    } else if (periodic_used) {
+      output(9) = periodic_lambdas;
+      output(10) = periodic_log_sizes;
+      
+      CharacterVector namevec = {"projection", "stage_dist", "rep_value", "pop_size",
+        "labels", "ahstages", "hstages", "agestages", "control", "periodic_lambda",
+        "periodic_log_size"};
+      output.attr("names") = namevec;
+    } else if (conv_used) {
+      output(9) = conv_steps;
+      
+      CharacterVector namevec = {"projection", "stage_dist", "rep_value", "pop_size",
+        "labels", "ahstages", "hstages", "agestages", "control", "convergence"};
       output.attr("names") = namevec;
     } else {
       CharacterVector namevec = {"projection", "stage_dist", "rep_value", "pop_size",
@@ -18156,6 +19718,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     
     //Rcout << "projection3_single N" << endl;
     
+    if (demostoch) {
+      throw Rcpp::exception("Argument demostoch requires a lefkoMat object with U and F matrices.",
+        false);
+    }
+    
     List projection_list (1);
     List amats = mpm;
     DataFrame hstages;
@@ -18257,10 +19824,11 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
         member_sum = 0;
       }
       
-      IntegerVector years_pre (times);
+      int years_needed = (periodic_used ? static_cast<int>(years_.length()) : times);
+      IntegerVector years_pre (years_needed);
       
       int rampant_exigence {0};
-      for (int i = 0; i < times; i++) {
+      for (int i = 0; i < years_needed; i++) {
         years_pre(i) = years_(rampant_exigence);
         rampant_exigence++;
         
@@ -18367,89 +19935,149 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
     // Run simulation, estimate descriptive metrics
     if (!assume_markov) twinput = twinput / sum(twinput);
     arma::uvec thenumbersofthebeast = uniqueyears;
+    double period_lambda {0.0};
+    double log_size {0.0};
+    int conv_step {NA_INTEGER};
     
-    // Replicate loop, creating a data frame of results
-    for (int rep = 0; rep < nreps; rep++) {
-      if (stochastic && !assume_markov) {
-        theprophecy = Rcpp::RcppArmadillo::sample(thenumbersofthebeast,
-          theclairvoyant, true, twinput);
-        
-      } else if (stochastic && assume_markov) {
-        for (int yr_counter = 0; yr_counter < theclairvoyant; yr_counter++) {
-          if (yr_counter == 0) {
-            twinput = twinput_markov.col(0);
-          }
-          twinput = twinput / sum(twinput);
+    if (periodic_used) {
+      // Deterministic cycle projected through powers of the period product
+      arma::uvec period_order = thenumbersofthebeast;
+      if (year_override) period_order = as<arma::uvec>(years_forward);
+      
+      arma::mat periodic_proj = proj3periodic(startvec, amats, period_order,
+        theclairvoyant, standardize, (sparse_input || sparse_switch == 1),
+        period_lambda, log_size);
+      projection = repmat(periodic_proj, nreps, 1);
+      
+    } else {
+      arma::umat rep_orders;
+      if (pva_used) rep_orders.set_size(theclairvoyant, nreps);
+      
+      // Replicate loop, creating a data frame of results
+      for (int rep = 0; rep < nreps; rep++) {
+        if (stochastic && !assume_markov) {
+          theprophecy = Rcpp::RcppArmadillo::sample(thenumbersofthebeast,
+            theclairvoyant, true, twinput);
           
-          arma::uvec theprophecy_piecemeal = Rcpp::RcppArmadillo::sample(thenumbersofthebeast,
-            1, true, twinput);
-          theprophecy(yr_counter) = theprophecy_piecemeal(0);
+        } else if (stochastic && assume_markov) {
+          for (int yr_counter = 0; yr_counter < theclairvoyant; yr_counter++) {
+            if (yr_counter == 0) {
+              twinput = twinput_markov.col(0);
+            }
+            twinput = twinput / sum(twinput);
             
-          arma::uvec tnotb_preassigned = find(thenumbersofthebeast == theprophecy_piecemeal(0));
-          twinput = twinput_markov.col(static_cast<int>(tnotb_preassigned(0)));
+            arma::uvec theprophecy_piecemeal = Rcpp::RcppArmadillo::sample(thenumbersofthebeast,
+              1, true, twinput);
+            theprophecy(yr_counter) = theprophecy_piecemeal(0);
+              
+            arma::uvec tnotb_preassigned = find(thenumbersofthebeast == theprophecy_piecemeal(0));
+            twinput = twinput_markov.col(static_cast<int>(tnotb_preassigned(0)));
+          }
+        } else if (year_override) {
+          theprophecy = as<arma::uvec>(years_forward);
+          
+        } else {
+          theprophecy.zeros();
+          for (int i = 0; i < theclairvoyant; i++) {
+            theprophecy(i) = thenumbersofthebeast(i % yl);
+          }
         }
-      } else if (year_override) {
-        theprophecy = as<arma::uvec>(years_forward);
         
-      } else {
-        theprophecy.zeros();
-        for (int i = 0; i < theclairvoyant; i++) {
-          theprophecy(i) = thenumbersofthebeast(i % yl);
+        if (pva_used) {
+          rep_orders.col(rep) = theprophecy;
+          continue;
         }
-      }
-      
-      if (dens_switch) {
-        RObject stage_weights_input = RObject(stage_weights);
-        RObject dens_RO = RObject(density);
         
-        if (rep == 0) {
-          projection = proj3dens(startvec, stage_weights_input, amats,
-            theprophecy, growthonly, integeronly, substoch, dens_RO, hstages,
-            stageframe, dens_list_length, eq_list_length, exp_tol, format,
-            used_matsize, historical, equiv_used, sparse_auto, sparse_switch,
-            sparse_input, sub_warnings);
+        if (dens_switch) {
+          RObject stage_weights_input = RObject(stage_weights);
+          RObject dens_RO = RObject(density);
           
-        } else {
-          arma::mat nextproj = proj3dens(startvec, stage_weights_input, amats,
-            theprophecy, growthonly, integeronly, substoch, dens_RO, hstages,
-            stageframe, dens_list_length, eq_list_length, exp_tol, format,
-            used_matsize, historical, equiv_used, sparse_auto, sparse_switch,
-            sparse_input, sub_warnings);
-          projection = arma::join_cols(projection, nextproj);
-        }
-      } else {
-        if (!sparse_input) {
           if (rep == 0) {
-            projection = proj3(startvec, amats, theprophecy, standardize,
-              growthonly, integeronly, sparse_auto, sparse_switch);
+            projection = proj3dens(startvec, stage_weights_input, amats,
+              theprophecy, growthonly, integeronly, substoch, dens_RO, hstages,
+              stageframe, dens_list_length, eq_list_length, exp_tol, format,
+              used_matsize, historical, equiv_used, sparse_auto, sparse_switch,
+              sparse_input, sub_warnings);
             
           } else {
-            arma::mat nextproj = proj3(startvec, amats, theprophecy, standardize,
-              growthonly, integeronly, sparse_auto, sparse_switch);
+            arma::mat nextproj = proj3dens(startvec, stage_weights_input, amats,
+              theprophecy, growthonly, integeronly, substoch, dens_RO, hstages,
+              stageframe, dens_list_length, eq_list_length, exp_tol, format,
+              used_matsize, historical, equiv_used, sparse_auto, sparse_switch,
+              sparse_input, sub_warnings);
             projection = arma::join_cols(projection, nextproj);
           }
         } else {
-          if (rep == 0) {
-            projection = proj3sp(startvec, amats, theprophecy, standardize,
-              growthonly, integeronly);
-            
+          if (!sparse_input) {
+            if (rep == 0) {
+              projection = proj3(startvec, amats, theprophecy, standardize,
+                growthonly, integeronly, sparse_auto, sparse_switch, used_tol);
+              
+            } else {
+              arma::mat nextproj = proj3(startvec, amats, theprophecy, standardize,
+                growthonly, integeronly, sparse_auto, sparse_switch);
+              projection = arma::join_cols(projection, nextproj);
+            }
           } else {
-            arma::mat nextproj = proj3sp(startvec, amats, theprophecy,
-              standardize, growthonly, integeronly);
-            projection = arma::join_cols(projection, nextproj);
+            if (rep == 0) {
+              projection = proj3sp(startvec, amats, theprophecy, standardize,
+                growthonly, integeronly, used_tol);
+              
+            } else {
+              arma::mat nextproj = proj3sp(startvec, amats, theprophecy,
+                standardize, growthonly, integeronly);
+              projection = arma::join_cols(projection, nextproj);
+            }
+          }
+          
+          if (conv_used) {
+            conv_step = conv_extend(projection, theclairvoyant, standardize,
+              theprophecy);
+            projection = repmat(projection, nreps, 1);
+            break;
           }
         }
       }
+      
+      if (pva_used) {
+        arma::ivec ext_occasions = proj3pva(startvec, amats, amats, amats,
+          rep_orders, equivalence_vec_arma, quasi_ext,
+          (!sparse_input && sparse_switch == 0), false, integeronly);
+        
+        arma::mat ext_risk(1, (theclairvoyant + 1), fill::zeros);
+        IntegerMatrix ext_times(1, nreps);
+        pva_record(ext_risk, ext_times, ext_occasions, 0);
+        
+        DataFrame pva_labels = DataFrame::create(_["pop"] = 1, _["patch"] = 1);
+        Rcpp::IntegerVector control = {nreps, times};
+        
+        fin_out = List::create(_["ext_risk"] = ext_risk,
+          _["ext_time"] = ext_times, _["labels"] = pva_labels,
+          _["control"] = control, _["quasi_ext"] = quasi_ext);
+        return;
+      }
     }
-    
+      
     //Rcout << "projection3_single U" << endl;
     
     projection_list(0) = projection;
     DataFrame newlabels = DataFrame::create(_["pop"] = 1, _["patch"] = 1);
-    Rcpp::IntegerVector control = {nreps, times};
-    
-    Rcpp::List output = List::create(_["projection"] = projection_list,
-      _["labels"] = newlabels, _["control"] = control);
+    Rcpp::IntegerVector control = {nreps, output_times};
+    
+    Rcpp::List output;
+    if (periodic_used) {
+      output = List::create(_["projection"] = projection_list,
+        _["labels"] = newlabels, _["control"] = control,
+        _["periodic_lambda"] = period_lambda,
+        _["periodic_log_size"] = log_size);
+    } else if (conv_used) {
+      output = List::create(_["projection"] = projection_list,
+        _["labels"] = newlabels, _["control"] = control,
+        _["convergence"] = conv_step);
+    } else {
+      output = List::create(_["projection"] = projection_list,
+        _["labels"] = newlabels, _["control"] = control);
+    }
     output.attr("class") = "lefkoProj";
     
     fin_out = output;
@@ -18548,6 +20176,27 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
 //' standard, square matrices with at least 50 rows and no more than 50\% of
 //' elements with values greater than zero, or when input \code{lefkoMat}
 //' objects include matrices of class \code{dgCMatrix}.
+//' @param periodic A logical value indicating whether to project deterministic
+//' cycles of matrices directly to the final occasion, using powers of the
+//' product of the matrices in one cycle. Only used if \code{growthonly = TRUE}.
+//' Defaults to \code{FALSE}.
+//' @param conv_tol A non-negative number. If positive, then deterministic
+//' projections stop once no element of the stage distribution changes by more
+//' than this amount between consecutive cycles of matrices, and the remaining
+//' occasions are extrapolated from the population growth rate across the last
+//' cycle. With a single matrix, each cycle is one occasion long. Only used if
+//' \code{growthonly = TRUE} and \code{periodic = FALSE}, and cannot be used
+//' with \code{integeronly = TRUE}. Defaults to \code{0}, in which case all
+//' occasions are projected.
+//' @param demostoch A logical value indicating whether to include demographic
+//' stochasticity, by projecting whole individuals whose fates are drawn at
+//' random from the \code{U} and \code{F} matrices of a \code{lefkoMat} object
+//' at each occasion. Defaults to \code{FALSE}.
+//' @param quasi_ext A non-negative number. If positive, then the function
+//' conducts a quasi-extinction analysis, in which each replicate is projected
+//' only until the population size, weighted as in \code{stage_weights}, falls
+//' below this threshold. Defaults to \code{0}, in which case a standard
+//' projection is conducted.
 //' 
 //' @return If a \code{lefkoMat} object or a simple list of matrices is used as
 //' input, then this function will produce a list of class \code{lefkoProj},
@@ -18576,6 +20225,29 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
 //' number of occasions projected per replicate.}
 //' \item{density}{The data frame input under the density option. Only provided
 //' if input by the user.}
+//' \item{periodic_lambda}{A vector giving the periodic population growth rate
+//' per occasion in each pop-patch or population. Only provided if
+//' \code{periodic = TRUE}.}
+//' \item{periodic_log_size}{A vector giving the natural logarithm of the
+//' population size at the final occasion in each pop-patch or population. Only
+//' provided if \code{periodic = TRUE}.}
+//' \item{convergence}{A vector giving the occasion at which the stage
+//' distribution converged in each pop-patch or population, or \code{NA} if it
+//' did not converge. Only provided if \code{conv_tol} is positive.}
+//' 
+//' If \code{quasi_ext} is positive, then projections are not stored, and the
+//' list instead includes the following elements:
+//' \item{ext_risk}{A matrix giving the cumulative proportion of replicates that
+//' have fallen below the quasi-extinction threshold by each occasion, with
+//' pop-patches and populations in rows and occasions in columns.}
+//' \item{ext_time}{A matrix giving the first occasion at which each replicate
+//' (column) in each pop-patch or population (row) fell below the threshold, or
+//' \code{NA} if it never did.}
+//' \item{labels}{A data frame showing the order of populations and patches in
+//' the rows of \code{ext_risk} and \code{ext_time}.}
+//' \item{control}{A short vector indicating the number of replicates and the
+//' number of occasions projected per replicate.}
+//' \item{quasi_ext}{The quasi-extinction threshold used.}
 //' 
 //' If a \code{lefkoMatList} object is entered, then this function will produce
 //' a list of class \code{lefkoProjList}, in which each element is an object of
@@ -18664,6 +20336,69 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
 //' since the population size can reach extremely small levels without dropping
 //' to 0.
 //' 
+//' Long deterministic projections through repeating sequences of matrices,
+//' whether set by \code{year} or by the default cycling of annual matrices,
+//' can be run much faster with \code{periodic = TRUE}. In this case, the
+//' product of the matrices in one cycle is formed once, and the population is
+//' projected to occasion \code{times} via repeated squaring of this product,
+//' so that runtime grows with the logarithm of \code{times}. Only the starting
+//' and final occasions are then given in \code{projection} and
+//' \code{pop_size}, element \code{control} gives a single occasion, and the
+//' periodic population growth rate per occasion, estimated as the dominant
+//' eigenvalue of the cycle product raised to the inverse of the cycle length,
+//' is given in element \code{periodic_lambda}. Because population sizes over
+//' very long horizons may be too large or too small to store, the final
+//' occasion in \code{projection} is standardized to sum to 1, and the natural
+//' logarithm of the final population size is given in element
+//' \code{periodic_log_size}. The projected numbers of individuals are then
+//' this stage distribution multiplied by \code{exp(periodic_log_size)}, and
+//' the final occasion in \code{pop_size} is 1. Periodic projection cannot be
+//' used with stochastic or density dependent projections, or with
+//' \code{integeronly = TRUE}. If \code{growthonly = FALSE}, then stage
+//' distributions and reproductive values are needed at each occasion, and so
+//' the projection is run through all occasions as usual.
+//' 
+//' Deterministic projections through a single matrix typically reach the
+//' stable stage distribution long before the default 10,000 occasions. Setting
+//' \code{conv_tol} to a small positive value, such as \code{1e-10}, stops the
+//' projection once the stage distribution changes by less than this amount
+//' between occasions, and fills the remaining occasions by growing the last
+//' projected vector at the final population growth rate, or by repeating it if
+//' \code{standardize = TRUE}. Deterministic projections cycling through
+//' several annual matrices are instead tested for convergence between the ends
+//' of consecutive cycles, and the remaining occasions are filled by repeating
+//' the last cycle at the growth rate across that cycle. The occasion of
+//' convergence is given in element \code{convergence}. Because all replicates
+//' of a deterministic projection are identical, the first replicate is also
+//' copied into the others. Convergence cannot be used with stochastic or
+//' density dependent projections, or with \code{integeronly = TRUE}.
+//' 
+//' Setting \code{integeronly = TRUE} rounds the expected numbers of
+//' individuals down, but does not add demographic stochasticity. Setting
+//' \code{demostoch = TRUE} instead projects whole individuals, as needed in
+//' the viability analysis of small populations. At each occasion, the
+//' individuals in each stage are assigned to the stages given by the
+//' corresponding column of the \code{U} matrix, or to death, through a
+//' multinomial draw, and the offspring produced in each stage are drawn from
+//' Poisson distributions with means given by the numbers of parents and the
+//' corresponding elements of the \code{F} matrix. Large numbers of individuals
+//' are drawn with transformed rejection samplers, so that runtime does not grow
+//' with population size, and replicates are run in parallel. The starting
+//' vector is rounded to whole individuals. This option requires a
+//' \code{lefkoMat} object as input, and cannot be used with density
+//' dependence, periodic or convergence-based projection, or with
+//' \code{standardize = TRUE} or \code{growthonly = FALSE}.
+//' 
+//' Setting \code{quasi_ext} to a positive number conducts a population
+//' viability analysis. Each replicate stops as soon as its population size
+//' falls below the threshold, so that extinction-prone scenarios run quickly
+//' and no trajectories need to be stored. Population size is weighted by the
+//' first element of \code{stage_weights}, if provided, and otherwise equals
+//' the total number of individuals across stages. It may be combined with
+//' \code{stochastic = TRUE} and \code{demostoch = TRUE}, but not with density
+//' dependence, periodic or convergence-based projection, or
+//' \code{standardize = TRUE}. Argument \code{growthonly} is ignored.
+//' 
 //' @seealso \code{\link{start_input}()}
 //' @seealso \code{\link{density_input}()}
 //' @seealso \code{\link{f_projection3}()}
@@ -18705,15 +20440,374 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
 //'   type = c(1, 1, 1, 1, 3, 3), type_t12 = c(1, 2, 1, 2, 1, 1),
 //'   stageframe = lathframe, historical = TRUE)
 //' 
-//' ehrlen3 <- rlefko3(data = lathvert, stageframe = lathframe,
-//'   year = c(1989, 1990), stages = c("stage3", "stage2", "stage1"),
-//'   supplement = lathsupp3, yearcol = "year2", indivcol = "individ")
+//' ehrlen3 <- rlefko3(data = lathvert, stageframe = lathframe,
+//'   year = c(1989, 1990), stages = c("stage3", "stage2", "stage1"),
+//'   supplement = lathsupp3, yearcol = "year2", indivcol = "individ")
+//' 
+//' lathproj <- projection3(ehrlen3, nreps = 5, stochastic = TRUE)
+//' 
+//' # Cypripedium example
+//' data(cypdata)
+//'  
+//' sizevector <- c(0, 0, 0, 0, 0, 0, 1, 2.5, 4.5, 8, 17.5)
+//' stagevector <- c("SD", "P1", "P2", "P3", "SL", "D", "XSm", "Sm", "Md", "Lg",
+//'   "XLg")
+//' repvector <- c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1)
+//' obsvector <- c(0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1)
+//' matvector <- c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1)
+//' immvector <- c(0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0)
+//' propvector <- c(1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+//' indataset <- c(0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1)
+//' binvec <- c(0, 0, 0, 0, 0, 0.5, 0.5, 1, 1, 2.5, 7)
+//' 
+//' cypframe_raw <- sf_create(sizes = sizevector, stagenames = stagevector,
+//'   repstatus = repvector, obsstatus = obsvector, matstatus = matvector, 
+//'   propstatus = propvector, immstatus = immvector, indataset = indataset,
+//'   binhalfwidth = binvec)
+//' 
+//' cypraw_v1 <- verticalize3(data = cypdata, noyears = 6, firstyear = 2004,
+//'   patchidcol = "patch", individcol = "plantid", blocksize = 4, 
+//'   sizeacol = "Inf2.04", sizebcol = "Inf.04", sizeccol = "Veg.04", 
+//'   repstracol = "Inf.04", repstrbcol = "Inf2.04", fecacol = "Pod.04",
+//'   stageassign = cypframe_raw, stagesize = "sizeadded", NAas0 = TRUE, 
+//'   NRasRep = TRUE)
+//' 
+//' cypsupp3r <- supplemental(stage3 = c("SD", "SD", "P1", "P1", "P2", "P3", "SL",
+//'     "D", "XSm", "Sm", "D", "XSm", "Sm", "mat", "mat", "mat", "SD", "P1"),
+//'   stage2 = c("SD", "SD", "SD", "SD", "P1", "P2", "P3", "SL", "SL", "SL", "SL",
+//'     "SL", "SL", "D", "XSm", "Sm", "rep", "rep"),
+//'   stage1 = c("SD", "rep", "SD", "rep", "SD", "P1", "P2", "P3", "P3", "P3",
+//'     "SL", "SL", "SL", "SL", "SL", "SL", "mat", "mat"),
+//'   eststage3 = c(NA, NA, NA, NA, NA, NA, NA, "D", "XSm", "Sm", "D", "XSm", "Sm",
+//'     "mat", "mat", "mat", NA, NA),
+//'   eststage2 = c(NA, NA, NA, NA, NA, NA, NA, "XSm", "XSm", "XSm", "XSm", "XSm",
+//'     "XSm", "D", "XSm", "Sm", NA, NA),
+//'   eststage1 = c(NA, NA, NA, NA, NA, NA, NA, "XSm", "XSm", "XSm", "XSm", "XSm",
+//'     "XSm", "XSm", "XSm", "XSm", NA, NA),
+//'   givenrate = c(0.1, 0.1, 0.2, 0.2, 0.2, 0.2, 0.25, NA, NA, NA, NA, NA, NA,
+//'     NA, NA, NA, NA, NA),
+//'   multiplier = c(NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA,
+//'     NA, 0.5, 0.5),
+//'   type = c(1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3),
+//'   type_t12 = c(1, 2, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
+//'   stageframe = cypframe_raw, historical = TRUE)
+//' 
+//' cypmatrix3r <- rlefko3(data = cypraw_v1, stageframe = cypframe_raw, 
+//'   year = "all", patch = "all", stages = c("stage3", "stage2", "stage1"),
+//'   size = c("size3added", "size2added", "size1added"), 
+//'   supplement = cypsupp3r, yearcol = "year2", 
+//'   patchcol = "patchid", indivcol = "individ")
+//' 
+//' cypstoch <- projection3(cypmatrix3r, nreps = 5, stochastic = TRUE)
+//' cypcycle <- projection3(cypmatrix3r, times = 100000, periodic = TRUE)
+//' 
+//' cypconv <- projection3(cypmatrix3r, year = 2004, conv_tol = 1e-10)
+//' 
+//' cypdemog <- projection3(cypmatrix3r, nreps = 5, times = 50,
+//'   stochastic = TRUE, demostoch = TRUE)
+//' cyppva <- projection3(cypmatrix3r, nreps = 50, times = 100,
+//'   stochastic = TRUE, quasi_ext = 5)
+//' 
+//' @export projection3
+// [[Rcpp::export(projection3)]]
+Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
+  bool historical = false, bool stochastic = false, bool standardize = false,
+  bool growthonly = true, bool integeronly = false, int substoch = 0,
+  double exp_tol = 700.0, bool sub_warnings = true, bool quiet = false,
+  Nullable<IntegerVector> year = R_NilValue, Nullable<NumericVector> start_vec = R_NilValue,
+  Nullable<DataFrame> start_frame = R_NilValue, Nullable<RObject> tweights = R_NilValue,
+  Nullable<RObject> density = R_NilValue, Nullable<RObject> stage_weights = R_NilValue,
+  Nullable<RObject> sparse = R_NilValue, bool periodic = false,
+  double conv_tol = 0.0, bool demostoch = false, double quasi_ext = 0.0) {
+  
+  List final_output;
+  bool lefkoList_true {false};
+  bool lefkoMat_true {false};
+  bool list_true {false};
+  
+  StringVector mpm_class = as<StringVector>(mpm.attr("class"));
+  
+  for (int i = 0; i < static_cast<int>(mpm_class.length()); i++) {
+    if (mpm_class(i) == "lefkoMatList") {
+      lefkoList_true = true;
+    } else if (mpm_class(i) == "lefkoMat") {
+      lefkoMat_true = true;
+    } else if (mpm_class(i) == "list") {
+      list_true = true;
+    }
+  }
+  
+  if (!lefkoList_true && !lefkoMat_true && ! list_true) {
+    throw Rcpp::exception("Function projection3 requires a lefkoMat, lefkoMatList, or matrix list object as input", false);
+  }
+  
+  if (lefkoList_true) {
+    int list_length = static_cast<int>(mpm.length());
+    List pre_final_output (list_length);
+    
+    for (int i = 0; i < list_length; i++) {
+      List current_mpm = as<List>(mpm(i));
+      List current_out;
+      
+      projection3_single(current_out, current_mpm, nreps, times, historical, stochastic,
+        standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings,
+        quiet, year, start_vec, start_frame, tweights, density, stage_weights,
+        sparse, periodic, conv_tol, demostoch, quasi_ext);
+      pre_final_output(i) = current_out;
+    }
+    
+    final_output = pre_final_output;
+    StringVector new_mpm_class = {"lefkoProjList"};
+    final_output.attr("class") = new_mpm_class;
+    
+  } else {
+    projection3_single(final_output, mpm, nreps, times, historical, stochastic,
+      standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings,
+      quiet, year, start_vec, start_frame, tweights, density, stage_weights,
+      sparse, periodic, conv_tol, demostoch, quasi_ext);
+  }
+  
+  return final_output;
+}
+
+//' Finite Difference Jacobian of a Density Dependent Map
+//' 
+//' Function \code{equil_jacobian()} estimates the Jacobian matrix of a density
+//' dependent projection map by forward finite differences, one stage at a
+//' time.
+//' 
+//' @name equil_jacobian
+//' 
+//' @param dens_map The map giving the population vector in the next occasion
+//' as a function of the current population vector.
+//' @param current_n The population vector at which to estimate the Jacobian.
+//' @param mapped_n The result of \code{dens_map} applied to \code{current_n}.
+//' 
+//' @return The Jacobian matrix, in which element \emph{ij} gives the change in
+//' stage \emph{i} in the next occasion per individual added to stage \emph{j}.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename DensMap>
+inline arma::mat equil_jacobian(const DensMap& dens_map,
+  const arma::vec& current_n, const arma::vec& mapped_n) {
+  
+  int nostages = static_cast<int>(current_n.n_elem);
+  arma::mat jacobian (nostages, nostages);
+  arma::vec shifted_n = current_n;
+  
+  for (int j = 0; j < nostages; j++) {
+    double h = 1.0e-7 * std::max(std::abs(current_n(j)), 1.0);
+    shifted_n(j) = current_n(j) + h;
+    jacobian.col(j) = (dens_map(shifted_n) - mapped_n) / h;
+    shifted_n(j) = current_n(j);
+  }
+  
+  return jacobian;
+}
+
+//' Solve for the Fixed Point of a Density Dependent Map
+//' 
+//' Function \code{equil_solve()} finds a population vector \eqn{N} such that
+//' \eqn{A(N) N = N}, by Newton iteration on the residual \eqn{A(N) N - N}, or
+//' by Anderson-accelerated fixed-point iteration.
+//' 
+//' @name equil_solve
+//' 
+//' @param dens_map The map giving the population vector in the next occasion
+//' as a function of the current population vector.
+//' @param equil_n On input, the starting population vector. On output, the
+//' equilibrium population vector.
+//' @param anderson The depth of Anderson acceleration. If \code{0}, then
+//' Newton iteration is used.
+//' @param tol The tolerance, as the largest absolute residual relative to the
+//' largest stage in the population vector.
+//' @param max_iter The maximum number of iterations.
+//' @param iterations Integer to hold the number of iterations used.
+//' 
+//' @return A logical value indicating whether the iteration converged.
+//' 
+//' @section Notes:
+//' Newton steps are halved until they reduce the residual, and population
+//' vectors are kept non-negative. If no halved step reduces the residual, then
+//' a single plain projection step is taken instead.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename DensMap>
+inline bool equil_solve(const DensMap& dens_map, arma::vec& equil_n,
+  int anderson, double tol, int max_iter, int& iterations) {
+  
+  arma::vec current_n = clamp(equil_n, 0.0, arma::datum::inf);
+  arma::vec mapped_n = dens_map(current_n);
+  arma::vec residual = mapped_n - current_n;
+  
+  arma::mat delta_f;
+  arma::mat delta_g;
+  arma::vec prev_residual;
+  arma::vec prev_mapped;
+  
+  bool converged {false};
+  iterations = 0;
+  
+  while (iterations <= max_iter) {
+    double resid_norm = norm(residual, "inf");
+    double scale = std::max(norm(current_n, "inf"), 1.0);
+    if (resid_norm <= tol * scale) {
+      converged = true;
+      break;
+    }
+    if (iterations == max_iter) break;
+    iterations++;
+    
+    if (iterations % 50 == 0) Rcpp::checkUserInterrupt();
+    
+    arma::vec next_n;
+    arma::vec next_mapped;
+    
+    if (anderson == 0) {
+      // Damped Newton step on A(N) N - N
+      arma::mat newton_mat = equil_jacobian(dens_map, current_n, mapped_n);
+      newton_mat.diag() -= 1.0;
+      
+      arma::vec newton_step;
+      bool solved = solve(newton_step, newton_mat, -residual,
+        solve_opts::no_approx);
+      
+      bool improved {false};
+      if (solved && newton_step.is_finite()) {
+        double step_length {1.0};
+        for (int halving = 0; halving < 20; halving++) {
+          next_n = clamp(current_n + step_length * newton_step, 0.0,
+            arma::datum::inf);
+          next_mapped = dens_map(next_n);
+          
+          if (norm(next_mapped - next_n, "inf") < resid_norm) {
+            improved = true;
+            break;
+          }
+          step_length *= 0.5;
+        }
+      }
+      
+      if (!improved) {
+        next_n = mapped_n;
+        next_mapped = dens_map(next_n);
+      }
+      
+    } else {
+      // Anderson acceleration over the last anderson residuals
+      if (iterations > 1) {
+        delta_f.insert_cols(delta_f.n_cols, residual - prev_residual);
+        delta_g.insert_cols(delta_g.n_cols, mapped_n - prev_mapped);
+        
+        if (static_cast<int>(delta_f.n_cols) > anderson) {
+          delta_f.shed_col(0);
+          delta_g.shed_col(0);
+        }
+      }
+      prev_residual = residual;
+      prev_mapped = mapped_n;
+      
+      next_n = mapped_n;
+      if (delta_f.n_cols > 0) {
+        arma::vec gamma;
+        bool solved = solve(gamma, delta_f, residual);
+        
+        if (solved && gamma.is_finite()) {
+          next_n = clamp(mapped_n - delta_g * gamma, 0.0, arma::datum::inf);
+        }
+      }
+      next_mapped = dens_map(next_n);
+    }
+    
+    current_n = next_n;
+    mapped_n = next_mapped;
+    residual = mapped_n - current_n;
+  }
+  
+  equil_n = current_n;
+  
+  return converged;
+}
+
+//' Find Equilibria of Density Dependent Matrix Projection Models
+//' 
+//' Function \code{equilibrium3()} finds the equilibrium population vector of
+//' each matrix in a density dependent MPM directly, rather than through long
+//' projections. The equilibrium is the population vector \eqn{N} for which
+//' \eqn{A(N) N = N}, where \eqn{A(N)} is the matrix after density adjustment as
+//' given in \code{density}.
 //' 
-//' lathproj <- projection3(ehrlen3, nreps = 5, stochastic = TRUE)
+//' @name equilibrium3
 //' 
-//' # Cypripedium example
+//' @param mpm A matrix projection model of class \code{lefkoMat}, or a list of
+//' full matrix projection matrices.
+//' @param density A data frame of class \code{lefkoDens}, or a list of such
+//' data frames with either one element or one element per matrix.
+//' @param historical An optional logical value only used if object \code{mpm}
+//' is a list of matrices, rather than a \code{lefkoMat} object. Defaults to
+//' \code{FALSE} for the former case, and overridden by information supplied in
+//' the \code{lefkoMat} object for the latter case.
+//' @param start_vec An optional numeric vector giving the population vector at
+//' which to start the search. Defaults to one individual in each stage.
+//' @param start_frame An optional data frame of class \code{lefkoSV}, created
+//' with function \code{\link{start_input}()}, giving the stages, stage pairs,
+//' or age-stages at which to start the search with non-zero values. Takes
+//' precedence over \code{start_vec}, and can only be used with
+//' \code{lefkoMat} objects.
+//' @param stage_weights An optional object of class \code{lefkoEq} giving the
+//' weight of each stage in the estimation of population size used in density
+//' dependence, as in \code{\link{projection3}()}. Defaults to equal weights.
+//' @param substoch An integer value indicating whether to force survival-
+//' transition matrices to be substochastic, as in \code{\link{projection3}()}.
+//' Defaults to \code{0}.
+//' @param exp_tol A numeric value used to indicate a maximum value to set
+//' exponents to in the core kernel to prevent numerical overflow. Defaults to
+//' \code{700}.
+//' @param anderson An integer giving the number of past iterations used in
+//' Anderson acceleration. Defaults to \code{0}, in which case Newton iteration
+//' is used instead.
+//' @param tol The tolerance used to determine convergence, given as the
+//' largest absolute change in any stage in a single occasion, relative to the
+//' size of the largest stage. Defaults to \code{1e-10}.
+//' @param max_iter The maximum number of iterations. Defaults to \code{1000}.
+//' 
+//' @return A list with the following elements:
+//' \item{equilibrium}{A matrix giving the equilibrium population vector of
+//' each matrix in \code{mpm}, with stages in rows and matrices in columns.}
+//' \item{summary}{A data frame giving, for each matrix, the total population
+//' size at equilibrium (\code{total}), the dominant eigenvalue of the Jacobian
+//' at equilibrium (\code{lambda}), whether the equilibrium is locally stable
+//' (\code{stable}), the number of iterations used (\code{iterations}), and
+//' whether the search converged (\code{converged}).}
+//' \item{labels}{The \code{labels} data frame of the \code{lefkoMat} object
+//' used as input, showing the order of matrices. Only provided if a
+//' \code{lefkoMat} object is used as input.}
+//' 
+//' @section Notes:
+//' Newton iteration estimates the Jacobian of the density dependent map by
+//' finite differences at each iteration, and usually converges in a handful of
+//' iterations. Anderson acceleration avoids the Jacobian, and so may be faster
+//' for very large matrices. In both cases, only a single occasion is projected
+//' per map evaluation, and time delays are ignored, since population size is
+//' constant at equilibrium.
+//' 
+//' The equilibrium is locally stable if the modulus of the dominant eigenvalue
+//' of the Jacobian, given in \code{lambda}, is less than 1. The Jacobian is
+//' always estimated at the equilibrium, including under Anderson acceleration.
+//' Populations unable to persist converge to the trivial equilibrium at zero,
+//' and a warning is then given, since this is rarely the equilibrium sought.
+//' Different starting vectors may lead to different equilibria where more than
+//' one exists, and so a search that ends at zero may be rerun from a different
+//' starting vector given in \code{start_vec} or \code{start_frame}.
+//' 
+//' @seealso \code{\link{density_input}()}
+//' @seealso \code{\link{projection3}()}
+//' 
+//' @examples
 //' data(cypdata)
-//'  
+//' 
 //' sizevector <- c(0, 0, 0, 0, 0, 0, 1, 2.5, 4.5, 8, 17.5)
 //' stagevector <- c("SD", "P1", "P2", "P3", "SL", "D", "XSm", "Sm", "Md", "Lg",
 //'   "XLg")
@@ -18737,93 +20831,630 @@ void projection3_single(List& fin_out, const List& mpm, int nreps = 1, int times
 //'   stageassign = cypframe_raw, stagesize = "sizeadded", NAas0 = TRUE, 
 //'   NRasRep = TRUE)
 //' 
-//' cypsupp3r <- supplemental(stage3 = c("SD", "SD", "P1", "P1", "P2", "P3", "SL",
-//'     "D", "XSm", "Sm", "D", "XSm", "Sm", "mat", "mat", "mat", "SD", "P1"),
-//'   stage2 = c("SD", "SD", "SD", "SD", "P1", "P2", "P3", "SL", "SL", "SL", "SL",
-//'     "SL", "SL", "D", "XSm", "Sm", "rep", "rep"),
-//'   stage1 = c("SD", "rep", "SD", "rep", "SD", "P1", "P2", "P3", "P3", "P3",
-//'     "SL", "SL", "SL", "SL", "SL", "SL", "mat", "mat"),
-//'   eststage3 = c(NA, NA, NA, NA, NA, NA, NA, "D", "XSm", "Sm", "D", "XSm", "Sm",
-//'     "mat", "mat", "mat", NA, NA),
-//'   eststage2 = c(NA, NA, NA, NA, NA, NA, NA, "XSm", "XSm", "XSm", "XSm", "XSm",
-//'     "XSm", "D", "XSm", "Sm", NA, NA),
-//'   eststage1 = c(NA, NA, NA, NA, NA, NA, NA, "XSm", "XSm", "XSm", "XSm", "XSm",
-//'     "XSm", "XSm", "XSm", "XSm", NA, NA),
-//'   givenrate = c(0.1, 0.1, 0.2, 0.2, 0.2, 0.2, 0.25, NA, NA, NA, NA, NA, NA,
-//'     NA, NA, NA, NA, NA),
-//'   multiplier = c(NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA, NA,
-//'     NA, 0.5, 0.5),
-//'   type = c(1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3),
-//'   type_t12 = c(1, 2, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1),
-//'   stageframe = cypframe_raw, historical = TRUE)
-//' 
-//' cypmatrix3r <- rlefko3(data = cypraw_v1, stageframe = cypframe_raw, 
+//' cypsupp2r <- supplemental(stage3 = c("SD", "P1", "P2", "P3", "SL", "D", 
+//'     "XSm", "Sm", "SD", "P1"),
+//'   stage2 = c("SD", "SD", "P1", "P2", "P3", "SL", "SL", "SL", "rep",
+//'     "rep"),
+//'   eststage3 = c(NA, NA, NA, NA, NA, "D", "XSm", "Sm", NA, NA),
+//'   eststage2 = c(NA, NA, NA, NA, NA, "XSm", "XSm", "XSm", NA, NA),
+//'   givenrate = c(0.10, 0.20, 0.20, 0.20, 0.25, NA, NA, NA, NA, NA),
+//'   multiplier = c(NA, NA, NA, NA, NA, NA, NA, NA, 0.5, 0.5),
+//'   type =c(1, 1, 1, 1, 1, 1, 1, 1, 3, 3),
+//'   stageframe = cypframe_raw, historical = FALSE)
+//' 
+//' cypmatrix2r <- rlefko2(data = cypraw_v1, stageframe = cypframe_raw, 
 //'   year = "all", patch = "all", stages = c("stage3", "stage2", "stage1"),
-//'   size = c("size3added", "size2added", "size1added"), 
-//'   supplement = cypsupp3r, yearcol = "year2", 
-//'   patchcol = "patchid", indivcol = "individ")
+//'   size = c("size3added", "size2added"), supplement = cypsupp2r,
+//'   yearcol = "year2", patchcol = "patchid", indivcol = "individ")
 //' 
-//' cypstoch <- projection3(cypmatrix3r, nreps = 5, stochastic = TRUE)
+//' c2d <- density_input(cypmatrix2r, stage3 = c("SD", "P1"),
+//'   stage2 = c("rep", "rep"), style = 1, alpha = 0.5, beta = 1.0,
+//'   type = c(2, 2))
 //' 
-//' @export projection3
-// [[Rcpp::export(projection3)]]
-Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
-  bool historical = false, bool stochastic = false, bool standardize = false,
-  bool growthonly = true, bool integeronly = false, int substoch = 0,
-  double exp_tol = 700.0, bool sub_warnings = true, bool quiet = false,
-  Nullable<IntegerVector> year = R_NilValue, Nullable<NumericVector> start_vec = R_NilValue,
-  Nullable<DataFrame> start_frame = R_NilValue, Nullable<RObject> tweights = R_NilValue,
-  Nullable<RObject> density = R_NilValue, Nullable<RObject> stage_weights = R_NilValue,
-  Nullable<RObject> sparse = R_NilValue) {
+//' cypeq <- equilibrium3(cypmatrix2r, density = c2d)
+//' cypeq_anderson <- equilibrium3(cypmatrix2r, density = c2d, anderson = 5)
+//' 
+//' cypsv <- start_input(cypmatrix2r, stage2 = c("SD", "XSm"),
+//'   value = c(100, 10))
+//' cypeq_sv <- equilibrium3(cypmatrix2r, density = c2d, start_frame = cypsv)
+//' 
+//' @export equilibrium3
+// [[Rcpp::export(equilibrium3)]]
+Rcpp::List equilibrium3(const List& mpm, const RObject& density,
+  bool historical = false, Nullable<NumericVector> start_vec = R_NilValue,
+  Nullable<DataFrame> start_frame = R_NilValue,
+  Nullable<RObject> stage_weights = R_NilValue, int substoch = 0,
+  double exp_tol = 700.0, int anderson = 0, double tol = 1e-10,
+  int max_iter = 1000) {
+  
+  if (substoch < 0 || substoch > 2) pop_error("substoch", "integer 0, 1, or 2", "", 1);
+  if (anderson < 0) pop_error("anderson", "a non-negative integer", "", 1);
+  if (tol <= 0.0 || !std::isfinite(tol)) pop_error("tol", "a positive number", "", 1);
+  if (max_iter < 1) pop_error("max_iter", "a positive integer", "", 1);
   
-  List final_output;
-  bool lefkoList_true {false};
   bool lefkoMat_true {false};
   bool list_true {false};
   
   StringVector mpm_class = as<StringVector>(mpm.attr("class"));
-  
   for (int i = 0; i < static_cast<int>(mpm_class.length()); i++) {
-    if (mpm_class(i) == "lefkoMatList") {
-      lefkoList_true = true;
-    } else if (mpm_class(i) == "lefkoMat") {
+    if (mpm_class(i) == "lefkoMat") {
       lefkoMat_true = true;
     } else if (mpm_class(i) == "list") {
       list_true = true;
     }
   }
   
-  if (!lefkoList_true && !lefkoMat_true && ! list_true) {
-    throw Rcpp::exception("Function projection3 requires a lefkoMat, lefkoMatList, or matrix list object as input", false);
+  if (!lefkoMat_true && !list_true) {
+    throw Rcpp::exception("Function equilibrium3 requires a lefkoMat or matrix list object as input", false);
   }
   
-  if (lefkoList_true) {
-    int list_length = static_cast<int>(mpm.length());
-    List pre_final_output (list_length);
+  List amats;
+  DataFrame stageframe;
+  DataFrame hstages;
+  DataFrame agestages;
+  RObject labels = R_NilValue;
+  int format {3};
+  
+  if (lefkoMat_true) {
+    amats = as<List>(mpm["A"]);
+    stageframe = as<DataFrame>(mpm["ahstages"]);
+    hstages = as<DataFrame>(mpm["hstages"]);
+    labels = mpm["labels"];
     
-    for (int i = 0; i < list_length; i++) {
-      List current_mpm = as<List>(mpm(i));
-      List current_out;
+    format = LefkoInputs::format_check_lM(mpm);
+    if (format < 3 && format > 0) {
+      historical = true;
+    } else if (format > 2) {
+      historical = false;
+    }
+    if (format == 4) agestages = as<DataFrame>(mpm["agestages"]);
+  } else {
+    amats = mpm;
+  }
+  
+  int amats_length = static_cast<int>(amats.length());
+  if (amats_length == 0) {
+    throw Rcpp::exception("Object mpm does not appear to include matrices.", false);
+  }
+  
+  // Matrices are read once in dense format
+  std::vector<arma::mat> base_mats;
+  for (int m = 0; m < amats_length; m++) {
+    if (is<S4>(amats(m))) {
+      base_mats.push_back(arma::mat(as<arma::sp_mat>(amats(m))));
+    } else if (is<NumericMatrix>(amats(m))) {
+      base_mats.push_back(as<arma::mat>(amats(m)));
+    } else {
+      throw Rcpp::exception("Object mpm does not appear to include matrices.", false);
+    }
+  }
+  int used_matsize = static_cast<int>(base_mats[0].n_rows);
+  
+  if (!lefkoMat_true) {
+    IntegerVector sf_stage_num = seq_len(used_matsize);
+    StringVector sf_stage = as<StringVector>(sf_stage_num);
+    stageframe = DataFrame::create(_["stage_id"] = sf_stage_num, _["stage"] = sf_stage);
+  }
+  
+  // Density inputs
+  List dens_frames;
+  if (is<DataFrame>(density)) {
+    dens_frames = List::create(density);
+  } else if (is<List>(density)) {
+    dens_frames = as<List>(density);
+    int dens_list_length = static_cast<int>(dens_frames.length());
+    
+    if (dens_list_length != 1 && dens_list_length != amats_length) {
+      throw Rcpp::exception("List entered in argument density input must have either 1 lefkoDens object, or as many as there matrices entered.", false);
+    }
+    if (!is<DataFrame>(dens_frames(0))) {
+      throw Rcpp::exception("Unrecognized object entered in argument density", false);
+    }
+  } else {
+    throw Rcpp::exception("Unrecognized object entered in argument density", false);
+  }
+  
+  // Stage weights
+  DataFrame equivalence_frame;
+  NumericVector equivalence_vec;
+  arma::vec equivalence_vec_arma;
+  int eq_vec_length {0};
+  
+  if (stage_weights.isNotNull()) {
+    if (!is<DataFrame>(stage_weights)) {
+      throw Rcpp::exception("Argument stage_weights should be a data frame of class lefkoEq.",
+        false);
+    }
+    RObject stage_weights_input = RObject(stage_weights);
+    
+    equivalence_prep (equivalence_frame, equivalence_vec,
+      equivalence_vec_arma, eq_vec_length, stage_weights_input, format,
+      used_matsize);
+  } else {
+    equivalence_vec_arma.ones(1);
+    eq_vec_length = 1;
+  }
+  
+  arma::vec startvec;
+  if (start_frame.isNotNull()) {
+    if (!lefkoMat_true) {
+      throw Rcpp::exception("Argument start_frame can only be used with lefkoMat objects.",
+        false);
+    }
+    startvec = start_frame_vec(Rcpp::DataFrame(start_frame), used_matsize,
+      (format == 4), historical, stageframe, hstages, agestages);
+    
+  } else if (start_vec.isNotNull()) {
+    startvec = as<arma::vec>(start_vec);
+    if (static_cast<int>(startvec.n_elem) != used_matsize) {
+      throw Rcpp::exception("Argument start_vec must have as many elements as there are stages in the MPM.",
+        false);
+    }
+  } else {
+    startvec.ones(used_matsize);
+  }
+  
+  // A start at or below zero is already the trivial equilibrium
+  if (!startvec.is_finite() || any(startvec < 0.0) || accu(startvec) <= 0.0) {
+    throw Rcpp::exception("Starting vector must be finite and non-negative, with at least one positive value.",
+      false);
+  }
+  
+  arma::mat equilibria (used_matsize, amats_length, fill::zeros);
+  NumericVector eq_totals (amats_length);
+  NumericVector eq_lambdas (amats_length);
+  LogicalVector eq_stable (amats_length);
+  IntegerVector eq_iterations (amats_length);
+  LogicalVector eq_converged (amats_length);
+  bool warn_nonconvergence {false};
+  bool warn_trivial {false};
+  
+  for (int m = 0; m < amats_length; m++) {
+    const arma::mat& base_mat = base_mats[m];
+    DataFrame dens_input = as<DataFrame>(dens_frames((dens_frames.length() > 1) ? m : 0));
+    
+    List dens_index;
+    arma::uvec dyn_style;
+    arma::vec dyn_alpha;
+    arma::vec dyn_beta;
+    arma::vec dyn_gamma;
+    
+    LefkoUtils::density_prep(dens_index, dyn_style, dyn_alpha, dyn_beta,
+      dyn_gamma, dens_input, hstages, stageframe, exp_tol, historical);
+    
+    arma::uvec dyn_index321 = as<arma::uvec>(dens_index["index321"]);
+    arma::uvec dyn_index_col = as<arma::uvec>(dens_index(1));
+    arma::uvec dyn_index_s3 = as<arma::uvec>(dens_index(0));
+    arma::uvec dyn_delay = as<arma::uvec>(dens_input["time_delay"]);
+    arma::uvec dyn_type = as<arma::uvec>(dens_input["type"]);
+    
+    if (dyn_index321.n_elem == 0) {
+      throw Rcpp::exception("Argument density must include at least one density dependent element.",
+        false);
+    }
+    
+    arma::uvec dyn_lag;
+    arma::uvec lag_levels;
+    arma::uvec lag_slot;
+    std::vector<arma::uvec> style_groups;
+    arma::uvec dyn_pass;
+    arma::uvec col_levels;
+    arma::uvec col_slot;
+    
+    dens_groups(dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass,
+      dyn_style, dyn_delay, dyn_index321);
+    LefkoUtils::dens_columns(col_levels, col_slot, dyn_index_col);
+    int max_lag = static_cast<int>(lag_levels.max());
+    
+    // Population size is constant at equilibrium, so all delays see N
+    arma::mat work_mat;
+    auto dens_map = [&](const arma::vec& current_n) -> arma::vec {
+      arma::mat lag_proj = repmat(current_n, 1, (max_lag + 1));
+      arma::uvec active;
+      double pop_size {0.0};
+      
+      work_mat = base_mat;
+      bool additive_limit_enforced = dens_apply(work_mat, active, pop_size,
+        lag_proj, max_lag, equivalence_vec_arma, eq_vec_length, dyn_index321,
+        dyn_lag, lag_levels, lag_slot, style_groups, dyn_pass, dyn_alpha,
+        dyn_beta, dyn_type, col_levels, col_slot, substoch);
+      
+      arma::vec next_n = work_mat * current_n;
+      if (additive_limit_enforced) {
+        dens_limits(next_n, pop_size, dyn_style, dyn_alpha, dyn_beta,
+          dyn_gamma, dyn_index_s3);
+      }
       
-      projection3_single(current_out, current_mpm, nreps, times, historical, stochastic,
-        standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings,
-        quiet, year, start_vec, start_frame, tweights, density, stage_weights,
-        sparse);
-      pre_final_output(i) = current_out;
+      return next_n;
+    };
+    
+    arma::vec equil_n = startvec;
+    int iterations {0};
+    bool converged = equil_solve(dens_map, equil_n, anderson, tol, max_iter,
+      iterations);
+    if (!converged) warn_nonconvergence = true;
+    
+    // Local stability from the Jacobian at equilibrium
+    arma::mat jacobian = equil_jacobian(dens_map, equil_n, dens_map(equil_n));
+    arma::cx_vec jacobian_values;
+    double dominant_value {NA_REAL};
+    if (eig_gen(jacobian_values, jacobian)) {
+      dominant_value = max(abs(jacobian_values));
     }
     
-    final_output = pre_final_output;
-    StringVector new_mpm_class = {"lefkoProjList"};
-    final_output.attr("class") = new_mpm_class;
+    equilibria.col(m) = equil_n;
+    eq_totals(m) = accu(equil_n);
+    if (converged && eq_totals(m) <= tol) warn_trivial = true;
+    eq_lambdas(m) = dominant_value;
+    if (NumericVector::is_na(dominant_value)) {
+      eq_stable(m) = NA_LOGICAL;
+    } else {
+      eq_stable(m) = (dominant_value < 1.0);
+    }
+    eq_iterations(m) = iterations;
+    eq_converged(m) = converged;
+  }
+  
+  if (warn_nonconvergence) {
+    Rf_warningcall(R_NilValue,
+      "Some equilibria were not found within max_iter iterations.");
+  }
+  if (warn_trivial) {
+    Rf_warningcall(R_NilValue,
+      "Some searches converged to the trivial equilibrium at N = 0. Try a different start_vec or start_frame.");
+  }
+  
+  DataFrame eq_summary = DataFrame::create(_["matrix"] = seq_len(amats_length),
+    _["total"] = eq_totals, _["lambda"] = eq_lambdas, _["stable"] = eq_stable,
+    _["iterations"] = eq_iterations, _["converged"] = eq_converged);
+  
+  Rcpp::List output;
+  if (lefkoMat_true) {
+    output = List::create(_["equilibrium"] = equilibria,
+      _["summary"] = eq_summary, _["labels"] = labels);
+  } else {
+    output = List::create(_["equilibrium"] = equilibria,
+      _["summary"] = eq_summary);
+  }
+  
+  return output;
+}
+
+//' Estimate Stochastic Growth Rate with Parallel Independent Chains
+//' 
+//' Function \code{slambda_chains()} runs the multi-chain mode of function
+//' \code{slambda3()}. Each chain projects a standardized population vector
+//' through randomly chosen matrices using its own random number stream, seeded
+//' from R's random number generator, and chains run in parallel where OpenMP
+//' is available. In a Markovian environment, each chain starts from a matrix
+//' drawn from the stationary distribution of the matrix choice chain. Each
+//' chain first runs a burn-in of one batch of occasions, which is not used in
+//' any estimate. Chains then advance in rounds of one batch of occasions each,
+//' and the means of all full batches provide the batch-means standard error of
+//' \eqn{a}. The run ends once every chain has completed at least 20 full
+//' batches and this standard error falls below \code{se_tol}, or once each
+//' chain reaches \code{times} occasions.
+//' 
+//' @name slambda_chains
+//' 
+//' @param mats The list of matrices to sample from.
+//' @param choices The indices of the matrices in \code{mats} that may be
+//' chosen.
+//' @param weights The probability weights of each element of \code{choices},
+//' used if \code{assume_markov = FALSE}.
+//' @param weights_markov A square matrix giving, by column, the probability of
+//' choosing each element of \code{choices} given the current choice. Used if
+//' \code{assume_markov = TRUE}.
+//' @param assume_markov A logical value indicating whether matrix choice
+//' follows a first-order Markov chain.
+//' @param start_vec The starting population vector.
+//' @param sparse A logical value indicating whether to project using sparse
+//' matrices.
+//' @param times The maximum number of occasions per chain.
+//' @param chains The number of independent chains.
+//' @param se_tol The standard error of \eqn{a} at which to end the run. Values
+//' of \code{0} run all chains for \code{times} occasions.
+//' 
+//' @return A vector holding the pooled estimate of \eqn{a}, the variance and
+//' standard deviation of the log growth rate across all simulated occasions,
+//' the batch-means standard error of \eqn{a}, and the total number of
+//' occasions used in estimation across chains, excluding burn-in.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::vec slambda_chains(const List& mats, const arma::uvec& choices,
+  const arma::vec& weights, const arma::mat& weights_markov, bool assume_markov,
+  const arma::vec& start_vec, bool sparse, int times, int chains,
+  double se_tol) {
+  
+  int no_choices = static_cast<int>(choices.n_elem);
+  
+  // Matrices are read once here, so that chains only read shared memory
+  std::vector<arma::mat> dense_mats;
+  std::vector<dgc_view> sparse_mats;
+  if (sparse) {
+    sparse_mats.reserve(no_choices);
+    for (int m = 0; m < no_choices; m++) {
+      sparse_mats.emplace_back(mats, static_cast<int>(choices(m)));
+    }
+  } else {
+    dense_mats.reserve(no_choices);
+    for (int m = 0; m < no_choices; m++) {
+      dense_mats.push_back(as<arma::mat>(mats[static_cast<int>(choices(m))]));
+    }
+  }
+  
+  arma::vec cum_weights = arma::cumsum(weights / sum(weights));
+  arma::mat cum_markov;
+  if (assume_markov) {
+    cum_markov = weights_markov;
+    for (int m = 0; m < static_cast<int>(cum_markov.n_cols); m++) {
+      cum_markov.col(m) = arma::cumsum(cum_markov.col(m) / sum(cum_markov.col(m)));
+    }
+  }
+  
+  auto choose = [no_choices](const double* cum, double u) -> int {
+    int chosen {0};
+    while (chosen < (no_choices - 1) && u > cum[chosen]) chosen++;
+    return chosen;
+  };
+  
+  // Independent streams, seeded from R so that set.seed() applies
+  std::vector<std::mt19937_64> streams (chains);
+  for (int c = 0; c < chains; c++) {
+    uint64_t seed_high = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+    uint64_t seed_low = static_cast<uint64_t>(R::unif_rand() * 4294967296.0);
+    streams[c].seed((seed_high << 32) ^ seed_low);
+  }
+  
+  auto draw_unif = [&streams](int c) -> double {
+    return static_cast<double>(streams[c]() >> 11) * (1.0 / 9007199254740992.0);
+  };
+  
+  // Markovian chains start from the stationary distribution of matrix choice,
+  // found by solving (P - I) pi = 0 with the constraint sum(pi) = 1
+  std::vector<int> positions (chains, 0);
+  if (assume_markov) {
+    arma::mat trans_mat = weights_markov;
+    for (int m = 0; m < static_cast<int>(trans_mat.n_cols); m++) {
+      trans_mat.col(m) = trans_mat.col(m) / sum(trans_mat.col(m));
+    }
+    
+    arma::mat stat_system = trans_mat - arma::eye(no_choices, no_choices);
+    stat_system.row(no_choices - 1).ones();
+    arma::vec stat_rhs (no_choices, fill::zeros);
+    stat_rhs(no_choices - 1) = 1.0;
+    
+    arma::vec stationary;
+    bool stat_found = arma::solve(stationary, stat_system, stat_rhs,
+      arma::solve_opts::no_approx);
+    if (!stat_found || any(stationary < -1e-10)) {
+      throw Rcpp::exception("The matrix choice chain in tweights has no unique stationary distribution.",
+        false);
+    }
+    stationary.clamp(0.0, arma::datum::inf);
+    arma::vec cum_stationary = arma::cumsum(stationary / sum(stationary));
+    
+    for (int c = 0; c < chains; c++) {
+      positions[c] = choose(cum_stationary.memptr(), draw_unif(c));
+    }
+  }
+  
+  std::vector<arma::vec> states (chains, start_vec / sum(start_vec));
+  std::vector<double> chain_n (chains, 0.0);
+  std::vector<double> chain_mean (chains, 0.0);
+  std::vector<double> chain_m2 (chains, 0.0);
+  std::vector<double> round_means (chains, 0.0);
+  std::vector<double> batch_means;
+  
+  int batch_size = std::min(std::max(50, times / 100), times);
+  int max_rounds = (times + batch_size - 1) / batch_size;
+  int full_rounds {0};
+  double se {arma::datum::nan};
+  
+  // Projects chain c by one occasion, returning the log growth rate
+  auto chain_step = [&](int c) -> double {
+    arma::vec& state = states[c];
+    double u = draw_unif(c);
+    
+    int chosen;
+    if (assume_markov) {
+      chosen = choose(cum_markov.colptr(positions[c]), u);
+    } else {
+      chosen = choose(cum_weights.memptr(), u);
+    }
+    positions[c] = chosen;
+    
+    arma::vec next_state;
+    if (sparse) {
+      next_state = sparse_mats[chosen].times(state);
+    } else {
+      next_state = dense_mats[chosen] * state;
+    }
+    
+    double growth = sum(next_state);
+    if (growth > 0.0) {
+      state = next_state / growth;
+    } else {
+      state = next_state;
+    }
+    
+    return log(growth);
+  };
+  
+  // Burn-in, so that estimates start from the stationary population structure
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+  #endif
+  for (int c = 0; c < chains; c++) {
+    for (int t = 0; t < batch_size; t++) chain_step(c);
+  }
+  
+  for (int round = 0; round < max_rounds; round++) {
+    int steps = std::min(batch_size, times - round * batch_size);
+    
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (int c = 0; c < chains; c++) {
+      double batch_total {0.0};
+      
+      for (int t = 0; t < steps; t++) {
+        double log_growth = chain_step(c);
+        
+        chain_n[c] += 1.0;
+        double delta = log_growth - chain_mean[c];
+        chain_mean[c] += delta / chain_n[c];
+        chain_m2[c] += delta * (log_growth - chain_mean[c]);
+        batch_total += log_growth;
+      }
+      
+      round_means[c] = batch_total / static_cast<double>(steps);
+    }
+    
+    Rcpp::checkUserInterrupt();
+    if (steps == batch_size) {
+      batch_means.insert(batch_means.end(), round_means.begin(), round_means.end());
+      full_rounds++;
+    }
+    
+    int no_batches = static_cast<int>(batch_means.size());
+    if (no_batches > 1) {
+      arma::vec all_batches (batch_means);
+      se = arma::stddev(all_batches) / sqrt(static_cast<double>(no_batches));
+    }
+    
+    // Each chain contributes one batch per full round
+    if (se_tol > 0.0 && full_rounds >= 20 && se < se_tol) break;
+  }
+  
+  // Pooled moments across chains
+  double total_n {0.0};
+  double total_mean {0.0};
+  double total_m2 {0.0};
+  for (int c = 0; c < chains; c++) {
+    if (chain_n[c] == 0.0) continue;
+    
+    double combined_n = total_n + chain_n[c];
+    double delta = chain_mean[c] - total_mean;
+    total_mean += delta * chain_n[c] / combined_n;
+    total_m2 += chain_m2[c] + delta * delta * total_n * chain_n[c] / combined_n;
+    total_n = combined_n;
+  }
+  
+  double total_var = (total_n > 1.0) ? total_m2 / (total_n - 1.0) : 0.0;
+  if (!std::isfinite(se)) se = sqrt(total_var / total_n);
+  
+  arma::vec output = {total_mean, total_var, sqrt(total_var), se, total_n};
+  
+  return output;
+}
+
+//' Small Noise Approximation of Stochastic Growth Rate
+//' 
+//' Function \code{sna_growth()} estimates the log stochastic growth rate of a
+//' set of matrices chosen independently in each occasion via Tuljapurkar's
+//' small noise approximation. Only the weighted mean matrix, its dominant
+//' eigenvalue and eigenvectors, and the growth perturbation implied by each
+//' matrix are used, and so no simulation is conducted.
+//' 
+//' @name sna_growth
+//' 
+//' @param mats A list of dense or sparse matrices.
+//' @param chosen A vector of the indices of the matrices in \code{mats} to use.
+//' @param weights A vector of the probabilities of choosing each matrix in
+//' \code{chosen}, in the same order. Need not sum to 1.
+//' @param w A vector to hold the right eigenvector of the mean matrix, scaled
+//' to sum to 1.
+//' @param v A vector to hold the left eigenvector of the mean matrix, scaled
+//' so that its first non-zero element equals 1.
+//' @param mean_mat A sparse matrix to hold the weighted mean matrix.
+//' 
+//' @return A vector holding the approximate log stochastic growth rate, the
+//' approximate variance of the log growth rate per occasion, and the dominant
+//' eigenvalue of the mean matrix.
+//' 
+//' @section Notes:
+//' With mean matrix \eqn{\bar{A}} having dominant eigenvalue \eqn{\lambda},
+//' the approximation is \eqn{\log \lambda - \tau^2 / (2 \lambda^2)}, where
+//' \eqn{\tau^2} is the weighted variance of \eqn{v^T A_k w / v^T w} across
+//' matrices \eqn{A_k}. This equals the sum of element covariances weighted by
+//' the products of their sensitivities, but does not require the covariance
+//' matrix itself.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::vec sna_growth(const List& mats, const arma::uvec& chosen,
+  const arma::vec& weights, arma::vec& w, arma::vec& v, arma::sp_mat& mean_mat) {
+  
+  int chosen_num = static_cast<int>(chosen.n_elem);
+  arma::vec probs = weights / sum(weights);
+  bool sparse_mats = is<S4>(mats(static_cast<int>(chosen(0))));
+  
+  List eigenstuff;
+  if (sparse_mats) {
+    LefkoMats::dgc_view first_view (mats, static_cast<int>(chosen(0)));
+    arma::sp_mat mean_sp (first_view.n_rows, first_view.n_cols);
+    
+    for (int k = 0; k < chosen_num; k++) {
+      if (probs(k) == 0.0) continue;
+      
+      LefkoMats::dgc_view current_view (mats, static_cast<int>(chosen(k)));
+      mean_sp = current_view.combine(mean_sp, probs(k), 1.0);
+    }
+    eigenstuff = LefkoMats::decomp3sp_inp(mean_sp);
+    mean_mat = mean_sp;
     
   } else {
-    projection3_single(final_output, mpm, nreps, times, historical, stochastic,
-      standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings,
-      quiet, year, start_vec, start_frame, tweights, density, stage_weights,
-      sparse);
+    arma::mat mean_dense;
+    
+    for (int k = 0; k < chosen_num; k++) {
+      if (k == 0) {
+        mean_dense = probs(k) * as<arma::mat>(mats(static_cast<int>(chosen(k))));
+      } else {
+        mean_dense += probs(k) * as<arma::mat>(mats(static_cast<int>(chosen(k))));
+      }
+    }
+    eigenstuff = LefkoMats::decomp3(mean_dense);
+    mean_mat = arma::sp_mat(mean_dense);
+  }
+  
+  arma::vec realeigenvals = real(as<arma::cx_vec>(eigenstuff["eigenvalues"]));
+  int lambda1 = static_cast<int>(realeigenvals.index_max());
+  double lambda = realeigenvals(lambda1);
+  
+  w = real(as<arma::cx_mat>(eigenstuff["right_eigenvectors"]).col(lambda1));
+  w.clean(0.00000000000001);
+  w = w / sum(w);
+  
+  v = real(as<arma::cx_mat>(eigenstuff["left_eigenvectors"]).col(lambda1));
+  v.clean(0.00000000000001);
+  arma::uvec vnonzero = find(v);
+  v = v / v(vnonzero(0));
+  
+  double vw = dot(v, w);
+  
+  // Growth perturbation implied by each matrix
+  double tau2 {0.0};
+  for (int k = 0; k < chosen_num; k++) {
+    if (probs(k) == 0.0) continue;
+    
+    arma::vec Aw;
+    if (sparse_mats) {
+      LefkoMats::dgc_view current_view (mats, static_cast<int>(chosen(k)));
+      Aw = current_view.times(w);
+    } else {
+      Aw = as<arma::mat>(mats(static_cast<int>(chosen(k)))) * w;
+    }
+    
+    double perturb = (dot(v, Aw) / vw) - lambda;
+    tau2 += probs(k) * perturb * perturb;
   }
   
-  return final_output;
+  double occasion_var = tau2 / (lambda * lambda);
+  
+  arma::vec output = {log(lambda) - (occasion_var / 2.0), occasion_var, lambda};
+  return output;
 }
 
 //' Estimate Stochastic Population Growth Rate
@@ -18856,6 +21487,15 @@ Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
 //' simple matrices. Defaults to \code{"auto"}, in which case sparse matrix
 //' encoding is used with simple square matrices with at least 50 rows and no
 //' more than 50\% of elements with values greater than zero.
+//' @param chains The number of independent chains to simulate per population
+//' and patch. Chains run in parallel where OpenMP is available. Defaults to
+//' \code{1}.
+//' @param se_tol The standard error of \eqn{a} below which simulation ends
+//' early. Only used in multi-chain mode. Defaults to \code{0}, in which case
+//' all chains run for \code{times} occasions.
+//' @param sna A logical value indicating whether to estimate \eqn{a} via
+//' Tuljapurkar's small noise approximation rather than via simulation. Defaults
+//' to \code{FALSE}.
 //' 
 //' @return A data frame with the following variables:
 //' \item{replicate}{The bootstrapped replicate. Only provided if a
@@ -18867,6 +21507,8 @@ Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
 //' \item{var}{The estimated variance of a.}
 //' \item{sd}{The standard deviation of a.}
 //' \item{se}{The standard error of a.}
+//' \item{occasions}{The total number of occasions used in estimation across
+//' all chains, excluding burn-in. Only provided in multi-chain mode.}
 //' 
 //' @section Notes:
 //' The log stochastic population growth rate, \eqn{a}, is as given in equation
@@ -18888,6 +21530,30 @@ Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
 //' Defaults work best when matrices are very small and dense, or very large and
 //' sparse.
 //' 
+//' Multi-chain mode is used if \code{chains} is greater than \code{1} or if
+//' \code{se_tol} is greater than \code{0}. In this mode, each chain uses its
+//' own random number stream seeded from R, so results are reproducible with
+//' \code{set.seed()}, and \code{times} gives the maximum number of occasions
+//' per chain. Chains are run in batches of \code{times / 100} occasions (at
+//' least 50), and the standard error given is the batch-means standard error
+//' of the pooled estimate, which accounts for autocorrelation in the log growth
+//' rate. Each chain first runs a burn-in of one batch, which is not used in
+//' estimation. If \code{tweights} is a matrix, then each chain starts from a
+//' matrix drawn from the stationary distribution of matrix choice. Once every
+//' chain has completed at least 20 batches, simulation stops as soon as this
+//' standard error falls below \code{se_tol}.
+//' 
+//' If \code{sna = TRUE}, then \eqn{a} is estimated without simulation as
+//' \eqn{\log \lambda - \tau^2 / (2 \lambda^2)}, where \eqn{\lambda} is the
+//' dominant eigenvalue of the weighted mean matrix, and \eqn{\tau^2} is the
+//' variance of the matrix elements weighted by their sensitivities (Tuljapurkar
+//' 1990). In this case, \code{var} gives the approximate variance of the log
+//' growth rate per occasion, \code{se} is \code{NA}, and arguments
+//' \code{times}, \code{chains}, and \code{se_tol} are ignored. The
+//' approximation assumes that matrices are chosen independently in each
+//' occasion, and so cannot be used if \code{tweights} is a matrix. It is most
+//' accurate when variation among matrices is small.
+//' 
 //' @examples
 //' data(cypdata)
 //' 
@@ -18943,6 +21609,9 @@ Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
 //'   patchcol = "patchid", indivcol = "individ")
 //' 
 //' cypstoch <- slambda3(cypmatrix3r)
+//' cypstoch_chains <- slambda3(cypmatrix3r, times = 100000, chains = 4,
+//'   se_tol = 0.001)
+//' cypstoch_sna <- slambda3(cypmatrix3r, sna = TRUE)
 //' 
 //' cypmatrix3r_boot <- rlefko3(data = cypraw_boot, stageframe = cypframe_raw, 
 //' year = "all", patch = "all", stages = c("stage3", "stage2", "stage1"),
@@ -18952,11 +21621,16 @@ Rcpp::List projection3 (const List& mpm, int nreps = 1, int times = 10000,
 //' 
 //' cypstoch_boot <- slambda3(cypmatrix3r_boot)
 //' 
+//' # Lists of plain matrices may also be supplied directly
+//' simple_mat <- matrix(c(0.2, 0.5, 1.5, 0.8), nrow = 2, ncol = 2)
+//' simple_stoch <- slambda3(list(simple_mat, simple_mat), times = 1000)
+//' 
 //' @export slambda3
 // [[Rcpp::export(slambda3)]]
 DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
   Nullable<RObject> tweights = R_NilValue,
-  Nullable<RObject> force_sparse = R_NilValue) {
+  Nullable<RObject> force_sparse = R_NilValue, int chains = 1,
+  double se_tol = 0.0, bool sna = false) {
   
   int class_switch {0}; // 1 - lefkoMat; 2 - lefkoMatList; 3 - list
   int theclairvoyant {0};
@@ -18968,6 +21642,17 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
   theclairvoyant = times;
   
   if (theclairvoyant < 1) pop_error("times", "a positive integer", "", 1);
+  if (chains < 1) pop_error("chains", "a positive integer", "", 1);
+  if (se_tol < 0.0 || !std::isfinite(se_tol)) {
+    pop_error("se_tol", "a non-negative number", "", 1);
+  }
+  bool chain_mode = (!sna && (chains > 1 || se_tol > 0.0));
+  
+  if (sna && tweights.isNotNull()) {
+    if (Rf_isMatrix(tweights)) {
+      throw Rcpp::exception("The small noise approximation cannot be used with first-order Markovian environments.", false);
+    }
+  }
   
   if (force_sparse.isNotNull()) {
     LefkoInputs::yesnoauto_to_logic(as<RObject>(force_sparse), "force_sparse", sparse_bool,
@@ -19126,15 +21811,51 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
       arma::uvec allppcs = as<arma::uvec>(sort_unique(poppatchc));
       int allppcsnem = static_cast<int>(allppcs.n_elem);
       
-      arma::mat slmat(theclairvoyant, trials, fill::zeros);
+      arma::mat slmat(((chain_mode || sna) ? 1 : theclairvoyant), trials, fill::zeros);
       arma::vec sl_mean(trials, fill::zeros);
       arma::vec sl_var(trials, fill::zeros);
       arma::vec sl_sd(trials, fill::zeros);
       arma::vec sl_se(trials, fill::zeros);
+      arma::vec sl_occ(trials, fill::zeros);
       
-      arma::uvec theprophecy (theclairvoyant);
+      arma::uvec theprophecy (((chain_mode || sna) ? 0 : theclairvoyant));
       for (int i= 0; i < allppcsnem; i++) {
         arma::uvec thenumbersofthebeast = find(ppcindex == allppcs(i));
+        
+        if (sna) {
+          arma::vec sna_w;
+          arma::vec sna_v;
+          arma::sp_mat sna_mean;
+          arma::vec sna_out = sna_growth(amats, thenumbersofthebeast, twinput,
+            sna_w, sna_v, sna_mean);
+          
+          sl_mean(i) = sna_out(0);
+          sl_var(i) = sna_out(1);
+          sl_sd(i) = sqrt(sna_out(1));
+          sl_se(i) = NA_REAL;
+          continue;
+        }
+        
+        if (chain_mode) {
+          bool chain_sparse = (!matrix_class_input || sparse_switch == 1);
+          if (chain_sparse) {
+            startvec = ss3matrix_sp(as<arma::sp_mat>(meanamats[i]));
+          } else {
+            startvec = ss3matrix(as<arma::mat>(meanamats[i]), sparse_switch);
+          }
+          
+          arma::vec chain_out = slambda_chains(amats, thenumbersofthebeast,
+            twinput, twinput_markov, assume_markov, startvec, chain_sparse,
+            theclairvoyant, chains, se_tol);
+          
+          sl_mean(i) = chain_out(0);
+          sl_var(i) = chain_out(1);
+          sl_sd(i) = chain_out(2);
+          sl_se(i) = chain_out(3);
+          sl_occ(i) = chain_out(4);
+          continue;
+        }
+        
         if (!assume_markov) {
           twinput = twinput / sum(twinput);
           
@@ -19264,6 +21985,34 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
           int numyearsused = meanmatyearlist.length();
           arma::uvec choicevec = linspace<arma::uvec>(0, (numyearsused - 1), numyearsused);
           
+          if (sna) {
+            arma::vec sna_w;
+            arma::vec sna_v;
+            arma::sp_mat sna_mean;
+            arma::vec sna_out = sna_growth(meanmatyearlist, choicevec, twinput,
+              sna_w, sna_v, sna_mean);
+            
+            sl_mean(allppcsnem + i) = sna_out(0);
+            sl_var(allppcsnem + i) = sna_out(1);
+            sl_sd(allppcsnem + i) = sqrt(sna_out(1));
+            sl_se(allppcsnem + i) = NA_REAL;
+            continue;
+          }
+          
+          if (chain_mode) {
+            arma::vec chain_out = slambda_chains(meanmatyearlist, choicevec,
+              twinput, twinput_markov, assume_markov, startvec,
+              (is<S4>(meanmatyearlist(0)) || sparse_switch == 1), theclairvoyant,
+              chains, se_tol);
+            
+            sl_mean(allppcsnem + i) = chain_out(0);
+            sl_var(allppcsnem + i) = chain_out(1);
+            sl_sd(allppcsnem + i) = chain_out(2);
+            sl_se(allppcsnem + i) = chain_out(3);
+            sl_occ(allppcsnem + i) = chain_out(4);
+            continue;
+          }
+          
           if (!assume_markov) {
             twinput = twinput / sum(twinput);
             
@@ -19305,6 +22054,11 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
           sl_se((allppcsnem + i)) = sl_sd((allppcsnem +i)) / sqrt(static_cast<double>(theclairvoyant));
         }
       }
+      if (chain_mode) {
+        return DataFrame::create(_["pop"] = mmpops, _["patch"] = mmpatches,
+          _["a"] = sl_mean, _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se,
+          _["occasions"] = sl_occ);
+      }
       return DataFrame::create(_["pop"] = mmpops, _["patch"] = mmpatches,
         _["a"] = sl_mean, _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se);
     } else {
@@ -19457,15 +22211,51 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
       arma::uvec allppcs = as<arma::uvec>(sort_unique(poppatchc));
       int allppcsnem = static_cast<int>(allppcs.n_elem);
       
-      arma::mat slmat(theclairvoyant, trials, fill::zeros);
+      arma::mat slmat(((chain_mode || sna) ? 1 : theclairvoyant), trials, fill::zeros);
       arma::vec sl_mean(trials, fill::zeros);
       arma::vec sl_var(trials, fill::zeros);
       arma::vec sl_sd(trials, fill::zeros);
       arma::vec sl_se(trials, fill::zeros);
+      arma::vec sl_occ(trials, fill::zeros);
       
-      arma::uvec theprophecy (theclairvoyant);
+      arma::uvec theprophecy (((chain_mode || sna) ? 0 : theclairvoyant));
       for (int i= 0; i < allppcsnem; i++) {
         arma::uvec thenumbersofthebeast = find(ppcindex == allppcs(i));
+        
+        if (sna) {
+          arma::vec sna_w;
+          arma::vec sna_v;
+          arma::sp_mat sna_mean;
+          arma::vec sna_out = sna_growth(amats, thenumbersofthebeast, twinput,
+            sna_w, sna_v, sna_mean);
+          
+          sl_mean(i) = sna_out(0);
+          sl_var(i) = sna_out(1);
+          sl_sd(i) = sqrt(sna_out(1));
+          sl_se(i) = NA_REAL;
+          continue;
+        }
+        
+        if (chain_mode) {
+          bool chain_sparse = (!matrix_class_input || sparse_switch == 1);
+          if (chain_sparse) {
+            startvec = ss3matrix_sp(as<arma::sp_mat>(meanamats[i]));
+          } else {
+            startvec = ss3matrix(as<arma::mat>(meanamats[i]), sparse_switch);
+          }
+          
+          arma::vec chain_out = slambda_chains(amats, thenumbersofthebeast,
+            twinput, twinput_markov, assume_markov, startvec, chain_sparse,
+            theclairvoyant, chains, se_tol);
+          
+          sl_mean(i) = chain_out(0);
+          sl_var(i) = chain_out(1);
+          sl_sd(i) = chain_out(2);
+          sl_se(i) = chain_out(3);
+          sl_occ(i) = chain_out(4);
+          continue;
+        }
+        
         if (!assume_markov) {
           twinput = twinput / sum(twinput);
           
@@ -19595,6 +22385,34 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
           int numyearsused = meanmatyearlist.length();
           arma::uvec choicevec = linspace<arma::uvec>(0, (numyearsused - 1), numyearsused);
           
+          if (sna) {
+            arma::vec sna_w;
+            arma::vec sna_v;
+            arma::sp_mat sna_mean;
+            arma::vec sna_out = sna_growth(meanmatyearlist, choicevec, twinput,
+              sna_w, sna_v, sna_mean);
+            
+            sl_mean(allppcsnem + i) = sna_out(0);
+            sl_var(allppcsnem + i) = sna_out(1);
+            sl_sd(allppcsnem + i) = sqrt(sna_out(1));
+            sl_se(allppcsnem + i) = NA_REAL;
+            continue;
+          }
+          
+          if (chain_mode) {
+            arma::vec chain_out = slambda_chains(meanmatyearlist, choicevec,
+              twinput, twinput_markov, assume_markov, startvec,
+              (is<S4>(meanmatyearlist(0)) || sparse_switch == 1), theclairvoyant,
+              chains, se_tol);
+            
+            sl_mean(allppcsnem + i) = chain_out(0);
+            sl_var(allppcsnem + i) = chain_out(1);
+            sl_sd(allppcsnem + i) = chain_out(2);
+            sl_se(allppcsnem + i) = chain_out(3);
+            sl_occ(allppcsnem + i) = chain_out(4);
+            continue;
+          }
+          
           if (!assume_markov) {
             twinput = twinput / sum(twinput);
             
@@ -19636,9 +22454,17 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
           sl_se((allppcsnem + i)) = sl_sd((allppcsnem +i)) / sqrt(static_cast<double>(theclairvoyant));
         }
       }
-      DataFrame castigated =  DataFrame::create(_["replicate"] = (current_i + 1),
-        _["pop"] = mmpops, _["patch"] = mmpatches, _["a"] = sl_mean,
-        _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se);
+      DataFrame castigated;
+      if (chain_mode) {
+        castigated = DataFrame::create(_["replicate"] = (current_i + 1),
+          _["pop"] = mmpops, _["patch"] = mmpatches, _["a"] = sl_mean,
+          _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se,
+          _["occasions"] = sl_occ);
+      } else {
+        castigated = DataFrame::create(_["replicate"] = (current_i + 1),
+          _["pop"] = mmpops, _["patch"] = mmpatches, _["a"] = sl_mean,
+          _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se);
+      }
       
       if (current_i == 0) {
         outward_df = castigated;
@@ -19729,6 +22555,40 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
     arma::vec startvec;
     int trials {1};
     
+    CharacterVector mmpops(1);
+    CharacterVector mmpatches(1);
+    mmpops(0) = "1";
+    mmpatches(0) = "0";
+    
+    if (sna) {
+      arma::vec sna_w;
+      arma::vec sna_v;
+      arma::sp_mat sna_mean;
+      arma::vec sna_out = sna_growth(amats, uniqueyears, twinput, sna_w, sna_v,
+        sna_mean);
+      
+      return DataFrame::create(_["pop"] = mmpops, _["patch"] = mmpatches,
+        _["a"] = sna_out(0), _["var"] = sna_out(1), _["sd"] = sqrt(sna_out(1)),
+        _["se"] = NA_REAL);
+    }
+    
+    if (chain_mode) {
+      bool chain_sparse = (!matrix_class_input || sparse_switch == 1);
+      if (!matrix_class_input) {
+        startvec = ss3matrix_sp(thechosenone_sp);
+      } else {
+        startvec = ss3matrix(thechosenone, sparse_switch);
+      }
+      
+      arma::vec chain_out = slambda_chains(amats, uniqueyears, twinput,
+        twinput_markov, assume_markov, startvec, chain_sparse, theclairvoyant,
+        chains, se_tol);
+      
+      return DataFrame::create(_["pop"] = mmpops, _["patch"] = mmpatches,
+        _["a"] = chain_out(0), _["var"] = chain_out(1), _["sd"] = chain_out(2),
+        _["se"] = chain_out(3), _["occasions"] = chain_out(4));
+    }
+    
     arma::mat slmat(theclairvoyant, trials);
     slmat.zeros();
     arma::vec sl_mean(trials);
@@ -19773,7 +22633,7 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
     }
     
     for (int j = 0; j < theclairvoyant; j++) {
-      slmat(j,0) = sum(projection.col(j+1));
+      slmat(j,0) = log(sum(projection.col(j+1)));
     }
     
     sl_mean(0) = mean(slmat.col(0));
@@ -19781,16 +22641,370 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
     sl_sd(0) = stddev(slmat.col(0));
     sl_se(0) = sl_sd(0) / sqrt(static_cast<double>(theclairvoyant));
     
-    CharacterVector mmpops(1);
-    CharacterVector mmpatches(1);
-    mmpops(0) = "1";
-    mmpatches(0) = "0";
-    
     return DataFrame::create(_["pop"] = mmpops, _["patch"] = mmpatches,
       _["a"] = sl_mean, _["var"] = sl_var, _["sd"] = sl_sd, _["se"] = sl_se);
   }
 }
 
+//' Checkpointed Stochastic Sensitivity Sums
+//' 
+//' Function \code{senselas_checkpointed()} adds the stochastic sensitivity or
+//' elasticity terms of a single simulated projection to a set of accumulator
+//' matrices, without holding the full \emph{w} and \emph{v} series in memory.
+//' A first forward pass keeps only every \code{interval}-th standardized
+//' population vector. The backward pass then walks occasions in reverse,
+//' propagating the reproductive value vector one occasion at a time while
+//' recomputing the stage distribution vectors of each segment from its stored
+//' checkpoint.
+//' 
+//' @name senselas_checkpointed
+//' 
+//' @param sens_acc A dense matrix to which the sensitivity or elasticity terms
+//' are added. Only used if \code{dense = TRUE}.
+//' @param sens_acc_sp A sparse matrix to which the sensitivity or elasticity
+//' terms are added. Only used if \code{dense = FALSE}.
+//' @param sens_ah_acc A dense matrix to which the ahistorical sensitivity terms
+//' of a historical MPM are added. Only used if \code{historical_ah = TRUE}.
+//' @param mats The list of projection matrices.
+//' @param mat_order A vector giving the order of matrices to use at each
+//' occasion.
+//' @param start_vec The starting vector of both the \emph{w} and \emph{v}
+//' projections.
+//' @param style An integer designating whether to add sensitivity terms
+//' (\code{1}) or elasticity terms (\code{2}).
+//' @param dense A logical value indicating whether to project with dense
+//' matrices (\code{TRUE}) or sparse matrices (\code{FALSE}).
+//' @param historical_ah A logical value indicating whether to also add the
+//' ahistorical sensitivity terms of a historical MPM.
+//' @param hstages_id2 A vector giving the ahistorical stage in occasion
+//' \emph{t} of each historical stage pair.
+//' @param interval The number of occasions between stored checkpoint vectors.
+//' Values below \code{1} use the square root of the number of occasions.
+//' 
+//' @return Nothing. The accumulator matrices are modified in place.
+//' 
+//' @section Notes:
+//' With \eqn{T} occasions, \eqn{n} stages, and an interval of \eqn{k}, memory
+//' use for the vector series falls from order \eqn{Tn} to order
+//' \eqn{(T/k + k)n}, or \eqn{\sqrt{T}n} at the default interval, at the cost
+//' of one further forward pass. Terms are identical to those estimated from
+//' the full series developed by \code{proj3()}, aside from the order of
+//' summation.
+//' 
+//' If \code{dense = FALSE}, then terms are summed only over the union of the
+//' non-zero elements of the matrices used, and added to \code{sens_acc_sp} at
+//' the end of the run, so that no dense \eqn{n \times n} matrix is created.
+//' 
+//' @keywords internal
+//' @noRd
+inline void senselas_checkpointed(arma::mat& sens_acc, arma::sp_mat& sens_acc_sp,
+  arma::mat& sens_ah_acc, const List& mats, const arma::uvec& mat_order,
+  const arma::vec& start_vec, int style, bool dense, bool historical_ah, const arma::uvec& hstages_id2,
+  int interval) {
+  
+  int nostages = static_cast<int>(start_vec.n_elem);
+  int ahstages_num = static_cast<int>(sens_ah_acc.n_rows);
+  int theclairvoyant = static_cast<int>(mat_order.n_elem);
+  double times_double = static_cast<double>(theclairvoyant);
+  
+  if (interval < 1) interval = static_cast<int>(std::ceil(std::sqrt(times_double)));
+  if (interval > theclairvoyant) interval = theclairvoyant;
+  
+  // Matrices used in the projection are read once
+  int matlist_length = static_cast<int>(mats.length());
+  arma::uvec used_mats = unique(mat_order);
+  std::vector<int> slot (matlist_length, -1);
+  std::vector<arma::mat> dense_mats;
+  std::vector<dgc_view> sparse_mats;
+  
+  for (int m = 0; m < static_cast<int>(used_mats.n_elem); m++) {
+    int current_mat = static_cast<int>(used_mats(m));
+    slot[current_mat] = m;
+    
+    if (dense) {
+      dense_mats.push_back(as<arma::mat>(mats[current_mat]));
+    } else {
+      sparse_mats.emplace_back(mats, current_mat);
+    }
+  }
+  
+  // Union of non-zero patterns of sparse matrices, and positions within it
+  std::vector<int> pattern_col_ptr;
+  std::vector<int> pattern_row_idx;
+  std::vector<std::vector<int>> pattern_positions;
+  arma::vec pattern_values;
+  
+  if (!dense) {
+    int pattern_cols = sparse_mats[0].n_cols;
+    pattern_col_ptr.assign(pattern_cols + 1, 0);
+    std::vector<int> col_rows;
+    
+    for (int col = 0; col < pattern_cols; col++) {
+      col_rows.clear();
+      for (const dgc_view& current_view : sparse_mats) {
+        for (int k = current_view.col_ptr[col]; k < current_view.col_ptr[col+1]; k++) {
+          col_rows.push_back(current_view.row_idx[k]);
+        }
+      }
+      std::sort(col_rows.begin(), col_rows.end());
+      col_rows.erase(std::unique(col_rows.begin(), col_rows.end()), col_rows.end());
+      
+      pattern_row_idx.insert(pattern_row_idx.end(), col_rows.begin(), col_rows.end());
+      pattern_col_ptr[col+1] = static_cast<int>(pattern_row_idx.size());
+    }
+    
+    for (const dgc_view& current_view : sparse_mats) {
+      std::vector<int> positions (current_view.n_nonzero);
+      
+      for (int col = 0; col < pattern_cols; col++) {
+        const int* col_start = pattern_row_idx.data() + pattern_col_ptr[col];
+        const int* col_end = pattern_row_idx.data() + pattern_col_ptr[col+1];
+        
+        for (int k = current_view.col_ptr[col]; k < current_view.col_ptr[col+1]; k++) {
+          positions[k] = static_cast<int>(std::lower_bound(col_start, col_end,
+            current_view.row_idx[k]) - pattern_row_idx.data());
+        }
+      }
+      pattern_positions.push_back(std::move(positions));
+    }
+    
+    pattern_values.zeros(pattern_row_idx.size());
+  }
+  
+  // Forward pass, keeping only the checkpoint vectors
+  int no_checkpoints = (theclairvoyant + interval - 1) / interval;
+  arma::mat checkpoints (nostages, no_checkpoints, fill::zeros);
+  arma::vec wt = start_vec / sum(start_vec);
+  int last_valid {theclairvoyant}; // Occasion of extinction, if any
+  
+  for (int t = 0; t < theclairvoyant; t++) {
+    if (t % 50 == 0) Rcpp::checkUserInterrupt();
+    if (t % interval == 0) checkpoints.col(t / interval) = wt;
+    
+    int current_slot = slot[mat_order(t)];
+    arma::vec next_w;
+    if (dense) {
+      next_w = dense_mats[current_slot] * wt;
+    } else {
+      next_w = sparse_mats[current_slot].times(wt);
+    }
+    
+    double next_R = sum(next_w);
+    if (next_R <= 0.0) {
+      last_valid = t;
+      break;
+    }
+    wt = next_w / next_R;
+  }
+  
+  // Backward pass over segments, last segment first
+  arma::rowvec vt = start_vec.as_row() / sum(start_vec);
+  arma::mat segment_w (nostages, interval + 1, fill::zeros);
+  arma::vec segment_R (interval, fill::zeros);
+  
+  for (int c = no_checkpoints - 1; c >= 0; c--) {
+    Rcpp::checkUserInterrupt();
+    
+    int seg_start = c * interval;
+    int seg_end = std::min(theclairvoyant, seg_start + interval);
+    
+    // Recompute w and R within the segment from its checkpoint
+    if (seg_start < last_valid) {
+      segment_w.col(0) = checkpoints.col(c);
+      int seg_stop = std::min(seg_end, last_valid);
+      
+      for (int t = seg_start; t < seg_stop; t++) {
+        int current_slot = slot[mat_order(t)];
+        arma::vec next_w;
+        if (dense) {
+          next_w = dense_mats[current_slot] * segment_w.col(t - seg_start);
+        } else {
+          next_w = sparse_mats[current_slot].times(segment_w.col(t - seg_start));
+        }
+        
+        segment_R(t - seg_start) = sum(next_w);
+        segment_w.col(t - seg_start + 1) = next_w / segment_R(t - seg_start);
+      }
+    }
+    
+    for (int j = seg_end - 1; j >= seg_start; j--) {
+      int current_slot = slot[mat_order(j)];
+      
+      // vt holds v at occasion j+1 here; both series must reach occasion j
+      if (j < last_valid && (j + 1) >= (theclairvoyant - last_valid)) {
+        arma::vec vtplus1 = vt.as_col();
+        arma::vec wt_j = segment_w.col(j - seg_start);
+        arma::vec wtplus1 = segment_w.col(j - seg_start + 1);
+        double Rtplus1 = segment_R(j - seg_start);
+        
+        double downward_spiral = Rtplus1 * dot(vtplus1, wtplus1) * times_double;
+        
+        if (downward_spiral != 0.0) {
+          arma::vec scaled_v = vtplus1 / downward_spiral;
+          
+          if (dense && style == 1) {
+            sens_acc += scaled_v * wt_j.as_row();
+          } else if (dense) {
+            sens_acc += (scaled_v * wt_j.as_row()) % dense_mats[current_slot];
+          } else if (style == 1) {
+            int pattern_cols = static_cast<int>(pattern_col_ptr.size()) - 1;
+            for (int col = 0; col < pattern_cols; col++) {
+              double w_col = wt_j(col);
+              if (w_col == 0.0) continue;
+              
+              for (int k = pattern_col_ptr[col]; k < pattern_col_ptr[col+1]; k++) {
+                pattern_values(k) += scaled_v(pattern_row_idx[k]) * w_col;
+              }
+            }
+          } else {
+            // Elasticity terms only occur at non-zero elements
+            const dgc_view& current_view = sparse_mats[current_slot];
+            const std::vector<int>& positions = pattern_positions[current_slot];
+            for (int col = 0; col < current_view.n_cols; col++) {
+              double w_col = wt_j(col);
+              if (w_col == 0.0) continue;
+              
+              for (int k = current_view.col_ptr[col]; k < current_view.col_ptr[col+1]; k++) {
+                int row = current_view.row_idx[k];
+                pattern_values(positions[k]) += current_view.values[k] * scaled_v(row) * w_col;
+              }
+            }
+          }
+        }
+        
+        if (historical_ah) {
+          arma::vec wprojection_ah (ahstages_num, fill::zeros);
+          arma::vec vprojection_ah (ahstages_num, fill::zeros);
+          
+          for (int k1 = 0; k1 < nostages; k1++) {
+            int current_stage2 = hstages_id2(k1);
+            wprojection_ah(current_stage2 - 1) += wtplus1(k1);
+          }
+          
+          for (int k2 = 0; k2 < nostages; k2++) {
+            int current_stage2 = hstages_id2(k2);
+            
+            if (wprojection_ah(current_stage2 - 1) > 0) {
+              vprojection_ah(current_stage2 - 1) += (vtplus1(k2) * wtplus1(k2) /
+                wprojection_ah(current_stage2 - 1));
+            }
+          }
+          
+          double dismal_showing = Rtplus1 * dot(vprojection_ah, wprojection_ah) *
+            times_double;
+          
+          if (dismal_showing != 0.0) {
+            sens_ah_acc += (vprojection_ah / dismal_showing) * wprojection_ah.as_row();
+          }
+        }
+      }
+      
+      // Step v back to occasion j
+      if ((theclairvoyant - 1 - j) < last_valid) {
+        if (dense) {
+          vt = vt * dense_mats[current_slot];
+        } else {
+          vt = sparse_mats[current_slot].trans_times(vt);
+        }
+        vt = vt / sum(vt);
+      }
+    }
+  }
+  
+  if (!dense) {
+    int pattern_nonzero = static_cast<int>(pattern_row_idx.size());
+    int pattern_cols = static_cast<int>(pattern_col_ptr.size()) - 1;
+    arma::umat sens_locations (2, pattern_nonzero);
+    
+    for (int col = 0; col < pattern_cols; col++) {
+      for (int k = pattern_col_ptr[col]; k < pattern_col_ptr[col+1]; k++) {
+        sens_locations(0, k) = pattern_row_idx[k];
+        sens_locations(1, k) = col;
+      }
+    }
+    
+    sens_acc_sp += arma::sp_mat(sens_locations, pattern_values, nostages,
+      nostages, false, true);
+  }
+}
+
+//' Small Noise Approximation of Stochastic Sensitivities
+//' 
+//' Function \code{sna_senselas()} estimates the sensitivities or elasticities
+//' of the log stochastic growth rate of a set of matrices chosen independently
+//' in each occasion, using the small noise approximation. No simulation is
+//' conducted.
+//' 
+//' @name sna_senselas
+//' 
+//' @param sens_out A dense matrix to hold the sensitivity or elasticity
+//' matrix.
+//' @param sens_ah_out A dense matrix to hold the ahistorical sensitivity matrix
+//' of a historical MPM. Must be sized to the number of ahistorical stages, and
+//' is only used if \code{historical_ah = TRUE}.
+//' @param mats A list of dense or sparse matrices.
+//' @param chosen A vector of the indices of the matrices in \code{mats} to use.
+//' @param weights A vector of the probabilities of choosing each matrix in
+//' \code{chosen}, in the same order. Need not sum to 1.
+//' @param style An integer designating whether to estimate sensitivities
+//' (\code{1}) or elasticities (\code{2}).
+//' @param historical_ah A logical value indicating whether to also estimate the
+//' ahistorical sensitivities of a historical MPM.
+//' @param hstages_id2 A vector giving the ahistorical stage in occasion
+//' \emph{t} of each historical stage pair.
+//' 
+//' @return Nothing. The output matrices are modified in place.
+//' 
+//' @section Notes:
+//' Sensitivities are taken to first order, as \eqn{v w^T / (\lambda v^T w)}
+//' from the dominant eigenvalue and eigenvectors of the weighted mean matrix,
+//' which is the leading term of the sensitivity of the log stochastic growth
+//' rate to the mean matrix elements. Elasticities are these sensitivities
+//' multiplied elementwise by the mean matrix.
+//' 
+//' @keywords internal
+//' @noRd
+inline void sna_senselas(arma::mat& sens_out, arma::mat& sens_ah_out,
+  const List& mats, const arma::uvec& chosen, const arma::vec& weights,
+  int style, bool historical_ah, const arma::uvec& hstages_id2) {
+  
+  arma::vec w;
+  arma::vec v;
+  arma::sp_mat mean_mat;
+  arma::vec sna_out = sna_growth(mats, chosen, weights, w, v, mean_mat);
+  double lambda = sna_out(2);
+  
+  sens_out = (v * w.as_row()) / (lambda * dot(v, w));
+  if (style == 2) sens_out = sens_out % arma::mat(mean_mat);
+  
+  if (historical_ah) {
+    int nostages = static_cast<int>(w.n_elem);
+    int ahstages_num = static_cast<int>(sens_ah_out.n_rows);
+    arma::vec w_ah (ahstages_num, fill::zeros);
+    arma::vec v_ah (ahstages_num, fill::zeros);
+    
+    for (int k = 0; k < nostages; k++) {
+      int current_stage2 = hstages_id2(k);
+      w_ah(current_stage2 - 1) += w(k);
+    }
+    
+    for (int k = 0; k < nostages; k++) {
+      int current_stage2 = hstages_id2(k);
+      
+      if (w_ah(current_stage2 - 1) > 0) {
+        v_ah(current_stage2 - 1) += (v(k) * w(k) / w_ah(current_stage2 - 1));
+      }
+    }
+    
+    double vw_ah = dot(v_ah, w_ah);
+    if (vw_ah != 0.0) {
+      sens_ah_out = (v_ah * w_ah.as_row()) / (lambda * vw_ah);
+    } else {
+      sens_ah_out.zeros();
+    }
+  }
+}
+
 //' Estimate Stochastic Sensitivity or Elasticity of Matrix Set
 //' 
 //' Function \code{stoch_senselas()} estimates the sensitivity and elasticity to
@@ -19820,6 +23034,15 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
 //' annual matrix is currently chosen. If a vector is input, then the choice of
 //' annual matrix is assumed to be independent of the current matrix. Defaults
 //' to equal weighting among matrices.
+//' @param checkpoint An integer controlling how the \emph{w} and \emph{v}
+//' series are held in memory. If \code{0} (the default), then the full series
+//' are developed through \code{proj3()}. Positive values give the number of
+//' occasions between stored checkpoint vectors, with intermediate vectors
+//' recomputed during the backward pass, and negative values set this interval
+//' to the square root of \code{times}.
+//' @param sna A logical value indicating whether to estimate sensitivities or
+//' elasticities via the small noise approximation rather than via simulation.
+//' Defaults to \code{FALSE}.
 //' 
 //' @return A list of one or two cubes (3d array) where each slice corresponds
 //' to a sensitivity or elasticity matrix for a specific pop-patch, followed by
@@ -19839,17 +23062,36 @@ DataFrame slambda3(const List& mpm, int times = 10000, bool historical = false,
 //' This function currently requires all patches to have the same occasions, if
 //' a \code{lefkoMat} object is used as input. Asymmetry in the number of
 //' occasions across patches and/or populations will likely cause errors.
+//' 
+//' Checkpointing reduces memory use for the vector series from order
+//' \eqn{Tn} to order \eqn{\sqrt{T}n} at the default interval, where \eqn{T}
+//' is \code{times} and \eqn{n} is the number of rows in each matrix, at the
+//' cost of one further forward projection per pop-patch. With sparse matrices,
+//' checkpointed terms are accumulated in sparse form over the union of the
+//' non-zero elements of the matrices used.
+//' 
+//' If \code{sna = TRUE}, then no simulation is conducted, and sensitivities
+//' are estimated to first order from the weighted mean matrix of each
+//' pop-patch, via function \code{sna_senselas()}. This requires an independent
+//' and identically distributed environment.
 //'
 //' @keywords internal
 //' @noRd
 // [[Rcpp::export(.stoch_senselas)]]
 Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
   bool historical = false, int style = 1, int sparse = 0, bool lefkoProj = true,
-  Nullable<RObject> tweights = R_NilValue) {
+  Nullable<RObject> tweights = R_NilValue, int checkpoint = 0,
+  bool sna = false) {
   
   int theclairvoyant = times;
   if (theclairvoyant < 1) pop_error("times", "a positive integer", "", 1);
   
+  if (sna && tweights.isNotNull()) {
+    if (Rf_isMatrix(tweights)) {
+      throw Rcpp::exception("The small noise approximation cannot be used with first-order Markovian environments.", false);
+    }
+  }
+  
   bool lMat_matrix_class_input {false};
   bool lMat_sparse_class_input {false};
   bool list_input {false};
@@ -20072,6 +23314,8 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
     for (int i= 0; i < allppcsnem; i++) { //  pop-patch loop
       arma::uvec theprophecy (theprophecy_allyears.length(), fill::zeros);
       arma::uvec tnotb_patch = find(ppcindex == allppcs(i));
+      arma::uvec sna_chosen (yl, fill::zeros);
+      arma::uvec sna_found (yl, fill::zeros);
       
       for (int j = 0; j < yl; j++) { // Main index for used matrices
         // Modify in case patches do not have same years
@@ -20080,6 +23324,9 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
         arma::uvec thenumbersofthebeast = intersect(tnotb_patch, tnotb_years);
         
         if (thenumbersofthebeast.n_elem > 0) {
+          sna_chosen(j) = thenumbersofthebeast(0);
+          sna_found(j) = 1;
+          
           IntegerVector prophetic_yearindices_IV = match(as<StringVector>(uniqueyears(j)), 
               theprophecy_allyears) - 1;
           arma::uvec prophetic_yearindices = as<arma::uvec>(wrap(prophetic_yearindices_IV));
@@ -20092,6 +23339,58 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
       }
       yearspulled.row(i) = theprophecy.t();
       
+      if (sna) {
+        // Small noise approximation
+        arma::uvec sna_years = find(sna_found);
+        arma::mat sna_sens;
+        arma::mat sna_sens_ah (ahstages_num, ahstages_num, fill::zeros);
+        sna_senselas(sna_sens, sna_sens_ah, amats, sna_chosen.elem(sna_years),
+          twinput.elem(sna_years), style, (historical && style == 1),
+          hstages_id2);
+        
+        if (sparse == 1) {
+          senscube(i) = arma::sp_mat(sna_sens);
+          if (historical && style == 1) senscube_ah(i) = arma::sp_mat(sna_sens_ah);
+        } else {
+          senscube(i) = sna_sens;
+          if (historical && style == 1) senscube_ah(i) = sna_sens_ah;
+        }
+        continue;
+      }
+      
+      if (checkpoint != 0) {
+        // Checkpointed w and v series
+        arma::mat ckpt_sens_ah (ahstages_num, ahstages_num, fill::zeros);
+        senselas_checkpointed(sens_base, sens_base_sp, ckpt_sens_ah, amats,
+          theprophecy, startvec, style, (lMat_matrix_class_input && sparse == 0),
+          (historical && style == 1), hstages_id2, checkpoint);
+        
+        if (lMat_matrix_class_input && sparse == 0) {
+          senscube(i) = sens_base;
+          
+          if (historical && style == 1) {
+            sens_base_ah += ckpt_sens_ah;
+            senscube_ah(i) = sens_base_ah;
+          }
+        } else {
+          if (sparse == 1) {
+            senscube(i) = sens_base_sp;
+          } else {
+            senscube(i) = arma::mat(sens_base_sp);
+          }
+          
+          if (historical && style == 1) {
+            sens_base_ah_sp += arma::sp_mat(ckpt_sens_ah);
+            if (sparse == 1) {
+              senscube_ah(i) = sens_base_ah_sp;
+            } else {
+              senscube_ah(i) = arma::mat(sens_base_ah_sp);
+            }
+          }
+        }
+        continue;
+      }
+      
       // Stable stage and rep value vectors, ahistorical versions of hMPMs
       arma::vec wprojection_ah(ahstages_num, fill::zeros);
       arma::vec vprojection_ah(ahstages_num, fill::zeros);
@@ -20372,6 +23671,60 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
         }
         yearspulled.row(allppcsnem + i) = theprophecy.t();
         
+        if (sna) {
+          // Small noise approximation
+          arma::uvec sna_chosen = linspace<arma::uvec>(0, (yl - 1), yl);
+          arma::mat sna_sens;
+          arma::mat sna_sens_ah (ahstages_num, ahstages_num, fill::zeros);
+          sna_senselas(sna_sens, sna_sens_ah, meanmatyearlist, sna_chosen,
+            twinput, style, (historical && style == 1), hstages_id2);
+          
+          if (sparse == 1) {
+            senscube(allppcsnem + i) = arma::sp_mat(sna_sens);
+            if (historical && style == 1) {
+              senscube_ah(allppcsnem + i) = arma::sp_mat(sna_sens_ah);
+            }
+          } else {
+            senscube(allppcsnem + i) = sna_sens;
+            if (historical && style == 1) senscube_ah(allppcsnem + i) = sna_sens_ah;
+          }
+          continue;
+        }
+        
+        if (checkpoint != 0) {
+          // Checkpointed w and v series
+          arma::mat ckpt_sens_ah (ahstages_num, ahstages_num, fill::zeros);
+          senselas_checkpointed(pop_sens_base, pop_sens_base_sp, ckpt_sens_ah,
+            meanmatyearlist, theprophecy, startvec, style,
+            (lMat_matrix_class_input && sparse == 0), (historical && style == 1),
+            hstages_id2, checkpoint);
+          
+          if (lMat_matrix_class_input && sparse == 0) {
+            senscube(allppcsnem + i) = pop_sens_base;
+            
+            if (historical && style == 1) {
+              pop_sens_base_ah += ckpt_sens_ah;
+              senscube_ah(allppcsnem + i) = pop_sens_base_ah;
+            }
+          } else {
+            if (sparse == 1) {
+              senscube(allppcsnem + i) = pop_sens_base_sp;
+            } else {
+              senscube(allppcsnem + i) = arma::mat(pop_sens_base_sp);
+            }
+            
+            if (historical && style == 1) {
+              pop_sens_base_ah_sp += arma::sp_mat(ckpt_sens_ah);
+              if (sparse == 1) {
+                senscube_ah(allppcsnem + i) = pop_sens_base_ah_sp;
+              } else {
+                senscube_ah(allppcsnem + i) = arma::mat(pop_sens_base_ah_sp);
+              }
+            }
+          }
+          continue;
+        }
+        
         arma::vec wprojection_ah(ahstages_num, fill::zeros);
         arma::vec vprojection_ah(ahstages_num, fill::zeros);
         
@@ -20479,7 +23832,7 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
               
               if (lMat_matrix_class_input && sparse == 0) {
                 csah_num = vprojection_ah * wtah_tpose;
-                csah_den = (Rvecmat(i, j) * vtah_tpose * wprojection_ah);
+                csah_den = (Rvecmat((allppcsnem + i), j) * vtah_tpose * wprojection_ah);
                 
                 double cdah_double = csah_den(0,0);
                 double downward_spiral = (cdah_double * static_cast<double>(theclairvoyant));
@@ -20495,7 +23848,7 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
                 
               } else {
                 csah_num_sp = vprojection_ah * wtah_tpose;
-                csah_den_sp = (Rvecmat(i, j) * vtah_tpose * wprojection_ah);
+                csah_den_sp = (Rvecmat((allppcsnem + i), j) * vtah_tpose * wprojection_ah);
                 
                 double cdah_double = csah_den_sp(0,0);
                 double downward_spiral = (cdah_double * static_cast<double>(theclairvoyant));
@@ -20674,6 +24027,47 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
     }
     
     
+    if (sna) {
+      // Small noise approximation
+      arma::mat sna_sens;
+      arma::mat sna_sens_ah;
+      arma::uvec sna_hstages;
+      sna_senselas(sna_sens, sna_sens_ah, amats, uniqueyears_arma, twinput,
+        style, false, sna_hstages);
+      
+      if (sparse == 1) {
+        senscube(0) = arma::sp_mat(sna_sens);
+      } else {
+        senscube(0) = sna_sens;
+      }
+      
+      return Rcpp::List::create(_["maincube"] = senscube);
+    }
+    
+    if (checkpoint != 0) {
+      // Checkpointed w and v series
+      bool ckpt_dense = (lMat_matrix_class_input && sparse == 0);
+      arma::mat ckpt_sens;
+      arma::sp_mat ckpt_sens_sp (matrows, matrows);
+      arma::mat ckpt_sens_ah;
+      arma::uvec ckpt_hstages;
+      if (ckpt_dense) ckpt_sens.zeros(matrows, matrows);
+      
+      senselas_checkpointed(ckpt_sens, ckpt_sens_sp, ckpt_sens_ah, amats,
+        theprophecy, startvec, style, ckpt_dense, false, ckpt_hstages,
+        checkpoint);
+      
+      if (ckpt_dense) {
+        senscube(0) = ckpt_sens;
+      } else if (sparse == 1) {
+        senscube(0) = ckpt_sens_sp;
+      } else {
+        senscube(0) = arma::mat(ckpt_sens_sp);
+      }
+      
+      return Rcpp::List::create(_["maincube"] = senscube);
+    }
+    
     // Matrices to hold R values
     arma::mat Rvecmat(trials, theclairvoyant, fill::zeros);
     
@@ -20770,8 +24164,153 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
       }
     }
     
-  return Rcpp::List::create(_["maincube"] = senscube);
+  return Rcpp::List::create(_["maincube"] = senscube);
+  }
+}
+
+//' Dominant Eigenvector Pair from Eigen Analysis Output
+//' 
+//' Function \code{ltre_eigen_pair()} extracts the real parts of the right and
+//' left eigenvectors associated with the dominant eigenvalue from the output of
+//' functions \code{decomp3()} and \code{decomp3sp_inp()}, scaled as in function
+//' \code{sens3matrix()}.
+//' 
+//' @name ltre_eigen_pair
+//' 
+//' @param eigenstuff The list output from an eigen analysis function.
+//' @param w A vector to hold the right eigenvector, scaled to sum to 1.
+//' @param v A vector to hold the left eigenvector, scaled so that its first
+//' non-zero element equals 1.
+//' 
+//' @return Nothing. Output vectors are modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void ltre_eigen_pair(const List& eigenstuff, arma::vec& w,
+  arma::vec& v) {
+  
+  arma::vec realeigenvals = real(as<arma::cx_vec>(eigenstuff["eigenvalues"]));
+  int lambda1 = realeigenvals.index_max();
+  
+  w = real(as<arma::cx_mat>(eigenstuff["right_eigenvectors"]).col(lambda1));
+  w.clean(0.00000000000001);
+  w = w / sum(w);
+  
+  v = real(as<arma::cx_mat>(eigenstuff["left_eigenvectors"]).col(lambda1));
+  v.clean(0.00000000000001);
+  arma::uvec rlvabsalt = find(v);
+  v = v / v(rlvabsalt(0));
+}
+
+//' Warm-Started Dominant Eigenvectors by Power Iteration
+//' 
+//' Function \code{ltre_warm_eigen()} estimates the dominant right and left
+//' eigenvectors of a dense or sparse matrix by power iteration, starting from
+//' the eigenvectors of a nearby matrix. In LTREs, the starting vectors are
+//' those of the reference matrix, which are usually very close to those of each
+//' midpoint matrix. This function uses only Armadillo objects, and so may be
+//' called within parallel regions.
+//' 
+//' @name ltre_warm_eigen
+//' 
+//' @param Amat The dense or sparse matrix to analyze.
+//' @param w On input, the starting right eigenvector. On output, the estimated
+//' right eigenvector, scaled to sum to 1.
+//' @param v On input, the starting left eigenvector. On output, the estimated
+//' left eigenvector, scaled to sum to 1.
+//' @param conv_tol The maximum summed absolute change in either vector between
+//' iterations at convergence. Defaults to \code{1e-12}.
+//' @param max_iter The maximum number of iterations. Defaults to \code{2000}.
+//' 
+//' @return A logical value indicating whether both vectors converged. Power
+//' iteration does not converge in imprimitive matrices, or where the two
+//' largest eigenvalues are very close in modulus, and a full eigen analysis
+//' should then be used instead.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename T>
+inline bool ltre_warm_eigen(const T& Amat, arma::vec& w, arma::vec& v,
+  double conv_tol = 1e-12, int max_iter = 2000) {
+  
+  int matdim = static_cast<int>(Amat.n_rows);
+  
+  // A small uniform component keeps starting vectors from missing stages
+  arma::vec w_now = arma::abs(w) / accu(arma::abs(w)) + (1e-8 / matdim);
+  arma::vec v_now = arma::abs(v) / accu(arma::abs(v)) + (1e-8 / matdim);
+  w_now = w_now / accu(w_now);
+  v_now = v_now / accu(v_now);
+  
+  bool w_done {false};
+  bool v_done {false};
+  
+  for (int iter = 0; iter < max_iter; iter++) {
+    if (!w_done) {
+      arma::vec w_next = Amat * w_now;
+      double w_sum = accu(w_next);
+      if (!(w_sum > 0.0) || !w_next.is_finite()) return false;
+      
+      w_next = w_next / w_sum;
+      if (arma::norm(w_next - w_now, 1) < conv_tol) w_done = true;
+      w_now = w_next;
+    }
+    
+    if (!v_done) {
+      arma::vec v_next = arma::vectorise(v_now.t() * Amat);
+      double v_sum = accu(v_next);
+      if (!(v_sum > 0.0) || !v_next.is_finite()) return false;
+      
+      v_next = v_next / v_sum;
+      if (arma::norm(v_next - v_now, 1) < conv_tol) v_done = true;
+      v_now = v_next;
+    }
+    
+    if (w_done && v_done) break;
+  }
+  if (!w_done || !v_done) return false;
+  
+  w = w_now;
+  v = v_now;
+  
+  return true;
+}
+
+//' Sparse LTRE Contributions from Eigenvectors
+//' 
+//' Function \code{ltre_sp_cont()} multiplies each non-zero element of a
+//' sparse difference matrix by the sensitivity implied by the given right and
+//' left eigenvectors, without creating the full sensitivity matrix. This
+//' function uses only Armadillo objects, and so may be called within parallel
+//' regions.
+//' 
+//' @name ltre_sp_cont
+//' 
+//' @param diffmat The sparse difference matrix.
+//' @param v The left eigenvector.
+//' @param w The right eigenvector.
+//' 
+//' @return A sparse matrix of LTRE contributions.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::sp_mat ltre_sp_cont(const arma::sp_mat& diffmat,
+  const arma::vec& v, const arma::vec& w) {
+  
+  double vwscalar = arma::dot(v, w);
+  int diff_nonzero = static_cast<int>(diffmat.n_nonzero);
+  arma::umat locations (2, diff_nonzero);
+  arma::vec values (diff_nonzero);
+  
+  int counter {0};
+  for (arma::sp_mat::const_iterator it = diffmat.begin(); it != diffmat.end(); ++it) {
+    locations(0, counter) = it.row();
+    locations(1, counter) = it.col();
+    values(counter) = (*it) * v(it.row()) * w(it.col()) / vwscalar;
+    counter++;
   }
+  
+  return arma::sp_mat(locations, values, diffmat.n_rows, diffmat.n_cols,
+    false, true);
 }
 
 //' Estimate LTRE of Any Population Matrix
@@ -20790,17 +24329,26 @@ Rcpp::List stoch_senselas(const List& mpm, int times = 10000,
 //' matrix as the reference.
 //' @param sparse A logical value indicating whether to use sparse or dense
 //' format in matrix calculations.
+//' @param approx A logical value indicating whether to use the sensitivities of
+//' the reference matrix in all comparisons, rather than those of each midpoint
+//' matrix. Defaults to \code{FALSE}.
 //' 
 //' @return This function returns a one-element list with a list of LTRE
 //' contributions, each element a matrix of contributions corresponding to each
 //' input matrix in \code{Amats}. 
 //' 
+//' @section Notes:
+//' The eigen analysis of the reference matrix is conducted once. Midpoint
+//' matrix eigenvectors are then estimated in parallel by power iteration
+//' started from the reference eigenvectors, and a full eigen analysis is only
+//' used for midpoint matrices in which power iteration does not converge.
+//' 
 //' @keywords internal
 //' @noRd
 // [[Rcpp::export(.ltre3matrix)]]
 Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
   Nullable<Rcpp::List> refmats_ = R_NilValue, bool mean = true,
-  bool sparse = false) {
+  bool sparse = false, bool approx = false) {
   
   bool sparse_input {false};
   if (is<S4>(Amats(0))) sparse_input = true;
@@ -20808,7 +24356,8 @@ Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
   int Amatnum = Amats.length();
   int matdim {0};
   if (sparse_input) {
-    matdim = as<arma::sp_mat>(Amats(0)).n_rows;
+    LefkoMats::dgc_view first_view (Amats, 0);
+    matdim = first_view.n_rows;
   } else {
     matdim = as<arma::mat>(Amats(0)).n_rows;
   }
@@ -20826,6 +24375,10 @@ Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
   List mean_set;
   List cont_list(Amatnum);
   
+  arma::vec ref_w;
+  arma::vec ref_v;
+  std::vector<int> warm_failed (Amatnum, 0);
+  
   if (!sparse && !sparse_input) {
     // Dense matrix analysis
     arma::mat finalrefmat(matdim, matdim, fill::zeros);
@@ -20843,66 +24396,55 @@ Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
       
     } else {
       if (mean && refmatnum > 1) {
-        for (int i = 0; i < Amatnum; i++) {
+        for (int i = 0; i < refmatnum; i++) {
           finalrefmat = finalrefmat + (as<arma::mat>(Amats(refnum(i))) /
-            static_cast<double>(Amatnum));
+            static_cast<double>(refmatnum));
         }
       } else {
         finalrefmat = as<arma::mat>(Amats(refnum(0)));
       }
     }
     
-    // Create halfway matrices and run sensitivities
-    arma::mat halfmat(matdim, matdim, fill::zeros);
-    arma::mat diffmat(matdim, matdim, fill::zeros);
+    // Reference eigenvectors, used as sensitivities or as warm starts
+    eigenstuff = LefkoMats::decomp3(finalrefmat);
+    ltre_eigen_pair(eigenstuff, ref_w, ref_v);
+    arma::mat ref_sens = (ref_v * ref_w.t()) / arma::dot(ref_v, ref_w);
     
+    std::vector<arma::mat> diffmats (Amatnum);
     for (int i = 0; i < Amatnum; i++) {
-      halfmat = (finalrefmat + (as<arma::mat>(Amats(i)))) / static_cast<double>(2.0);
-      diffmat = (as<arma::mat>(Amats(i))) - finalrefmat;
-      
-      cont_list(i) = diffmat % sens3matrix(halfmat, 0);
+      diffmats[i] = (as<arma::mat>(Amats(i))) - finalrefmat;
     }
-  } else if (!sparse_input) {
-    // Sparse matrix analysis with dense input
-    arma::sp_mat finalrefmat(matdim, matdim);
     
-    if (refmats_.isNotNull()) {
-      Rcpp::List refmats(refmats_);
-      
-      if (mean && refmatnum > 1) {
-        for (int i = 0; i < refmatnum; i++) {
-          finalrefmat = finalrefmat + (arma::sp_mat(as<arma::mat>(refmats(refnum(i)))) / 
-            static_cast<double>(refmatnum));
-        }
+    // Create halfway matrices and run sensitivities
+    std::vector<arma::mat> cont_mats (Amatnum);
+    
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int i = 0; i < Amatnum; i++) {
+      if (approx) {
+        cont_mats[i] = diffmats[i] % ref_sens;
       } else {
-        finalrefmat = (arma::sp_mat(as<arma::mat>(refmats(refnum(0)))));
-      }
-      
-    } else {
-      if (mean && refmatnum > 1) {
-        for (int i = 0; i < Amatnum; i++) {
-          finalrefmat = finalrefmat + (arma::sp_mat(as<arma::mat>(Amats(refnum(i)))) / 
-            static_cast<double>(Amatnum));
-        }
+        arma::mat halfmat = finalrefmat + (diffmats[i] / 2.0);
+        arma::vec current_w = ref_w;
+        arma::vec current_v = ref_v;
         
-      } else {
-        finalrefmat = (arma::sp_mat(as<arma::mat>(Amats(refnum(0)))));
+        if (ltre_warm_eigen(halfmat, current_w, current_v)) {
+          cont_mats[i] = diffmats[i] % ((current_v * current_w.t()) /
+            arma::dot(current_v, current_w));
+        } else warm_failed[i] = 1;
       }
     }
     
-    // Create halfway matrices and run sensitivities
-    arma::sp_mat halfmat(matdim, matdim);
-    arma::sp_mat diffmat(matdim, matdim);
-    
     for (int i = 0; i < Amatnum; i++) {
-      halfmat = (finalrefmat + (arma::sp_mat(as<arma::mat>(Amats(i))))) /
-        static_cast<double>(2.0);
-      diffmat = (arma::sp_mat(as<arma::mat>(Amats(i)))) - finalrefmat;
-      arma::sp_mat set_up = diffmat % sens3sp_matrix(halfmat, diffmat);
-      cont_list(i) = set_up;
+      if (warm_failed[i] == 1) {
+        arma::mat halfmat = finalrefmat + (diffmats[i] / 2.0);
+        cont_mats[i] = diffmats[i] % sens3matrix(halfmat, 0);
+      }
+      cont_list(i) = cont_mats[i];
     }
   } else {
-    // Sparse matrix analysis with sparse input
+    // Sparse matrix analysis, reading sparse input slots in place
     arma::sp_mat finalrefmat(matdim, matdim);
     
     if (refmats_.isNotNull()) {
@@ -20910,36 +24452,65 @@ Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
       
       if (mean && refmatnum > 1) {
         for (int i = 0; i < refmatnum; i++) {
-          finalrefmat = finalrefmat + (as<arma::sp_mat>(refmats(refnum(i))) / 
-            static_cast<double>(refmatnum));
+          LefkoMats::dgc_view ref_view (refmats, refnum(i));
+          finalrefmat = ref_view.combine(finalrefmat,
+            (1.0 / static_cast<double>(refmatnum)), 1.0);
         }
       } else {
-        finalrefmat = (as<arma::sp_mat>(refmats(refnum(0))));
+        LefkoMats::dgc_view ref_view (refmats, refnum(0));
+        finalrefmat = ref_view.sp();
       }
       
     } else {
       if (mean && refmatnum > 1) {
-        for (int i = 0; i < Amatnum; i++) {
-          finalrefmat = finalrefmat + (as<arma::sp_mat>(Amats(refnum(i))) / 
-            static_cast<double>(Amatnum));
+        for (int i = 0; i < refmatnum; i++) {
+          LefkoMats::dgc_view ref_view (Amats, refnum(i));
+          finalrefmat = ref_view.combine(finalrefmat,
+            (1.0 / static_cast<double>(refmatnum)), 1.0);
         }
         
       } else {
-        finalrefmat = (as<arma::sp_mat>(Amats(refnum(0))));
+        LefkoMats::dgc_view ref_view (Amats, refnum(0));
+        finalrefmat = ref_view.sp();
       }
     }
     
+    // Reference eigenvectors, used as sensitivities or as warm starts
+    eigenstuff = LefkoMats::decomp3sp_inp(finalrefmat);
+    ltre_eigen_pair(eigenstuff, ref_w, ref_v);
+    
+    std::vector<arma::sp_mat> halfmats (Amatnum);
+    std::vector<arma::sp_mat> diffmats (Amatnum);
+    for (int i = 0; i < Amatnum; i++) {
+      LefkoMats::dgc_view current_view (Amats, i);
+      if (!approx) halfmats[i] = current_view.combine(finalrefmat, 0.5, 0.5);
+      diffmats[i] = current_view.combine(finalrefmat, 1.0, -1.0);
+    }
+    
     // Create halfway matrices and run sensitivities
-    arma::sp_mat halfmat(matdim, matdim);
-    arma::sp_mat diffmat(matdim, matdim);
+    std::vector<arma::sp_mat> cont_mats (Amatnum);
     
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
     for (int i = 0; i < Amatnum; i++) {
-      halfmat = (finalrefmat + (as<arma::sp_mat>(Amats(i)))) /
-        static_cast<double>(2.0);
-      diffmat = (as<arma::sp_mat>(Amats(i))) - finalrefmat;
-      
-      arma::sp_mat outmat = diffmat % sens3sp_matrix(halfmat, diffmat);
-      cont_list(i) = outmat;
+      if (approx) {
+        cont_mats[i] = ltre_sp_cont(diffmats[i], ref_v, ref_w);
+      } else {
+        arma::vec current_w = ref_w;
+        arma::vec current_v = ref_v;
+        
+        if (ltre_warm_eigen(halfmats[i], current_w, current_v)) {
+          cont_mats[i] = ltre_sp_cont(diffmats[i], current_v, current_w);
+        } else warm_failed[i] = 1;
+      }
+    }
+    
+    for (int i = 0; i < Amatnum; i++) {
+      if (warm_failed[i] == 1) {
+        cont_mats[i] = diffmats[i] % sens3sp_matrix(halfmats[i], diffmats[i]);
+      }
+      cont_list(i) = cont_mats[i];
     }
   }
   
@@ -20950,6 +24521,194 @@ Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum,
   return output;
 }
 
+//' Stack Matrix Elements Across a Set of Matrices
+//' 
+//' Function \code{ltre_stack()} reads the chosen elements of a set of matrices
+//' into a single dense matrix, with one row per element and one column per
+//' chosen matrix. Elements not greater than \code{tol_used} are set to
+//' \code{0}. Each distinct matrix is read only once, even if chosen repeatedly.
+//' 
+//' @name ltre_stack
+//' 
+//' @param mats A list of dense or sparse matrices.
+//' @param chosen A vector giving the indices of the matrices to use, in order.
+//' Indices may repeat.
+//' @param index A vector of column-major linear indices of the elements to
+//' read.
+//' @param tol_used The lower positive limit to element values.
+//' 
+//' @return A matrix with as many rows as elements in \code{index}, and as many
+//' columns as elements in \code{chosen}.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::mat ltre_stack(const List& mats, const arma::uvec& chosen,
+  const arma::uvec& index, double tol_used) {
+  
+  arma::mat stack (index.n_elem, chosen.n_elem, fill::zeros);
+  arma::uvec unique_chosen = unique(chosen);
+  
+  for (int m = 0; m < static_cast<int>(unique_chosen.n_elem); m++) {
+    int current_mat = static_cast<int>(unique_chosen(m));
+    arma::vec elems;
+    
+    if (is<S4>(mats(current_mat))) {
+      LefkoMats::dgc_view current_view (mats, current_mat);
+      elems = current_view.gather(index);
+    } else {
+      arma::mat current_dense = as<arma::mat>(mats(current_mat));
+      elems = current_dense.elem(index);
+    }
+    elems.elem(find(elems <= tol_used)).zeros();
+    
+    arma::uvec chosen_cols = find(chosen == unique_chosen(m));
+    for (int c = 0; c < static_cast<int>(chosen_cols.n_elem); c++) {
+      stack.col(chosen_cols(c)) = elems;
+    }
+  }
+  
+  return stack;
+}
+
+//' Temporal Standard Deviations and Correlations of Stacked Elements
+//' 
+//' Function \code{ltre_moments()} estimates the standard deviation of each row
+//' of a matrix produced by \code{ltre_stack()}, and the correlations between
+//' rows. Correlations are kept only where the first element varies by more
+//' than \code{tol_used}, the second element varies at all, and the
+//' correlation itself is greater than \code{tol_used}. This function uses only
+//' Armadillo objects, and so may be called within parallel regions.
+//' 
+//' @name ltre_moments
+//' 
+//' @param stack A matrix of element values, with rows as elements and columns
+//' as matrices.
+//' @param tol_used The lower positive limit to element values.
+//' @param sd_out A vector to hold the standard deviation of each element.
+//' @param corr_out A square matrix to hold the correlations between elements.
+//' 
+//' @return Nothing. Output objects are modified in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void ltre_moments(const arma::mat& stack, double tol_used,
+  arma::vec& sd_out, arma::mat& corr_out) {
+  
+  int index_num = static_cast<int>(stack.n_rows);
+  sd_out.zeros(index_num);
+  corr_out.zeros(index_num, index_num);
+  if (index_num == 0) return;
+  
+  sd_out = arma::stddev(stack, 0, 1);
+  if (stack.n_cols < 2) return;
+  
+  corr_out = arma::cor(stack.t());
+  for (int k = 0; k < index_num; k++) {
+    for (int j = 0; j < index_num; j++) {
+      double corr_bit = corr_out(j, k);
+      
+      if (!(sd_out(j) > tol_used) || !(sd_out(k) > 0.0) ||
+          !std::isfinite(corr_bit) || corr_bit <= tol_used) {
+        corr_out(j, k) = 0.0;
+      }
+    }
+  }
+}
+
+//' Coefficients of Variation of Indexed Matrix Elements
+//' 
+//' Function \code{ltre_cv()} divides element standard deviations by the
+//' corresponding elements of a mean matrix. Coefficients are set to \code{0}
+//' where either the standard deviation or the mean is not greater than
+//' \code{tol_used}.
+//' 
+//' @name ltre_cv
+//' 
+//' @param sds A vector of element standard deviations.
+//' @param mean_mat The dense or sparse mean matrix.
+//' @param index A vector of column-major linear indices of the elements in
+//' \code{sds}.
+//' @param tol_used The lower positive limit to element values.
+//' 
+//' @return A vector of coefficients of variation.
+//' 
+//' @keywords internal
+//' @noRd
+template <typename T>
+inline arma::vec ltre_cv(const arma::vec& sds, const T& mean_mat,
+  const arma::uvec& index, double tol_used) {
+  
+  int index_num = static_cast<int>(index.n_elem);
+  arma::vec cvs (index_num, fill::zeros);
+  
+  for (int p = 0; p < index_num; p++) {
+    double mean_elem = mean_mat(index(p));
+    if (sds(p) > tol_used && mean_elem > tol_used) cvs(p) = sds(p) / mean_elem;
+  }
+  
+  return cvs;
+}
+
+//' Sparse Square Matrix from Indexed Element Values
+//' 
+//' Function \code{ltre_sp_elems()} creates a square sparse matrix holding the
+//' given values at the given column-major linear indices.
+//' 
+//' @name ltre_sp_elems
+//' 
+//' @param index A vector of column-major linear indices.
+//' @param values A vector of values, one per element of \code{index}.
+//' @param matdim The number of rows and columns in the output matrix.
+//' 
+//' @return A sparse matrix.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::sp_mat ltre_sp_elems(const arma::uvec& index,
+  const arma::vec& values, int matdim) {
+  
+  arma::umat locations (2, index.n_elem);
+  for (int p = 0; p < static_cast<int>(index.n_elem); p++) {
+    locations(0, p) = index(p) % matdim;
+    locations(1, p) = index(p) / matdim;
+  }
+  
+  return arma::sp_mat(locations, values, matdim, matdim);
+}
+
+//' Sparse Element-by-Element Matrix from Indexed Pair Values
+//' 
+//' Function \code{ltre_sp_pairs()} scatters a square matrix of values for
+//' pairs of indexed elements, such as element correlations, into a sparse
+//' matrix with one row and one column per matrix element.
+//' 
+//' @name ltre_sp_pairs
+//' 
+//' @param index A vector of column-major linear indices.
+//' @param values A square matrix of values for each pair of elements in
+//' \code{index}.
+//' @param matlength The number of rows and columns in the output matrix.
+//' 
+//' @return A sparse matrix.
+//' 
+//' @keywords internal
+//' @noRd
+inline arma::sp_mat ltre_sp_pairs(const arma::uvec& index,
+  const arma::mat& values, int matlength) {
+  
+  arma::uvec found = find(values);
+  arma::umat locations (2, found.n_elem);
+  int index_num = static_cast<int>(index.n_elem);
+  
+  for (int p = 0; p < static_cast<int>(found.n_elem); p++) {
+    locations(0, p) = index(found(p) % index_num);
+    locations(1, p) = index(found(p) / index_num);
+  }
+  
+  return arma::sp_mat(locations, arma::vec(values.elem(found)), matlength,
+    matlength);
+}
+
 //' Estimate sLTRE of Any Population Matrix
 //' 
 //' \code{sltre3matrix()} returns the one-way stochastic LTRE of a dense or
@@ -21052,10 +24811,32 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
   arma::sp_mat ref_sp_matsd;
   
   // First the pop/patch means and sds
+  // Element values are stacked once in the main thread, so that the sds of all
+  // pop-patches may be estimated in parallel
+  arma::uvec mat_index_main = general_index(Amats, tol_used, true);
+  int mat_index_num = static_cast<int>(mat_index_main.n_elem);
+  
+  std::vector<arma::mat> poppatch_stacks (numpoppatches);
+  for (int i = 0; i < numpoppatches; i++) {
+    arma::uvec poppatch_chosen = find(poppatchc == uniquepoppatches(i));
+    poppatch_stacks[i] = ltre_stack(Amats, poppatch_chosen, mat_index_main,
+      tol_used);
+  }
+  
+  arma::mat poppatch_sds (mat_index_num, numpoppatches, fill::zeros);
+  if (mat_index_num > 0) {
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int i = 0; i < numpoppatches; i++) {
+      poppatch_sds.col(i) = arma::stddev(poppatch_stacks[i], 0, 1);
+    }
+  }
+  
   for (int i = 0; i < numpoppatches; i++) {
     arma::uvec poppatch_chosen = find(poppatchc == uniquepoppatches(i));
     int numpoppatch_chosen = static_cast<int>(poppatch_chosen.n_elem);
-    arma::vec mat_elems(numpoppatch_chosen);
+    arma::vec poppatch_sd_elems = poppatch_sds.col(i);
     
     if (!sparse && !sparse_input) {
       arma::mat mat_mean(matdim, matdim, fill::zeros);
@@ -21067,76 +24848,30 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
       }
       poppatch_meanmat_temp(i) = mat_mean;
       
-      for (int j = 0; j < matlength; j++) {
-        mat_elems.zeros();
-        
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_chosen; k++) {
-          double elem_check_mat_elems = as<arma::mat>(Amats(poppatch_chosen(k)))(j);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(j) = arma::stddev(mat_elems, 0);
-      }
+      mat_sd.elem(mat_index_main) = poppatch_sd_elems;
       poppatch_sdmat_temp(i) = mat_sd;
       
     } else if (!sparse_input) {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       
       for (int j = 0; j < numpoppatch_chosen; j++) {
         mat_mean = mat_mean + (arma::sp_mat(as<arma::mat>(Amats(poppatch_chosen(j)))) / 
           static_cast<double>(numpoppatch_chosen));
       }
       poppatch_meanmat_temp(i) = mat_mean;
-      
-      for (int j = 0; j < matlength; j++) {
-        mat_elems.zeros();
-        
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_chosen; k++) {
-          double elem_check_mat_elems = arma::sp_mat(as<arma::mat>(Amats(poppatch_chosen(k))))(j);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(j) = arma::stddev(mat_elems, 0);
-      }
-      poppatch_sdmat_temp(i) = mat_sd;
+      poppatch_sdmat_temp(i) = ltre_sp_elems(mat_index_main, poppatch_sd_elems,
+        matdim);
       
     } else {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       
       for (int j = 0; j < numpoppatch_chosen; j++) {
         mat_mean = mat_mean + (as<arma::sp_mat>(Amats(poppatch_chosen(j))) / 
           static_cast<double>(numpoppatch_chosen));
       }
       poppatch_meanmat_temp(i) = mat_mean;
-      
-      for (int j = 0; j < matlength; j++) {
-        mat_elems.zeros();
-        
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_chosen; k++) {
-          double elem_check_mat_elems = as<arma::sp_mat>(Amats(poppatch_chosen(k)))(j);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(j) = arma::stddev(mat_elems, 0);
-      }
-      poppatch_sdmat_temp(i) = mat_sd;
+      poppatch_sdmat_temp(i) = ltre_sp_elems(mat_index_main, poppatch_sd_elems,
+        matdim);
     }
   }
   poppatch_meanmat = poppatch_meanmat_temp;
@@ -21147,6 +24882,11 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
     Rcpp::List refmats(refmats_);
     ref_byyear = refmats;
     
+    arma::uvec ref_chosen = as<arma::uvec>(refnum);
+    arma::uvec ref_index_main = general_index(refmats, tol_used, true);
+    arma::vec ref_sd_elems = arma::stddev(ltre_stack(refmats, ref_chosen,
+      ref_index_main, tol_used), 0, 1);
+    
     if (!sparse && !sparse_input) {
       arma::mat mat_mean(matdim, matdim, fill::zeros);
       arma::mat mat_sd(matdim, matdim, fill::zeros);
@@ -21154,80 +24894,34 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
       for (int i = 0; i < refmatnum; i++) {
         mat_mean = mat_mean + (as<arma::mat>(refmats(refnum(i))) / static_cast<double>(refmatnum));
       }
+      mat_sd.elem(ref_index_main) = ref_sd_elems;
       
-      for (int i = 0; i < matlength; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = as<arma::mat>(refmats(refnum(j)))(i);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-      }
       ref_matmean = mat_mean;
       ref_matsd = mat_sd;
       
     } else if (!sparse_input) {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       
       for (int i = 0; i < refmatnum; i++) {
         mat_mean = mat_mean + (arma::sp_mat(as<arma::mat>(refmats(refnum(i)))) /
           static_cast<double>(refmatnum));
       }
-      
-      for (int i = 0; i < matlength; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = arma::sp_mat(as<arma::mat>(refmats(refnum(j))))(i);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-      }
       ref_sp_matmean = mat_mean;
-      ref_sp_matsd = mat_sd;
+      ref_sp_matsd = ltre_sp_elems(ref_index_main, ref_sd_elems, matdim);
       
     } else {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       
       for (int i = 0; i < refmatnum; i++) {
         mat_mean = mat_mean + (as<arma::sp_mat>(refmats(refnum(i))) /
           static_cast<double>(refmatnum));
       }
-      
-      for (int i = 0; i < matlength; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = as<arma::sp_mat>(refmats(refnum(j)))(i);
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-      }
       ref_sp_matmean = mat_mean;
-      ref_sp_matsd = mat_sd;
+      ref_sp_matsd = ltre_sp_elems(ref_index_main, ref_sd_elems, matdim);
     }
   } else {
+    int ref_setnum {refmatnum};
+    
     if (refmatnum == Amatnum) {
       
       // Reference by year
@@ -21264,125 +24958,52 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
         }
       }
       ref_byyear = ref_byyear_temp;
+      ref_setnum = numyears;
       
-      // Reference mean and sd
-      if (!sparse && !sparse_input) {
-        arma::mat mat_mean(matdim, matdim, fill::zeros);
-        arma::mat mat_sd(matdim, matdim, fill::zeros);
-        
-        for (int i = 0; i < numyears; i++) {
-          mat_mean = mat_mean + (as<arma::mat>(ref_byyear(i)) / static_cast<double>(numyears));
-        }
-        
-        for (int i = 0; i < matlength; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < numyears; j++) {
-            double elem_check_mat_elems = as<arma::mat>(ref_byyear(j))(i);
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-        }
-        ref_matmean = mat_mean;
-        ref_matsd = mat_sd;
-        
-      } else {
-        arma::sp_mat mat_mean(matdim, matdim);
-        arma::sp_mat mat_sd(matdim, matdim);
-        
-        for (int i = 0; i < numyears; i++) {
-          mat_mean = mat_mean + (as<arma::sp_mat>(ref_byyear(i)) / static_cast<double>(numyears));
-        }
-        
-        for (int i = 0; i < matlength; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < numyears; j++) {
-            double elem_check_mat_elems = as<arma::sp_mat>(ref_byyear(j))(i);
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-        }
-        ref_sp_matmean = mat_mean;
-        ref_sp_matsd = mat_sd;
-      }
     } else {
       // Reference by year
       List ref_byyear_temp (refmatnum);
       
       for (int i = 0; i < refmatnum; i++) {
         if (!sparse && !sparse_input) {
-          ref_byyear_temp(i) = as<arma::mat>(Amats(i));
+          ref_byyear_temp(i) = as<arma::mat>(Amats(refnum(i)));
+        } else if (!sparse_input) {
+          ref_byyear_temp(i) = arma::sp_mat(as<arma::mat>(Amats(refnum(i))));
         } else {
-          ref_byyear_temp(i) = arma::sp_mat(as<arma::mat>(Amats(i)));
+          ref_byyear_temp(i) = as<arma::sp_mat>(Amats(refnum(i)));
         }
       }
-      
-      // Reference mean and sd
-      if (!sparse && !sparse_input) {
-        arma::mat mat_mean(matdim, matdim, fill::zeros);
-        arma::mat mat_sd(matdim, matdim, fill::zeros);
-        
-        for (int i = 0; i < refmatnum; i++) {
-          mat_mean = mat_mean + (as<arma::mat>(ref_byyear(i)) /
-            static_cast<double>(refmatnum));
-        }
-        for (int i = 0; i < matlength; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < refmatnum; j++) {
-            double elem_check_mat_elems = as<arma::mat>(ref_byyear(j))(i);
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-        }
-        ref_matmean = mat_mean;
-        ref_matsd = mat_sd;
-        
-      } else {
-        arma::sp_mat mat_mean(matdim, matdim);
-        arma::sp_mat mat_sd(matdim, matdim);
-        
-        for (int i = 0; i < refmatnum; i++) {
-          mat_mean = mat_mean + (as<arma::sp_mat>(ref_byyear(i)) /
-            static_cast<double>(refmatnum));
-        }
-        for (int i = 0; i < matlength; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < refmatnum; j++) {
-            double elem_check_mat_elems = as<arma::sp_mat>(ref_byyear(j))(i);
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(i) = arma::stddev(mat_elems, 0);
-        }
-        ref_sp_matmean = mat_mean;
-        ref_sp_matsd = mat_sd;
+      ref_byyear = ref_byyear_temp;
+    }
+    
+    // Reference mean and sd
+    arma::uvec ref_chosen = linspace<arma::uvec>(0, ref_setnum - 1, ref_setnum);
+    arma::uvec ref_index_main = general_index(ref_byyear, tol_used, true);
+    arma::vec ref_sd_elems = arma::stddev(ltre_stack(ref_byyear, ref_chosen,
+      ref_index_main, tol_used), 0, 1);
+    
+    if (!sparse && !sparse_input) {
+      arma::mat mat_mean(matdim, matdim, fill::zeros);
+      arma::mat mat_sd(matdim, matdim, fill::zeros);
+      
+      for (int i = 0; i < ref_setnum; i++) {
+        mat_mean = mat_mean + (as<arma::mat>(ref_byyear(i)) /
+          static_cast<double>(ref_setnum));
+      }
+      mat_sd.elem(ref_index_main) = ref_sd_elems;
+      
+      ref_matmean = mat_mean;
+      ref_matsd = mat_sd;
+      
+    } else {
+      arma::sp_mat mat_mean(matdim, matdim);
+      
+      for (int i = 0; i < ref_setnum; i++) {
+        mat_mean = mat_mean + (as<arma::sp_mat>(ref_byyear(i)) /
+          static_cast<double>(ref_setnum));
       }
+      ref_sp_matmean = mat_mean;
+      ref_sp_matsd = ltre_sp_elems(ref_index_main, ref_sd_elems, matdim);
     }
   }
   
@@ -21456,29 +25077,41 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
   arma::rowvec Rvecmat = crazy_prophet.submat((static_cast<int>(startvec.n_elem) * 3), 1,
       (static_cast<int>(startvec.n_elem) * 3), theclairvoyant); // Rvec
   
+  // Each sensitivity matrix is the outer product of a scaled v(t+1) and w(t),
+  // so v is scaled once here and occasions are grouped by reference matrix
+  int sens_steps = theclairvoyant - burnin;
+  arma::mat v_scaled = vprojection.cols(burnin + 1, theclairvoyant);
+  arma::mat w_used = wprojection.cols(burnin, theclairvoyant - 1);
+  
+  for (int j = 0; j < sens_steps; j++) {
+    double cd_double = Rvecmat(burnin + j) * arma::dot(v_scaled.col(j),
+      wprojection.col(burnin + j + 1));
+    v_scaled.col(j) = v_scaled.col(j) / cd_double;
+  }
+  
+  arma::uvec step_refs = theprophecy.subvec(burnin, theclairvoyant - 1);
+  arma::uvec used_refs = unique(step_refs);
+  int used_refnum = static_cast<int>(used_refs.n_elem);
+  
   if (!sparse && !sparse_input) {
     arma::mat sensmat(matdim, matdim, fill::zeros);
     arma::mat elasmean(matdim, matdim, fill::zeros);
     arma::mat elassd(matdim, matdim, fill::zeros);
     
-    // Time loop for sensitivity matrices
-    for (int j = burnin; j < theclairvoyant; j++) { 
-      if (j % 10 == 0) Rcpp::checkUserInterrupt();
-      
-      arma::vec vtplus1 = vprojection.col(j+1);
-      arma::vec wtplus1 = wprojection.col(j+1);
-      arma::vec wt = wprojection.col(j);
+    // Sensitivity sums for each reference matrix, as single matrix products
+    for (int y = 0; y < used_refnum; y++) {
+      Rcpp::checkUserInterrupt();
       
-      arma::mat currentsens_num = vtplus1 * wt.as_row(); // Key matrix equation numerator
-      arma::mat currentsens_den = (Rvecmat(j) * vtplus1.as_row() * wtplus1); // Denominator
-      double cd_double = currentsens_den(0,0);
-      sensmat = currentsens_num / (cd_double);
+      arma::uvec y_steps = find(step_refs == used_refs(y));
+      arma::mat ref_sens = v_scaled.cols(y_steps) * w_used.cols(y_steps).t();
       
-      elasmean = elasmean + ((sensmat % ref_matmean) /
-        static_cast<double>(theclairvoyant - burnin));
-      elassd = elassd + ((sensmat % ((as<arma::mat>(ref_byyear(theprophecy(j)))) - ref_matmean)) / 
-        static_cast<double>(theclairvoyant - burnin));
+      sensmat = sensmat + ref_sens;
+      elassd = elassd + (ref_sens % (as<arma::mat>(ref_byyear(used_refs(y))) -
+        ref_matmean));
     }
+    elasmean = (sensmat % ref_matmean) / static_cast<double>(sens_steps);
+    elassd = elassd / static_cast<double>(sens_steps);
+    
     // Difference matrix estimation
     arma::mat diffmean1(matdim, matdim, fill::zeros);
     arma::mat diffsd1(matdim, matdim, fill::zeros);
@@ -21517,28 +25150,49 @@ Rcpp::List sltre3matrix(const List& Amats, const DataFrame& labels,
     cont_sdmat = cont_sdmat_temp;
     
   } else {
-    arma::sp_mat sensmat(matdim, matdim);
-    arma::sp_mat elasmean(matdim, matdim);
-    arma::sp_mat elassd(matdim, matdim);
+    // Sensitivities are only needed where reference matrices are non-zero
+    arma::uvec sens_index = general_index(ref_byyear);
+    int sens_num = static_cast<int>(sens_index.n_elem);
+    arma::uvec sens_rows = sens_index - ((sens_index / matdim) * matdim);
+    arma::uvec sens_cols = sens_index / matdim;
+    
+    arma::vec mean_elems (sens_num);
+    for (int p = 0; p < sens_num; p++) {
+      mean_elems(p) = ref_sp_matmean(sens_index(p));
+    }
     
-    // Time loop for sensitivity matrices
-    for (int j = burnin; j < theclairvoyant; j++) {
-      if (j % 10 == 0) Rcpp::checkUserInterrupt();
+    arma::mat v_rows = v_scaled.t();
+    arma::mat w_rows = w_used.t();
+    arma::vec sens_elems (sens_num, fill::zeros);
+    arma::vec elassd_elems (sens_num, fill::zeros);
+    
+    for (int y = 0; y < used_refnum; y++) {
+      Rcpp::checkUserInterrupt();
       
-      arma::vec vtplus1 = vprojection.col(j+1);
-      arma::vec wtplus1 = wprojection.col(j+1);
-      arma::vec wt = wprojection.col(j);
+      arma::uvec y_steps = find(step_refs == used_refs(y));
+      arma::mat v_y = v_rows.rows(y_steps);
+      arma::mat w_y = w_rows.rows(y_steps);
       
-      arma::sp_mat currentsens_num = arma::sp_mat(vtplus1) * arma::sp_mat(wt.as_row()); // Key matrix equation numerator 
-      arma::sp_mat currentsens_den = arma::sp_mat(Rvecmat(j) * vtplus1.as_row() * wtplus1); // Denominator
-      double cd_double = currentsens_den(0,0);
-      sensmat = currentsens_num / (cd_double);
+      LefkoMats::dgc_view ref_view (ref_byyear, static_cast<int>(used_refs(y)));
+      arma::vec ref_diffs = ref_view.gather(sens_index) - mean_elems;
+      arma::vec y_sens (sens_num);
       
-      elasmean = elasmean + ((sensmat % ref_sp_matmean) /
-        static_cast<double>(theclairvoyant - burnin));
-      elassd = elassd + ((sensmat % ((as<arma::sp_mat>(ref_byyear(theprophecy(j)))) - ref_sp_matmean)) / 
-        static_cast<double>(theclairvoyant - burnin));
+      #ifdef _OPENMP
+      #pragma omp parallel for schedule(static)
+      #endif
+      for (int p = 0; p < sens_num; p++) {
+        y_sens(p) = arma::dot(v_y.col(sens_rows(p)), w_y.col(sens_cols(p)));
+      }
+      
+      sens_elems = sens_elems + y_sens;
+      elassd_elems = elassd_elems + (y_sens % ref_diffs);
     }
+    
+    arma::sp_mat elasmean = ltre_sp_elems(sens_index,
+      (sens_elems % mean_elems) / static_cast<double>(sens_steps), matdim);
+    arma::sp_mat elassd = ltre_sp_elems(sens_index,
+      elassd_elems / static_cast<double>(sens_steps), matdim);
+    
     // Difference matrix estimation
     ref_sp_matmean = LefkoUtils::spmat_log(ref_sp_matmean);
     ref_sp_matsd = LefkoUtils::spmat_log(ref_sp_matsd);
@@ -21630,7 +25284,8 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
   int Amatnum = Amats.length();
   int matdim {0};
   if (sparse_input) {
-    matdim = as<arma::sp_mat>(Amats(0)).n_rows;
+    LefkoMats::dgc_view first_view (Amats, 0);
+    matdim = first_view.n_rows;
   } else {
     matdim = as<arma::mat>(Amats(0)).n_rows;
   }
@@ -21673,7 +25328,6 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
   arma::sp_mat ref_sp_matcorr;
   
   arma::uvec mat_index_main = LefkoMats::general_index(Amats, tol_used, true);
-  int mat_index_main_nonzeros = static_cast<int>(mat_index_main.n_elem);
   
   if (tweights_.isNotNull()) {
     tweights = as<arma::vec>(tweights_);
@@ -21716,7 +25370,13 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
   NumericVector rvals_poppatch (numpoppatches);
   double rvals_ref {0.0};
   
-  // First pop/patch means and sds
+  // Element stacks and dense mean matrices are read in the main thread, so
+  // that element moments and dense eigen analyses may be run in parallel
+  // across pop-patches
+  bool dense_means = (!sparse && !sparse_input);
+  std::vector<arma::uvec> poppatch_extensions (numpoppatches);
+  std::vector<arma::mat> poppatch_stacks (numpoppatches);
+  std::vector<arma::mat> poppatch_dense_means (numpoppatches);
   for (int i = 0; i < numpoppatches; i++) {
     arma::uvec poppatch_chosen = find(poppatchc == uniquepoppatches(i));
     
@@ -21728,83 +25388,67 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         tw_counter++;
       }
     }
+    poppatch_extensions[i] = poppatch_extended;
+    poppatch_stacks[i] = ltre_stack(Amats, poppatch_extended, mat_index_main,
+      tol_used);
+    
+    if (dense_means) {
+      arma::mat mat_mean (matdim, matdim, fill::zeros);
+      
+      for (int j = 0; j < tweights_total_mats; j++) {
+        mat_mean = mat_mean + (as<arma::mat>(Amats(poppatch_extended(j))) / 
+          static_cast<double>(tweights_total_mats));
+      }
+      poppatch_dense_means[i] = mat_mean;
+    }
+  }
+  
+  std::vector<arma::vec> poppatch_sds (numpoppatches);
+  std::vector<arma::mat> poppatch_corrs (numpoppatches);
+  std::vector<arma::mat> poppatch_dense_elas (numpoppatches);
+  arma::vec poppatch_lambdas (numpoppatches, fill::zeros);
+  arma::uvec eigen_failed (numpoppatches, fill::zeros);
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i = 0; i < numpoppatches; i++) {
+    ltre_moments(poppatch_stacks[i], tol_used, poppatch_sds[i],
+      poppatch_corrs[i]);
     
+    if (dense_means) {
+      if (!elas3_core(poppatch_dense_means[i], poppatch_lambdas(i),
+        poppatch_dense_elas[i])) eigen_failed(i) = 1;
+    }
+  }
+  
+  if (any(eigen_failed)) {
+    throw Rcpp::exception("Eigen analysis failed for a pop-patch mean matrix.",
+      false);
+  }
+  
+  // First pop/patch means and sds
+  for (int i = 0; i < numpoppatches; i++) {
+    arma::uvec poppatch_extended = poppatch_extensions[i];
     int numpoppatch_extended = static_cast<int>(poppatch_extended.n_elem);
-    arma::vec mat_elems (numpoppatch_extended, fill::zeros);
-    arma::vec mat_elems_forcorr (numpoppatch_extended, fill::zeros);
     
-    if (!sparse && !sparse_input) {
-      arma::mat mat_mean (matdim, matdim, fill::zeros);
-      arma::mat mat_sd (matdim, matdim, fill::zeros);
+    if (dense_means) {
+      arma::mat mat_mean = poppatch_dense_means[i];
       arma::mat mat_cv (matdim, matdim, fill::zeros);
       arma::mat mat_corr (matdim * matdim, matdim * matdim, fill::zeros);
       
-      for (int j = 0; j < numpoppatch_extended; j++) {
-        mat_mean = mat_mean + (as<arma::mat>(Amats(poppatch_extended(j))) / 
-          static_cast<double>(numpoppatch_extended));
-      }
       poppatch_meanmat(i) = mat_mean;
+      rvals_poppatch(i) = log(poppatch_lambdas(i));
+      poppatch_elasmat(i) = poppatch_dense_elas[i];
       
-      List eigenstuff = LefkoMats::decomp3(mat_mean);
-      arma::vec realeigenvals = real(as<arma::cx_vec>(eigenstuff["eigenvalues"]));
-      double lambda = max(realeigenvals);
-      rvals_poppatch(i) = log(lambda);
-      
-      arma::mat mat_elas = elas3matrix(mat_mean, false);
-      poppatch_elasmat(i) = mat_elas;
-      
-      for (int j = 0; j < mat_index_main_nonzeros; j++) {
-        mat_elems.zeros();
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_extended; k++) {
-          double elem_check_mat_elems = as<arma::mat>(Amats(poppatch_extended(k)))(mat_index_main(j));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(mat_index_main(j)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(mat_index_main(j)) > tol_used) {
-          if (mat_mean(mat_index_main(j)) > tol_used) {
-            mat_cv(mat_index_main(j)) = mat_sd(mat_index_main(j)) / mat_mean(mat_index_main(j));
-          } else {
-            mat_cv(mat_index_main(j)) = 0.0;
-          }
-          
-          for (int k = 0; k < mat_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < numpoppatch_extended; l++) {
-              double elem_check_mef = as<arma::mat>(Amats(poppatch_extended(l)))(mat_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(mat_index_main(j), mat_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv.elem(mat_index_main) = ltre_cv(poppatch_sds[i], mat_mean, mat_index_main,
+        tol_used);
+      mat_corr.submat(mat_index_main, mat_index_main) = poppatch_corrs[i];
       poppatch_cvmat(i) = mat_cv;
       poppatch_corrmat(i) = mat_corr;
       
     } else if (!sparse_input) {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       arma::sp_mat mat_cv (matdim, matdim);
       arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
       
@@ -21822,58 +25466,15 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       arma::sp_mat mat_elas = elas3sp_matrix(mat_mean);
       poppatch_elasmat(i) = mat_elas;
       
-      for (int j = 0; j < mat_index_main_nonzeros; j++) {
-        mat_elems.zeros();
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_extended; k++) {
-          double elem_check_mat_elems = arma::sp_mat(as<arma::mat>(Amats(poppatch_extended(k))))(mat_index_main(j));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(mat_index_main(j)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(mat_index_main(j)) > tol_used) {
-          if (mat_mean(mat_index_main(j)) > tol_used) {
-            mat_cv(mat_index_main(j)) = mat_sd(mat_index_main(j)) / mat_mean(mat_index_main(j));
-          } else {
-            mat_cv(mat_index_main(j)) = 0.0;
-          }
-          
-          for (int k = 0; k < mat_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < numpoppatch_extended; l++) {
-              double elem_check_mef = as<arma::mat>(Amats(poppatch_extended(l)))(mat_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(mat_index_main(j), mat_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv = ltre_sp_elems(mat_index_main, ltre_cv(poppatch_sds[i], mat_mean,
+        mat_index_main, tol_used), matdim);
+      mat_corr = ltre_sp_pairs(mat_index_main, poppatch_corrs[i],
+        matdim * matdim);
       poppatch_cvmat(i) = mat_cv;
       poppatch_corrmat(i) = mat_corr;
       
     } else {
       arma::sp_mat mat_mean(matdim, matdim);
-      arma::sp_mat mat_sd(matdim, matdim);
       arma::sp_mat mat_cv (matdim, matdim);
       arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
       
@@ -21891,52 +25492,10 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       arma::sp_mat mat_elas = elas3sp_matrix(mat_mean);
       poppatch_elasmat(i) = mat_elas;
       
-      for (int j = 0; j < mat_index_main_nonzeros; j++) {
-        mat_elems.zeros();
-        bool found_greater {false};
-        
-        for (int k = 0; k < numpoppatch_extended; k++) {
-          double elem_check_mat_elems = as<arma::sp_mat>(Amats(poppatch_extended(k)))(mat_index_main(j));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(k) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(mat_index_main(j)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(mat_index_main(j)) > tol_used) {
-          if (mat_mean(mat_index_main(j)) > tol_used) {
-            mat_cv(mat_index_main(j)) = mat_sd(mat_index_main(j)) / mat_mean(mat_index_main(j));
-          } else {
-            mat_cv(mat_index_main(j)) = 0.0;
-          }
-          
-          for (int k = 0; k < mat_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < numpoppatch_extended; l++) {
-              double elem_check_mef = as<arma::sp_mat>(Amats(poppatch_extended(l)))(mat_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(mat_index_main(j), mat_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv = ltre_sp_elems(mat_index_main, ltre_cv(poppatch_sds[i], mat_mean,
+        mat_index_main, tol_used), matdim);
+      mat_corr = ltre_sp_pairs(mat_index_main, poppatch_corrs[i],
+        matdim * matdim);
       poppatch_cvmat(i) = mat_cv;
       poppatch_corrmat(i) = mat_corr;
     }
@@ -21948,11 +25507,14 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
     ref_byyear = refmats;
     
     arma::uvec ref_index_main = LefkoMats::general_index(refmats, tol_used, true);
-    int ref_index_main_nonzeros = static_cast<int>(ref_index_main.n_elem);
+    
+    arma::vec ref_sds;
+    arma::mat ref_corrs;
+    ltre_moments(ltre_stack(refmats, as<arma::uvec>(refnum), ref_index_main,
+      tol_used), tol_used, ref_sds, ref_corrs);
     
     if (!sparse && !sparse_input) {
       arma::mat mat_mean (matdim, matdim, fill::zeros);
-      arma::mat mat_sd (matdim, matdim, fill::zeros);
       arma::mat mat_cv (matdim, matdim, fill::zeros);
       arma::mat mat_corr (matdim * matdim, matdim * matdim, fill::zeros);
       
@@ -21965,54 +25527,9 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       double lambda = max(realeigenvals);
       rvals_ref = log(lambda);
       
-      for (int i = 0; i < ref_index_main_nonzeros; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        arma::vec mat_elems_forcorr (refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = as<arma::mat>(refmats(refnum(j)))(ref_index_main(i));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(ref_index_main(i)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(ref_index_main(i)) > tol_used) {
-          if (mat_mean(ref_index_main(i)) > tol_used) {
-            mat_cv(ref_index_main(i)) = mat_sd(ref_index_main(i)) / mat_mean(ref_index_main(i));
-          } else {
-            mat_cv(ref_index_main(i)) = 0.0;
-          }
-          
-          for (int k = 0; k < ref_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < refmatnum; l++) {
-              double elem_check_mef = as<arma::mat>(refmats(refnum(l)))(ref_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(ref_index_main(i), ref_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv.elem(ref_index_main) = ltre_cv(ref_sds, mat_mean, ref_index_main,
+        tol_used);
+      mat_corr.submat(ref_index_main, ref_index_main) = ref_corrs;
       
       ref_matmean = mat_mean;
       ref_matelas = elas3matrix(mat_mean, false);
@@ -22021,7 +25538,6 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       
     } else if (!sparse_input) {
       arma::sp_mat mat_mean (matdim, matdim);
-      arma::sp_mat mat_sd (matdim, matdim);
       arma::sp_mat mat_cv (matdim, matdim);
       arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
       
@@ -22035,54 +25551,10 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       double lambda = max(realeigenvals);
       rvals_ref = log(lambda);
       
-      for (int i = 0; i < ref_index_main_nonzeros; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        arma::vec mat_elems_forcorr (refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = arma::sp_mat(as<arma::mat>(refmats(refnum(j))))(ref_index_main(i));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(ref_index_main(i)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(ref_index_main(i)) > tol_used) {
-          if (mat_mean(ref_index_main(i)) > tol_used) {
-            mat_cv(ref_index_main(i)) = mat_sd(ref_index_main(i)) / mat_mean(ref_index_main(i));
-          } else {
-            mat_cv(ref_index_main(i)) = 0.0;
-          }
-          
-          for (int k = 0; k < ref_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < refmatnum; l++) {
-              double elem_check_mef = as<arma::mat>(refmats(refnum(l)))(ref_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(ref_index_main(i), ref_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv = ltre_sp_elems(ref_index_main, ltre_cv(ref_sds, mat_mean,
+        ref_index_main, tol_used), matdim);
+      mat_corr = ltre_sp_pairs(ref_index_main, ref_corrs,
+        matdim * matdim);
       
       ref_sp_matmean = mat_mean;
       ref_sp_matelas = elas3sp_matrix(mat_mean);
@@ -22091,7 +25563,6 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       
     } else {
       arma::sp_mat mat_mean (matdim, matdim);
-      arma::sp_mat mat_sd (matdim, matdim);
       arma::sp_mat mat_cv (matdim, matdim);
       arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
       
@@ -22105,54 +25576,10 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       double lambda = max(realeigenvals);
       rvals_ref = log(lambda);
       
-      for (int i = 0; i < ref_index_main_nonzeros; i++) {
-        arma::vec mat_elems(refmatnum, fill::zeros);
-        arma::vec mat_elems_forcorr (refmatnum, fill::zeros);
-        
-        bool found_greater {false};
-        
-        for (int j = 0; j < refmatnum; j++) {
-          double elem_check_mat_elems = as<arma::sp_mat>(refmats(refnum(j)))(ref_index_main(i));
-          if (elem_check_mat_elems > tol_used) {
-            mat_elems(j) = elem_check_mat_elems;
-            found_greater = true;
-          }
-        }
-        
-        if (found_greater) mat_sd(ref_index_main(i)) = arma::stddev(mat_elems, 0);
-        
-        if (mat_sd(ref_index_main(i)) > tol_used) {
-          if (mat_mean(ref_index_main(i)) > tol_used) {
-            mat_cv(ref_index_main(i)) = mat_sd(ref_index_main(i)) / mat_mean(ref_index_main(i));
-          } else {
-            mat_cv(ref_index_main(i)) = 0.0;
-          }
-          
-          for (int k = 0; k < ref_index_main_nonzeros; k++) {
-            if (k % 10 == 0) Rcpp::checkUserInterrupt();
-            
-            mat_elems_forcorr.zeros();
-            bool found_greater_forcorr {false};
-            
-            for (int l = 0; l < refmatnum; l++) {
-              double elem_check_mef = as<arma::sp_mat>(refmats(refnum(l)))(ref_index_main(k));
-              if (elem_check_mef > tol_used) {
-                mat_elems_forcorr(l) = elem_check_mef;
-                found_greater_forcorr = true;
-              }
-            }
-            
-            double mefc_sd {0.0};
-            if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-            
-            if (mefc_sd > 0.0) {
-              arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-              double corr_bit = new_cor(0);
-              if (corr_bit > tol_used) mat_corr(ref_index_main(i), ref_index_main(k)) = corr_bit;
-            }
-          }
-        }
-      }
+      mat_cv = ltre_sp_elems(ref_index_main, ltre_cv(ref_sds, mat_mean,
+        ref_index_main, tol_used), matdim);
+      mat_corr = ltre_sp_pairs(ref_index_main, ref_corrs,
+        matdim * matdim);
       
       ref_sp_matmean = mat_mean;
       ref_sp_matelas = elas3sp_matrix(mat_mean);
@@ -22209,10 +25636,14 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       }
       int ref_extended_length = static_cast<int>(ref_extended.n_elem);
       
+      arma::vec ref_sds;
+      arma::mat ref_corrs;
+      ltre_moments(ltre_stack(ref_byyear, ref_extended, mat_index_main,
+        tol_used), tol_used, ref_sds, ref_corrs);
+      
       // Reference mean and sd
       if (!sparse && !sparse_input) {
         arma::mat mat_mean(matdim, matdim, fill::zeros);
-        arma::mat mat_sd(matdim, matdim, fill::zeros);
         arma::mat mat_cv (matdim, matdim, fill::zeros);
         arma::mat mat_corr (matdim * matdim, matdim * matdim, fill::zeros);
         
@@ -22226,54 +25657,9 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         double lambda = max(realeigenvals);
         rvals_ref = log(lambda);
         
-        for (int i = 0; i < mat_index_main_nonzeros; i++) {
-          arma::vec mat_elems(ref_extended_length, fill::zeros);
-          arma::vec mat_elems_forcorr (ref_extended_length, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < ref_extended_length; j++) {
-            double elem_check_mat_elems = as<arma::mat>(ref_byyear(ref_extended(j)))(mat_index_main(i));
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(mat_index_main(i)) = arma::stddev(mat_elems, 0);
-          
-          if (mat_sd(mat_index_main(i)) > tol_used) {
-            if (mat_mean(mat_index_main(i)) > tol_used) {
-              mat_cv(mat_index_main(i)) = mat_sd(mat_index_main(i)) / mat_mean(mat_index_main(i));
-            } else {
-              mat_cv(mat_index_main(i)) = 0.0;
-            }
-            
-            for (int k = 0; k < mat_index_main_nonzeros; k++) {
-              if (k % 10 == 0) Rcpp::checkUserInterrupt();
-              
-              mat_elems_forcorr.zeros();
-              bool found_greater_forcorr {false};
-              
-              for (int l = 0; l < ref_extended_length; l++) {
-                double elem_check_mef = as<arma::mat>(ref_byyear(ref_extended(l)))(mat_index_main(k));
-                if (elem_check_mef > tol_used) {
-                  mat_elems_forcorr(l) = elem_check_mef;
-                  found_greater_forcorr = true;
-                }
-              }
-              
-              double mefc_sd {0.0};
-              if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-              
-              if (mefc_sd > 0.0) {
-                arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-                double corr_bit = new_cor(0);
-                if (corr_bit > tol_used) mat_corr(mat_index_main(i), mat_index_main(k)) = corr_bit;
-              }
-            }
-          }
-        }
+        mat_cv.elem(mat_index_main) = ltre_cv(ref_sds, mat_mean, mat_index_main,
+          tol_used);
+        mat_corr.submat(mat_index_main, mat_index_main) = ref_corrs;
         
         ref_matmean = mat_mean;
         ref_matelas = elas3matrix(mat_mean, false);
@@ -22282,7 +25668,6 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         
       } else {
         arma::sp_mat mat_mean(matdim, matdim);
-        arma::sp_mat mat_sd(matdim, matdim);
         arma::sp_mat mat_cv (matdim, matdim);
         arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
         
@@ -22296,55 +25681,10 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         double lambda = max(realeigenvals);
         rvals_ref = log(lambda);
         
-        for (int i = 0; i < mat_index_main_nonzeros; i++) {
-          arma::vec mat_elems(ref_extended_length, fill::zeros);
-          arma::vec mat_elems_forcorr (ref_extended_length, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < ref_extended_length; j++) {
-            double elem_check_mat_elems = as<arma::sp_mat>(ref_byyear(ref_extended(j)))(mat_index_main(i));
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(mat_index_main(i)) = arma::stddev(mat_elems, 0);
-          
-          if (mat_sd(mat_index_main(i)) > tol_used) {
-            if (mat_mean(mat_index_main(i)) > tol_used) {
-              mat_cv(mat_index_main(i)) = mat_sd(mat_index_main(i)) / mat_mean(mat_index_main(i));
-            } else {
-              mat_cv(mat_index_main(i)) = 0.0;
-            }
-            
-            // This is crazy - correlation matrix is ultra-high dimension...
-            for (int k = 0; k < mat_index_main_nonzeros; k++) {
-              if (k % 10 == 0) Rcpp::checkUserInterrupt();
-              
-              mat_elems_forcorr.zeros();
-              bool found_greater_forcorr {false};
-              
-              for (int l = 0; l < ref_extended_length; l++) {
-                double elem_check_mef = as<arma::sp_mat>(ref_byyear(ref_extended(l)))(mat_index_main(k));
-                if (elem_check_mef > tol_used) {
-                  mat_elems_forcorr(l) = elem_check_mef;
-                  found_greater_forcorr = true;
-                }
-              }
-              
-              double mefc_sd {0.0};
-              if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-              
-              if (mefc_sd > 0.0) {
-                arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-                double corr_bit = new_cor(0);
-                if (corr_bit > tol_used) mat_corr(mat_index_main(i), mat_index_main(k)) = corr_bit;
-              }
-            }
-          }
-        }
+        mat_cv = ltre_sp_elems(mat_index_main, ltre_cv(ref_sds, mat_mean,
+          mat_index_main, tol_used), matdim);
+        mat_corr = ltre_sp_pairs(mat_index_main, ref_corrs,
+          matdim * matdim);
         
         ref_sp_matmean = mat_mean;
         ref_sp_matelas = elas3sp_matrix(mat_mean);
@@ -22358,19 +25698,23 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
       
       for (int i = 0; i < refmatnum; i++) {
         if (!sparse && !sparse_input) {
-          ref_byyear_temp(i) = as<arma::mat>(Amats(i));
+          ref_byyear_temp(i) = as<arma::mat>(Amats(refnum(i)));
         } else if (!sparse_input) {
-          ref_byyear_temp(i) = arma::sp_mat(as<arma::mat>(Amats(i)));
+          ref_byyear_temp(i) = arma::sp_mat(as<arma::mat>(Amats(refnum(i))));
         } else {
-          ref_byyear_temp(i) = as<arma::sp_mat>(Amats(i));
+          ref_byyear_temp(i) = as<arma::sp_mat>(Amats(refnum(i)));
         }
       }
       ref_byyear = ref_byyear_temp;
       
+      arma::vec ref_sds;
+      arma::mat ref_corrs;
+      ltre_moments(ltre_stack(ref_byyear, linspace<arma::uvec>(0, refmatnum - 1,
+        refmatnum), mat_index_main, tol_used), tol_used, ref_sds, ref_corrs);
+      
       // Reference mean and sd
-      if (!sparse) {
+      if (!sparse && !sparse_input) {
         arma::mat mat_mean (matdim, matdim, fill::zeros);
-        arma::mat mat_sd (matdim, matdim, fill::zeros);
         arma::mat mat_cv (matdim, matdim, fill::zeros);
         arma::mat mat_corr (matdim * matdim, matdim * matdim, fill::zeros);
         
@@ -22384,54 +25728,9 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         double lambda = max(realeigenvals);
         rvals_ref = log(lambda);
         
-        for (int i = 0; i < mat_index_main_nonzeros; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          arma::vec mat_elems_forcorr (refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < refmatnum; j++) {
-            double elem_check_mat_elems = as<arma::mat>(ref_byyear(j))(mat_index_main(i));
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(mat_index_main(i)) = arma::stddev(mat_elems, 0);
-          
-          if (mat_sd(mat_index_main(i)) > tol_used) {
-            if (mat_mean(mat_index_main(i)) > tol_used) {
-              mat_cv(mat_index_main(i)) = mat_sd(mat_index_main(i)) / mat_mean(mat_index_main(i));
-            } else {
-              mat_cv(mat_index_main(i)) = 0.0;
-            }
-            
-            for (int k = 0; k < mat_index_main_nonzeros; k++) {
-              if (k % 10 == 0) Rcpp::checkUserInterrupt();
-              
-              mat_elems_forcorr.zeros();
-              bool found_greater_forcorr {false};
-              
-              for (int l = 0; l < refmatnum; l++) {
-                double elem_check_mef = as<arma::mat>(ref_byyear(l))(mat_index_main(k));
-                if (elem_check_mef > tol_used) {
-                  mat_elems_forcorr(l) = elem_check_mef;
-                  found_greater_forcorr = true;
-                }
-              }
-              
-              double mefc_sd {0.0};
-              if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-              
-              if (mefc_sd > 0.0) {
-                arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-                double corr_bit = new_cor(0);
-                if (corr_bit > tol_used) mat_corr(mat_index_main(i), mat_index_main(k)) = corr_bit;
-              }
-            }
-          }
-        }
+        mat_cv.elem(mat_index_main) = ltre_cv(ref_sds, mat_mean, mat_index_main,
+          tol_used);
+        mat_corr.submat(mat_index_main, mat_index_main) = ref_corrs;
         
         ref_matmean = mat_mean;
         ref_matelas = elas3matrix(mat_mean, false);
@@ -22440,7 +25739,6 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         
       } else {
         arma::sp_mat mat_mean(matdim, matdim);
-        arma::sp_mat mat_sd(matdim, matdim);
         arma::sp_mat mat_cv (matdim, matdim);
         arma::sp_mat mat_corr (matdim * matdim, matdim * matdim);
         
@@ -22454,55 +25752,10 @@ Rcpp::List snaltre3matrix(const List& Amats, const DataFrame& labels,
         double lambda = max(realeigenvals);
         rvals_ref = log(lambda);
         
-        for (int i = 0; i < mat_index_main_nonzeros; i++) {
-          arma::vec mat_elems(refmatnum, fill::zeros);
-          arma::vec mat_elems_forcorr (refmatnum, fill::zeros);
-          
-          bool found_greater {false};
-          
-          for (int j = 0; j < refmatnum; j++) {
-            double elem_check_mat_elems = as<arma::sp_mat>(ref_byyear(j))(mat_index_main(i));
-            if (elem_check_mat_elems > tol_used) {
-              mat_elems(j) = elem_check_mat_elems;
-              found_greater = true;
-            }
-          }
-          
-          if (found_greater) mat_sd(mat_index_main(i)) = arma::stddev(mat_elems, 0);
-          
-          if (mat_sd(mat_index_main(i)) > tol_used) {
-            if (mat_mean(mat_index_main(i)) > tol_used) {
-              mat_cv(mat_index_main(i)) = mat_sd(mat_index_main(i)) / mat_mean(mat_index_main(i));
-            } else {
-              mat_cv(mat_index_main(i)) = 0.0;
-            }
-            
-            // This is crazy - correlation matrix is ultra-high dimension...
-            for (int k = 0; k < mat_index_main_nonzeros; k++) {
-              if (k % 10 == 0) Rcpp::checkUserInterrupt();
-              
-              mat_elems_forcorr.zeros();
-              bool found_greater_forcorr {false};
-              
-              for (int l = 0; l < refmatnum; l++) {
-                double elem_check_mef = as<arma::sp_mat>(ref_byyear(l))(mat_index_main(k));
-                if (elem_check_mef > tol_used) {
-                  mat_elems_forcorr(l) = elem_check_mef;
-                  found_greater_forcorr = true;
-                }
-              }
-              
-              double mefc_sd {0.0};
-              if (found_greater_forcorr) mefc_sd = stddev(mat_elems_forcorr);
-              
-              if (mefc_sd > 0.0) {
-                arma::mat new_cor = arma::cor(mat_elems, mat_elems_forcorr);
-                double corr_bit = new_cor(0);
-                if (corr_bit > tol_used) mat_corr(mat_index_main(i), mat_index_main(k)) = corr_bit;
-              }
-            }
-          }
-        }
+        mat_cv = ltre_sp_elems(mat_index_main, ltre_cv(ref_sds, mat_mean,
+          mat_index_main, tol_used), matdim);
+        mat_corr = ltre_sp_pairs(mat_index_main, ref_corrs,
+          matdim * matdim);
         
         ref_sp_matmean = mat_mean;
         ref_sp_matelas = elas3sp_matrix(mat_mean);
@@ -1,7 +1,14 @@
 #include <RcppArmadillo.h>
 #include <LefkoUtils.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 // [[Rcpp::depends(RcppArmadillo)]]
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace Rcpp;
 using namespace arma;
 using namespace LefkoUtils;
@@ -15,6 +22,16 @@ using namespace LefkoMats;
 // 3. DataFrame create_pm  Creates a Skeleton Paramnames Object for Use in Function-based Modeling
 // 4. NumericVector vrmf_inator  Convert modelextract Coefficient Vector to vrm_frame Vector
 // 5. List miniMod  Minimize lefkoMod Object by Conversion to vrm_input Object
+// 6. struct glm_fit  Parameter Estimates of One Native Model Fit
+// 7. class glm_colstore  Shared Design Matrix Column Store for Native Model Fits
+// 8. class glm_view  Column-Index View of a Candidate Design Matrix
+// 9. bool glm_obs_eval  Per-Observation Log Likelihood, Score, and Weight for Native Model Fits
+// 10. bool glm_chol  In-Place Cholesky Factorization for Native Model Fits
+// 11. void glm_chol_solve  Solve Linear System Using Cholesky Factor
+// 12. bool glm_newton  Penalized Newton-Raphson Fit of a Single Linear Predictor
+// 13. int glm_core_fit  Fit One Candidate Model with the Native Engine
+// 14. List glm_fit_list  Export Single Native Model Fit as List
+// 15. List glm_dredge  Fit All Candidate Models of a Vital Rate with the Native Engine
 
 
 //' Workhorse Formula Creator for Function modelsearch()
@@ -4690,3 +4707,1542 @@ Rcpp::List miniMod (RObject lMod, Nullable<RObject> hfv_data = R_NilValue,
   return output;
 }
 
+
+//' Parameter Estimates of One Native Model Fit
+//' 
+//' Structure \code{glm_fit} holds the estimates produced by function
+//' \code{glm_core_fit()} for a single candidate model.
+//' 
+//' @name glm_fit
+//' 
+//' @keywords internal
+//' @noRd
+struct glm_fit {
+  arma::vec beta;
+  arma::vec beta_zi;
+  arma::vec ranef;
+  arma::vec ran_var;
+  double theta {1.0};
+  double phi {1.0};
+  double loglik {0.0};
+  double df {0.0};
+  bool converged {false};
+};
+
+//' Shared Design Matrix Column Store for Native Model Fits
+//' 
+//' Class \code{glm_colstore} builds every design matrix column used by the
+//' candidate models of a single vital rate, once per vital rate data subset.
+//' Incomplete cases are removed a single time over all variables used, and the
+//' design matrix of each candidate model is then taken from the store as a
+//' \code{glm_view} of column indices, without rebuilding or copying columns.
+//' Terms may hold numeric variables, factors, character variables, and
+//' variables wrapped in \code{as.factor()}, as well as colon-separated
+//' interactions of these. Factors are coded as in \code{model.matrix()}, with
+//' treatment contrasts unless the margin of the factor within the term is
+//' absent from the model, in which case all levels are used.
+//' 
+//' @name glm_colstore
+//' 
+//' @param data The data frame holding the vital rate data subset.
+//' @param response_name The name of the response variable.
+//' @param term_labels The term labels of the global model, excluding the
+//' intercept and random terms.
+//' @param ran_vars The names of the random grouping variables.
+//' 
+//' @section Notes:
+//' Unused factor levels are dropped after removing incomplete cases, so that
+//' no design matrix column is entirely zero. Terms that cannot be built from
+//' the data, such as those using other functions of variables, produce an
+//' error.
+//' 
+//' @keywords internal
+//' @noRd
+class glm_colstore {
+  public:
+    int n {0};
+    arma::mat columns;
+    arma::vec response;
+    std::vector<std::string> names;
+    std::vector<int> assign;
+    std::vector<std::vector<int>> term_vars;
+    arma::umat ran;
+    arma::uvec ran_group;
+    arma::uvec ran_nlev;
+    std::vector<std::vector<std::string>> ran_levels;
+    
+    glm_colstore (const DataFrame& data, const std::string& response_name,
+      const CharacterVector& term_labels, const CharacterVector& ran_vars) {
+      
+      std::vector<std::string> data_names = as<std::vector<std::string>>(data.names());
+      int no_terms = static_cast<int>(term_labels.length());
+      int no_ran = static_cast<int>(ran_vars.length());
+      int data_rows = static_cast<int>(data.nrows());
+      
+      auto find_var = [&](const std::string& var_name) -> int {
+        for (int k = 0; k < static_cast<int>(data_names.size()); k++) {
+          if (data_names[k] == var_name) return k;
+        }
+        throw Rcpp::exception("Some model variables could not be found in the data.", false);
+      };
+      
+      // Variables used in terms, identified by their labels as written
+      std::vector<std::string> var_labels;
+      std::vector<int> var_cols;
+      std::vector<bool> var_factor;
+      std::vector<std::vector<int>> term_parts(no_terms);
+      
+      for (int t = 0; t < no_terms; t++) {
+        std::string label = as<std::string>(term_labels(t));
+        size_t start {0};
+        
+        while (start <= label.size()) {
+          size_t end = label.find(':', start);
+          if (end == std::string::npos) end = label.size();
+          std::string part = label.substr(start, end - start);
+          part.erase(0, part.find_first_not_of(' '));
+          part.erase(part.find_last_not_of(' ') + 1);
+          
+          int part_index {-1};
+          for (int v = 0; v < static_cast<int>(var_labels.size()); v++) {
+            if (var_labels[v] == part) part_index = v;
+          }
+          
+          if (part_index == -1) {
+            bool wrapped {false};
+            std::string var_name = part;
+            if (part.size() > 11 && part.compare(0, 10, "as.factor(") == 0 &&
+              part.back() == ')') {
+              wrapped = true;
+              var_name = part.substr(10, part.size() - 11);
+            }
+            
+            int data_col = find_var(var_name);
+            SEXP x = data[data_col];
+            int x_type = TYPEOF(x);
+            if (x_type != REALSXP && x_type != INTSXP && x_type != LGLSXP &&
+              x_type != STRSXP) {
+              throw Rcpp::exception("Model variables must be numeric, logical, character, or factor.", false);
+            }
+            
+            part_index = static_cast<int>(var_labels.size());
+            var_labels.push_back(part);
+            var_cols.push_back(data_col);
+            var_factor.push_back(wrapped || x_type == STRSXP || Rf_isFactor(x));
+          }
+          
+          term_parts[t].push_back(part_index);
+          start = end + 1;
+        }
+      }
+      
+      // Complete cases over all variables, found once for all candidates
+      int response_col = find_var(response_name);
+      std::vector<int> check_cols (var_cols);
+      check_cols.push_back(response_col);
+      
+      std::vector<int> ran_cols (no_ran);
+      for (int g = 0; g < no_ran; g++) {
+        ran_cols[g] = find_var(as<std::string>(ran_vars(g)));
+        check_cols.push_back(ran_cols[g]);
+      }
+      
+      std::vector<int> kept;
+      for (int i = 0; i < data_rows; i++) {
+        bool complete {true};
+        for (int c : check_cols) {
+          if (is_missing(data[c], i)) {
+            complete = false;
+            break;
+          }
+        }
+        if (complete) kept.push_back(i);
+      }
+      n = static_cast<int>(kept.size());
+      if (n == 0) throw Rcpp::exception("No complete cases found in data.", false);
+      
+      SEXP y_sexp = data[response_col];
+      if (TYPEOF(y_sexp) == STRSXP || Rf_isFactor(y_sexp)) {
+        throw Rcpp::exception("Response variable must be numeric.", false);
+      }
+      response = numeric_values(y_sexp, kept);
+      
+      // Variable values, extracted once and shared by all terms
+      int no_vars = static_cast<int>(var_labels.size());
+      std::vector<arma::vec> var_values (no_vars);
+      std::vector<std::vector<int>> var_codes (no_vars);
+      std::vector<std::vector<std::string>> var_levels (no_vars);
+      
+      for (int v = 0; v < no_vars; v++) {
+        if (var_factor[v]) {
+          factor_codes(data[var_cols[v]], kept, var_codes[v], var_levels[v]);
+        } else {
+          var_values[v] = numeric_values(data[var_cols[v]], kept);
+        }
+      }
+      
+      term_vars.resize(no_terms);
+      for (int t = 0; t < no_terms; t++) {
+        term_vars[t] = term_parts[t];
+        std::sort(term_vars[t].begin(), term_vars[t].end());
+        term_vars[t].erase(std::unique(term_vars[t].begin(), term_vars[t].end()),
+          term_vars[t].end());
+      }
+      
+      // Design columns, with the intercept first
+      std::vector<arma::vec> col_list;
+      col_list.push_back(arma::vec(n, fill::ones));
+      names.push_back("(Intercept)");
+      assign.push_back(0);
+      
+      for (int t = 0; t < no_terms; t++) {
+        int no_parts = static_cast<int>(term_parts[t].size());
+        std::vector<std::vector<arma::vec>> blocks (no_parts);
+        std::vector<std::vector<std::string>> block_names (no_parts);
+        
+        for (int c = 0; c < no_parts; c++) {
+          int v = term_parts[t][c];
+          
+          if (!var_factor[v]) {
+            blocks[c].push_back(var_values[v]);
+            block_names[c].push_back(var_labels[v]);
+            continue;
+          }
+          
+          std::vector<int> margin;
+          for (int w : term_vars[t]) if (w != v) margin.push_back(w);
+          
+          bool contrasts = margin.empty();
+          for (int u = 0; u < no_terms && !contrasts; u++) {
+            if (term_vars[u] == margin) contrasts = true;
+          }
+          
+          int no_levels = static_cast<int>(var_levels[v].size());
+          for (int l = (contrasts ? 1 : 0); l < no_levels; l++) {
+            arma::vec indicator (n, fill::zeros);
+            for (int i = 0; i < n; i++) {
+              if (var_codes[v][i] == l) indicator(i) = 1.0;
+            }
+            blocks[c].push_back(indicator);
+            block_names[c].push_back(var_labels[v] + var_levels[v][l]);
+          }
+        }
+        
+        int no_combos {1};
+        for (int c = 0; c < no_parts; c++) {
+          no_combos *= static_cast<int>(blocks[c].size());
+        }
+        if (no_combos == 0) {
+          throw Rcpp::exception("Some model factors have only one level in the data.", false);
+        }
+        
+        // The first variable in each term varies fastest, as in model.matrix()
+        for (int combo = 0; combo < no_combos; combo++) {
+          arma::vec current (n, fill::ones);
+          std::string current_name;
+          int remainder = combo;
+          
+          for (int c = 0; c < no_parts; c++) {
+            int block_size = static_cast<int>(blocks[c].size());
+            int k = remainder % block_size;
+            remainder /= block_size;
+            
+            current %= blocks[c][k];
+            if (c > 0) current_name += ":";
+            current_name += block_names[c][k];
+          }
+          
+          col_list.push_back(current);
+          names.push_back(current_name);
+          assign.push_back(t + 1);
+        }
+      }
+      
+      columns.set_size(n, col_list.size());
+      for (int j = 0; j < static_cast<int>(col_list.size()); j++) {
+        columns.col(j) = col_list[j];
+      }
+      
+      // Random intercepts, indexed into a single vector of coefficients
+      ran.set_size(n, no_ran);
+      ran_nlev.set_size(no_ran);
+      ran_levels.resize(no_ran);
+      int q {0};
+      
+      for (int g = 0; g < no_ran; g++) {
+        std::vector<int> codes;
+        factor_codes(data[ran_cols[g]], kept, codes, ran_levels[g]);
+        
+        ran_nlev(g) = static_cast<arma::uword>(ran_levels[g].size());
+        for (int i = 0; i < n; i++) {
+          ran(i, g) = static_cast<arma::uword>(q + codes[i]);
+        }
+        q += static_cast<int>(ran_levels[g].size());
+      }
+      
+      ran_group.set_size(q);
+      for (int g = 0, l = 0; g < no_ran; g++) {
+        for (int k = 0; k < static_cast<int>(ran_nlev(g)); k++, l++) ran_group(l) = g;
+      }
+    }
+  
+  private:
+    static bool is_missing (SEXP x, int i) {
+      switch (TYPEOF(x)) {
+        case REALSXP:
+          return ISNAN(REAL(x)[i]);
+        case INTSXP:
+          return INTEGER(x)[i] == NA_INTEGER;
+        case LGLSXP:
+          return LOGICAL(x)[i] == NA_LOGICAL;
+        case STRSXP:
+          return STRING_ELT(x, i) == NA_STRING;
+        default:
+          return false;
+      }
+    }
+    
+    static arma::vec numeric_values (SEXP x, const std::vector<int>& kept) {
+      int n_kept = static_cast<int>(kept.size());
+      arma::vec out (n_kept);
+      
+      for (int i = 0; i < n_kept; i++) {
+        if (TYPEOF(x) == REALSXP) {
+          out(i) = REAL(x)[kept[i]];
+        } else if (TYPEOF(x) == INTSXP) {
+          out(i) = static_cast<double>(INTEGER(x)[kept[i]]);
+        } else {
+          out(i) = static_cast<double>(LOGICAL(x)[kept[i]]);
+        }
+      }
+      
+      return out;
+    }
+    
+    // Zero-based codes and level names, as given by droplevels(as.factor(x))
+    static void factor_codes (SEXP x, const std::vector<int>& kept,
+      std::vector<int>& codes, std::vector<std::string>& levels) {
+      
+      int n_kept = static_cast<int>(kept.size());
+      codes.assign(n_kept, 0);
+      levels.clear();
+      
+      if (Rf_isFactor(x)) {
+        CharacterVector all_levels = Rf_getAttrib(x, R_LevelsSymbol);
+        int no_all = static_cast<int>(all_levels.length());
+        std::vector<int> new_code (no_all, -1);
+        std::vector<bool> used (no_all, false);
+        
+        for (int i = 0; i < n_kept; i++) used[INTEGER(x)[kept[i]] - 1] = true;
+        for (int l = 0; l < no_all; l++) {
+          if (used[l]) {
+            new_code[l] = static_cast<int>(levels.size());
+            levels.push_back(as<std::string>(all_levels(l)));
+          }
+        }
+        for (int i = 0; i < n_kept; i++) codes[i] = new_code[INTEGER(x)[kept[i]] - 1];
+        
+      } else if (TYPEOF(x) == STRSXP) {
+        std::vector<std::string> values (n_kept);
+        for (int i = 0; i < n_kept; i++) values[i] = CHAR(STRING_ELT(x, kept[i]));
+        
+        levels = values;
+        std::sort(levels.begin(), levels.end());
+        levels.erase(std::unique(levels.begin(), levels.end()), levels.end());
+        
+        for (int i = 0; i < n_kept; i++) {
+          codes[i] = static_cast<int>(std::lower_bound(levels.begin(),
+            levels.end(), values[i]) - levels.begin());
+        }
+        
+      } else {
+        arma::vec values = numeric_values(x, kept);
+        arma::vec unique_values = arma::unique(values);
+        
+        for (int i = 0; i < n_kept; i++) {
+          codes[i] = static_cast<int>(std::lower_bound(unique_values.begin(),
+            unique_values.end(), values(i)) - unique_values.begin());
+        }
+        
+        for (double value : unique_values) {
+          if (TYPEOF(x) == LGLSXP) {
+            levels.push_back(value != 0.0 ? "TRUE" : "FALSE");
+          } else {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.15g", value);
+            levels.push_back(buffer);
+          }
+        }
+      }
+    }
+};
+
+//' Column-Index View of a Candidate Design Matrix
+//' 
+//' Class \code{glm_view} presents selected columns of a \code{glm_colstore}
+//' as the design matrix of a single candidate model. Columns are read in place
+//' from the shared store, so that no candidate design matrix is copied.
+//' 
+//' @name glm_view
+//' 
+//' @param store_in The \code{columns} matrix of the vital rate's column store.
+//' @param cols_in The store columns used in the candidate model, beginning
+//' with the intercept.
+//' 
+//' @keywords internal
+//' @noRd
+class glm_view {
+  public:
+    const arma::mat& store;
+    arma::uvec cols;
+    int n_rows;
+    int n_cols;
+    
+    glm_view (const arma::mat& store_in, const arma::uvec& cols_in) :
+      store(store_in), cols(cols_in), n_rows(static_cast<int>(store_in.n_rows)),
+      n_cols(static_cast<int>(cols_in.n_elem)) {}
+    
+    inline double at (int i, int a) const {
+      return store.at(static_cast<arma::uword>(i), cols(a));
+    }
+    
+    // Linear predictor X * b
+    inline void times (const arma::vec& b, arma::vec& out) const {
+      out.zeros(n_rows);
+      
+      for (int a = 0; a < n_cols; a++) {
+        double b_a = b(a);
+        if (b_a == 0.0) continue;
+        
+        const double* x_a = store.colptr(cols(a));
+        for (int i = 0; i < n_rows; i++) out(i) += x_a[i] * b_a;
+      }
+    }
+    
+    // Product t(X) * s, written to the leading elements of out
+    inline void trans_times (const arma::vec& s, arma::vec& out) const {
+      for (int a = 0; a < n_cols; a++) {
+        const double* x_a = store.colptr(cols(a));
+        double total {0.0};
+        for (int i = 0; i < n_rows; i++) total += x_a[i] * s(i);
+        out(a) = total;
+      }
+    }
+    
+    // Weighted cross-product t(X) * diag(w) * X, written to the leading block
+    inline void cross (const arma::vec& w, arma::mat& out) const {
+      for (int a = 0; a < n_cols; a++) {
+        const double* x_a = store.colptr(cols(a));
+        
+        for (int b = 0; b <= a; b++) {
+          const double* x_b = store.colptr(cols(b));
+          double total {0.0};
+          for (int i = 0; i < n_rows; i++) total += w(i) * x_a[i] * x_b[i];
+          
+          out(a, b) = total;
+          out(b, a) = total;
+        }
+      }
+    }
+};
+
+//' Per-Observation Log Likelihood, Score, and Weight for Native Model Fits
+//' 
+//' Function \code{glm_obs_eval()} calculates the log likelihood of a single
+//' observation under the response distributions supported by
+//' \code{modelsearch()}, together with its first derivative and its negative
+//' second derivative with respect to the linear predictor. Binomial responses
+//' use the logit link, gaussian responses the identity link, gamma responses
+//' the inverse link, and poisson and negative binomial responses the log link.
+//' 
+//' @name glm_obs_eval
+//' 
+//' @param dist An integer representing the response distribution. \code{0} = 
+//' poisson, \code{1} = negbin, \code{2} = gaussian, \code{3} = gamma, and
+//' \code{4} = binomial.
+//' @param truncz A logical value indicating whether the distribution is
+//' zero-truncated. Only used with poisson and negbin responses.
+//' @param y The response value.
+//' @param eta The linear predictor.
+//' @param theta The scale parameter theta of the negative binomial
+//' distribution.
+//' @param phi The dispersion parameter of the gaussian and gamma distributions.
+//' @param ll The log likelihood, returned by reference.
+//' @param score The first derivative of \code{ll} with respect to \code{eta},
+//' returned by reference.
+//' @param weight The negative second derivative of \code{ll} with respect to
+//' \code{eta}, or its expectation where that is always positive. Returned by
+//' reference.
+//' 
+//' @return A logical value indicating whether the log likelihood is defined at
+//' \code{eta}.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool glm_obs_eval(int dist, bool truncz, double y, double eta,
+  double theta, double phi, double& ll, double& score, double& weight) {
+  
+  if (dist == 4) {
+    double mu = 1.0 / (1.0 + exp(-eta));
+    
+    if (eta > 0.0) {
+      ll = y * eta - eta - log1p(exp(-eta));
+    } else {
+      ll = y * eta - log1p(exp(eta));
+    }
+    score = y - mu;
+    weight = mu * (1.0 - mu);
+    
+  } else if (dist == 2) {
+    double resid = y - eta;
+    
+    ll = -0.5 * log(2.0 * M_PI * phi) - (resid * resid) / (2.0 * phi);
+    score = resid / phi;
+    weight = 1.0 / phi;
+    
+  } else if (dist == 3) {
+    if (eta <= 0.0 || y <= 0.0) return false;
+    
+    double mu = 1.0 / eta;
+    double nu = 1.0 / phi;
+    
+    ll = nu * log(nu) - boost::math::lgamma(nu) + (nu - 1.0) * log(y) -
+      nu * y * eta + nu * log(eta);
+    score = nu * (mu - y);
+    weight = nu * mu * mu;
+    
+  } else if (dist == 0 || dist == 1) {
+    if (eta > 700.0) return false;
+    
+    double mu = exp(eta);
+    double log_p0 {0.0};
+    double g1 {0.0};
+    double g2 {0.0};
+    
+    if (dist == 0) {
+      ll = y * eta - mu - boost::math::lgamma(y + 1.0);
+      score = y - mu;
+      weight = mu;
+      
+      log_p0 = -mu;
+      g1 = -mu;
+      g2 = -mu;
+      
+    } else {
+      double tpm = theta + mu;
+      
+      ll = boost::math::lgamma(y + theta) - boost::math::lgamma(theta) -
+        boost::math::lgamma(y + 1.0) + theta * (log(theta) - log(tpm)) +
+        y * (eta - log(tpm));
+      score = theta * (y - mu) / tpm;
+      
+      if (truncz) {
+        weight = theta * mu * (y + theta) / (tpm * tpm);
+      } else {
+        weight = theta * mu / tpm;
+      }
+      
+      log_p0 = theta * (log(theta) - log(tpm));
+      g1 = -theta * mu / tpm;
+      g2 = -theta * theta * mu / (tpm * tpm);
+    }
+    
+    // Zero-truncation divides the density by the probability of a nonzero
+    if (truncz) {
+      if (y < 1.0) return false;
+      
+      double not_p0 = -expm1(log_p0);
+      if (not_p0 <= 0.0) return false;
+      
+      double ratio = exp(log_p0) / not_p0;
+      
+      ll -= log(not_p0);
+      score += ratio * g1;
+      weight -= ratio * (g1 * g1 + g2) + ratio * ratio * g1 * g1;
+    }
+    
+  } else {
+    return false;
+  }
+  
+  if (weight < 1e-10) weight = 1e-10;
+  
+  return std::isfinite(ll);
+}
+
+//' In-Place Cholesky Factorization for Native Model Fits
+//' 
+//' Function \code{glm_chol()} replaces the lower triangle of a symmetric
+//' matrix with its Cholesky factor. Only the lower triangle is read. This
+//' routine is used instead of Armadillo's decompositions so that no warnings
+//' are issued from within parallel regions.
+//' 
+//' @name glm_chol
+//' 
+//' @param A A square matrix with a valid lower triangle.
+//' 
+//' @return A logical value indicating whether the matrix is positive definite.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool glm_chol(arma::mat& A) {
+  int m = static_cast<int>(A.n_rows);
+  
+  for (int j = 0; j < m; j++) {
+    double d = A(j, j);
+    for (int k = 0; k < j; k++) d -= A(j, k) * A(j, k);
+    
+    if (!(d > 0.0)) return false;
+    d = sqrt(d);
+    A(j, j) = d;
+    
+    for (int i = j + 1; i < m; i++) {
+      double s = A(i, j);
+      for (int k = 0; k < j; k++) s -= A(i, k) * A(j, k);
+      A(i, j) = s / d;
+    }
+  }
+  
+  return true;
+}
+
+//' Solve Linear System Using Cholesky Factor
+//' 
+//' Function \code{glm_chol_solve()} solves \code{L L' x = b} by forward and
+//' back substitution, overwriting \code{b} with \code{x}.
+//' 
+//' @name glm_chol_solve
+//' 
+//' @param L A Cholesky factor produced by \code{glm_chol()}.
+//' @param b The right-hand side, replaced by the solution.
+//' 
+//' @return This function modifies \code{b} in place.
+//' 
+//' @keywords internal
+//' @noRd
+inline void glm_chol_solve(const arma::mat& L, arma::vec& b) {
+  int m = static_cast<int>(L.n_rows);
+  
+  for (int i = 0; i < m; i++) {
+    double s = b(i);
+    for (int k = 0; k < i; k++) s -= L(i, k) * b(k);
+    b(i) = s / L(i, i);
+  }
+  
+  for (int i = m - 1; i >= 0; i--) {
+    double s = b(i);
+    for (int k = i + 1; k < m; k++) s -= L(k, i) * b(k);
+    b(i) = s / L(i, i);
+  }
+}
+
+//' Penalized Newton-Raphson Fit of a Single Linear Predictor
+//' 
+//' Function \code{glm_newton()} maximizes the weighted log likelihood of a
+//' response given a fixed design matrix and, optionally, random intercepts
+//' with Gaussian penalties. Steps are halved until the penalized log likelihood
+//' does not decrease.
+//' 
+//' @name glm_newton
+//' 
+//' @param Xs A \code{glm_view} of the design matrix of the candidate model.
+//' @param y The response vector.
+//' @param prior A vector of prior weights, one per observation.
+//' @param ran An integer matrix with one column per random grouping factor,
+//' giving the index of the random coefficient applied to each observation.
+//' @param ran_group A vector giving the grouping factor of each random
+//' coefficient.
+//' @param ran_var The variance of each random grouping factor.
+//' @param dist An integer representing the response distribution, as in
+//' \code{glm_obs_eval()}.
+//' @param truncz A logical value indicating whether the distribution is
+//' zero-truncated.
+//' @param theta The negative binomial scale parameter.
+//' @param phi The gaussian or gamma dispersion parameter.
+//' @param beta The fixed slopes, used as starting values and replaced by the
+//' estimates.
+//' @param ranef The random coefficients, used as starting values and replaced
+//' by the estimates.
+//' @param eta The linear predictor at the estimates, returned by reference.
+//' @param hess The lower triangle of the penalized information matrix at the
+//' estimates, returned by reference.
+//' @param pen_ll The penalized log likelihood at the estimates, returned by
+//' reference.
+//' @param max_iter The maximum number of Newton iterations.
+//' @param tol The relative convergence tolerance on the penalized log
+//' likelihood.
+//' @param converged Set to \code{TRUE} if the penalized log likelihood
+//' converged within \code{max_iter} iterations, and to \code{FALSE} if the
+//' iteration limit was reached first. Returned by reference.
+//' 
+//' @return A logical value indicating whether the fit succeeded numerically.
+//' 
+//' @keywords internal
+//' @noRd
+inline bool glm_newton(const glm_view& Xs, const arma::vec& y,
+  const arma::vec& prior, const arma::umat& ran, const arma::uvec& ran_group,
+  const arma::vec& ran_var, int dist, bool truncz, double theta, double phi,
+  arma::vec& beta, arma::vec& ranef, arma::vec& eta, arma::mat& hess,
+  double& pen_ll, int max_iter, double tol, bool& converged) {
+  
+  converged = false;
+  
+  int n = Xs.n_rows;
+  int p = Xs.n_cols;
+  int r = static_cast<int>(ran.n_cols);
+  int q = static_cast<int>(ranef.n_elem);
+  int m = p + q;
+  
+  arma::vec score(n, fill::zeros);
+  arma::vec weight(n, fill::zeros);
+  
+  auto evaluate = [&](const arma::vec& b, const arma::vec& u, arma::vec& et,
+      bool derivs) -> double {
+    Xs.times(b, et);
+    for (int g = 0; g < r; g++) {
+      for (int i = 0; i < n; i++) et(i) += u(ran(i, g));
+    }
+    
+    double total {0.0};
+    double ll_i {0.0};
+    double s_i {0.0};
+    double w_i {0.0};
+    
+    for (int i = 0; i < n; i++) {
+      if (prior(i) <= 0.0) {
+        if (derivs) {
+          score(i) = 0.0;
+          weight(i) = 0.0;
+        }
+        continue;
+      }
+      
+      if (!glm_obs_eval(dist, truncz, y(i), et(i), theta, phi, ll_i, s_i, w_i)) {
+        return -arma::datum::inf;
+      }
+      total += prior(i) * ll_i;
+      
+      if (derivs) {
+        score(i) = prior(i) * s_i;
+        weight(i) = prior(i) * w_i;
+      }
+    }
+    
+    for (int l = 0; l < q; l++) {
+      total -= 0.5 * u(l) * u(l) / ran_var(ran_group(l));
+    }
+    
+    return total;
+  };
+  
+  double current = evaluate(beta, ranef, eta, true);
+  if (!std::isfinite(current)) return false;
+  
+  arma::mat chol_factor;
+  arma::vec gradient;
+  arma::vec trial_beta;
+  arma::vec trial_ranef;
+  arma::vec trial_eta;
+  bool done {false};
+  
+  for (int iter = 0; iter <= max_iter; iter++) {
+    hess.zeros(m, m);
+    gradient.zeros(m);
+    
+    Xs.cross(weight, hess);
+    Xs.trans_times(score, gradient);
+    
+    for (int i = 0; i < n; i++) {
+      if (weight(i) == 0.0) continue;
+      
+      for (int g = 0; g < r; g++) {
+        int lg = p + static_cast<int>(ran(i, g));
+        gradient(lg) += score(i);
+        
+        for (int a = 0; a < p; a++) hess(lg, a) += weight(i) * Xs.at(i, a);
+        
+        for (int h = 0; h <= g; h++) {
+          int lh = p + static_cast<int>(ran(i, h));
+          
+          if (lg >= lh) {
+            hess(lg, lh) += weight(i);
+          } else {
+            hess(lh, lg) += weight(i);
+          }
+        }
+      }
+    }
+    
+    for (int l = 0; l < q; l++) {
+      hess(p + l, p + l) += 1.0 / ran_var(ran_group(l));
+      gradient(p + l) -= ranef(l) / ran_var(ran_group(l));
+    }
+    
+    if (done || iter == max_iter) break;
+    
+    chol_factor = hess;
+    double ridge {0.0};
+    int attempts {0};
+    while (!glm_chol(chol_factor)) {
+      if (++attempts > 6) return false;
+      
+      ridge = (ridge == 0.0) ? 1e-8 * (1.0 + hess.diag().max()) : ridge * 100.0;
+      chol_factor = hess;
+      chol_factor.diag() += ridge;
+    }
+    
+    arma::vec delta = gradient;
+    glm_chol_solve(chol_factor, delta);
+    
+    double step {1.0};
+    double trial {current};
+    bool accepted {false};
+    
+    for (int h = 0; h < 30; h++) {
+      trial_beta = beta + step * delta.subvec(0, p - 1);
+      if (q > 0) {
+        trial_ranef = ranef + step * delta.subvec(p, m - 1);
+      } else {
+        trial_ranef = ranef;
+      }
+      
+      trial = evaluate(trial_beta, trial_ranef, trial_eta, false);
+      if (std::isfinite(trial) && trial >= current - 1e-10 * (std::abs(current) + 1.0)) {
+        accepted = true;
+        break;
+      }
+      step *= 0.5;
+    }
+    
+    if (!accepted) {
+      // No uphill step remains, so the fit has converged only at a stationary
+      // point
+      converged = (arma::abs(gradient).max() < sqrt(tol) * (std::abs(current) + 1.0));
+      break;
+    }
+    
+    beta = trial_beta;
+    ranef = trial_ranef;
+    
+    double change = trial - current;
+    current = evaluate(beta, ranef, eta, true);
+    
+    if (std::abs(change) < tol * (std::abs(current) + tol)) done = true;
+  }
+  if (done) converged = true;
+  
+  pen_ll = current;
+  
+  return true;
+}
+
+//' Fit One Candidate Model with the Native Engine
+//' 
+//' Function \code{glm_core_fit()} fits a single candidate vital rate model.
+//' Models without random terms, zero-inflation, or extra scale parameters are
+//' fit in a single Newton-Raphson pass. Otherwise, an outer loop alternates
+//' the Newton-Raphson fit with updates of the dispersion or negative binomial
+//' scale parameter, EM updates of the random intercept variances, and EM
+//' updates of the zero-inflation model. The log likelihood of mixed models is
+//' the Laplace approximation at the conditional modes of the random terms.
+//' 
+//' @name glm_core_fit
+//' 
+//' @param Xs A \code{glm_view} of the design matrix of the candidate model.
+//' The first column must be the intercept.
+//' @param y The response vector.
+//' @param ran An integer matrix with one column per random grouping factor,
+//' giving the index of the random coefficient applied to each observation.
+//' @param ran_group A vector giving the grouping factor of each random
+//' coefficient.
+//' @param ran_nlev The number of levels of each random grouping factor.
+//' @param dist An integer representing the response distribution, as in
+//' \code{glm_obs_eval()}.
+//' @param truncz A logical value indicating whether the distribution is
+//' zero-truncated.
+//' @param zero A logical value indicating whether the distribution is
+//' zero-inflated. The zero-inflation model uses the same fixed terms as the
+//' count model.
+//' @param max_iter The maximum number of Newton iterations per pass.
+//' @param tol The relative convergence tolerance.
+//' @param fit A \code{glm_fit} structure holding the estimates, returned by
+//' reference.
+//' 
+//' @return An integer giving the status of the fit. \code{0} means that the
+//' fit failed, \code{1} that it converged, and \code{2} that it reached the
+//' iteration limit without converging.
+//' 
+//' @section Notes:
+//' Gaussian models with random terms are fit by restricted maximum likelihood
+//' (REML), and their log likelihood is the REML log likelihood, as with the
+//' default settings of \code{lme4::lmer()}. All other models are fit by
+//' maximum likelihood.
+//' 
+//' @keywords internal
+//' @noRd
+inline int glm_core_fit(const glm_view& Xs, const arma::vec& y,
+  const arma::umat& ran, const arma::uvec& ran_group, const arma::uvec& ran_nlev,
+  int dist, bool truncz, bool zero, int max_iter, double tol, glm_fit& fit) {
+  
+  int n = Xs.n_rows;
+  int p = Xs.n_cols;
+  int r = static_cast<int>(ran.n_cols);
+  int q = static_cast<int>(ran_group.n_elem);
+  int m = p + q;
+  
+  double y_mean = arma::mean(y);
+  double y_var = (n > 1) ? arma::var(y) : 0.0;
+  
+  fit.beta.zeros(p);
+  fit.beta_zi.reset();
+  fit.ranef.zeros(q);
+  fit.ran_var.set_size(r);
+  fit.ran_var.fill(0.1);
+  fit.theta = 1.0;
+  fit.phi = 1.0;
+  fit.converged = false;
+  
+  if (dist == 4) {
+    double start_mean = std::min(std::max(y_mean, 0.01), 0.99);
+    fit.beta(0) = log(start_mean / (1.0 - start_mean));
+    
+  } else if (dist == 0 || dist == 1) {
+    fit.beta(0) = log(std::max(y_mean, 0.1));
+    
+    if (dist == 1) {
+      if (y_var > y_mean) {
+        fit.theta = std::max(y_mean * y_mean / (y_var - y_mean), 0.01);
+      } else {
+        fit.theta = 10.0;
+      }
+    }
+    
+  } else if (dist == 2) {
+    fit.beta(0) = y_mean;
+    fit.phi = (y_var > 0.0) ? y_var : 1.0;
+    fit.ran_var.fill(0.1 * fit.phi);
+    
+  } else if (dist == 3) {
+    if (y_mean <= 0.0) return 0;
+    
+    fit.beta(0) = 1.0 / y_mean;
+    fit.phi = (y_var > 0.0) ? y_var / (y_mean * y_mean) : 1.0;
+    fit.ran_var.fill(0.01 * fit.beta(0) * fit.beta(0));
+  }
+  
+  arma::vec prior(n, fill::ones);
+  arma::vec tau(n, fill::zeros);
+  arma::vec eta;
+  Xs.times(fit.beta, eta);
+  arma::vec eta_zi(n, fill::zeros);
+  arma::mat hess;
+  arma::mat hess_zi;
+  double pen_ll {0.0};
+  double pen_zi {0.0};
+  
+  arma::umat no_ran(n, 0);
+  arma::uvec no_group;
+  arma::vec no_var;
+  arma::vec no_ranef;
+  
+  if (zero) {
+    double zero_frac = static_cast<double>(arma::accu(y == 0.0)) / static_cast<double>(n);
+    double start_pi = std::min(std::max(0.5 * zero_frac, 0.01), 0.99);
+    
+    fit.beta_zi.zeros(p);
+    fit.beta_zi(0) = log(start_pi / (1.0 - start_pi));
+    eta_zi.fill(fit.beta_zi(0));
+  }
+  
+  bool outer_needed = (r > 0 || zero || dist == 1 || dist == 2 || dist == 3);
+  bool reml = (dist == 2 && r > 0);
+  int max_outer = outer_needed ? 200 : 1;
+  double last_ll = -arma::datum::inf;
+  double ll_i {0.0};
+  double s_i {0.0};
+  double w_i {0.0};
+  bool newton_converged {false};
+  bool zi_converged {true};
+  
+  for (int outer = 0; outer < max_outer; outer++) {
+    // E step of the zero-inflation model
+    if (zero) {
+      for (int i = 0; i < n; i++) {
+        if (y(i) == 0.0) {
+          double pi_i = 1.0 / (1.0 + exp(-eta_zi(i)));
+          if (!glm_obs_eval(dist, false, 0.0, eta(i), fit.theta, fit.phi,
+            ll_i, s_i, w_i)) return 0;
+          
+          tau(i) = pi_i / (pi_i + (1.0 - pi_i) * exp(ll_i));
+        } else {
+          tau(i) = 0.0;
+        }
+      }
+      prior = 1.0 - tau;
+    }
+    
+    if (!glm_newton(Xs, y, prior, ran, ran_group, fit.ran_var, dist, truncz,
+      fit.theta, fit.phi, fit.beta, fit.ranef, eta, hess, pen_ll, max_iter,
+      tol, newton_converged)) return 0;
+    
+    if (zero) {
+      arma::vec zi_prior(n, fill::ones);
+      
+      if (!glm_newton(Xs, tau, zi_prior, no_ran, no_group, no_var, 4, false,
+        1.0, 1.0, fit.beta_zi, no_ranef, eta_zi, hess_zi, pen_zi, max_iter,
+        tol, zi_converged)) return 0;
+    }
+    
+    // Marginal log likelihood at the current estimates
+    double total {0.0};
+    for (int i = 0; i < n; i++) {
+      if (zero) {
+        double pi_i = 1.0 / (1.0 + exp(-eta_zi(i)));
+        
+        if (!glm_obs_eval(dist, false, y(i), eta(i), fit.theta, fit.phi,
+          ll_i, s_i, w_i)) return 0;
+        
+        if (y(i) == 0.0) {
+          total += log(pi_i + (1.0 - pi_i) * exp(ll_i));
+        } else {
+          total += log1p(-pi_i) + ll_i;
+        }
+      } else {
+        if (!glm_obs_eval(dist, truncz, y(i), eta(i), fit.theta, fit.phi,
+          ll_i, s_i, w_i)) return 0;
+        
+        total += ll_i;
+      }
+    }
+    
+    // Cholesky factor of the full penalized information matrix, also used in
+    // the REML likelihood and in the variance updates below
+    arma::mat chol_factor;
+    if (r > 0) {
+      for (int l = 0; l < q; l++) {
+        total -= 0.5 * fit.ranef(l) * fit.ranef(l) / fit.ran_var(ran_group(l));
+      }
+      for (int g = 0; g < r; g++) {
+        total -= 0.5 * static_cast<double>(ran_nlev(g)) * log(fit.ran_var(g));
+      }
+      
+      arma::mat ran_block = hess.submat(p, p, m - 1, m - 1);
+      if (!glm_chol(ran_block)) return 0;
+      double ran_logdet = arma::accu(arma::log(ran_block.diag()));
+      total -= ran_logdet;
+      
+      chol_factor = hess;
+      if (!glm_chol(chol_factor)) return 0;
+      
+      // Gaussian mixed models use the REML likelihood, as in lme4::lmer(). The
+      // fixed slopes are integrated out, adding the log determinant of the
+      // Schur complement of the random block of the information matrix
+      if (reml) {
+        double full_logdet = arma::accu(arma::log(chol_factor.diag()));
+        total += 0.5 * static_cast<double>(p) * log(2.0 * arma::datum::pi) -
+          (full_logdet - ran_logdet);
+      }
+    }
+    fit.loglik = total;
+    
+    if (!outer_needed) {
+      fit.converged = newton_converged;
+      break;
+    }
+    
+    // Diagonal of the inverse of the full information matrix at the random
+    // coefficients, giving their posterior variances with the fixed slopes
+    // integrated out
+    arma::vec ran_inv_diag(q, fill::zeros);
+    if (r > 0) {
+      arma::vec z(m, fill::zeros);
+      
+      for (int l = 0; l < q; l++) {
+        int j = p + l;
+        
+        z(j) = 1.0 / chol_factor(j, j);
+        ran_inv_diag(l) += z(j) * z(j);
+        
+        for (int i = j + 1; i < m; i++) {
+          double s = 0.0;
+          for (int k = j; k < i; k++) s -= chol_factor(i, k) * z(k);
+          z(i) = s / chol_factor(i, i);
+          ran_inv_diag(l) += z(i) * z(i);
+        }
+      }
+    }
+    
+    // Dispersion and scale parameters
+    if (dist == 2) {
+      arma::vec resid = y - eta;
+      double resid_ss = arma::accu(prior % resid % resid);
+      
+      if (reml) {
+        // EM update of the REML residual variance
+        double edf = static_cast<double>(p + q);
+        for (int l = 0; l < q; l++) {
+          edf -= ran_inv_diag(l) / fit.ran_var(ran_group(l));
+        }
+        resid_ss += fit.phi * edf;
+      }
+      fit.phi = std::max(resid_ss / arma::accu(prior), 1e-10);
+      
+    } else if (dist == 3) {
+      double deviance {0.0};
+      for (int i = 0; i < n; i++) {
+        double mu = 1.0 / eta(i);
+        deviance += prior(i) * 2.0 * (-log(y(i) / mu) + (y(i) - mu) / mu);
+      }
+      fit.phi = std::max(deviance / arma::accu(prior), 1e-10);
+      
+    } else if (dist == 1) {
+      // Golden section search on the log scale
+      auto theta_ll = [&](double log_theta) -> double {
+        double th = exp(log_theta);
+        double th_total {0.0};
+        
+        for (int i = 0; i < n; i++) {
+          if (prior(i) <= 0.0) continue;
+          if (!glm_obs_eval(1, truncz, y(i), eta(i), th, 1.0, ll_i, s_i, w_i)) {
+            return -arma::datum::inf;
+          }
+          th_total += prior(i) * ll_i;
+        }
+        return th_total;
+      };
+      
+      const double golden = 0.5 * (sqrt(5.0) - 1.0);
+      double lo = std::max(log(fit.theta) - 4.0, -8.0);
+      double hi = std::min(log(fit.theta) + 4.0, 12.0);
+      double c = hi - golden * (hi - lo);
+      double d = lo + golden * (hi - lo);
+      double fc = theta_ll(c);
+      double fd = theta_ll(d);
+      
+      for (int k = 0; k < 60 && (hi - lo) > 1e-6; k++) {
+        if (fc > fd) {
+          hi = d;
+          d = c;
+          fd = fc;
+          c = hi - golden * (hi - lo);
+          fc = theta_ll(c);
+        } else {
+          lo = c;
+          c = d;
+          fc = fd;
+          d = lo + golden * (hi - lo);
+          fd = theta_ll(d);
+        }
+      }
+      fit.theta = exp(0.5 * (lo + hi));
+    }
+    
+    // EM update of random intercept variances
+    double var_change {0.0};
+    if (r > 0) {
+      arma::vec new_var(r, fill::zeros);
+      
+      for (int l = 0; l < q; l++) {
+        new_var(ran_group(l)) += fit.ranef(l) * fit.ranef(l) + ran_inv_diag(l);
+      }
+      
+      for (int g = 0; g < r; g++) {
+        new_var(g) = std::max(new_var(g) / static_cast<double>(ran_nlev(g)), 1e-10);
+        var_change = std::max(var_change, std::abs(new_var(g) - fit.ran_var(g)) / fit.ran_var(g));
+      }
+      fit.ran_var = new_var;
+    }
+    
+    if (std::abs(total - last_ll) < 1e-7 * (std::abs(total) + 1e-7) &&
+      var_change < 1e-4) {
+      fit.converged = newton_converged && zi_converged;
+      break;
+    }
+    last_ll = total;
+  }
+  
+  fit.df = static_cast<double>(p + r);
+  if (zero) fit.df += static_cast<double>(p);
+  if (dist == 1 || dist == 2 || dist == 3) fit.df += 1.0;
+  
+  if (!std::isfinite(fit.loglik)) return 0;
+  
+  return (fit.converged) ? 1 : 2;
+}
+
+//' Export Single Native Model Fit as List
+//' 
+//' Function \code{glm_fit_list()} converts a \code{glm_fit} structure into the
+//' list returned to R by function \code{.glm_dredge()}.
+//' 
+//' @name glm_fit_list
+//' 
+//' @param fit The \code{glm_fit} structure to convert.
+//' @param used_cols The columns of the shared column store used in the fit.
+//' @param dist An integer representing the response distribution, as in
+//' \code{glm_obs_eval()}.
+//' @param n The number of observations.
+//' @param ic The value of the information criterion of the fit.
+//' 
+//' @return A list with the fixed slopes, zero-inflation slopes, random
+//' coefficients, random intercept variances, theta, sigma, log likelihood,
+//' degrees of freedom, criterion value, convergence status, and the 1-based
+//' columns of the design matrix used.
+//' 
+//' @keywords internal
+//' @noRd
+inline Rcpp::List glm_fit_list(const glm_fit& fit, const arma::uvec& used_cols,
+  int dist, int n, double ic) {
+  
+  double sigma {1.0};
+  int p = static_cast<int>(used_cols.n_elem);
+  
+  if (dist == 2 && fit.ran_var.n_elem > 0) {
+    // REML estimate
+    sigma = sqrt(fit.phi);
+  } else if (dist == 2) {
+    if (n > p) {
+      sigma = sqrt(fit.phi * static_cast<double>(n) / static_cast<double>(n - p));
+    } else {
+      sigma = sqrt(fit.phi);
+    }
+  } else if (dist == 3) {
+    sigma = sqrt(fit.phi);
+  }
+  
+  IntegerVector cols_out(p);
+  for (int j = 0; j < p; j++) cols_out(j) = static_cast<int>(used_cols(j)) + 1;
+  
+  List output = List::create(_["beta"] = NumericVector(fit.beta.begin(), fit.beta.end()),
+    _["beta_zi"] = NumericVector(fit.beta_zi.begin(), fit.beta_zi.end()),
+    _["ranef"] = NumericVector(fit.ranef.begin(), fit.ranef.end()),
+    _["ran_var"] = NumericVector(fit.ran_var.begin(), fit.ran_var.end()),
+    _["theta"] = fit.theta, _["sigma"] = sigma, _["loglik"] = fit.loglik,
+    _["df"] = fit.df, _["criterion"] = ic, _["converged"] = fit.converged,
+    _["cols"] = cols_out);
+  
+  return output;
+}
+
+//' Fit All Candidate Models of a Vital Rate with the Native Engine
+//' 
+//' Function \code{.glm_dredge()} is the native alternative to fitting a global
+//' model in R and dredging it with package \code{MuMIn}. All candidate models
+//' are subsets of the terms of the global model that respect marginality, so
+//' that interactions only appear with their main effects. The design columns
+//' of the vital rate are built once in a \code{glm_colstore}, and every
+//' candidate is fit in parallel, where OpenMP is available, on a view of the
+//' columns it uses. Random terms are random intercepts kept in all candidate
+//' models.
+//' 
+//' @name .glm_dredge
+//' 
+//' @param data The data frame holding the vital rate data subset.
+//' @param response The name of the response variable.
+//' @param term_labels The term labels of the global model, excluding the
+//' intercept and random terms, as given by the \code{term.labels} attribute of
+//' its \code{terms} object.
+//' @param ran_vars The names of the random grouping variables.
+//' @param dist An integer representing the response distribution. \code{0} = 
+//' poisson, \code{1} = negbin, \code{2} = gaussian, \code{3} = gamma, and
+//' \code{4} = binomial.
+//' @param truncz A logical value indicating whether the distribution is
+//' zero-truncated.
+//' @param zero A logical value indicating whether the distribution is
+//' zero-inflated.
+//' @param criterion The information criterion used to rank models. Can equal
+//' \code{"AICc"}, \code{"AIC"}, or \code{"BIC"}.
+//' @param dredge A logical value indicating whether to fit all candidate
+//' models (\code{TRUE}) or the global model only (\code{FALSE}).
+//' @param bestfit_k A logical value indicating whether the best-fit model is
+//' the model with the fewest parameters among those within 2 units of the best
+//' criterion value (\code{TRUE}), or simply the model with the best criterion
+//' value (\code{FALSE}).
+//' @param null_model A logical value indicating whether to also return the
+//' model with the fewest parameters.
+//' @param max_iter The maximum number of Newton iterations per fit.
+//' @param tol The relative convergence tolerance.
+//' 
+//' @return A list with the following elements:
+//' \item{table}{A list holding the model selection table, sorted by criterion
+//' value. Element \code{terms} is a logical matrix of the terms included in
+//' each model, followed by vectors \code{df}, \code{logLik}, \code{criterion},
+//' \code{delta}, and \code{weight}.}
+//' \item{global}{The fit of the global model.}
+//' \item{best}{The fit of the best-fit model.}
+//' \item{null}{The fit of the model with the fewest parameters, or \code{NULL}
+//' if \code{null_model = FALSE}.}
+//' \item{models_fit}{The number of candidate models attempted.}
+//' \item{models_failed}{The number of candidate models that could not be fit,
+//' including those that did not converge.}
+//' \item{models_nonconverged}{The number of candidate models that reached the
+//' iteration limit without converging. These are left out of the model
+//' selection table, and cannot be chosen as the best-fit or null model.}
+//' \item{design_names}{The names of all columns in the column store.}
+//' \item{assign}{The term of each column in the column store, with \code{0}
+//' denoting the intercept.}
+//' \item{ran_levels}{A list giving the levels of each random grouping
+//' variable.}
+//' \item{nobs}{The number of complete cases used in all fits.}
+//' 
+//' @keywords internal
+//' @noRd
+// [[Rcpp::export(.glm_dredge)]]
+Rcpp::List glm_dredge(const DataFrame& data, String response,
+  const CharacterVector& term_labels, const CharacterVector& ran_vars,
+  int dist, bool truncz = false, bool zero = false, String criterion = "AICc",
+  bool dredge = true, bool bestfit_k = true, bool null_model = false,
+  int max_iter = 50, double tol = 1e-8) {
+  
+  if (dist < 0 || dist > 4) {
+    throw Rcpp::exception("Response distribution not recognized.", false);
+  }
+  if (truncz && zero) {
+    throw Rcpp::exception("Distribution cannot be both zero-inflated and zero-truncated.", false);
+  }
+  if ((truncz || zero) && dist != 0 && dist != 1) {
+    throw Rcpp::exception("Zero-inflated and zero-truncated models require poisson or negbin responses.", false);
+  }
+  
+  int crit_code {0}; // 0 = AICc, 1 = AIC, 2 = BIC
+  std::string crit_string = criterion.get_cstring();
+  if (stringcompare_simple(crit_string, "aicc", true)) {
+    crit_code = 0;
+  } else if (stringcompare_simple(crit_string, "bic", true)) {
+    crit_code = 2;
+  } else if (stringcompare_simple(crit_string, "aic", true)) {
+    crit_code = 1;
+  } else {
+    throw Rcpp::exception("Option criterion must equal AICc, AIC, or BIC.", false);
+  }
+  
+  int no_terms = static_cast<int>(term_labels.length());
+  if (no_terms > 30) {
+    throw Rcpp::exception("The native engine cannot dredge more than 30 terms.", false);
+  }
+  
+  // All design columns of the vital rate, built once for all candidates
+  glm_colstore store(data, std::string(response.get_cstring()), term_labels,
+    ran_vars);
+  
+  int n = store.n;
+  int no_cols = static_cast<int>(store.columns.n_cols);
+  const arma::vec& y = store.response;
+  const arma::umat& ran = store.ran;
+  const arma::uvec& ran_group = store.ran_group;
+  const arma::uvec& ran_nlev = store.ran_nlev;
+  
+  std::vector<std::vector<arma::uword>> term_cols(no_terms + 1);
+  for (int j = 0; j < no_cols; j++) {
+    term_cols[store.assign[j]].push_back(static_cast<arma::uword>(j));
+  }
+  
+  // Marginality: each term requires all terms whose variables it contains
+  std::vector<uint32_t> required(no_terms, 0);
+  for (int b = 0; b < no_terms; b++) {
+    for (int a = 0; a < no_terms; a++) {
+      if (a == b || store.term_vars[a].size() >= store.term_vars[b].size()) continue;
+      
+      if (std::includes(store.term_vars[b].begin(), store.term_vars[b].end(),
+        store.term_vars[a].begin(), store.term_vars[a].end())) {
+        required[b] |= (static_cast<uint32_t>(1) << a);
+      }
+    }
+  }
+  
+  uint32_t full_mask = (no_terms > 0) ? ((static_cast<uint32_t>(1) << no_terms) - 1) : 0;
+  std::vector<uint32_t> candidates;
+  
+  if (dredge) {
+    for (uint64_t mask = 0; mask <= static_cast<uint64_t>(full_mask); mask++) {
+      uint32_t current_mask = static_cast<uint32_t>(mask);
+      bool valid {true};
+      
+      for (int b = 0; b < no_terms && valid; b++) {
+        if (((current_mask >> b) & 1u) && (required[b] & ~current_mask) != 0) {
+          valid = false;
+        }
+      }
+      if (valid) candidates.push_back(current_mask);
+    }
+  } else {
+    candidates.push_back(full_mask);
+  }
+  
+  auto model_columns = [&](uint32_t mask) -> arma::uvec {
+    std::vector<arma::uword> used(term_cols[0]);
+    for (int b = 0; b < no_terms; b++) {
+      if ((mask >> b) & 1u) used.insert(used.end(), term_cols[b + 1].begin(),
+        term_cols[b + 1].end());
+    }
+    return arma::conv_to<arma::uvec>::from(used);
+  };
+  
+  double n_d = static_cast<double>(n);
+  auto info_crit = [&](double ll, double k) -> double {
+    double ic = -2.0 * ll;
+    
+    if (crit_code == 2) {
+      ic += log(n_d) * k;
+    } else {
+      ic += 2.0 * k;
+      if (crit_code == 0) {
+        if (n_d - k - 1.0 > 0.0) {
+          ic += (2.0 * k * (k + 1.0)) / (n_d - k - 1.0);
+        } else {
+          ic = arma::datum::inf;
+        }
+      }
+    }
+    return ic;
+  };
+  
+  // Parallel fits of all candidate models
+  int no_models = static_cast<int>(candidates.size());
+  std::vector<double> model_ll(no_models, 0.0);
+  std::vector<double> model_df(no_models, 0.0);
+  std::vector<double> model_ic(no_models, arma::datum::inf);
+  std::vector<int> model_ok(no_models, 0);
+  std::vector<int> model_status(no_models, 0);
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int mdl = 0; mdl < no_models; mdl++) {
+    glm_fit fit;
+    int fit_status {0};
+    
+    try {
+      glm_view Xs(store.columns, model_columns(candidates[mdl]));
+      fit_status = glm_core_fit(Xs, y, ran, ran_group, ran_nlev, dist, truncz,
+        zero, max_iter, tol, fit);
+    } catch (...) {
+      fit_status = 0;
+    }
+    model_status[mdl] = fit_status;
+    
+    // Models that did not converge are left out of the selection table
+    if (fit_status == 1) {
+      double ic = info_crit(fit.loglik, fit.df);
+      if (std::isfinite(ic)) {
+        model_ll[mdl] = fit.loglik;
+        model_df[mdl] = fit.df;
+        model_ic[mdl] = ic;
+        model_ok[mdl] = 1;
+      }
+    }
+  }
+  
+  std::vector<int> order;
+  int no_nonconverged {0};
+  for (int mdl = 0; mdl < no_models; mdl++) {
+    if (model_ok[mdl] == 1) order.push_back(mdl);
+    if (model_status[mdl] == 2) no_nonconverged++;
+  }
+  if (order.size() == 0) {
+    throw Rcpp::exception("No candidate model converged with the native engine.", false);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    if (model_ic[a] != model_ic[b]) return model_ic[a] < model_ic[b];
+    return model_df[a] < model_df[b];
+  });
+  
+  // Model selection table
+  int no_ok = static_cast<int>(order.size());
+  double best_ic = model_ic[order[0]];
+  double weight_total {0.0};
+  
+  LogicalMatrix out_terms(no_ok, no_terms);
+  NumericVector out_df(no_ok);
+  NumericVector out_ll(no_ok);
+  NumericVector out_ic(no_ok);
+  NumericVector out_delta(no_ok);
+  NumericVector out_weight(no_ok);
+  
+  for (int pos = 0; pos < no_ok; pos++) {
+    int mdl = order[pos];
+    
+    for (int b = 0; b < no_terms; b++) {
+      out_terms(pos, b) = static_cast<bool>((candidates[mdl] >> b) & 1u);
+    }
+    out_df(pos) = model_df[mdl];
+    out_ll(pos) = model_ll[mdl];
+    out_ic(pos) = model_ic[mdl];
+    out_delta(pos) = model_ic[mdl] - best_ic;
+    out_weight(pos) = exp(-0.5 * out_delta(pos));
+    weight_total += out_weight(pos);
+  }
+  out_weight = out_weight / weight_total;
+  
+  // Best-fit and null models
+  int best_pos {0};
+  if (bestfit_k) {
+    double min_df = out_df(0);
+    for (int pos = 1; pos < no_ok; pos++) {
+      if (out_delta(pos) <= 2.0 && out_df(pos) < min_df) {
+        min_df = out_df(pos);
+        best_pos = pos;
+      }
+    }
+  }
+  
+  int null_pos {0};
+  for (int pos = 1; pos < no_ok; pos++) {
+    if (out_df(pos) < out_df(null_pos)) null_pos = pos;
+  }
+  
+  auto refit = [&](uint32_t mask) -> List {
+    glm_fit fit;
+    arma::uvec used_cols = model_columns(mask);
+    glm_view Xs(store.columns, used_cols);
+    
+    if (glm_core_fit(Xs, y, ran, ran_group, ran_nlev, dist, truncz, zero,
+      max_iter, tol, fit) != 1) {
+      throw Rcpp::exception("Native model refit failed.", false);
+    }
+    
+    return glm_fit_list(fit, used_cols, dist, n, info_crit(fit.loglik, fit.df));
+  };
+  
+  uint32_t best_mask = candidates[order[best_pos]];
+  uint32_t null_mask = candidates[order[null_pos]];
+  uint32_t global_mask = full_mask;
+  
+  bool global_ok {false};
+  for (int pos = 0; pos < no_ok; pos++) {
+    if (candidates[order[pos]] == full_mask) global_ok = true;
+  }
+  if (!global_ok) global_mask = best_mask;
+  
+  List best_list = refit(best_mask);
+  List global_list = (global_mask == best_mask) ? best_list : refit(global_mask);
+  List null_list;
+  if (null_model) {
+    if (null_mask == best_mask) {
+      null_list = best_list;
+    } else if (null_mask == global_mask) {
+      null_list = global_list;
+    } else {
+      null_list = refit(null_mask);
+    }
+  }
+  
+  List table = List::create(_["terms"] = out_terms, _["df"] = out_df,
+    _["logLik"] = out_ll, _["criterion"] = out_ic, _["delta"] = out_delta,
+    _["weight"] = out_weight);
+  
+  List ran_levels(static_cast<int>(ran_vars.length()));
+  for (int g = 0; g < static_cast<int>(ran_vars.length()); g++) {
+    ran_levels(g) = wrap(store.ran_levels[g]);
+  }
+  ran_levels.attr("names") = ran_vars;
+  
+  List output = List::create(_["table"] = table, _["global"] = global_list,
+    _["best"] = best_list, _["null"] = null_model ? RObject(null_list) : RObject(R_NilValue),
+    _["models_fit"] = no_models, _["models_failed"] = no_models - no_ok,
+    _["models_nonconverged"] = no_nonconverged,
+    _["design_names"] = wrap(store.names), _["assign"] = wrap(store.assign),
+    _["ran_levels"] = ran_levels, _["nobs"] = n);
+  
+  return output;
+}
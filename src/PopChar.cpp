@@ -3498,6 +3498,37 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
     
   }
   
+  // Integer stage codes, so that the main loop compares codes, not strings
+  arma::ivec data_stage3_codes (data_rows);
+  arma::ivec data_stage2_codes (data_rows);
+  arma::ivec data_stage1_codes (data_rows);
+  arma::ivec new_stage2_codes;
+  arma::ivec new_stage1_codes;
+  
+  data_stage3_codes.fill(-1);
+  data_stage2_codes.fill(-1);
+  data_stage1_codes.fill(-1);
+  
+  if (check_stage) {
+    // The reference includes the new stages, so that every new stage has its
+    // own code and data stages not found in it share the single sentinel -1
+    StringVector code_reference = concat_str(concat_str(all_stages, all_stages_t1a),
+      concat_str(new_stage2, new_stage1));
+    
+    if (data_stage3.length() == data_rows) {
+      data_stage3_codes = stage_codes(data_stage3, code_reference, -1);
+    }
+    if (data_stage2.length() == data_rows) {
+      data_stage2_codes = stage_codes(data_stage2, code_reference, -1);
+    }
+    if (historical && data_stage1.length() == data_rows) {
+      data_stage1_codes = stage_codes(data_stage1, code_reference, -1);
+    }
+    
+    new_stage2_codes = stage_codes(new_stage2, code_reference, -1);
+    new_stage1_codes = stage_codes(new_stage1, code_reference, -1);
+  }
+  
   // Main analysis loop
   IntegerVector pop_by_years (years_num);
   
@@ -3539,7 +3570,7 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
     if (check_stage && !check_age) {
       if (year_guys_length > 0) {
         for (int j = 0; j < year_guys_length; j++) {
-          if (stringcompare_hard(as<std::string>(data_stage2(year_guys(j))), as<std::string>(new_stage2(i)))) {
+          if (data_stage2_codes(year_guys(j)) == new_stage2_codes(i)) {
             if (!historical) {
               arma::uvec year_found = find(all_years_arma == new_year(i));
               pop_by_years(year_found(0))++;
@@ -3547,7 +3578,7 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
               new_frequency(i)++;
             } else {
             
-              if (stringcompare_hard(as<std::string>(data_stage1(year_guys(j))), as<std::string>(new_stage1(i)))) {
+              if (data_stage1_codes(year_guys(j)) == new_stage1_codes(i)) {
                 arma::uvec year_found = find(all_years_arma == new_year(i));
                 pop_by_years(year_found(0))++;
                 
@@ -3561,14 +3592,14 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
         int year_guys_length3 = static_cast<int>(year_guys3.n_elem);
         
         for (int j = 0; j < year_guys_length3; j++) {
-          if (stringcompare_hard(as<std::string>(data_stage3(year_guys3(j))), as<std::string>(new_stage2(i)))) {
+          if (data_stage3_codes(year_guys3(j)) == new_stage2_codes(i)) {
             if (!historical) {
               arma::uvec year_found = find(all_years_arma == new_year(i));
               pop_by_years(year_found(0))++;
               
               new_frequency(i)++;
             } else {
-              if (stringcompare_hard(as<std::string>(data_stage2(year_guys3(j))), as<std::string>(new_stage1(i)))) {
+              if (data_stage2_codes(year_guys3(j)) == new_stage1_codes(i)) {
                 arma::uvec year_found = find(all_years_arma == new_year(i));
                 pop_by_years(year_found(0))++;
                 
@@ -3582,7 +3613,7 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
     } else if (check_stage && check_age) {
       if (year_guys_length > 0) {
         for (int j = 0; j < year_guys_length; j++) {
-          if (stringcompare_hard(as<std::string>(data_stage2(year_guys(j))), as<std::string>(new_stage2(i)))) {
+          if (data_stage2_codes(year_guys(j)) == new_stage2_codes(i)) {
             if (data_agecol(year_guys(j)) == new_age(i)) {
               
               arma::uvec year_found = find(all_years_arma == new_year(i));
@@ -3597,7 +3628,7 @@ List actualstage3(RObject data, bool check_stage = true, bool check_age = false,
         int year_guys_length3 = static_cast<int>(year_guys3.n_elem);
         
         for (int j = 0; j < year_guys_length3; j++) {
-          if (stringcompare_hard(as<std::string>(data_stage3(year_guys3(j))), as<std::string>(new_stage2(i)))) {
+          if (data_stage3_codes(year_guys3(j)) == new_stage2_codes(i)) {
             if (data_agecol(year_guys3(j)) == new_age(i) - 1) {
               
               arma::uvec year_found = find(all_years_arma == new_year(i));
@@ -7404,6 +7435,14 @@ DataFrame sup_skeleton (Nullable<RObject> rows = R_NilValue) {
 //' @return This creates a modified \code{lefkoMat} object, and places it at
 //' the reference for object \code{final_output}.
 //' 
+//' @section Notes:
+//' Stage and label lookups are hashed once per call. All edits are then
+//' compiled into per-matrix records of element index, proxy element index, and
+//' supplement row, and applied to each matrix in a single parallel pass.
+//' Supplement rows are applied in their original order within each matrix.
+//' Sparse matrices are edited through a working copy of the touched elements
+//' only, and unedited matrices are passed through without copying.
+//' 
 //' @keywords internal
 //' @noRd
 void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop = R_NilValue,
@@ -8199,6 +8238,31 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
     StringVector ahst_stage = as<StringVector>(ahstages["stage"]);
     int ahstages_length = static_cast<int>(ahst_stage.length());
     
+    // Stage names and stage pairs are hashed once, rather than per entry
+    std::unordered_map<std::string, int> stage_ids;
+    for (int j = 0; j < ahstages_length; j++) {
+      stage_ids[as<std::string>(ahst_stage(j))] = ahst_stage_id(j);
+    }
+    auto find_id = [&](const StringVector& x, int i) {
+      if (StringVector::is_na(x(i))) return 0;
+      auto found = stage_ids.find(as<std::string>(x(i)));
+      return (found != stage_ids.end()) ? found->second : 0;
+    };
+    
+    int hstages_length = static_cast<int>(hst_stage2_id.n_elem);
+    std::unordered_map<long long, int> hst_rows;
+    for (int j = 0; j < hstages_length; j++) {
+      long long pair_key = static_cast<long long>(hst_stage2_id(j)) *
+        (static_cast<long long>(INT_MAX) + 1LL) + static_cast<long long>(hst_stage1_id(j));
+      hst_rows.emplace(pair_key, j);
+    }
+    auto find_pair = [&](int id2, int id1) {
+      long long pair_key = static_cast<long long>(id2) *
+        (static_cast<long long>(INT_MAX) + 1LL) + static_cast<long long>(id1);
+      auto found = hst_rows.find(pair_key);
+      return (found != hst_rows.end()) ? found->second : -1;
+    };
+    
     IntegerVector new_col_index (check_loop_length, -1);
     IntegerVector new_row_index (check_loop_length, -1);
     IntegerVector new_use_est (check_loop_length);
@@ -8206,59 +8270,34 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
     IntegerVector new_est_row_index (check_loop_length, -1);
     
     for (int i = 0; i < check_loop_length; i++) {
-      int found_stage3 {0};
-      int found_stage2 {0};
-      int found_stage1 {0};
-      
-      int found_eststage3 {0};
-      int found_eststage2 {0};
-      int found_eststage1 {0};
-      
-      for (int j = 0; j < ahstages_length; j++) {
-        if (ahst_stage(j) == new_stage3(i)) found_stage3 = ahst_stage_id(j);
-        if (ahst_stage(j) == new_stage2(i)) found_stage2 = ahst_stage_id(j);
-        if (ahst_stage(j) == new_stage1(i)) found_stage1 = ahst_stage_id(j);
-        
-        if (!StringVector::is_na(new_eststage3(i)) && new_eststage3(i) != "NA") {
-          new_use_est(i) = 1;
-          if (ahst_stage(j) == new_eststage3(i)) found_eststage3 = ahst_stage_id(j);
-          if (ahst_stage(j) == new_eststage2(i)) found_eststage2 = ahst_stage_id(j);
-          if (ahst_stage(j) == new_eststage1(i)) found_eststage1 = ahst_stage_id(j);
-        }
-      }
+      int found_stage3 = find_id(new_stage3, i);
+      int found_stage2 = find_id(new_stage2, i);
+      int found_stage1 = find_id(new_stage1, i);
       
-      arma::uvec hst_found_stage3of32 = find(hst_stage2_id == found_stage3);
-      arma::uvec hst_found_stage2of32 = find(hst_stage1_id == found_stage2);
-      arma::uvec hst_found_stage2of21 = find(hst_stage2_id == found_stage2);
-      arma::uvec hst_found_stage1of21 = find(hst_stage1_id == found_stage1);
+      int hst_found_stage32 = find_pair(found_stage3, found_stage2);
+      int hst_found_stage21 = find_pair(found_stage2, found_stage1);
       
-      arma::uvec hst_found_stage32 = intersect(hst_found_stage3of32,
-        hst_found_stage2of32);
-      arma::uvec hst_found_stage21 = intersect(hst_found_stage2of21,
-        hst_found_stage1of21);
-      
-      if (hst_found_stage32.n_elem > 0 && hst_found_stage21.n_elem > 0) {
-        new_col_index(i) = static_cast<int>(hst_found_stage21(0));
-        new_row_index(i) = static_cast<int>(hst_found_stage32(0));
+      if (hst_found_stage32 > -1 && hst_found_stage21 > -1) {
+        new_col_index(i) = hst_found_stage21;
+        new_row_index(i) = hst_found_stage32;
       } else {
         Rf_warningcall(R_NilValue, "Some stage designations could not be found.");
       }
       
-      if (new_use_est(i) == 1) {
-        arma::uvec hst_found_eststage3of32 = find(hst_stage2_id == found_eststage3);
-        arma::uvec hst_found_eststage2of32 = find(hst_stage1_id == found_eststage2);
-        arma::uvec hst_found_eststage2of21 = find(hst_stage2_id == found_eststage2);
-        arma::uvec hst_found_eststage1of21 = find(hst_stage1_id == found_eststage1);
+      if (!StringVector::is_na(new_eststage3(i)) && new_eststage3(i) != "NA") {
+        new_use_est(i) = 1;
+        
+        int found_eststage3 = find_id(new_eststage3, i);
+        int found_eststage2 = find_id(new_eststage2, i);
+        int found_eststage1 = find_id(new_eststage1, i);
         
-        arma::uvec hst_found_eststage32 = intersect(hst_found_eststage3of32,
-          hst_found_eststage2of32);
-        arma::uvec hst_found_eststage21 = intersect(hst_found_eststage2of21,
-          hst_found_eststage1of21);
+        int hst_found_eststage32 = find_pair(found_eststage3, found_eststage2);
+        int hst_found_eststage21 = find_pair(found_eststage2, found_eststage1);
         
-        if (hst_found_eststage32.n_elem > 0 && hst_found_eststage21.n_elem > 0) {
-          new_est_col_index(i) = static_cast<int>(hst_found_eststage21(0));
-          new_est_row_index(i) = static_cast<int>(hst_found_eststage32(0));
-        } else if (!StringVector::is_na(new_eststage3(i))) {
+        if (hst_found_eststage32 > -1 && hst_found_eststage21 > -1) {
+          new_est_col_index(i) = hst_found_eststage21;
+          new_est_row_index(i) = hst_found_eststage32;
+        } else {
           Rf_warningcall(R_NilValue, "Some eststage designations could not be found.");
         }
       }
@@ -8298,49 +8337,34 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
     IntegerVector new_est_col_index (check_loop_length, -1);
     IntegerVector new_est_row_index (check_loop_length, -1);
     
+    std::unordered_map<std::string, int> stage_indices;
+    for (int j = 0; j < agestages_length; j++) {
+      stage_indices[as<std::string>(ahst_stage(j))] = j;
+    }
+    auto find_index = [&](const StringVector& x, int i) {
+      if (StringVector::is_na(x(i))) return -1;
+      auto found = stage_indices.find(as<std::string>(x(i)));
+      return (found != stage_indices.end()) ? found->second : -1;
+    };
+    
     for (int i = 0; i < check_loop_length; i++) {
-      int found_stage2 {0};
-      int found_stage3 {0};
-      bool found_stage2_log {false};
-      bool found_stage3_log {false};
-      
-      int found_eststage2 {0};
-      int found_eststage3 {0};
-      bool found_eststage2_log {false};
-      bool found_eststage3_log {false};
-      
-      for (int j = 0; j < agestages_length; j++) {
-        if (ahst_stage(j) == new_stage3(i)) {
-          found_stage3 = j;
-          found_stage3_log = true;
-        }
-        if (ahst_stage(j) == new_stage2(i)) {
-          found_stage2 = j;
-          found_stage2_log = true;
-        }
-        
-        if (!StringVector::is_na(new_eststage3(i)) && new_eststage3(i) != "NA") {
-          new_use_est(i) = 1;
-          if (ahst_stage(j) == new_eststage3(i)) {
-            found_eststage3 = j;
-            found_eststage3_log = true;
-          }
-          if (ahst_stage(j) == new_eststage2(i)) {
-            found_eststage2 = j;
-            found_eststage2_log = true;
-          }
-        }
-      }
+      int found_stage3 = find_index(new_stage3, i);
+      int found_stage2 = find_index(new_stage2, i);
       
-      if (found_stage3_log && found_stage2_log) {
+      if (found_stage3 > -1 && found_stage2 > -1) {
         new_col_index(i) = found_stage2;
         new_row_index(i) = found_stage3;
       } else {
         Rf_warningcall(R_NilValue, "Some stage designations could not be found.");
       }
       
-      if (new_use_est(i) == 1) {
-        if (found_eststage3_log && found_eststage2_log) {
+      if (!StringVector::is_na(new_eststage3(i)) && new_eststage3(i) != "NA") {
+        new_use_est(i) = 1;
+        
+        int found_eststage3 = find_index(new_eststage3, i);
+        int found_eststage2 = find_index(new_eststage2, i);
+        
+        if (found_eststage3 > -1 && found_eststage2 > -1) {
           new_est_col_index(i) = found_eststage2;
           new_est_row_index(i) = found_eststage3;
         } else {
@@ -8391,69 +8415,66 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
     IntegerVector new_est_col_index (check_loop_length, -1);
     IntegerVector new_est_row_index (check_loop_length, -1);
     
+    // Stage names and age-stage pairs are hashed once, rather than per entry
+    std::unordered_map<std::string, int> stage_ids;
+    std::unordered_map<long long, int> agst_rows;
+    std::unordered_map<int, int> agst_ages;
+    for (int j = 0; j < agestages_length; j++) {
+      stage_ids[as<std::string>(agst_stage(j))] = static_cast<int>(agst_stage_id(j));
+      
+      long long pair_key = static_cast<long long>(agst_stage_id(j)) *
+        (static_cast<long long>(INT_MAX) + 1LL) + static_cast<long long>(agst_age(j));
+      agst_rows.emplace(pair_key, j);
+      agst_ages.emplace(static_cast<int>(agst_age(j)), j);
+    }
+    auto find_id = [&](const StringVector& x, int i) {
+      if (StringVector::is_na(x(i))) return 0;
+      auto found = stage_ids.find(as<std::string>(x(i)));
+      return (found != stage_ids.end()) ? found->second : 0;
+    };
+    auto find_age = [&](const IntegerVector& x, int i) {
+      if (IntegerVector::is_na(x(i))) return 0;
+      return (agst_ages.find(x(i)) != agst_ages.end()) ? static_cast<int>(x(i)) : 0;
+    };
+    auto find_pair = [&](int id, int age) {
+      if (age < 0) return -1;
+      long long pair_key = static_cast<long long>(id) *
+        (static_cast<long long>(INT_MAX) + 1LL) + static_cast<long long>(age);
+      auto found = agst_rows.find(pair_key);
+      return (found != agst_rows.end()) ? found->second : -1;
+    };
+    
     for (int i = 0; i < check_loop_length; i++) {
-      int found_age2 {0};
-      int found_stage3 {0};
-      int found_stage2 {0};
-      
-      int found_estage2 {0};
-      int found_eststage3 {0};
-      int found_eststage2 {0};
-      
-      for (int j = 0; j < agestages_length; j++) {
-        if (agst_stage(j) == new_stage3(i)) found_stage3 = agst_stage_id(j);
-        if (agst_stage(j) == new_stage2(i)) found_stage2 = agst_stage_id(j);
-        if (static_cast<int>(agst_age(j)) == static_cast<int>(new_age2(i))) found_age2 = agst_age(j);
-        
-        if (!IntegerVector::is_na(new_estage2(i))) {
-          new_use_est(i) = 1;
-          if (agst_stage(j) == new_eststage3(i)) found_eststage3 = agst_stage_id(j);
-          if (agst_stage(j) == new_eststage2(i)) found_eststage2 = agst_stage_id(j);
-          if (static_cast<int>(agst_age(j)) == static_cast<int>(new_estage2(i))) found_estage2 = agst_age(j);
-        }
-      }
-      
-      arma::uvec agst_found_stage3of3a2 = find(agst_stage_id == found_stage3);
-      arma::uvec agst_found_stage2of3a2;
-      if (found_age2 < max_age) {
-        agst_found_stage2of3a2= find(agst_age == (found_age2 + 1));
-      } else {
-        agst_found_stage2of3a2= find(agst_age == found_age2);
-      }
-      arma::uvec agst_found_stage2of2a1 = find(agst_stage_id == found_stage2);
-      arma::uvec agst_found_stage1of2a1 = find(agst_age == found_age2);
+      int found_stage3 = find_id(new_stage3, i);
+      int found_stage2 = find_id(new_stage2, i);
+      int found_age2 = find_age(new_age2, i);
+      int found_age3 = (found_age2 < max_age) ? (found_age2 + 1) : found_age2;
       
-      arma::uvec agst_found_stage3a2 = intersect(agst_found_stage3of3a2,
-        agst_found_stage2of3a2);
-      arma::uvec agst_found_stage2a1 = intersect(agst_found_stage2of2a1,
-        agst_found_stage1of2a1);
+      int agst_found_stage3a2 = find_pair(found_stage3, found_age3);
+      int agst_found_stage2a1 = find_pair(found_stage2, found_age2);
       
-      if (agst_found_stage3a2.n_elem > 0 && agst_found_stage2a1.n_elem > 0) {
-        new_col_index(i) = static_cast<int>(agst_found_stage2a1(0));
-        new_row_index(i) = static_cast<int>(agst_found_stage3a2(0));
+      if (agst_found_stage3a2 > -1 && agst_found_stage2a1 > -1) {
+        new_col_index(i) = agst_found_stage2a1;
+        new_row_index(i) = agst_found_stage3a2;
       } else {
         Rf_warningcall(R_NilValue, "Some stage designations could not be found.");
       }
       
-      if (new_use_est(i) == 1) {
-        arma::uvec agst_found_eststage3of3a2 = find(agst_stage_id == found_eststage3);
-        arma::uvec agst_found_eststage2of3a2;
-        if (found_estage2 < max_age) {
-          agst_found_eststage2of3a2 = find(agst_age == (found_estage2 + 1));
-        } else {
-          agst_found_eststage2of3a2 = find(agst_age == found_estage2);
-        }
-        arma::uvec agst_found_eststage2of2a1 = find(agst_stage_id == found_eststage2);
-        arma::uvec agst_found_eststage1of2a1 = find(agst_age == found_estage2);
+      if (!IntegerVector::is_na(new_estage2(i))) {
+        new_use_est(i) = 1;
         
-        arma::uvec agst_found_eststage3a2 = intersect(agst_found_eststage3of3a2,
-        agst_found_eststage2of3a2);
-        arma::uvec agst_found_eststage2a1 = intersect(agst_found_eststage2of2a1,
-        agst_found_eststage1of2a1);
+        int found_eststage3 = find_id(new_eststage3, i);
+        int found_eststage2 = find_id(new_eststage2, i);
+        int found_estage2 = find_age(new_estage2, i);
+        int found_estage3 = (found_estage2 < max_age) ? (found_estage2 + 1) :
+          found_estage2;
         
-        if (agst_found_eststage3a2.n_elem > 0 && agst_found_eststage2a1.n_elem > 0) {
-          new_est_col_index(i) = static_cast<int>(agst_found_eststage2a1(0));
-          new_est_row_index(i) = static_cast<int>(agst_found_eststage3a2(0));
+        int agst_found_eststage3a2 = find_pair(found_eststage3, found_estage3);
+        int agst_found_eststage2a1 = find_pair(found_eststage2, found_estage2);
+        
+        if (agst_found_eststage3a2 > -1 && agst_found_eststage2a1 > -1) {
+          new_est_col_index(i) = agst_found_eststage2a1;
+          new_est_row_index(i) = agst_found_eststage3a2;
         } else {
           Rf_warningcall(R_NilValue, "Some eststage designations could not be found.");
         }
@@ -8555,10 +8576,6 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
   }
   
   // Core matrix editing
-  List A_mats;
-  List U_mats;
-  List F_mats;
-  
   bool A_used {false};
   bool U_used {false};
   bool F_used {false};
@@ -8566,30 +8583,31 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
   bool mat_sparse {false};
   int mat_num {0};
   
+  List A_mats_in;
+  List U_mats_in;
+  List F_mats_in;
+  
   if (mpm.containsElementNamed("A")) {
     if (is<List>(mpm["A"])) {
-      List new_A_mats = as<List>(mpm["A"]);
-      A_mats = clone(new_A_mats);
+      A_mats_in = as<List>(mpm["A"]);
       A_used = true;
-      mat_num = static_cast<int>(A_mats.length());
+      mat_num = static_cast<int>(A_mats_in.length());
       
-      if (is<S4>(A_mats(0))) mat_sparse = true;
+      if (is<S4>(A_mats_in(0))) mat_sparse = true;
     }
     if (is<List>(mpm["U"])) {
-      List new_U_mats = as<List>(mpm["U"]);
-      U_mats = clone(new_U_mats);
+      U_mats_in = as<List>(mpm["U"]);
       U_used = true;
-      mat_num = static_cast<int>(U_mats.length());
+      mat_num = static_cast<int>(U_mats_in.length());
       
-      if (is<S4>(U_mats(0))) mat_sparse = true;
+      if (is<S4>(U_mats_in(0))) mat_sparse = true;
     }
     if (is<List>(mpm["F"])) {
-      List new_F_mats = as<List>(mpm["F"]);
-      F_mats = clone(new_F_mats);
+      F_mats_in = as<List>(mpm["F"]);
       F_used = true;
-      mat_num = static_cast<int>(F_mats.length());
+      mat_num = static_cast<int>(F_mats_in.length());
       
-      if (is<S4>(F_mats(0))) mat_sparse = true;
+      if (is<S4>(F_mats_in(0))) mat_sparse = true;
     }
   }
   
@@ -8597,6 +8615,54 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
     throw Rcpp::exception("This input object does not appear to hold matrices.", false);
   }
   
+  // Output lists share all unedited matrices with the input
+  List A_mats (A_mats_in.length());
+  List U_mats (U_mats_in.length());
+  List F_mats (F_mats_in.length());
+  for (int i = 0; i < static_cast<int>(A_mats_in.length()); i++) A_mats(i) = A_mats_in(i);
+  for (int i = 0; i < static_cast<int>(U_mats_in.length()); i++) U_mats(i) = U_mats_in(i);
+  for (int i = 0; i < static_cast<int>(F_mats_in.length()); i++) F_mats(i) = F_mats_in(i);
+  
+  // Edits go to U and F matrices if both exist, and otherwise to A matrices
+  bool UF_used = U_used && F_used;
+  int num_targets {0};
+  if (UF_used) {
+    num_targets = 2;
+  } else if (A_used) {
+    num_targets = 1;
+  }
+  int num_jobs = num_targets * mat_num;
+  
+  // Matrix access set up before any parallel work
+  std::vector<NumericMatrix> mats_dense;
+  std::vector<LefkoMats::dgc_view> mats_sparse;
+  int mat_dim {0};
+  
+  for (int t = 0; t < num_targets; t++) {
+    const List& current_list = UF_used ? ((t == 0) ? U_mats_in : F_mats_in) : A_mats_in;
+    
+    for (int i = 0; i < mat_num; i++) {
+      int current_rows {0};
+      int current_cols {0};
+      
+      if (!mat_sparse) {
+        mats_dense.push_back(as<NumericMatrix>(current_list(i)));
+        current_rows = mats_dense.back().nrow();
+        current_cols = mats_dense.back().ncol();
+      } else {
+        mats_sparse.emplace_back(current_list, i);
+        current_rows = mats_sparse.back().n_rows;
+        current_cols = mats_sparse.back().n_cols;
+      }
+      
+      if (t == 0 && i == 0) mat_dim = current_rows;
+      if (current_rows != mat_dim || current_cols != mat_dim) {
+        throw Rcpp::exception("All input matrices must be square and of equal dimension.",
+          false);
+      }
+    }
+  }
+  
   StringVector new_pop = as<StringVector>(newsupplement["pop"]);
   StringVector new_patch = as<StringVector>(newsupplement["patch"]);
   StringVector new_year2 = as<StringVector>(newsupplement["year2"]);
@@ -8606,309 +8672,324 @@ void edit_lM_single (List& final_output, const List& mpm, Nullable<RObject> pop
   StringVector labels_year2 = labels["year2"];
   
   int labels_length = static_cast<int>(labels_pop.length());
-  arma::uvec main_labels_index (labels_length, fill::ones);
+  
+  // Label values are coded as integers once, so that each edit selects its
+  // matrices without string comparisons
+  std::unordered_map<std::string, int> pop_codes;
+  std::unordered_map<std::string, int> patch_codes;
+  std::unordered_map<std::string, int> year2_codes;
+  arma::ivec labels_pop_code (labels_length);
+  arma::ivec labels_patch_code (labels_length);
+  arma::ivec labels_year2_code (labels_length);
+  
+  for (int j = 0; j < labels_length; j++) {
+    labels_pop_code(j) = pop_codes.emplace(as<std::string>(labels_pop(j)),
+      static_cast<int>(pop_codes.size())).first->second;
+    labels_patch_code(j) = patch_codes.emplace(as<std::string>(labels_patch(j)),
+      static_cast<int>(patch_codes.size())).first->second;
+    labels_year2_code(j) = year2_codes.emplace(as<std::string>(labels_year2(j)),
+      static_cast<int>(year2_codes.size())).first->second;
+  }
+  
+  // Codes -1 for all values and -2 for values not found in the labels
+  auto supp_code = [](StringVector& x, int i,
+    const std::unordered_map<std::string, int>& codes) {
+    if (StringVector::is_na(x(i)) || x(i) == "NA" || x(i) == "all") return -1;
+    auto found = codes.find(as<std::string>(x(i)));
+    return (found != codes.end()) ? found->second : -2;
+  };
+  
+  std::map<std::vector<int>, std::vector<int>> chosen_cache;
+  
+  // Compiled edits, one record per matrix and element
+  std::vector<int> rec_supp;
+  std::vector<int> rec_target;
+  std::vector<arma::uword> rec_index;
+  std::vector<long long> rec_est_index;
+  std::vector<std::vector<int>> job_records (num_jobs);
   
   int new_supp_length = static_cast<int>(new_col_index_.length());
-  int U_adjustment {0};
-  int F_adjustment {0};
+  arma::uword mat_dim_u = static_cast<arma::uword>(mat_dim);
   
   for (int i = 0; i < new_supp_length; i++) {
-    arma::ivec chosen_pops (labels_length);
-    arma::ivec chosen_patches (labels_length);
-    arma::ivec chosen_year2s (labels_length);
-    chosen_pops.fill(-1);
-    chosen_patches.fill(-1);
-    chosen_year2s.fill(-1);
-    
-    if (StringVector::is_na(new_pop(i)) || new_pop(i) == "NA" || new_pop(i) == "all") {
-      chosen_pops = arma::conv_to<arma::ivec>::from(main_labels_index);
-    } else {
-      for (int j = 0; j < labels_length; j++) {
-        if (new_pop(i) == labels_pop(j)) chosen_pops(j) = j;
-      }
-    }
-    if (StringVector::is_na(new_patch(i)) || new_patch(i) == "NA" || new_patch(i) == "all") {
-      chosen_patches = arma::conv_to<arma::ivec>::from(main_labels_index);
-    } else {
-      for (int j = 0; j < labels_length; j++) {
-        if (new_patch(i) == labels_patch(j)) chosen_patches(j) = j;
-      }
-    }
-    if (StringVector::is_na(new_year2(i)) || new_year2(i) == "NA" || new_year2(i) == "all") {
-      chosen_year2s = arma::conv_to<arma::ivec>::from(main_labels_index);
-    } else {
-      for (int j = 0; j < labels_length; j++) {
-        if (new_year2(i) == labels_year2(j)) chosen_year2s(j) = j;
-      }
-    }
-    
-    arma::uvec pop_indices = find(chosen_pops > -1);
-    arma::uvec patch_indices = find(chosen_patches > -1);
-    arma::uvec year2_indices = find(chosen_year2s > -1);
+    std::vector<int> label_key = {supp_code(new_pop, i, pop_codes),
+      supp_code(new_patch, i, patch_codes), supp_code(new_year2, i, year2_codes)};
     
-    if (pop_indices.n_elem == 0) {
+    if (label_key[0] == -2) {
       Rf_warningcall(R_NilValue,
         "Pop designations could not be found in input MPM.");
     }
-    if (patch_indices.n_elem == 0) {
+    if (label_key[1] == -2) {
       Rf_warningcall(R_NilValue,
         "Patch designations could not be found in input MPM.");
     }
-    if (year2_indices.n_elem == 0) {
+    if (label_key[2] == -2) {
       Rf_warningcall(R_NilValue,
         "Year2 designations could not be found in input MPM.");
     }
     
-    arma::uvec pop_patch_intersect = intersect(pop_indices, patch_indices);
-    arma::uvec chosen_matrices = intersect(pop_patch_intersect, year2_indices);
-    int chosen_matrices_num = static_cast<int>(chosen_matrices.n_elem);
+    auto cached = chosen_cache.find(label_key);
+    if (cached == chosen_cache.end()) {
+      std::vector<int> chosen_matrices;
+      for (int j = 0; j < labels_length; j++) {
+        if ((label_key[0] == -1 || label_key[0] == labels_pop_code(j)) &&
+          (label_key[1] == -1 || label_key[1] == labels_patch_code(j)) &&
+          (label_key[2] == -1 || label_key[2] == labels_year2_code(j))) {
+          chosen_matrices.push_back(j);
+        }
+      }
+      cached = chosen_cache.emplace(label_key, chosen_matrices).first;
+    }
     
-    for (int j = 0; j < chosen_matrices_num; j++) {
-      if (U_used && F_used) {
-        if (!mat_sparse) {
-          arma::mat chosen_U = as<arma::mat>(U_mats(chosen_matrices(j)));
-          arma::mat chosen_F = as<arma::mat>(F_mats(chosen_matrices(j)));
-          
-          if (new_convtype_(i) == 1 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_givenrate_(i))) {
-              if (chosen_U(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                  new_givenrate_(i) != 0.0) {
-                U_adjustment += 1;
-              } else if (chosen_U(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                  new_givenrate_(i) == 0.0) {
-                U_adjustment -= 1;
-              }
-              
-              chosen_U(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-            }
-            if (!NumericVector::is_na(new_offset_(i))) {
-              if (new_offset_(i) != 0.0) {
-                chosen_U(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-                U_adjustment += 1;
-                
-                if (chosen_U(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                  Rf_warningcall(R_NilValue,
-                    "Some numeric offsets have produced negative matrix elements (survival-transition).");
-                }
-              }
-            }
-            if (new_use_est_(i) == 1) {
-              chosen_U(new_row_index_(i), new_col_index_(i)) =
-                chosen_U(new_est_row_index_(i), new_est_col_index_(i));
-            }
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              chosen_U(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-            }
-            
-            U_mats(chosen_matrices(j)) = chosen_U;
-            
-          } else if (new_convtype_(i) == 2 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_givenrate_(i))) {
-              if (chosen_F(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                  new_givenrate_(i) != 0.0) {
-                F_adjustment += 1;
-              } else if (chosen_F(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                  new_givenrate_(i) == 0.0) {
-                F_adjustment -= 1;
-              }
-              chosen_F(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-            }
-            if (!NumericVector::is_na(new_offset_(i))) {
-              if (new_offset_(i) != 0.0) {
-                chosen_F(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-                F_adjustment += 1;
-                
-                if (chosen_F(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                  Rf_warningcall(R_NilValue,
-                    "Some numeric offsets have produced negative matrix elements (fecundity).");
-                }
-              }
-            }
-            if (new_use_est_(i) == 1) {
-              chosen_F(new_row_index_(i), new_col_index_(i)) =
-                chosen_F(new_est_row_index_(i), new_est_col_index_(i));
-            }
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              chosen_F(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-            }
-            
-            F_mats(chosen_matrices(j)) = chosen_F;
-            
-          } else if (new_convtype_(i) == 3 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              
-              double replacement_value = chosen_F(new_row_index_(i), new_col_index_(i)) * new_multiplier_(i);
-              chosen_F(new_row_index_(i), new_col_index_(i)) = replacement_value;
-            }
-            
-            F_mats(chosen_matrices(j)) = chosen_F;
-          }
-          
-        } else {
-          arma::sp_mat chosen_U = as<arma::sp_mat>(U_mats(chosen_matrices(j)));
-          arma::sp_mat chosen_F = as<arma::sp_mat>(F_mats(chosen_matrices(j)));
+    if (new_col_index_(i) == -1 || num_targets == 0) continue;
+    
+    int target {0};
+    if (UF_used) {
+      if (new_convtype_(i) == 1) {
+        target = 0;
+      } else if (new_convtype_(i) == 2 || new_convtype_(i) == 3) {
+        target = 1;
+      } else continue;
+    }
+    
+    arma::uword flat_index = static_cast<arma::uword>(new_row_index_(i)) +
+      static_cast<arma::uword>(new_col_index_(i)) * mat_dim_u;
+    long long est_index {-1};
+    if (new_use_est_(i) == 1) {
+      if (new_est_row_index_(i) == -1 || new_est_col_index_(i) == -1) {
+        if (cached->second.empty()) continue;
+        
+        throw Rcpp::exception("Some proxy elements given by eststage designations could not be found.",
+          false);
+      }
+      est_index = static_cast<long long>(new_est_row_index_(i)) +
+        static_cast<long long>(new_est_col_index_(i)) * static_cast<long long>(mat_dim);
+    }
+    
+    for (int m : cached->second) {
+      if (m >= mat_num) continue;
+      
+      job_records[target * mat_num + m].push_back(static_cast<int>(rec_supp.size()));
+      rec_supp.push_back(i);
+      rec_target.push_back(target);
+      rec_index.push_back(flat_index);
+      rec_est_index.push_back(est_index);
+    }
+  }
+  
+  std::vector<const double*> dense_ptrs;
+  for (int j = 0; j < static_cast<int>(mats_dense.size()); j++) {
+    dense_ptrs.push_back(mats_dense[j].begin());
+  }
+  
+  const double* givenrate_mem = new_givenrate_.begin();
+  const double* offset_mem = new_offset_.begin();
+  const double* multiplier_mem = new_multiplier_.begin();
+  const int* convtype_mem = new_convtype_.begin();
+  
+  std::vector<arma::mat> dense_out (mat_sparse ? 0 : num_jobs);
+  std::vector<arma::sp_mat> sparse_out (mat_sparse ? num_jobs : 0);
+  std::vector<int> job_adjustment (num_jobs, 0);
+  std::vector<int> rec_negative (rec_supp.size(), 0);
+  
+  // Applies one compiled record to an element, given the proxy element value
+  auto edit_value = [&](int r, double& value, const double* est_value,
+    int& adjustment, int& negative) {
+    int i = rec_supp[r];
+    
+    if (UF_used && convtype_mem[i] == 3) {
+      if (!NumericVector::is_na(multiplier_mem[i])) value *= multiplier_mem[i];
+      return;
+    }
+    
+    if (!NumericVector::is_na(givenrate_mem[i])) {
+      if (value == 0.0 && givenrate_mem[i] != 0.0) {
+        adjustment += 1;
+      } else if (value != 0.0 && givenrate_mem[i] == 0.0) {
+        adjustment -= 1;
+      }
+      value = givenrate_mem[i];
+    }
+    if (!NumericVector::is_na(offset_mem[i])) {
+      if (offset_mem[i] != 0.0) {
+        value += offset_mem[i];
+        adjustment += 1;
+        
+        if (value < 0.0) negative = 1;
+      }
+    }
+    if (est_value != nullptr) value = *est_value;
+    if (!NumericVector::is_na(multiplier_mem[i])) value *= multiplier_mem[i];
+  };
+  
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int job = 0; job < num_jobs; job++) {
+    const std::vector<int>& records = job_records[job];
+    if (records.empty()) continue;
+    
+    if (!mat_sparse) {
+      dense_out[job] = arma::mat(dense_ptrs[job], mat_dim, mat_dim);
+      double* values = dense_out[job].memptr();
+      
+      for (int r : records) {
+        const double* est_value = (rec_est_index[r] > -1) ?
+          (values + rec_est_index[r]) : nullptr;
+        edit_value(r, values[rec_index[r]], est_value, job_adjustment[job],
+          rec_negative[r]);
+      }
+    } else {
+      const LefkoMats::dgc_view& current_mat = mats_sparse[job];
+      
+      // Working copies of all elements read or written by this matrix's edits
+      std::vector<arma::uword> touched;
+      for (int r : records) {
+        touched.push_back(rec_index[r]);
+        if (rec_est_index[r] > -1) {
+          touched.push_back(static_cast<arma::uword>(rec_est_index[r]));
+        }
+      }
+      std::sort(touched.begin(), touched.end());
+      touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+      
+      arma::uvec touched_vec (touched);
+      arma::vec working = current_mat.gather(touched_vec);
+      double* working_mem = working.memptr();
+      
+      auto working_pos = [&](arma::uword index) {
+        return static_cast<int>(std::lower_bound(touched.begin(), touched.end(),
+          index) - touched.begin());
+      };
+      
+      for (int r : records) {
+        const double* est_value = (rec_est_index[r] > -1) ?
+          (working_mem + working_pos(static_cast<arma::uword>(rec_est_index[r]))) :
+          nullptr;
+        edit_value(r, working_mem[working_pos(rec_index[r])], est_value,
+          job_adjustment[job], rec_negative[r]);
+      }
+      
+      // Untouched elements are kept, and touched elements are replaced
+      std::vector<arma::uword> out_rows;
+      std::vector<arma::uword> out_cols;
+      std::vector<double> out_vals;
+      out_rows.reserve(current_mat.n_nonzero + touched.size());
+      out_cols.reserve(current_mat.n_nonzero + touched.size());
+      out_vals.reserve(current_mat.n_nonzero + touched.size());
+      
+      for (int c = 0; c < current_mat.n_cols; c++) {
+        for (int k = current_mat.col_ptr[c]; k < current_mat.col_ptr[c+1]; k++) {
+          arma::uword linear = static_cast<arma::uword>(c) * mat_dim_u +
+            static_cast<arma::uword>(current_mat.row_idx[k]);
           
-          if (new_convtype_(i) == 1 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_givenrate_(i))) {
-              if (chosen_U(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                  new_givenrate_(i) != 0.0) {
-                U_adjustment += 1;
-              } else if (chosen_U(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                  new_givenrate_(i) == 0.0) {
-                U_adjustment -= 1;
-              }
-              chosen_U(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-            }
-            if (!NumericVector::is_na(new_offset_(i))) {
-              if (new_offset_(i) != 0.0) {
-                chosen_U(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-                U_adjustment += 1;
-                
-                if (chosen_U(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                  Rf_warningcall(R_NilValue,
-                    "Some numeric offsets have produced negative matrix elements (survival-transition).");
-                }
-              }
-            }
-            if (new_use_est_(i) == 1) {
-              chosen_U(new_row_index_(i), new_col_index_(i)) =
-                chosen_U(new_est_row_index_(i), new_est_col_index_(i));
-            }
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              chosen_U(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-            }
-            
-            U_mats(chosen_matrices(j)) = chosen_U;
-            
-          } else if (new_convtype_(i) == 2 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_givenrate_(i))) {
-              if (chosen_F(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                  new_givenrate_(i) != 0.0) {
-                F_adjustment += 1;
-              } else if (chosen_F(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                  new_givenrate_(i) == 0.0) {
-                F_adjustment -= 1;
-              }
-              chosen_F(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-            }
-            if (!NumericVector::is_na(new_offset_(i))) {
-              if (new_offset_(i) != 0.0) {
-                chosen_F(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-                F_adjustment += 1;
-                
-                if (chosen_F(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                  Rf_warningcall(R_NilValue,
-                    "Some numeric offsets have produced negative matrix elements (fecundity).");
-                }
-              }
-            }
-            if (new_use_est_(i) == 1) {
-              chosen_F(new_row_index_(i), new_col_index_(i)) =
-                chosen_F(new_est_row_index_(i), new_est_col_index_(i));
-            }
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              chosen_F(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-            }
-            
-            F_mats(chosen_matrices(j)) = chosen_F;
-            
-          } else if (new_convtype_(i) == 3 && new_col_index_(i) != -1) {
-            if (!NumericVector::is_na(new_multiplier_(i))) {
-              chosen_F(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-            }
-            
-            F_mats(chosen_matrices(j)) = chosen_F;
+          if (!std::binary_search(touched.begin(), touched.end(), linear)) {
+            out_rows.push_back(static_cast<arma::uword>(current_mat.row_idx[k]));
+            out_cols.push_back(static_cast<arma::uword>(c));
+            out_vals.push_back(current_mat.values[k]);
           }
         }
-      } else if (A_used) {
-        if (!mat_sparse) {
-          arma::mat chosen_A = as<arma::mat>(A_mats(chosen_matrices(j)));
-          
-          if (!NumericVector::is_na(new_givenrate_(i)) && new_col_index_(i) != -1) {
-            if (chosen_A(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                new_givenrate_(i) != 0.0) {
-              U_adjustment += 1;
-            } else if (chosen_A(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                new_givenrate_(i) == 0.0) {
-              U_adjustment -= 1;
-            }
-            chosen_A(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-          }
-          if (!NumericVector::is_na(new_offset_(i))) {
-            if (new_offset_(i) != 0.0) {
-              chosen_A(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-              U_adjustment += 1;
-              
-              if (chosen_A(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                Rf_warningcall(R_NilValue,
-                  "Some numeric offsets have produced negative matrix elements.");
-              }
-            }
-          }
-          if (new_use_est_(i) == 1) {
-            chosen_A(new_row_index_(i), new_col_index_(i)) =
-              chosen_A(new_est_row_index_(i), new_est_col_index_(i));
-          }
-          if (!NumericVector::is_na(new_multiplier_(i)) && new_col_index_(i) != -1) {
-            chosen_A(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-          }
-          
-          A_mats(chosen_matrices(j)) = chosen_A;
-          
-        } else {
-          arma::sp_mat chosen_A = as<arma::sp_mat>(A_mats(chosen_matrices(j)));
-          
-          if (!NumericVector::is_na(new_givenrate_(i)) && new_col_index_(i) != -1) {
-            if (chosen_A(new_row_index_(i), new_col_index_(i)) == 0.0 &&
-                new_givenrate_(i) != 0.0) {
-              U_adjustment += 1;
-            } else if (chosen_A(new_row_index_(i), new_col_index_(i)) != 0.0 &&
-                new_givenrate_(i) == 0.0) {
-              U_adjustment -= 1;
-            }
-            chosen_A(new_row_index_(i), new_col_index_(i)) = new_givenrate_(i);
-          }
-          if (!NumericVector::is_na(new_offset_(i))) {
-            if (new_offset_(i) != 0.0) {
-              chosen_A(new_row_index_(i), new_col_index_(i)) += new_offset_(i);
-              U_adjustment += 1;
-              
-              if (chosen_A(new_row_index_(i), new_col_index_(i)) < 0.0) {
-                Rf_warningcall(R_NilValue,
-                  "Some numeric offsets have produced negative matrix elements.");
-              }
-            }
-          }
-          if (new_use_est_(i) == 1) {
-            chosen_A(new_row_index_(i), new_col_index_(i)) =
-              chosen_A(new_est_row_index_(i), new_est_col_index_(i));
-          }
-          if (!NumericVector::is_na(new_multiplier_(i)) && new_col_index_(i) != -1) {
-            chosen_A(new_row_index_(i), new_col_index_(i)) *= new_multiplier_(i);
-          }
-          
-          A_mats(chosen_matrices(j)) = chosen_A;
+      }
+      for (int k = 0; k < static_cast<int>(touched.size()); k++) {
+        if (working_mem[k] != 0.0) {
+          out_rows.push_back(touched[k] % mat_dim_u);
+          out_cols.push_back(touched[k] / mat_dim_u);
+          out_vals.push_back(working_mem[k]);
         }
       }
+      
+      arma::umat locations (2, out_vals.size());
+      for (int k = 0; k < static_cast<int>(out_vals.size()); k++) {
+        locations(0, k) = out_rows[k];
+        locations(1, k) = out_cols[k];
+      }
+      sparse_out[job] = arma::sp_mat(locations, arma::vec(out_vals), mat_dim,
+        mat_dim);
     }
   }
   
-  if (U_used && F_used) {
+  // A matrices are rebuilt as sums of U and F matrices
+  std::vector<arma::mat> A_dense_out (UF_used && !mat_sparse ? mat_num : 0);
+  std::vector<arma::sp_mat> A_sparse_out (UF_used && mat_sparse ? mat_num : 0);
+  
+  if (UF_used) {
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
     for (int i = 0; i < mat_num; i++) {
-      if (!mat_sparse) { 
-        arma::mat current_U = as<arma::mat>(U_mats(i));
-        arma::mat current_F = as<arma::mat>(F_mats(i));
-        arma::mat current_A = current_U + current_F;
-        A_mats(i) = current_A;
+      int U_job = i;
+      int F_job = mat_num + i;
+      
+      if (!mat_sparse) {
+        const double* U_mem = job_records[U_job].empty() ? dense_ptrs[U_job] :
+          dense_out[U_job].memptr();
+        const double* F_mem = job_records[F_job].empty() ? dense_ptrs[F_job] :
+          dense_out[F_job].memptr();
+        
+        A_dense_out[i].set_size(mat_dim, mat_dim);
+        double* A_mem = A_dense_out[i].memptr();
+        arma::uword total_elems = mat_dim_u * mat_dim_u;
+        for (arma::uword k = 0; k < total_elems; k++) A_mem[k] = U_mem[k] + F_mem[k];
+        
       } else {
-        arma::sp_mat current_U = as<arma::sp_mat>(U_mats(i));
-        arma::sp_mat current_F = as<arma::sp_mat>(F_mats(i));
-        arma::sp_mat current_A = current_U + current_F;
-        A_mats(i) = current_A;
+        arma::sp_mat current_U = job_records[U_job].empty() ?
+          mats_sparse[U_job].sp() : sparse_out[U_job];
+        arma::sp_mat current_F = job_records[F_job].empty() ?
+          mats_sparse[F_job].sp() : sparse_out[F_job];
+        A_sparse_out[i] = current_U + current_F;
       }
     }
   }
   
+  int U_adjustment {0};
+  int F_adjustment {0};
+  
+  for (int job = 0; job < num_jobs; job++) {
+    int target = job / mat_num;
+    int i = job % mat_num;
+    
+    if (target == 0) {
+      U_adjustment += job_adjustment[job];
+    } else {
+      F_adjustment += job_adjustment[job];
+    }
+    
+    if (job_records[job].empty()) continue;
+    
+    List& current_list = UF_used ? ((target == 0) ? U_mats : F_mats) : A_mats;
+    if (!mat_sparse) {
+      current_list(i) = dense_out[job];
+    } else {
+      current_list(i) = sparse_out[job];
+    }
+  }
+  
+  if (UF_used) {
+    for (int i = 0; i < mat_num; i++) {
+      if (!mat_sparse) {
+        A_mats(i) = A_dense_out[i];
+      } else {
+        A_mats(i) = A_sparse_out[i];
+      }
+    }
+  }
+  
+  // Warnings issued in order, once per supplement row and matrix affected
+  for (int r = 0; r < static_cast<int>(rec_supp.size()); r++) {
+    if (rec_negative[r] == 0) continue;
+    
+    if (!UF_used) {
+      Rf_warningcall(R_NilValue,
+        "Some numeric offsets have produced negative matrix elements.");
+    } else if (rec_target[r] == 0) {
+      Rf_warningcall(R_NilValue,
+        "Some numeric offsets have produced negative matrix elements (survival-transition).");
+    } else {
+      Rf_warningcall(R_NilValue,
+        "Some numeric offsets have produced negative matrix elements (fecundity).");
+    }
+  }
+  
   IntegerVector dataqc;
   if (mpm.containsElementNamed("dataqc")) {
     dataqc = as<IntegerVector>(mpm["dataqc"]);
@@ -9119,7 +9200,43 @@ Rcpp::List edit_lM (const RObject mpm, Nullable<RObject> pop = R_NilValue,
     int mpmlist_length = static_cast<int>(mpm_list.length());
     List semifinal_output (mpmlist_length);
     
+    LogicalVector mpm_targeted (mpmlist_length, true);
+    if (target_mpm.isNotNull()) {
+      RObject target_mpm_ = RObject(target_mpm);
+      
+      if (is<StringVector>(target_mpm_)) {
+        StringVector target_mpm_str = as<StringVector>(target_mpm_);
+        
+        for (int i = 0; i < static_cast<int>(target_mpm_str.length()); i++) {
+          if (!stringcompare_simple(as<std::string>(target_mpm_str(i)), "all", true)) {
+            throw Rcpp::exception("Argument target_mpm must be \"all\" or a vector of integers.",
+              false);
+          }
+        }
+      } else if (is<NumericVector>(target_mpm_) || is<IntegerVector>(target_mpm_)) {
+        IntegerVector target_mpm_int = as<IntegerVector>(target_mpm_);
+        mpm_targeted.fill(false);
+        
+        for (int i = 0; i < static_cast<int>(target_mpm_int.length()); i++) {
+          if (IntegerVector::is_na(target_mpm_int(i)) || target_mpm_int(i) < 1 ||
+              target_mpm_int(i) > mpmlist_length) {
+            throw Rcpp::exception("Entries in argument target_mpm must refer to MPMs in the input lefkoMatList.",
+              false);
+          }
+          mpm_targeted(target_mpm_int(i) - 1) = true;
+        }
+      } else {
+        throw Rcpp::exception("Argument target_mpm must be \"all\" or a vector of integers.",
+          false);
+      }
+    }
+    
     for (int i = 0; i < mpmlist_length; i++) {
+      if (!mpm_targeted(i)) {
+        semifinal_output(i) = mpm_list(i);
+        continue;
+      }
+      
       List single_elem_output;
       List current_mpm = as<List>(mpm_list(i));
       edit_lM_single(single_elem_output, current_mpm, pop, patch, year2, stage3,
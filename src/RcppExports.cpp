@@ -163,31 +163,26 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// hoffmannofstuttgart
-Rcpp::List hoffmannofstuttgart(arma::mat& mainmat, DataFrame indices, int ahstages, StringVector stagenames);
-RcppExport SEXP _lefko3_hoffmannofstuttgart(SEXP mainmatSEXP, SEXP indicesSEXP, SEXP ahstagesSEXP, SEXP stagenamesSEXP) {
+// write_lefko
+double write_lefko(RObject object, String file);
+RcppExport SEXP _lefko3_write_lefko(SEXP objectSEXP, SEXP fileSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< arma::mat& >::type mainmat(mainmatSEXP);
-    Rcpp::traits::input_parameter< DataFrame >::type indices(indicesSEXP);
-    Rcpp::traits::input_parameter< int >::type ahstages(ahstagesSEXP);
-    Rcpp::traits::input_parameter< StringVector >::type stagenames(stagenamesSEXP);
-    rcpp_result_gen = Rcpp::wrap(hoffmannofstuttgart(mainmat, indices, ahstages, stagenames));
+    Rcpp::traits::input_parameter< RObject >::type object(objectSEXP);
+    Rcpp::traits::input_parameter< String >::type file(fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(write_lefko(object, file));
     return rcpp_result_gen;
 END_RCPP
 }
-// hoffmannofstuttgart_sp
-Rcpp::List hoffmannofstuttgart_sp(arma::sp_mat& mainmat, DataFrame indices, int ahstages, StringVector stagenames);
-RcppExport SEXP _lefko3_hoffmannofstuttgart_sp(SEXP mainmatSEXP, SEXP indicesSEXP, SEXP ahstagesSEXP, SEXP stagenamesSEXP) {
+// read_lefko
+RObject read_lefko(String file);
+RcppExport SEXP _lefko3_read_lefko(SEXP fileSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< arma::sp_mat& >::type mainmat(mainmatSEXP);
-    Rcpp::traits::input_parameter< DataFrame >::type indices(indicesSEXP);
-    Rcpp::traits::input_parameter< int >::type ahstages(ahstagesSEXP);
-    Rcpp::traits::input_parameter< StringVector >::type stagenames(stagenamesSEXP);
-    rcpp_result_gen = Rcpp::wrap(hoffmannofstuttgart_sp(mainmat, indices, ahstages, stagenames));
+    Rcpp::traits::input_parameter< String >::type file(fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_lefko(file));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -348,15 +343,17 @@ BEGIN_RCPP
 END_RCPP
 }
 // hist_null
-Rcpp::List hist_null(RObject mpm, int format, bool err_check);
-RcppExport SEXP _lefko3_hist_null(SEXP mpmSEXP, SEXP formatSEXP, SEXP err_checkSEXP) {
+Rcpp::List hist_null(RObject mpm, int format, bool err_check, bool sparse_output, bool as_operator);
+RcppExport SEXP _lefko3_hist_null(SEXP mpmSEXP, SEXP formatSEXP, SEXP err_checkSEXP, SEXP sparse_outputSEXP, SEXP as_operatorSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< RObject >::type mpm(mpmSEXP);
     Rcpp::traits::input_parameter< int >::type format(formatSEXP);
     Rcpp::traits::input_parameter< bool >::type err_check(err_checkSEXP);
-    rcpp_result_gen = Rcpp::wrap(hist_null(mpm, format, err_check));
+    Rcpp::traits::input_parameter< bool >::type sparse_output(sparse_outputSEXP);
+    Rcpp::traits::input_parameter< bool >::type as_operator(as_operatorSEXP);
+    rcpp_result_gen = Rcpp::wrap(hist_null(mpm, format, err_check, sparse_output, as_operator));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -374,14 +371,14 @@ BEGIN_RCPP
 END_RCPP
 }
 // add_stage
-Rcpp::List add_stage(const RObject mpm, int add_before, int add_after, Nullable<CharacterVector> stage_name);
+Rcpp::List add_stage(const RObject mpm, Nullable<IntegerVector> add_before, Nullable<IntegerVector> add_after, Nullable<CharacterVector> stage_name);
 RcppExport SEXP _lefko3_add_stage(SEXP mpmSEXP, SEXP add_beforeSEXP, SEXP add_afterSEXP, SEXP stage_nameSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const RObject >::type mpm(mpmSEXP);
-    Rcpp::traits::input_parameter< int >::type add_before(add_beforeSEXP);
-    Rcpp::traits::input_parameter< int >::type add_after(add_afterSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type add_before(add_beforeSEXP);
+    Rcpp::traits::input_parameter< Nullable<IntegerVector> >::type add_after(add_afterSEXP);
     Rcpp::traits::input_parameter< Nullable<CharacterVector> >::type stage_name(stage_nameSEXP);
     rcpp_result_gen = Rcpp::wrap(add_stage(mpm, add_before, add_after, stage_name));
     return rcpp_result_gen;
@@ -694,8 +691,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // proj3
-arma::mat proj3(const arma::vec& start_vec, const List& core_list, const arma::uvec& mat_order, bool standardize, bool growthonly, bool integeronly, bool sparse_auto, bool sparse);
-RcppExport SEXP _lefko3_proj3(SEXP start_vecSEXP, SEXP core_listSEXP, SEXP mat_orderSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP, SEXP sparse_autoSEXP, SEXP sparseSEXP) {
+arma::mat proj3(const arma::vec& start_vec, const List& core_list, const arma::uvec& mat_order, bool standardize, bool growthonly, bool integeronly, bool sparse_auto, bool sparse, double conv_tol, bool calc_v);
+RcppExport SEXP _lefko3_proj3(SEXP start_vecSEXP, SEXP core_listSEXP, SEXP mat_orderSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP, SEXP sparse_autoSEXP, SEXP sparseSEXP, SEXP conv_tolSEXP, SEXP calc_vSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -707,13 +704,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type integeronly(integeronlySEXP);
     Rcpp::traits::input_parameter< bool >::type sparse_auto(sparse_autoSEXP);
     Rcpp::traits::input_parameter< bool >::type sparse(sparseSEXP);
-    rcpp_result_gen = Rcpp::wrap(proj3(start_vec, core_list, mat_order, standardize, growthonly, integeronly, sparse_auto, sparse));
+    Rcpp::traits::input_parameter< double >::type conv_tol(conv_tolSEXP);
+    Rcpp::traits::input_parameter< bool >::type calc_v(calc_vSEXP);
+    rcpp_result_gen = Rcpp::wrap(proj3(start_vec, core_list, mat_order, standardize, growthonly, integeronly, sparse_auto, sparse, conv_tol, calc_v));
     return rcpp_result_gen;
 END_RCPP
 }
 // proj3sp
-arma::mat proj3sp(const arma::vec& start_vec, const List& core_list, const arma::uvec& mat_order, bool standardize, bool growthonly, bool integeronly);
-RcppExport SEXP _lefko3_proj3sp(SEXP start_vecSEXP, SEXP core_listSEXP, SEXP mat_orderSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP) {
+arma::mat proj3sp(const arma::vec& start_vec, const List& core_list, const arma::uvec& mat_order, bool standardize, bool growthonly, bool integeronly, double conv_tol, bool calc_v);
+RcppExport SEXP _lefko3_proj3sp(SEXP start_vecSEXP, SEXP core_listSEXP, SEXP mat_orderSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP, SEXP conv_tolSEXP, SEXP calc_vSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -723,13 +722,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type standardize(standardizeSEXP);
     Rcpp::traits::input_parameter< bool >::type growthonly(growthonlySEXP);
     Rcpp::traits::input_parameter< bool >::type integeronly(integeronlySEXP);
-    rcpp_result_gen = Rcpp::wrap(proj3sp(start_vec, core_list, mat_order, standardize, growthonly, integeronly));
+    Rcpp::traits::input_parameter< double >::type conv_tol(conv_tolSEXP);
+    Rcpp::traits::input_parameter< bool >::type calc_v(calc_vSEXP);
+    rcpp_result_gen = Rcpp::wrap(proj3sp(start_vec, core_list, mat_order, standardize, growthonly, integeronly, conv_tol, calc_v));
     return rcpp_result_gen;
 END_RCPP
 }
 // projection3
-Rcpp::List projection3(const List& mpm, int nreps, int times, bool historical, bool stochastic, bool standardize, bool growthonly, bool integeronly, int substoch, double exp_tol, bool sub_warnings, bool quiet, Nullable<IntegerVector> year, Nullable<NumericVector> start_vec, Nullable<DataFrame> start_frame, Nullable<RObject> tweights, Nullable<RObject> density, Nullable<RObject> stage_weights, Nullable<RObject> sparse);
-RcppExport SEXP _lefko3_projection3(SEXP mpmSEXP, SEXP nrepsSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP stochasticSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP, SEXP substochSEXP, SEXP exp_tolSEXP, SEXP sub_warningsSEXP, SEXP quietSEXP, SEXP yearSEXP, SEXP start_vecSEXP, SEXP start_frameSEXP, SEXP tweightsSEXP, SEXP densitySEXP, SEXP stage_weightsSEXP, SEXP sparseSEXP) {
+Rcpp::List projection3(const List& mpm, int nreps, int times, bool historical, bool stochastic, bool standardize, bool growthonly, bool integeronly, int substoch, double exp_tol, bool sub_warnings, bool quiet, Nullable<IntegerVector> year, Nullable<NumericVector> start_vec, Nullable<DataFrame> start_frame, Nullable<RObject> tweights, Nullable<RObject> density, Nullable<RObject> stage_weights, Nullable<RObject> sparse, bool periodic, double conv_tol, bool demostoch, double quasi_ext);
+RcppExport SEXP _lefko3_projection3(SEXP mpmSEXP, SEXP nrepsSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP stochasticSEXP, SEXP standardizeSEXP, SEXP growthonlySEXP, SEXP integeronlySEXP, SEXP substochSEXP, SEXP exp_tolSEXP, SEXP sub_warningsSEXP, SEXP quietSEXP, SEXP yearSEXP, SEXP start_vecSEXP, SEXP start_frameSEXP, SEXP tweightsSEXP, SEXP densitySEXP, SEXP stage_weightsSEXP, SEXP sparseSEXP, SEXP periodicSEXP, SEXP conv_tolSEXP, SEXP demostochSEXP, SEXP quasi_extSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -752,13 +753,38 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Nullable<RObject> >::type density(densitySEXP);
     Rcpp::traits::input_parameter< Nullable<RObject> >::type stage_weights(stage_weightsSEXP);
     Rcpp::traits::input_parameter< Nullable<RObject> >::type sparse(sparseSEXP);
-    rcpp_result_gen = Rcpp::wrap(projection3(mpm, nreps, times, historical, stochastic, standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings, quiet, year, start_vec, start_frame, tweights, density, stage_weights, sparse));
+    Rcpp::traits::input_parameter< bool >::type periodic(periodicSEXP);
+    Rcpp::traits::input_parameter< double >::type conv_tol(conv_tolSEXP);
+    Rcpp::traits::input_parameter< bool >::type demostoch(demostochSEXP);
+    Rcpp::traits::input_parameter< double >::type quasi_ext(quasi_extSEXP);
+    rcpp_result_gen = Rcpp::wrap(projection3(mpm, nreps, times, historical, stochastic, standardize, growthonly, integeronly, substoch, exp_tol, sub_warnings, quiet, year, start_vec, start_frame, tweights, density, stage_weights, sparse, periodic, conv_tol, demostoch, quasi_ext));
+    return rcpp_result_gen;
+END_RCPP
+}
+// equilibrium3
+Rcpp::List equilibrium3(const List& mpm, const RObject& density, bool historical, Nullable<NumericVector> start_vec, Nullable<DataFrame> start_frame, Nullable<RObject> stage_weights, int substoch, double exp_tol, int anderson, double tol, int max_iter);
+RcppExport SEXP _lefko3_equilibrium3(SEXP mpmSEXP, SEXP densitySEXP, SEXP historicalSEXP, SEXP start_vecSEXP, SEXP start_frameSEXP, SEXP stage_weightsSEXP, SEXP substochSEXP, SEXP exp_tolSEXP, SEXP andersonSEXP, SEXP tolSEXP, SEXP max_iterSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const List& >::type mpm(mpmSEXP);
+    Rcpp::traits::input_parameter< const RObject& >::type density(densitySEXP);
+    Rcpp::traits::input_parameter< bool >::type historical(historicalSEXP);
+    Rcpp::traits::input_parameter< Nullable<NumericVector> >::type start_vec(start_vecSEXP);
+    Rcpp::traits::input_parameter< Nullable<DataFrame> >::type start_frame(start_frameSEXP);
+    Rcpp::traits::input_parameter< Nullable<RObject> >::type stage_weights(stage_weightsSEXP);
+    Rcpp::traits::input_parameter< int >::type substoch(substochSEXP);
+    Rcpp::traits::input_parameter< double >::type exp_tol(exp_tolSEXP);
+    Rcpp::traits::input_parameter< int >::type anderson(andersonSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    rcpp_result_gen = Rcpp::wrap(equilibrium3(mpm, density, historical, start_vec, start_frame, stage_weights, substoch, exp_tol, anderson, tol, max_iter));
     return rcpp_result_gen;
 END_RCPP
 }
 // slambda3
-DataFrame slambda3(const List& mpm, int times, bool historical, Nullable<RObject> tweights, Nullable<RObject> force_sparse);
-RcppExport SEXP _lefko3_slambda3(SEXP mpmSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP tweightsSEXP, SEXP force_sparseSEXP) {
+DataFrame slambda3(const List& mpm, int times, bool historical, Nullable<RObject> tweights, Nullable<RObject> force_sparse, int chains, double se_tol, bool sna);
+RcppExport SEXP _lefko3_slambda3(SEXP mpmSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP tweightsSEXP, SEXP force_sparseSEXP, SEXP chainsSEXP, SEXP se_tolSEXP, SEXP snaSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -767,13 +793,16 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type historical(historicalSEXP);
     Rcpp::traits::input_parameter< Nullable<RObject> >::type tweights(tweightsSEXP);
     Rcpp::traits::input_parameter< Nullable<RObject> >::type force_sparse(force_sparseSEXP);
-    rcpp_result_gen = Rcpp::wrap(slambda3(mpm, times, historical, tweights, force_sparse));
+    Rcpp::traits::input_parameter< int >::type chains(chainsSEXP);
+    Rcpp::traits::input_parameter< double >::type se_tol(se_tolSEXP);
+    Rcpp::traits::input_parameter< bool >::type sna(snaSEXP);
+    rcpp_result_gen = Rcpp::wrap(slambda3(mpm, times, historical, tweights, force_sparse, chains, se_tol, sna));
     return rcpp_result_gen;
 END_RCPP
 }
 // stoch_senselas
-Rcpp::List stoch_senselas(const List& mpm, int times, bool historical, int style, int sparse, bool lefkoProj, Nullable<RObject> tweights);
-RcppExport SEXP _lefko3_stoch_senselas(SEXP mpmSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP styleSEXP, SEXP sparseSEXP, SEXP lefkoProjSEXP, SEXP tweightsSEXP) {
+Rcpp::List stoch_senselas(const List& mpm, int times, bool historical, int style, int sparse, bool lefkoProj, Nullable<RObject> tweights, int checkpoint, bool sna);
+RcppExport SEXP _lefko3_stoch_senselas(SEXP mpmSEXP, SEXP timesSEXP, SEXP historicalSEXP, SEXP styleSEXP, SEXP sparseSEXP, SEXP lefkoProjSEXP, SEXP tweightsSEXP, SEXP checkpointSEXP, SEXP snaSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -784,13 +813,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type sparse(sparseSEXP);
     Rcpp::traits::input_parameter< bool >::type lefkoProj(lefkoProjSEXP);
     Rcpp::traits::input_parameter< Nullable<RObject> >::type tweights(tweightsSEXP);
-    rcpp_result_gen = Rcpp::wrap(stoch_senselas(mpm, times, historical, style, sparse, lefkoProj, tweights));
+    Rcpp::traits::input_parameter< int >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< bool >::type sna(snaSEXP);
+    rcpp_result_gen = Rcpp::wrap(stoch_senselas(mpm, times, historical, style, sparse, lefkoProj, tweights, checkpoint, sna));
     return rcpp_result_gen;
 END_RCPP
 }
 // ltre3matrix
-Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum, Nullable<Rcpp::List> refmats_, bool mean, bool sparse);
-RcppExport SEXP _lefko3_ltre3matrix(SEXP AmatsSEXP, SEXP refnumSEXP, SEXP refmats_SEXP, SEXP meanSEXP, SEXP sparseSEXP) {
+Rcpp::List ltre3matrix(const List& Amats, Rcpp::IntegerVector refnum, Nullable<Rcpp::List> refmats_, bool mean, bool sparse, bool approx);
+RcppExport SEXP _lefko3_ltre3matrix(SEXP AmatsSEXP, SEXP refnumSEXP, SEXP refmats_SEXP, SEXP meanSEXP, SEXP sparseSEXP, SEXP approxSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -799,7 +830,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Nullable<Rcpp::List> >::type refmats_(refmats_SEXP);
     Rcpp::traits::input_parameter< bool >::type mean(meanSEXP);
     Rcpp::traits::input_parameter< bool >::type sparse(sparseSEXP);
-    rcpp_result_gen = Rcpp::wrap(ltre3matrix(Amats, refnum, refmats_, mean, sparse));
+    Rcpp::traits::input_parameter< bool >::type approx(approxSEXP);
+    rcpp_result_gen = Rcpp::wrap(ltre3matrix(Amats, refnum, refmats_, mean, sparse, approx));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -942,6 +974,29 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// glm_dredge
+Rcpp::List glm_dredge(const DataFrame& data, String response, const CharacterVector& term_labels, const CharacterVector& ran_vars, int dist, bool truncz, bool zero, String criterion, bool dredge, bool bestfit_k, bool null_model, int max_iter, double tol);
+RcppExport SEXP _lefko3_glm_dredge(SEXP dataSEXP, SEXP responseSEXP, SEXP term_labelsSEXP, SEXP ran_varsSEXP, SEXP distSEXP, SEXP trunczSEXP, SEXP zeroSEXP, SEXP criterionSEXP, SEXP dredgeSEXP, SEXP bestfit_kSEXP, SEXP null_modelSEXP, SEXP max_iterSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const DataFrame& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< String >::type response(responseSEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type term_labels(term_labelsSEXP);
+    Rcpp::traits::input_parameter< const CharacterVector& >::type ran_vars(ran_varsSEXP);
+    Rcpp::traits::input_parameter< int >::type dist(distSEXP);
+    Rcpp::traits::input_parameter< bool >::type truncz(trunczSEXP);
+    Rcpp::traits::input_parameter< bool >::type zero(zeroSEXP);
+    Rcpp::traits::input_parameter< String >::type criterion(criterionSEXP);
+    Rcpp::traits::input_parameter< bool >::type dredge(dredgeSEXP);
+    Rcpp::traits::input_parameter< bool >::type bestfit_k(bestfit_kSEXP);
+    Rcpp::traits::input_parameter< bool >::type null_model(null_modelSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(glm_dredge(data, response, term_labels, ran_vars, dist, truncz, zero, criterion, dredge, bestfit_k, null_model, max_iter, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
 // sf_create
 Rcpp::List sf_create(NumericVector sizes, Nullable<StringVector> stagenames, Nullable<NumericVector> sizesb, Nullable<NumericVector> sizesc, Nullable<IntegerVector> repstatus, Nullable<IntegerVector> obsstatus, Nullable<IntegerVector> propstatus, Nullable<IntegerVector> matstatus, Nullable<IntegerVector> immstatus, Nullable<NumericVector> minage, Nullable<NumericVector> maxage, Nullable<IntegerVector> indataset, Nullable<NumericVector> sizemin, Nullable<NumericVector> sizebmin, Nullable<NumericVector> sizecmin, Nullable<NumericVector> sizemax, Nullable<NumericVector> sizebmax, Nullable<NumericVector> sizecmax, Nullable<NumericVector> binhalfwidth, Nullable<NumericVector> binhalfwidthb, Nullable<NumericVector> binhalfwidthc, Nullable<IntegerVector> group, Nullable<StringVector> comments, int roundsize, int roundsizeb, int roundsizec, int ipmbins, int ipmbinsb, int ipmbinsc);
 RcppExport SEXP _lefko3_sf_create(SEXP sizesSEXP, SEXP stagenamesSEXP, SEXP sizesbSEXP, SEXP sizescSEXP, SEXP repstatusSEXP, SEXP obsstatusSEXP, SEXP propstatusSEXP, SEXP matstatusSEXP, SEXP immstatusSEXP, SEXP minageSEXP, SEXP maxageSEXP, SEXP indatasetSEXP, SEXP sizeminSEXP, SEXP sizebminSEXP, SEXP sizecminSEXP, SEXP sizemaxSEXP, SEXP sizebmaxSEXP, SEXP sizecmaxSEXP, SEXP binhalfwidthSEXP, SEXP binhalfwidthbSEXP, SEXP binhalfwidthcSEXP, SEXP groupSEXP, SEXP commentsSEXP, SEXP roundsizeSEXP, SEXP roundsizebSEXP, SEXP roundsizecSEXP, SEXP ipmbinsSEXP, SEXP ipmbinsbSEXP, SEXP ipmbinscSEXP) {
@@ -1196,8 +1251,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_lefko3_jpf", (DL_FUNC) &_lefko3_jpf, 54},
     {"_lefko3_density3", (DL_FUNC) &_lefko3_density3, 5},
     {"_lefko3_bootstrap3", (DL_FUNC) &_lefko3_bootstrap3, 11},
-    {"_lefko3_hoffmannofstuttgart", (DL_FUNC) &_lefko3_hoffmannofstuttgart, 4},
-    {"_lefko3_hoffmannofstuttgart_sp", (DL_FUNC) &_lefko3_hoffmannofstuttgart_sp, 4},
+    {"_lefko3_write_lefko", (DL_FUNC) &_lefko3_write_lefko, 2},
+    {"_lefko3_read_lefko", (DL_FUNC) &_lefko3_read_lefko, 1},
     {"_lefko3_cond_hmpm", (DL_FUNC) &_lefko3_cond_hmpm, 3},
     {"_lefko3_cond_diff", (DL_FUNC) &_lefko3_cond_diff, 4},
     {"_lefko3_ricker3", (DL_FUNC) &_lefko3_ricker3, 9},
@@ -1208,7 +1263,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_lefko3_binomial_test", (DL_FUNC) &_lefko3_binomial_test, 1},
     {"_lefko3_sf_reassess", (DL_FUNC) &_lefko3_sf_reassess, 8},
     {"_lefko3_sf_skeleton", (DL_FUNC) &_lefko3_sf_skeleton, 2},
-    {"_lefko3_hist_null", (DL_FUNC) &_lefko3_hist_null, 3},
+    {"_lefko3_hist_null", (DL_FUNC) &_lefko3_hist_null, 5},
     {"_lefko3_lmean", (DL_FUNC) &_lefko3_lmean, 3},
     {"_lefko3_add_stage", (DL_FUNC) &_lefko3_add_stage, 4},
     {"_lefko3_cycle_check", (DL_FUNC) &_lefko3_cycle_check, 2},
@@ -1227,18 +1282,20 @@ static const R_CallMethodDef CallEntries[] = {
     {"_lefko3_elas3sp_matrix", (DL_FUNC) &_lefko3_elas3sp_matrix, 1},
     {"_lefko3_elas3hlefko", (DL_FUNC) &_lefko3_elas3hlefko, 3},
     {"_lefko3_elas3sp_hlefko", (DL_FUNC) &_lefko3_elas3sp_hlefko, 3},
-    {"_lefko3_proj3", (DL_FUNC) &_lefko3_proj3, 8},
-    {"_lefko3_proj3sp", (DL_FUNC) &_lefko3_proj3sp, 6},
-    {"_lefko3_projection3", (DL_FUNC) &_lefko3_projection3, 19},
-    {"_lefko3_slambda3", (DL_FUNC) &_lefko3_slambda3, 5},
-    {"_lefko3_stoch_senselas", (DL_FUNC) &_lefko3_stoch_senselas, 7},
-    {"_lefko3_ltre3matrix", (DL_FUNC) &_lefko3_ltre3matrix, 5},
+    {"_lefko3_proj3", (DL_FUNC) &_lefko3_proj3, 10},
+    {"_lefko3_proj3sp", (DL_FUNC) &_lefko3_proj3sp, 8},
+    {"_lefko3_projection3", (DL_FUNC) &_lefko3_projection3, 23},
+    {"_lefko3_equilibrium3", (DL_FUNC) &_lefko3_equilibrium3, 11},
+    {"_lefko3_slambda3", (DL_FUNC) &_lefko3_slambda3, 8},
+    {"_lefko3_stoch_senselas", (DL_FUNC) &_lefko3_stoch_senselas, 9},
+    {"_lefko3_ltre3matrix", (DL_FUNC) &_lefko3_ltre3matrix, 6},
     {"_lefko3_sltre3matrix", (DL_FUNC) &_lefko3_sltre3matrix, 9},
     {"_lefko3_snaltre3matrix", (DL_FUNC) &_lefko3_snaltre3matrix, 7},
     {"_lefko3_markov_run", (DL_FUNC) &_lefko3_markov_run, 4},
     {"_lefko3_stovokor", (DL_FUNC) &_lefko3_stovokor, 49},
     {"_lefko3_create_pm", (DL_FUNC) &_lefko3_create_pm, 1},
     {"_lefko3_miniMod", (DL_FUNC) &_lefko3_miniMod, 9},
+    {"_lefko3_glm_dredge", (DL_FUNC) &_lefko3_glm_dredge, 13},
     {"_lefko3_sf_create", (DL_FUNC) &_lefko3_sf_create, 29},
     {"_lefko3_actualstage3", (DL_FUNC) &_lefko3_actualstage3, 10},
     {"_lefko3_density_input", (DL_FUNC) &_lefko3_density_input, 12},